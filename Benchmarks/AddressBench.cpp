@@ -0,0 +1,665 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: benchmarks of the address classes
+//======================================================================================================================
+
+#include "BenchUtils.hpp"
+
+#include "../NetAddress.hpp"
+#include "../NetAddressSort.hpp"
+#include "../IPAddrBatch.hpp"
+
+#include <random>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <vector>
+#include <cstdio>
+
+using namespace own;
+using namespace own::bench;
+
+
+//======================================================================================================================
+//  input generation
+
+enum class AddrMix
+{
+	OnlyV4,
+	OnlyV6,
+	Mixed
+};
+
+static const char * enumString( AddrMix mix ) noexcept
+{
+	switch (mix)
+	{
+		case AddrMix::OnlyV4: return "v4";
+		case AddrMix::OnlyV6: return "v6";
+		default:              return "mixed";
+	}
+}
+
+/// Generates textual addresses in the form commonly seen in logs.
+static std::vector< std::string > generateAddrStrings( size_t count, AddrMix mix )
+{
+	std::mt19937 rng( 12345 );
+	auto random = [ &rng ]( unsigned range ) { return unsigned( rng() % range ); };
+	std::vector< std::string > strings;
+	strings.reserve( count );
+	char str [64];
+	for (size_t i = 0; i < count; ++i)
+	{
+		bool v6 = mix == AddrMix::OnlyV6 || (mix == AddrMix::Mixed && random( 2 ));
+		if (!v6)
+		{
+			snprintf( str, sizeof(str), "%u.%u.%u.%u", random( 256 ), random( 256 ), random( 256 ), random( 256 ) );
+		}
+		else if (random( 2 ))
+		{
+			snprintf( str, sizeof(str), "2001:db8:%x:%x::%x", random( 0x10000 ), random( 0x10000 ), random( 0x10000 ) );
+		}
+		else
+		{
+			snprintf( str, sizeof(str), "fe80:%x:%x:%x:%x:%x:%x:%x",
+				random( 0x10000 ), random( 0x10000 ), random( 0x10000 ), random( 0x10000 ),
+				random( 0x10000 ), random( 0x10000 ), random( 0x10000 ) );
+		}
+		strings.emplace_back( str );
+	}
+	return strings;
+}
+
+
+//======================================================================================================================
+//  parsing
+
+CPPNETWORK_BENCHMARK( addr_parse )
+{
+	static const AddrMix mixes [] = { AddrMix::OnlyV4, AddrMix::OnlyV6, AddrMix::Mixed };
+
+	for (AddrMix mix : mixes)
+	{
+		std::vector< std::string > strings = generateAddrStrings( report.iters( 1000000 ), mix );
+		size_t failures = 0;
+
+		auto start = Clock::now();
+		for (const std::string & str : strings)
+		{
+			std::istringstream is( str );
+			IPAddr addr;
+			if (!(is >> addr))
+				++failures;
+			doNotOptimize( addr );
+		}
+		double streamTime = secondsSince( start );
+
+		start = Clock::now();
+		for (const std::string & str : strings)
+		{
+			std::optional< IPAddr > addr = IPAddr::parse( str );
+			if (!addr)
+				++failures;
+			doNotOptimize( addr );
+		}
+		double parseTime = secondsSince( start );
+
+		double count = double( strings.size() );
+		report.add( Result( "addr_parse" )
+			.param( "mix", enumString( mix ) )
+			.param( "count", count )
+			.metric( "istream_ns_per_addr", streamTime * 1e9 / count )
+			.metric( "parse_ns_per_addr", parseTime * 1e9 / count )
+			.metric( "parse_Maddr_per_s", count / parseTime / 1e6 )
+			.metric( "speedup", streamTime / parseTime )
+			.metric( "failures", double( failures ) )
+		);
+	}
+}
+
+
+//======================================================================================================================
+//  formatting
+
+static std::vector< IPAddr > generateAddrs( size_t count, AddrMix mix )
+{
+	std::vector< IPAddr > addrs;
+	addrs.reserve( count );
+	for (const std::string & str : generateAddrStrings( count, mix ))
+		addrs.push_back( *IPAddr::parse( str ) );
+	return addrs;
+}
+
+CPPNETWORK_BENCHMARK( addr_format )
+{
+	static const AddrMix mixes [] = { AddrMix::OnlyV4, AddrMix::OnlyV6, AddrMix::Mixed };
+
+	for (AddrMix mix : mixes)
+	{
+		std::vector< IPAddr > addrs = generateAddrs( report.iters( 1000000 ), mix );
+		size_t totalLength = 0;
+
+		// what every caller had to do before
+		auto start = Clock::now();
+		for (const IPAddr & addr : addrs)
+		{
+			std::ostringstream os;
+			os << addr;
+			totalLength += os.str().size();
+		}
+		double streamTime = secondsSince( start );
+
+		start = Clock::now();
+		for (const IPAddr & addr : addrs)
+		{
+			std::string str = addr.toString();
+			totalLength += str.size();
+		}
+		double toStringTime = secondsSince( start );
+
+		char buffer [IPAddr::MAX_STR_LEN];
+		start = Clock::now();
+		for (const IPAddr & addr : addrs)
+		{
+			totalLength += addr.toChars( buffer, sizeof(buffer) );
+			doNotOptimize( buffer );
+		}
+		double toCharsTime = secondsSince( start );
+
+		doNotOptimize( totalLength );
+		double count = double( addrs.size() );
+		report.add( Result( "addr_format" )
+			.param( "mix", enumString( mix ) )
+			.param( "count", count )
+			.metric( "ostringstream_ns_per_addr", streamTime * 1e9 / count )
+			.metric( "to_string_ns_per_addr", toStringTime * 1e9 / count )
+			.metric( "to_chars_ns_per_addr", toCharsTime * 1e9 / count )
+			.metric( "to_chars_Maddr_per_s", count / toCharsTime / 1e6 )
+		);
+	}
+}
+
+CPPNETWORK_BENCHMARK( endpoint_format )
+{
+	std::vector< IPAddr > addrs = generateAddrs( report.iters( 1000000 ), AddrMix::Mixed );
+	std::vector< Endpoint > endpoints;
+	endpoints.reserve( addrs.size() );
+	for (size_t i = 0; i < addrs.size(); ++i)
+		endpoints.push_back({ addrs[i], uint16_t( i * 7919 ) });
+
+	char buffer [Endpoint::MAX_STR_LEN];
+	size_t totalLength = 0;
+	auto start = Clock::now();
+	for (const Endpoint & endpoint : endpoints)
+	{
+		totalLength += endpoint.toChars( buffer, sizeof(buffer) );
+		doNotOptimize( buffer );
+	}
+	double elapsed = secondsSince( start );
+
+	doNotOptimize( totalLength );
+	double count = double( endpoints.size() );
+	report.add( Result( "endpoint_format" )
+		.param( "count", count )
+		.metric( "to_chars_ns_per_endpoint", elapsed * 1e9 / count )
+		.metric( "to_chars_Mendpoints_per_s", count / elapsed / 1e6 )
+	);
+}
+
+
+//======================================================================================================================
+//  comparison, sorting and hashing
+
+/// the byte-by-byte comparison the address classes used before, as a baseline
+static bool bytewiseLess( const IPAddr & a1, const IPAddr & a2 )
+{
+	if (a1.version() != a2.version())
+		return a1.version() < a2.version();
+	return std::lexicographical_compare( a1.data().begin(), a1.data().end(), a2.data().begin(), a2.data().end() );
+}
+
+static std::vector< Endpoint > generateEndpoints( size_t count )
+{
+	std::vector< IPAddr > addrs = generateAddrs( count, AddrMix::Mixed );
+	std::vector< Endpoint > endpoints;
+	endpoints.reserve( addrs.size() );
+	std::mt19937 rng( 54321 );
+	for (const IPAddr & addr : addrs)
+		endpoints.push_back({ addr, uint16_t( rng() ) });
+	return endpoints;
+}
+
+CPPNETWORK_BENCHMARK( addr_sort )
+{
+	const size_t count = report.iters( 10000000 );
+
+	{
+		std::vector< IPAddr > original = generateAddrs( count, AddrMix::Mixed );
+
+		std::vector< IPAddr > addrs = original;
+		auto start = Clock::now();
+		std::sort( addrs.begin(), addrs.end(), bytewiseLess );
+		double bytewiseTime = secondsSince( start );
+
+		addrs = original;
+		start = Clock::now();
+		std::sort( addrs.begin(), addrs.end() );
+		double stdSortTime = secondsSince( start );
+
+		addrs = original;
+		start = Clock::now();
+		radixSort( addrs );
+		double radixTime = secondsSince( start );
+
+		report.add( Result( "addr_sort" )
+			.param( "type", "IPAddr" )
+			.param( "count", double( count ) )
+			.metric( "std_sort_bytewise_s", bytewiseTime )
+			.metric( "std_sort_s", stdSortTime )
+			.metric( "radix_sort_s", radixTime )
+			.metric( "radix_sort_Melem_per_s", double( count ) / radixTime / 1e6 )
+		);
+	}
+	{
+		std::vector< Endpoint > original = generateEndpoints( count );
+
+		std::vector< Endpoint > endpoints = original;
+		auto start = Clock::now();
+		std::sort( endpoints.begin(), endpoints.end() );
+		double stdSortTime = secondsSince( start );
+
+		endpoints = original;
+		start = Clock::now();
+		radixSort( endpoints );
+		double radixTime = secondsSince( start );
+
+		report.add( Result( "addr_sort" )
+			.param( "type", "Endpoint" )
+			.param( "count", double( count ) )
+			.metric( "std_sort_s", stdSortTime )
+			.metric( "radix_sort_s", radixTime )
+			.metric( "radix_sort_Melem_per_s", double( count ) / radixTime / 1e6 )
+		);
+	}
+}
+
+CPPNETWORK_BENCHMARK( addr_compare )
+{
+	// the comparison and the hash read all the 16 bytes, so an address that held IPv6 before must not keep any of it
+	IPAddr fresh = IPv4Addr{ 1, 2, 3, 4 };
+	IPAddr reused;
+	std::istringstream input( "2001:db8::1 1.2.3.4" );
+	input >> reused >> reused;
+	bool streamReuseOk = reused == fresh && reused.hash() == fresh.hash();
+	reused = *IPAddr::parse( "2001:db8::1" );
+	reused = *IPAddr::parse( "1.2.3.4" );
+	bool parseReuseOk = reused == fresh && reused.hash() == fresh.hash();
+	if (!streamReuseOk || !parseReuseOk)
+		fprintf( stderr, "addr_compare: an IPAddr reused for IPv6 and then IPv4 differs from a fresh one\n" );
+
+	std::vector< IPAddr > addrs = generateAddrs( report.iters( 10000000 ), AddrMix::Mixed );
+	size_t count = addrs.size();
+	size_t less = 0, equal = 0;
+
+	auto start = Clock::now();
+	for (size_t i = 1; i < count; ++i)
+		less += bytewiseLess( addrs[ i - 1 ], addrs[i] );
+	double bytewiseTime = secondsSince( start );
+
+	start = Clock::now();
+	for (size_t i = 1; i < count; ++i)
+		less += addrs[ i - 1 ] < addrs[i];
+	double lessTime = secondsSince( start );
+
+	start = Clock::now();
+	for (size_t i = 1; i < count; ++i)
+		equal += addrs[ i - 1 ] == addrs[i];
+	double equalTime = secondsSince( start );
+
+	doNotOptimize( less );
+	doNotOptimize( equal );
+	report.add( Result( "addr_compare" )
+		.param( "count", double( count ) )
+		.metric( "bytewise_less_ns", bytewiseTime * 1e9 / double( count ) )
+		.metric( "less_ns", lessTime * 1e9 / double( count ) )
+		.metric( "equal_ns", equalTime * 1e9 / double( count ) )
+	);
+}
+
+CPPNETWORK_BENCHMARK( addr_hash )
+{
+	const size_t count = report.iters( 10000000 );
+	std::vector< Endpoint > endpoints = generateEndpoints( count );
+
+	size_t combined = 0;
+	auto start = Clock::now();
+	for (const Endpoint & ep : endpoints)
+		combined ^= std::hash< IPAddr >()( ep.addr );
+	double addrHashTime = secondsSince( start );
+
+	start = Clock::now();
+	for (const Endpoint & ep : endpoints)
+		combined ^= std::hash< Endpoint >()( ep );
+	double endpointHashTime = secondsSince( start );
+	doNotOptimize( combined );
+
+	start = Clock::now();
+	std::unordered_set< Endpoint > set;
+	set.reserve( count );
+	for (const Endpoint & ep : endpoints)
+		set.insert( ep );
+	double insertTime = secondsSince( start );
+
+	start = Clock::now();
+	size_t found = 0;
+	for (const Endpoint & ep : endpoints)
+		found += set.count( ep );
+	double lookupTime = secondsSince( start );
+	doNotOptimize( found );
+
+	report.add( Result( "addr_hash" )
+		.param( "count", double( count ) )
+		.metric( "ipaddr_hash_ns", addrHashTime * 1e9 / double( count ) )
+		.metric( "endpoint_hash_ns", endpointHashTime * 1e9 / double( count ) )
+		.metric( "unordered_set_insert_ns", insertTime * 1e9 / double( count ) )
+		.metric( "unordered_set_lookup_ns", lookupTime * 1e9 / double( count ) )
+	);
+}
+
+
+CPPNETWORK_BENCHMARK( endpoint_native_conversion )
+{
+	const size_t count = report.iters( 10000000 );
+	std::vector< Endpoint > endpoints = generateEndpoints( count );
+	std::vector< NativeEndpoint > natives( endpoints.size() );
+
+	// what every send with Endpoint pays
+	auto start = Clock::now();
+	for (size_t i = 0; i < endpoints.size(); ++i)
+		natives[i] = NativeEndpoint( endpoints[i] );
+	double toNativeTime = secondsSince( start );
+
+	// what every receive into Endpoint pays
+	uint64_t sum = 0;
+	start = Clock::now();
+	for (const NativeEndpoint & native : natives)
+	{
+		Endpoint ep = native.toEndpoint();
+		sum += ep.port + ep.addr[0];
+	}
+	double fromNativeTime = secondsSince( start );
+
+	// what the senders and receivers with NativeEndpoint pay for reading the port and the address
+	start = Clock::now();
+	for (const NativeEndpoint & native : natives)
+		sum += native.port() + native.addr()[0];
+	double accessorTime = secondsSince( start );
+	doNotOptimize( sum );
+
+	report.add( Result( "endpoint_native_conversion" )
+		.param( "count", double( count ) )
+		.metric( "to_native_ns", toNativeTime * 1e9 / double( count ) )
+		.metric( "from_native_ns", fromNativeTime * 1e9 / double( count ) )
+		.metric( "native_accessors_ns", accessorTime * 1e9 / double( count ) )
+		.metric( "native_endpoint_bytes", double( sizeof( NativeEndpoint ) ) )
+	);
+}
+
+//======================================================================================================================
+//  connection table
+
+/// the previous layout of Endpoint with the version stored as int, kept to measure the memory difference
+struct WideEndpoint
+{
+	uint8_t data [16];
+	int version;
+	uint16_t port;
+
+	bool operator==( const WideEndpoint & other ) const noexcept
+	{
+		return memcmp( data, other.data, 16 ) == 0 && version == other.version && port == other.port;
+	}
+	bool operator<( const WideEndpoint & other ) const noexcept
+	{
+		if (version != other.version)
+			return version < other.version;
+		int addrCmp = priv::addrCompare< 16 >( data, other.data );
+		return addrCmp != 0 ? addrCmp < 0 : port < other.port;
+	}
+};
+struct WideEndpointHash
+{
+	size_t operator()( const WideEndpoint & ep ) const noexcept
+	{
+		return priv::hashWords( priv::loadNative64( ep.data ), priv::loadNative64( ep.data + 8 ) ^ (uint64_t( ep.version ) << 16 | ep.port) );
+	}
+};
+
+static size_t g_allocatedBytes = 0;
+
+/// counts the memory allocated by a container
+template< typename T >
+struct CountingAllocator
+{
+	using value_type = T;
+	CountingAllocator() noexcept = default;
+	template< typename U > CountingAllocator( const CountingAllocator< U > & ) noexcept {}
+	T * allocate( size_t n )
+	{
+		g_allocatedBytes += n * sizeof( T );
+		return std::allocator< T >().allocate( n );
+	}
+	void deallocate( T * ptr, size_t n ) noexcept
+	{
+		g_allocatedBytes -= n * sizeof( T );
+		std::allocator< T >().deallocate( ptr, n );
+	}
+	template< typename U > bool operator==( const CountingAllocator< U > & ) const noexcept { return true; }
+	template< typename U > bool operator!=( const CountingAllocator< U > & ) const noexcept { return false; }
+};
+
+/// per-connection state of a typical server, keyed by the remote endpoint
+/** Node-based maps round every node up to 8 bytes, so there the smaller key often disappears in the padding. */
+struct ConnectionState
+{
+	uint64_t bytesReceived;
+	uint32_t lastActivity;
+	uint32_t id;
+};
+
+template< typename Key, typename Hash >
+static void measureConnectionTable( const std::vector< Key > & keys, Result & result, const char * prefix )
+{
+	using Table = std::unordered_map< Key, ConnectionState, Hash, std::equal_to< Key >, CountingAllocator< std::pair< const Key, ConnectionState > > >;
+
+	size_t allocatedBefore = g_allocatedBytes;
+	auto start = Clock::now();
+	Table table;
+	table.reserve( keys.size() );
+	for (size_t i = 0; i < keys.size(); ++i)
+		table.emplace( keys[i], ConnectionState{ 0, 0, uint32_t( i ) } );
+	double insertTime = secondsSince( start );
+	size_t tableBytes = g_allocatedBytes - allocatedBefore;
+
+	start = Clock::now();
+	uint64_t sum = 0;
+	for (const Key & key : keys)
+	{
+		auto iter = table.find( key );
+		sum += iter != table.end() ? iter->second.id : 0;
+	}
+	double lookupTime = secondsSince( start );
+
+	// sorted flat table of endpoints and connection indexes, looked up by binary search
+	using FlatEntry = std::pair< Key, uint32_t >;
+	std::vector< FlatEntry > flat;
+	flat.reserve( keys.size() );
+	for (size_t i = 0; i < keys.size(); ++i)
+		flat.emplace_back( keys[i], uint32_t( i ) );
+	auto keyLess = []( const FlatEntry & a, const FlatEntry & b ) { return a.first < b.first; };
+	std::sort( flat.begin(), flat.end(), keyLess );
+	size_t flatBytes = flat.size() * sizeof( FlatEntry );
+
+	start = Clock::now();
+	for (const Key & key : keys)
+	{
+		auto iter = std::lower_bound( flat.begin(), flat.end(), FlatEntry{ key, 0 }, keyLess );
+		sum += iter != flat.end() ? iter->second : 0;
+	}
+	double flatLookupTime = secondsSince( start );
+	doNotOptimize( sum );
+
+	double count = double( keys.size() );
+	auto name = [ prefix ]( const char * metric ) { return std::string( prefix ) + metric; };
+	result.metric( name( "_endpoint_bytes" ).c_str(), double( sizeof( Key ) ) )
+	      .metric( name( "_map_MB" ).c_str(), double( tableBytes ) / 1e6 )
+	      .metric( name( "_map_insert_ns" ).c_str(), insertTime * 1e9 / count )
+	      .metric( name( "_map_lookup_ns" ).c_str(), lookupTime * 1e9 / count )
+	      .metric( name( "_flat_MB" ).c_str(), double( flatBytes ) / 1e6 )
+	      .metric( name( "_flat_lookup_ns" ).c_str(), flatLookupTime * 1e9 / count );
+}
+
+CPPNETWORK_BENCHMARK( connection_table )
+{
+	std::vector< Endpoint > endpoints = generateEndpoints( report.iters( 2000000 ) );
+	std::sort( endpoints.begin(), endpoints.end() );
+	endpoints.erase( std::unique( endpoints.begin(), endpoints.end() ), endpoints.end() );
+	std::shuffle( endpoints.begin(), endpoints.end(), std::mt19937( 999 ) );
+
+	std::vector< WideEndpoint > wideEndpoints;
+	wideEndpoints.reserve( endpoints.size() );
+	for (const Endpoint & ep : endpoints)
+	{
+		WideEndpoint wide = {};
+		memcpy( wide.data, ep.addr.data().data(), 16 );
+		wide.version = int( ep.addr.version() );
+		wide.port = ep.port;
+		wideEndpoints.push_back( wide );
+	}
+
+	Result result( "connection_table" );
+	result.param( "connections", double( endpoints.size() ) )
+	      .metric( "ipaddr_bytes", double( sizeof( IPAddr ) ) );
+	measureConnectionTable< Endpoint, std::hash< Endpoint > >( endpoints, result, "compact" );
+	measureConnectionTable< WideEndpoint, WideEndpointHash >( wideEndpoints, result, "wide" );
+	report.add( result );
+}
+
+
+//======================================================================================================================
+//  columnar batches
+
+CPPNETWORK_BENCHMARK( addr_batch )
+{
+	static const AddrMix mixes [] = { AddrMix::OnlyV4, AddrMix::OnlyV6, AddrMix::Mixed };
+
+	for (AddrMix mix : mixes)
+	{
+		std::vector< std::string > strings = generateAddrStrings( report.iters( 1000000 ), mix );
+		std::string text;
+		for (const std::string & str : strings)
+			text.append( str ).push_back( '\n' );
+		const double count = double( strings.size() );
+		auto rate = [ count ]( double seconds ) { return count / seconds / 1e6; };
+
+		// parsing
+
+		auto start = Clock::now();
+		std::vector< IPAddr > addrs;
+		addrs.reserve( strings.size() );
+		for (std::string_view rest = text; !rest.empty(); )
+		{
+			size_t lineEnd = rest.find( '\n' );
+			if (std::optional< IPAddr > addr = IPAddr::parse( rest.substr( 0, lineEnd ) ))
+				addrs.push_back( *addr );
+			rest.remove_prefix( lineEnd + 1 );
+		}
+		double vectorParseTime = secondsSince( start );
+
+		start = Clock::now();
+		IPAddrBatch batch;
+		batch.reserve( strings.size() );
+		size_t failures = batch.appendParsed( text );
+		double batchParseTime = secondsSince( start );
+
+		// equality filter
+
+		const IPAddr needle = addrs[ addrs.size() / 2 ];
+		std::vector< size_t > vectorFound, batchFound;
+		start = Clock::now();
+		for (size_t i = 0; i < addrs.size(); ++i)
+			if (addrs[i] == needle)
+				vectorFound.push_back( i );
+		double vectorFindTime = secondsSince( start );
+
+		start = Clock::now();
+		batch.findEqual( needle, batchFound );
+		double batchFindTime = secondsSince( start );
+
+		// hashing
+
+		std::vector< size_t > hashes( addrs.size() );
+		start = Clock::now();
+		for (size_t i = 0; i < addrs.size(); ++i)
+			hashes[i] = std::hash< IPAddr >()( addrs[i] );
+		double vectorHashTime = secondsSince( start );
+		doNotOptimize( hashes.data() );
+
+		start = Clock::now();
+		batch.hash( make_span( hashes ) );
+		double batchHashTime = secondsSince( start );
+		doNotOptimize( hashes.data() );
+
+		// masking to /24 and /48 networks
+
+		start = Clock::now();
+		for (IPAddr & addr : addrs)
+			addr = IPPrefix( addr, addr.version() == IPVer::_4 ? 24 : 48 ).addr();
+		double vectorMaskTime = secondsSince( start );
+
+		start = Clock::now();
+		batch.maskToPrefix( 24, 48 );
+		double batchMaskTime = secondsSince( start );
+
+		// deduplication of the networks
+
+		start = Clock::now();
+		std::sort( addrs.begin(), addrs.end() );
+		addrs.erase( std::unique( addrs.begin(), addrs.end() ), addrs.end() );
+		double vectorDedupTime = secondsSince( start );
+
+		start = Clock::now();
+		batch.deduplicate();
+		double batchDedupTime = secondsSince( start );
+
+		if (vectorFound != batchFound || batch.size() != addrs.size())
+			fprintf( stderr, "addr_batch: the batch results differ from the vector ones\n" );
+
+		size_t batchBytes = batch.v4Count() * 4 + batch.v6Count() * 16 + batch.size() / 8;
+		report.add( Result( "addr_batch" )
+			.param( "mix", enumString( mix ) )
+			.param( "count", count )
+			.metric( "vector_parse_Maddr_per_s", rate( vectorParseTime ) )
+			.metric( "batch_parse_Maddr_per_s", rate( batchParseTime ) )
+			.metric( "vector_find_Maddr_per_s", rate( vectorFindTime ) )
+			.metric( "batch_find_Maddr_per_s", rate( batchFindTime ) )
+			.metric( "vector_hash_Maddr_per_s", rate( vectorHashTime ) )
+			.metric( "batch_hash_Maddr_per_s", rate( batchHashTime ) )
+			.metric( "vector_mask_Maddr_per_s", rate( vectorMaskTime ) )
+			.metric( "batch_mask_Maddr_per_s", rate( batchMaskTime ) )
+			.metric( "vector_dedup_Maddr_per_s", rate( vectorDedupTime ) )
+			.metric( "batch_dedup_Maddr_per_s", rate( batchDedupTime ) )
+			.metric( "vector_bytes_per_addr", double( sizeof( IPAddr ) ) )
+			.metric( "batch_bytes_per_addr_after_dedup", batch.empty() ? 0.0 : double( batchBytes ) / double( batch.size() ) )
+			.metric( "failures", double( failures ) )
+		);
+	}
+}
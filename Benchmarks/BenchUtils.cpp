@@ -0,0 +1,183 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: minimal benchmark harness producing machine-readable JSON reports
+//======================================================================================================================
+
+#include "BenchUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+
+#ifndef _WIN32
+	#include <net/if.h>  // if_nametoindex
+#endif
+
+
+namespace own {
+namespace bench {
+
+
+//======================================================================================================================
+//  timing
+
+double percentile( std::vector< double > & samples, double p )
+{
+	if (samples.empty())
+		return 0.0;
+	size_t idx = std::min( size_t( p * double( samples.size() ) ), samples.size() - 1 );
+	std::nth_element( samples.begin(), samples.begin() + ptrdiff_t( idx ), samples.end() );
+	return samples[ idx ];
+}
+
+
+//======================================================================================================================
+//  results
+
+static std::string jsonNumber( double value )
+{
+	if (!std::isfinite( value ))
+		return "null";
+	char str [32];
+	if (value == std::floor( value ) && std::fabs( value ) < 1e15)
+		snprintf( str, sizeof(str), "%.0f", value );  // counts and sizes should stay exact
+	else
+		snprintf( str, sizeof(str), "%.6g", value );
+	return str;
+}
+
+static std::string jsonString( const char * value )
+{
+	std::string str = "\"";
+	for (const char * c = value; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+			str += '\\';
+		str += *c;
+	}
+	str += '"';
+	return str;
+}
+
+Result & Result::param( const char * key, double value )
+{
+	params.emplace_back( key, jsonNumber( value ) );
+	return *this;
+}
+
+Result & Result::param( const char * key, const char * value )
+{
+	params.emplace_back( key, jsonString( value ) );
+	return *this;
+}
+
+Result & Result::metric( const char * key, double value )
+{
+	metrics.emplace_back( key, value );
+	return *this;
+}
+
+void Report::add( Result result )
+{
+	_results.push_back( move( result ) );
+}
+
+void Report::writeJson( std::ostream & os ) const
+{
+	os << "{\n";
+	os << "  \"suite\": \"CppNetwork_Bench\",\n";
+	os << "  \"format_version\": 1,\n";
+	os << "  \"quick\": " << (_quick ? "true" : "false") << ",\n";
+	os << "  \"results\": [";
+	for (size_t i = 0; i < _results.size(); ++i)
+	{
+		const Result & result = _results[i];
+		os << (i == 0 ? "\n" : ",\n");
+		os << "    { \"name\": " << jsonString( result.name.c_str() ) << ", \"params\": {";
+		for (size_t j = 0; j < result.params.size(); ++j)
+		{
+			os << (j == 0 ? " " : ", ") << jsonString( result.params[j].first.c_str() ) << ": " << result.params[j].second;
+		}
+		os << " }, \"metrics\": {";
+		for (size_t j = 0; j < result.metrics.size(); ++j)
+		{
+			os << (j == 0 ? " " : ", ") << jsonString( result.metrics[j].first.c_str() ) << ": " << jsonNumber( result.metrics[j].second );
+		}
+		os << " } }";
+	}
+	os << "\n  ]\n";
+	os << "}\n";
+}
+
+
+//======================================================================================================================
+//  registration
+
+static std::vector< RegisteredBench > & benchList()
+{
+	static std::vector< RegisteredBench > list;  // function-local, so that it's constructed before the first use
+	return list;
+}
+
+bool registerBenchmark( const char * name, BenchFunc func )
+{
+	benchList().push_back({ name, func });
+	return true;
+}
+
+const std::vector< RegisteredBench > & registeredBenchmarks()
+{
+	return benchList();
+}
+
+
+//======================================================================================================================
+//  loopback helpers
+
+static constexpr uint16_t FIRST_BENCH_PORT = 41000;
+static constexpr uint16_t LAST_BENCH_PORT = 41999;
+
+static uint16_t g_nextPort = FIRST_BENCH_PORT;  // ports in TIME_WAIT state can't be reused right away, so rotate them
+
+template< typename SocketType >
+static uint16_t openOnFreePortImpl( SocketType & socket )
+{
+	for (uint16_t attempt = FIRST_BENCH_PORT; attempt <= LAST_BENCH_PORT; ++attempt)
+	{
+		uint16_t port = g_nextPort;
+		g_nextPort = (g_nextPort < LAST_BENCH_PORT) ? uint16_t( g_nextPort + 1 ) : FIRST_BENCH_PORT;
+		if (socket.open( port ) == SocketError::Success)
+			return port;
+	}
+	return 0;
+}
+
+uint16_t openOnFreePort( TcpServerSocket & server )
+{
+	return openOnFreePortImpl( server );
+}
+
+uint16_t openOnFreePort( UdpSocket & socket )
+{
+	return openOnFreePortImpl( socket );
+}
+
+uint32_t loopbackInterfaceIndex()
+{
+ #ifdef _WIN32
+	return 1;  // the loopback pseudo-interface always has this index
+ #else
+	uint32_t index = if_nametoindex( "lo" );  // Linux
+	return index != 0 ? index : if_nametoindex( "lo0" );  // BSD, macOS
+ #endif // _WIN32
+}
+
+
+//======================================================================================================================
+
+
+} // namespace bench
+} // namespace own
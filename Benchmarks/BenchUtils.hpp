@@ -0,0 +1,143 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: minimal benchmark harness producing machine-readable JSON reports
+//======================================================================================================================
+
+#ifndef CPPUTILS_NETWORK_BENCH_UTILS_INCLUDED
+#define CPPUTILS_NETWORK_BENCH_UTILS_INCLUDED
+
+
+#include "../Socket.hpp"
+
+#include <CppUtils-Essential/Essential.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iosfwd>
+
+
+namespace own {
+namespace bench {
+
+
+//======================================================================================================================
+//  timing
+
+using Clock = std::chrono::steady_clock;
+
+inline double secondsSince( Clock::time_point start ) noexcept
+{
+	return std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+/// Returns the p-th percentile (0.0 - 1.0) of the samples. The samples get reordered.
+double percentile( std::vector< double > & samples, double p );
+
+/// Prevents the optimizer from eliminating a computation whose result is otherwise unused.
+template< typename Type >
+inline void doNotOptimize( const Type & value ) noexcept
+{
+ #if defined(__GNUC__) || defined(__clang__)
+	asm volatile( "" : : "r,m"( value ) : "memory" );
+ #else
+	static const void * volatile sink;
+	sink = &value;
+ #endif
+}
+
+
+//======================================================================================================================
+//  results
+
+/// One measured configuration of one benchmark.
+struct Result
+{
+	std::string name;
+	std::vector< std::pair< std::string, std::string > > params;  ///< values are already formatted as JSON
+	std::vector< std::pair< std::string, double > > metrics;
+
+	Result( std::string resultName ) : name( move( resultName ) ) {}
+
+	Result & param( const char * key, double value );
+	Result & param( const char * key, const char * value );
+	Result & metric( const char * key, double value );
+};
+
+/// Collection of results of all benchmarks that were run, serializable to JSON.
+class Report
+{
+
+ public:
+
+	Report( bool quick ) : _quick( quick ) {}
+
+	/// In quick mode the benchmarks scale down their iteration counts, useful for smoke-testing.
+	bool isQuick() const noexcept  { return _quick; }
+
+	/// Scales an iteration count according to the selected mode.
+	size_t iters( size_t full ) const noexcept  { return _quick ? (full / 20 > 0 ? full / 20 : 1) : full; }
+
+	void add( Result result );
+
+	void writeJson( std::ostream & os ) const;
+
+ private:
+
+	std::vector< Result > _results;
+	bool _quick;
+
+};
+
+
+//======================================================================================================================
+//  registration
+
+using BenchFunc = void (*)( Report & report );
+
+bool registerBenchmark( const char * name, BenchFunc func );
+
+struct RegisteredBench
+{
+	const char * name;
+	BenchFunc func;
+};
+const std::vector< RegisteredBench > & registeredBenchmarks();
+
+/// Defines a benchmark function and registers it to be run by the main executable.
+#define CPPNETWORK_BENCHMARK( benchName ) \
+	static void benchName( ::own::bench::Report & report ); \
+	static const bool benchName##_registered = ::own::bench::registerBenchmark( #benchName, &benchName ); \
+	static void benchName( ::own::bench::Report & report )
+
+
+//======================================================================================================================
+//  loopback helpers
+
+/// Endpoint on the loopback interface with the given port.
+inline Endpoint loopback( uint16_t port )
+{
+	return Endpoint{ IPAddr({ 127, 0, 0, 1 }), port };
+}
+
+/// Opens the server on the first free port from a range reserved for benchmarks and returns the port, or 0 on failure.
+uint16_t openOnFreePort( TcpServerSocket & server );
+
+/// Opens the socket on the first free port from a range reserved for benchmarks and returns the port, or 0 on failure.
+uint16_t openOnFreePort( UdpSocket & socket );
+
+/// Index of the loopback network interface, for joining multicast groups on it, or 0 if it's not found.
+uint32_t loopbackInterfaceIndex();
+
+
+//======================================================================================================================
+
+
+} // namespace bench
+} // namespace own
+
+
+#endif // CPPUTILS_NETWORK_BENCH_UTILS_INCLUDED
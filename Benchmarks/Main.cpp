@@ -0,0 +1,89 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: entry point of the benchmark executable
+//======================================================================================================================
+
+#include "BenchUtils.hpp"
+
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+
+using namespace own;
+
+
+static void printUsage( const char * exeName )
+{
+	fprintf( stderr,
+		"Usage: %s [--quick] [--filter <substring>] [--output <file.json>] [--list]\n"
+		"  --quick     scale down the iteration counts (smoke test)\n"
+		"  --filter    run only the benchmarks whose name contains the substring\n"
+		"  --output    write the JSON report into a file instead of the standard output\n"
+		"  --list      list the available benchmarks and exit\n",
+		exeName
+	);
+}
+
+int main( int argc, char * argv [] )
+{
+	bool quick = false;
+	const char * filter = nullptr;
+	const char * outputPath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp( argv[i], "--quick" ) == 0)
+		{
+			quick = true;
+		}
+		else if (strcmp( argv[i], "--filter" ) == 0 && i + 1 < argc)
+		{
+			filter = argv[ ++i ];
+		}
+		else if (strcmp( argv[i], "--output" ) == 0 && i + 1 < argc)
+		{
+			outputPath = argv[ ++i ];
+		}
+		else if (strcmp( argv[i], "--list" ) == 0)
+		{
+			for (const auto & bench : bench::registeredBenchmarks())
+				printf( "%s\n", bench.name );
+			return 0;
+		}
+		else
+		{
+			printUsage( argv[0] );
+			return 1;
+		}
+	}
+
+	bench::Report report( quick );
+
+	for (const auto & bench : bench::registeredBenchmarks())
+	{
+		if (filter && !strstr( bench.name, filter ))
+			continue;
+		fprintf( stderr, "running %s\n", bench.name );
+		bench.func( report );
+	}
+
+	if (outputPath)
+	{
+		std::ofstream file( outputPath );
+		if (!file)
+		{
+			fprintf( stderr, "cannot open %s for writing\n", outputPath );
+			return 1;
+		}
+		report.writeJson( file );
+	}
+	else
+	{
+		report.writeJson( std::cout );
+	}
+
+	return 0;
+}
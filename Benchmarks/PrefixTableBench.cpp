@@ -0,0 +1,280 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: benchmarks of the longest-prefix-match table and the prefix database
+//======================================================================================================================
+
+#include "BenchUtils.hpp"
+
+#include "../NetAddress.hpp"
+#include "../PrefixTable.hpp"
+#include "../PrefixDatabase.hpp"
+
+#include <random>
+#include <cstring>  // memcpy
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace own;
+using namespace own::bench;
+
+
+//======================================================================================================================
+//  input generation
+
+/// Generates prefixes with the length distribution of a full internet routing table (mostly /24 for IPv4, /48 for IPv6).
+static std::vector< std::pair< IPPrefix, uint32_t > > generatePrefixes( size_t count, IPVer version )
+{
+	std::mt19937_64 rng( 777 );
+	std::vector< std::pair< IPPrefix, uint32_t > > entries;
+	entries.reserve( count );
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t lengthDice = uint32_t( rng() % 100 );
+		IPAddr addr;
+		uint8_t length;
+		if (version == IPVer::_4)
+		{
+			length = lengthDice < 60 ? 24 : lengthDice < 95 ? uint8_t( 16 + rng() % 8 ) : uint8_t( 8 + rng() % 25 );
+			uint32_t bits = uint32_t( rng() );
+			addr = IPv4Addr{ uint8_t( bits >> 24 ), uint8_t( bits >> 16 ), uint8_t( bits >> 8 ), uint8_t( bits ) };
+		}
+		else
+		{
+			length = lengthDice < 45 ? 48 : lengthDice < 75 ? uint8_t( 32 + rng() % 16 ) : uint8_t( 19 + rng() % 46 );
+			uint64_t bits = rng();
+			addr = IPv6Addr{ 0x20, uint8_t( 0x01 + bits % 3 ), uint8_t( bits >> 8 ), uint8_t( bits >> 16 ),
+			                 uint8_t( bits >> 24 ), uint8_t( bits >> 32 ), uint8_t( bits >> 40 ), uint8_t( bits >> 48 ),
+			                 0, 0, 0, 0, 0, 0, 0, 0 };
+		}
+		entries.push_back({ IPPrefix( addr, length ), uint32_t( i ) });
+	}
+	return entries;
+}
+
+/// Half of the addresses fall into the stored prefixes, the other half is random.
+static std::vector< IPAddr > generateLookups( const std::vector< std::pair< IPPrefix, uint32_t > > & entries, size_t count )
+{
+	std::mt19937_64 rng( 888 );
+	std::vector< IPAddr > addrs;
+	addrs.reserve( count );
+	for (size_t i = 0; i < count; ++i)
+	{
+		const IPAddr & prefixAddr = entries[ rng() % entries.size() ].first.addr();
+		uint64_t bits = rng();
+		size_t firstRandom = i % 2 ? 0 : (prefixAddr.version() == IPVer::_4 ? 3 : 6);
+		size_t size = prefixAddr.version() == IPVer::_4 ? 4 : 16;
+		uint8_t bytes [16];
+		memcpy( bytes, prefixAddr.data().data(), 16 );
+		for (size_t j = firstRandom; j < size; ++j, bits = bits >> 8 | bits << 56)
+			bytes[j] = uint8_t( bits );
+		addrs.push_back( IPAddr( make_span( bytes, size ) ) );
+	}
+	return addrs;
+}
+
+
+//======================================================================================================================
+//  benchmarks
+
+CPPNETWORK_BENCHMARK( prefix_lookup )
+{
+	const size_t prefixCount = report.iters( 1000000 );
+	const size_t lookupCount = report.iters( 10000000 );
+
+	for (IPVer version : { IPVer::_4, IPVer::_6 })
+	{
+		auto entries = generatePrefixes( prefixCount, version );
+		std::vector< IPAddr > addrs = generateLookups( entries, lookupCount );
+
+		auto start = Clock::now();
+		PrefixTable< uint32_t > table( entries );
+		double buildTime = secondsSince( start );
+
+		size_t matched = 0, found = 0;
+		start = Clock::now();
+		for (const IPAddr & addr : addrs)
+			matched += table.lookup( addr ) != nullptr;
+		double lookupTime = secondsSince( start );
+
+		std::vector< const uint32_t * > values( addrs.size() );
+		start = Clock::now();
+		table.lookup( make_span( addrs ), make_span( values ) );
+		double batchTime = secondsSince( start );
+
+		// dependent lookups expose the full memory latency instead of the throughput
+		uint64_t chain = 0;
+		start = Clock::now();
+		for (size_t i = 0; i < addrs.size(); ++i)
+		{
+			const uint32_t * value = table.lookup( addrs[ (i + chain) % addrs.size() ] );
+			chain = value ? *value & 1 : 0;
+		}
+		double chainedTime = secondsSince( start );
+
+		ConcurrentPrefixTable< uint32_t > concurrent{ PrefixTable< uint32_t >( entries ) };
+		start = Clock::now();
+		for (const IPAddr & addr : addrs)
+			found += concurrent.lookup( addr ).has_value();
+		double concurrentTime = secondsSince( start );
+
+		start = Clock::now();
+		{
+			auto guard = concurrent.read();
+			for (const IPAddr & addr : addrs)
+				found += guard.lookup( addr ) != nullptr;
+		}
+		double singleGuardTime = secondsSince( start );
+
+		doNotOptimize( matched );
+		doNotOptimize( found );
+		doNotOptimize( chain );
+		report.add( Result( "prefix_lookup" )
+			.param( "version", version == IPVer::_4 ? "v4" : "v6" )
+			.param( "prefixes", double( table.size() ) )
+			.metric( "build_s", buildTime )
+			.metric( "memory_MB", double( table.memoryUsage() ) / 1e6 )
+			.metric( "lookup_ns", lookupTime * 1e9 / double( addrs.size() ) )
+			.metric( "batch_lookup_ns", batchTime * 1e9 / double( addrs.size() ) )
+			.metric( "dependent_lookup_ns", chainedTime * 1e9 / double( addrs.size() ) )
+			.metric( "concurrent_lookup_ns", concurrentTime * 1e9 / double( addrs.size() ) )
+			.metric( "concurrent_single_guard_lookup_ns", singleGuardTime * 1e9 / double( addrs.size() ) )
+			.metric( "match_ratio", double( matched ) / double( addrs.size() ) )
+		);
+	}
+}
+
+CPPNETWORK_BENCHMARK( prefix_lookup_during_rebuild )
+{
+	const size_t prefixCount = report.iters( 1000000 );
+	const size_t rebuildCount = report.isQuick() ? 2 : 5;
+
+	auto entries = generatePrefixes( prefixCount, IPVer::_4 );
+	std::vector< IPAddr > addrs = generateLookups( entries, 1 << 20 );
+	ConcurrentPrefixTable< uint32_t > concurrent{ PrefixTable< uint32_t >( entries ) };
+
+	std::atomic< bool > stop = false;
+	std::atomic< uint64_t > lookups = 0;
+	std::thread reader( [&]()
+	{
+		uint64_t done = 0, found = 0;
+		while (!stop.load( std::memory_order_relaxed ))
+		{
+			for (size_t i = 0; i < 1024; ++i, ++done)
+				found += concurrent.lookup( addrs[ done % addrs.size() ] ).has_value();
+		}
+		doNotOptimize( found );
+		lookups = done;
+	});
+
+	auto start = Clock::now();
+	double maxReplaceTime = 0.0;
+	for (size_t i = 0; i < rebuildCount; ++i)
+	{
+		PrefixTable< uint32_t > table( entries );
+		auto replaceStart = Clock::now();
+		concurrent.replace( move( table ) );
+		maxReplaceTime = std::max( maxReplaceTime, secondsSince( replaceStart ) );
+	}
+	double totalTime = secondsSince( start );
+	stop = true;
+	reader.join();
+
+	report.add( Result( "prefix_lookup_during_rebuild" )
+		.param( "prefixes", double( prefixCount ) )
+		.param( "rebuilds", double( rebuildCount ) )
+		.metric( "rebuild_s", totalTime / double( rebuildCount ) )
+		.metric( "max_replace_ms", maxReplaceTime * 1e3 )
+		.metric( "reader_Mlookups_per_s", double( lookups ) / totalTime / 1e6 )
+	);
+}
+
+CPPNETWORK_BENCHMARK( prefix_db_startup )
+{
+	const size_t prefixCount = report.iters( 500000 );
+
+	auto entries = generatePrefixes( prefixCount / 2, IPVer::_4 );
+	auto v6Entries = generatePrefixes( prefixCount / 2, IPVer::_6 );
+	entries.insert( entries.end(), v6Entries.begin(), v6Entries.end() );
+	std::vector< IPAddr > addrs = generateLookups( entries, report.iters( 1000000 ) );
+
+	std::string tempDir = std::filesystem::temp_directory_path().string();
+	std::string textPath = tempDir + "/CppNetwork_Bench_prefixes.txt";
+	std::string dbPath = tempDir + "/CppNetwork_Bench_prefixes.db";
+	{
+		std::ofstream textFile( textPath );
+		for (const auto & entry : entries)
+			textFile << entry.first << ' ' << entry.second << '\n';
+	}
+
+	// the traditional way: parse the text and build the table in memory
+	auto start = Clock::now();
+	std::vector< std::pair< IPPrefix, uint32_t > > parsed;
+	{
+		std::ifstream textFile( textPath );
+		std::string line;
+		while (std::getline( textFile, line ))
+		{
+			size_t spacePos = line.find( ' ' );
+			std::optional< IPPrefix > prefix = IPPrefix::parse( std::string_view( line ).substr( 0, spacePos ) );
+			if (prefix)
+				parsed.emplace_back( *prefix, uint32_t( std::strtoul( line.c_str() + spacePos + 1, nullptr, 10 ) ) );
+		}
+	}
+	PrefixTable< uint32_t > table( move( parsed ) );
+	double textLoadTime = secondsSince( start );
+
+	start = Clock::now();
+	PrefixDatabase< uint32_t > db;
+	PrefixDbError error = db.create( dbPath, table );
+	double createTime = secondsSince( start );
+	db.close();
+	if (error != PrefixDbError::Success)
+	{
+		fprintf( stderr, "prefix_db_startup: cannot create %s: %s\n", dbPath.c_str(), enumString( error ) );
+		return;
+	}
+
+	start = Clock::now();
+	error = db.open( dbPath );
+	double openTime = secondsSince( start );
+
+	// the first lookups after opening page in the file
+	size_t found = 0;
+	const size_t coldCount = std::min( addrs.size(), size_t( 1000 ) );
+	start = Clock::now();
+	for (size_t i = 0; i < coldCount; ++i)
+		found += db.lookup( addrs[i] ) != nullptr;
+	double coldTime = secondsSince( start );
+
+	std::vector< const uint32_t * > values( addrs.size() );
+	start = Clock::now();
+	db.lookup( make_span( addrs ), make_span( values ) );
+	double batchTime = secondsSince( start );
+
+	start = Clock::now();
+	error = db.verify();
+	double verifyTime = secondsSince( start );
+
+	doNotOptimize( found );
+	db.close();
+	std::remove( textPath.c_str() );
+	std::remove( dbPath.c_str() );
+
+	report.add( Result( "prefix_db_startup" )
+		.param( "prefixes", double( table.size() ) )
+		.metric( "text_load_s", textLoadTime )
+		.metric( "create_s", createTime )
+		.metric( "open_us", openTime * 1e6 )
+		.metric( "first_lookup_us", coldTime * 1e6 / double( coldCount ) )
+		.metric( "batch_lookup_ns", batchTime * 1e9 / double( addrs.size() ) )
+		.metric( "verify_s", verifyTime )
+	);
+}
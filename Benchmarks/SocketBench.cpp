@@ -0,0 +1,1814 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: loopback throughput and latency benchmarks of the socket classes
+//======================================================================================================================
+
+#include "BenchUtils.hpp"
+
+#include "../Socket.hpp"
+#include "../ParallelUdpServer.hpp"
+#include "../PacedUdpSender.hpp"
+#include "../ReliableUdp.hpp"
+#include "../ForwardErrorCorrection.hpp"
+#include "../SharedMemoryChannel.hpp"
+#include "../MessageFraming.hpp"
+#include "../BufferedTcpWriter.hpp"
+#include "../MirroredRingBuffer.hpp"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifndef _WIN32
+	#include <unistd.h>    // fork
+	#include <sys/wait.h>  // waitpid
+#endif
+
+using namespace own;
+using namespace own::bench;
+
+
+//======================================================================================================================
+//  TcpSocket
+
+static const size_t g_tcpMessageSizes [] = { 64, 1024, 16 * 1024, 256 * 1024 };
+
+CPPNETWORK_BENCHMARK( tcp_throughput )
+{
+	for (size_t msgSize : g_tcpMessageSizes)
+	{
+		TcpServerSocket server;
+		uint16_t port = openOnFreePort( server );
+		if (port == 0)
+			return;
+
+		const size_t totalBytes = report.iters( 1024 * 1024 * 1024 );
+		const size_t msgCount = totalBytes / msgSize > 0 ? totalBytes / msgSize : 1;
+
+		std::thread receiver( [ &server, msgSize, msgCount ]()
+		{
+			Endpoint clientEp;
+			TcpSocket conn = server.accept( clientEp );
+			std::vector< uint8_t > buffer( msgSize );
+			size_t received;
+			for (size_t i = 0; i < msgCount; ++i)
+				if (conn.receive( make_span( buffer ), received ) != SocketError::Success)
+					return;
+			conn.send( "!" );  // let the sender know everything has arrived
+		});
+
+		TcpSocket client;
+		client.connect( IPAddr({ 127, 0, 0, 1 }), port );
+		std::vector< uint8_t > message( msgSize, 0xAB );
+		uint8_t ack [1];
+		size_t received;
+
+		auto start = Clock::now();
+		for (size_t i = 0; i < msgCount; ++i)
+			client.send( make_span( message ) );
+		client.receive( make_span( ack, 1 ), received );
+		double elapsed = secondsSince( start );
+
+		receiver.join();
+
+		report.add( Result( "tcp_throughput" )
+			.param( "msg_size", double( msgSize ) )
+			.param( "msg_count", double( msgCount ) )
+			.metric( "MiB_per_s", double( msgSize * msgCount ) / elapsed / (1024.0 * 1024.0) )
+			.metric( "msgs_per_s", double( msgCount ) / elapsed )
+		);
+	}
+}
+
+CPPNETWORK_BENCHMARK( tcp_latency )
+{
+	for (size_t msgSize : g_tcpMessageSizes)
+	{
+		TcpServerSocket server;
+		uint16_t port = openOnFreePort( server );
+		if (port == 0)
+			return;
+
+		const size_t roundTrips = report.iters( msgSize <= 1024 ? 50000 : 5000 );
+
+		std::thread echoer( [ &server, msgSize, roundTrips ]()
+		{
+			Endpoint clientEp;
+			TcpSocket conn = server.accept( clientEp );
+			std::vector< uint8_t > buffer( msgSize );
+			size_t received;
+			for (size_t i = 0; i < roundTrips; ++i)
+			{
+				if (conn.receive( make_span( buffer ), received ) != SocketError::Success)
+					return;
+				conn.send( make_span( buffer ) );
+			}
+		});
+
+		TcpSocket client;
+		client.connect( IPAddr({ 127, 0, 0, 1 }), port );
+		std::vector< uint8_t > message( msgSize, 0xCD );
+		std::vector< uint8_t > response( msgSize );
+		std::vector< double > samples;
+		samples.reserve( roundTrips );
+		size_t received;
+
+		for (size_t i = 0; i < roundTrips; ++i)
+		{
+			auto start = Clock::now();
+			client.send( make_span( message ) );
+			client.receive( make_span( response ), received );
+			samples.push_back( secondsSince( start ) * 1e6 );
+		}
+
+		echoer.join();
+
+		double p50 = percentile( samples, 0.50 );
+		double p99 = percentile( samples, 0.99 );
+		report.add( Result( "tcp_latency" )
+			.param( "msg_size", double( msgSize ) )
+			.param( "round_trips", double( roundTrips ) )
+			.metric( "rtt_p50_us", p50 )
+			.metric( "rtt_p99_us", p99 )
+		);
+	}
+}
+
+
+//======================================================================================================================
+//  UdpSocket
+
+static const size_t g_udpPacketSizes [] = { 64, 512, 1400 };
+
+/// sends with either Endpoint, which is converted on every call, or NativeEndpoint, which is passed to the system as it is
+template< typename EndpointType >
+static void measureUdpPacketsPerSecond( Report & report, size_t pktSize, const char * endpointType )
+{
+	UdpSocket receiverSock;
+	uint16_t port = openOnFreePort( receiverSock );
+	if (port == 0)
+		return;
+
+	const size_t pktCount = report.iters( 2000000 );
+	std::atomic< bool > receiverDone( false );
+	size_t receivedCount = 0;
+	double receiveTime = 0.0;
+
+	std::thread receiver( [ & ]()
+	{
+		std::vector< uint8_t > buffer( 2048 );
+		EndpointType senderEp;
+		size_t received;
+		Clock::time_point start;
+		while (receiverSock.recvFrom( senderEp, make_span( buffer ), received ) == SocketError::Success)
+		{
+			if (received == 1)  // end marker
+				break;
+			if (receivedCount++ == 0)
+				start = Clock::now();
+		}
+		receiveTime = receivedCount > 0 ? secondsSince( start ) : 0.0;
+		receiverDone = true;
+	});
+
+	UdpSocket sender;
+	sender.open();
+	std::vector< uint8_t > packet( pktSize, 0x5A );
+	EndpointType target( loopback( port ) );
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < pktCount; ++i)
+		sender.sendTo( target, make_span( packet ) );
+	double sendTime = secondsSince( start );
+
+	// the end marker may get lost the same way as any other datagram, so repeat it until it's noticed
+	uint8_t endMarker [1] = { 0 };
+	while (!receiverDone)
+	{
+		sender.sendTo( target, make_span( endMarker, 1 ) );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+	receiver.join();
+
+	report.add( Result( "udp_packets_per_second" )
+		.param( "endpoint", endpointType )
+		.param( "pkt_size", double( pktSize ) )
+		.param( "pkt_count", double( pktCount ) )
+		.metric( "sent_pps", double( pktCount ) / sendTime )
+		.metric( "received_pps", receiveTime > 0.0 ? double( receivedCount ) / receiveTime : 0.0 )
+		.metric( "loss_ratio", 1.0 - double( receivedCount ) / double( pktCount ) )
+	);
+}
+
+CPPNETWORK_BENCHMARK( udp_packets_per_second )
+{
+	for (size_t pktSize : g_udpPacketSizes)
+	{
+		measureUdpPacketsPerSecond< Endpoint >( report, pktSize, "Endpoint" );
+		measureUdpPacketsPerSecond< NativeEndpoint >( report, pktSize, "NativeEndpoint" );
+	}
+}
+
+
+/// The cost of the send path alone, the receiver doesn't read, so the system drops the datagrams when its queue is full.
+CPPNETWORK_BENCHMARK( udp_connected_send )
+{
+	UdpSocket receiverSock;
+	uint16_t port = openOnFreePort( receiverSock );
+	if (port == 0)
+		return;
+
+	const size_t pktCount = report.iters( 2000000 );
+	uint8_t packet [64] = {};
+
+	UdpSocket sender;
+	sender.open();
+	Endpoint target = loopback( port );
+	auto start = Clock::now();
+	for (size_t i = 0; i < pktCount; ++i)
+		sender.sendTo( target, make_span( packet, sizeof( packet ) ) );
+	double sendToTime = secondsSince( start );
+
+	NativeEndpoint nativeTarget( target );
+	start = Clock::now();
+	for (size_t i = 0; i < pktCount; ++i)
+		sender.sendTo( nativeTarget, make_span( packet, sizeof( packet ) ) );
+	double nativeSendToTime = secondsSince( start );
+
+	UdpPeer peer;
+	if (peer.connect( target ) != SocketError::Success)
+		return;
+	start = Clock::now();
+	for (size_t i = 0; i < pktCount; ++i)
+		peer.send( make_span( packet, sizeof( packet ) ) );
+	double connectedTime = secondsSince( start );
+
+	report.add( Result( "udp_connected_send" )
+		.param( "pkt_size", double( sizeof( packet ) ) )
+		.param( "pkt_count", double( pktCount ) )
+		.metric( "sendto_pps", double( pktCount ) / sendToTime )
+		.metric( "sendto_native_pps", double( pktCount ) / nativeSendToTime )
+		.metric( "connected_send_pps", double( pktCount ) / connectedTime )
+	);
+}
+
+/// sends the datagrams either one by one or segmented by the system, and receives them either one by one or coalesced
+static void measureSegmentationOffload( Report & report, size_t segmentSize, bool segmentedSend, bool coalescedReceive )
+{
+	UdpSocket receiverSock;
+	uint16_t port = openOnFreePort( receiverSock );
+	if (port == 0)
+		return;
+	if (coalescedReceive && receiverSock.setReceiveCoalescing( true ) != SocketError::Success)
+		return;
+	receiverSock.setTimeout( std::chrono::milliseconds( 300 ) );
+
+	const size_t datagramCount = report.iters( 2000000 );
+	const size_t datagramsPerCall = 64;
+	size_t receivedCount = 0;
+	double receiveTime = 0.0;
+
+	std::thread receiver( [ & ]()
+	{
+		std::vector< uint8_t > buffer( 65536 );
+		NativeEndpoint senderEp;
+		size_t received, receivedSegmentSize;
+		Clock::time_point start = Clock::now(), last = start;
+		while (receiverSock.recvCoalesced( senderEp, make_span( buffer ), received, receivedSegmentSize ) == SocketError::Success)
+		{
+			if (receivedCount == 0)
+				start = Clock::now();
+			receivedCount += (received + receivedSegmentSize - 1) / receivedSegmentSize;
+			last = Clock::now();
+		}
+		receiveTime = std::chrono::duration< double >( last - start ).count();
+	});
+
+	UdpSocket sender;
+	sender.open();
+	std::vector< uint8_t > data( segmentSize * datagramsPerCall, 0x5A );
+	NativeEndpoint target( loopback( port ) );
+
+	auto start = Clock::now();
+	for (size_t sent = 0; sent < datagramCount; sent += datagramsPerCall)
+	{
+		if (segmentedSend)
+			sender.sendSegmented( target, make_span( data ), segmentSize );
+		else
+			for (size_t i = 0; i < datagramsPerCall; ++i)
+				sender.sendTo( target, make_span( data.data() + i * segmentSize, segmentSize ) );
+	}
+	double sendTime = secondsSince( start );
+	receiver.join();
+
+	size_t sentCount = (datagramCount + datagramsPerCall - 1) / datagramsPerCall * datagramsPerCall;
+	report.add( Result( "udp_segmentation_offload" )
+		.param( "segment_size", double( segmentSize ) )
+		.param( "send", segmentedSend ? "GSO" : "sendTo" )
+		.param( "receive", coalescedReceive ? "GRO" : "recvFrom" )
+		.metric( "sent_pps", double( sentCount ) / sendTime )
+		.metric( "sent_Gbps", double( sentCount * segmentSize ) * 8.0 / sendTime / 1e9 )
+		.metric( "received_pps", receiveTime > 0.0 ? double( receivedCount ) / receiveTime : 0.0 )
+		.metric( "loss_ratio", 1.0 - double( receivedCount ) / double( sentCount ) )
+	);
+}
+
+CPPNETWORK_BENCHMARK( udp_segmentation_offload )
+{
+	for (size_t segmentSize : { size_t( 512 ), size_t( 1200 ) })
+	{
+		measureSegmentationOffload( report, segmentSize, false, false );
+		measureSegmentationOffload( report, segmentSize, true, false );
+		measureSegmentationOffload( report, segmentSize, true, true );
+	}
+}
+
+/// Several senders flood one port served by a different number of workers, each sender from its own source port,
+/// so that the system spreads them between the workers. Scaling can only show when there are enough CPU cores
+/// for both the senders and the workers.
+static void measureParallelReceive( Report & report, size_t workerCount )
+{
+	// find a free port, the server needs a fixed one for all its sockets
+	UdpSocket probe;
+	uint16_t port = openOnFreePort( probe );
+	if (port == 0)
+		return;
+	probe.close();
+
+	ParallelUdpServer server;
+	ParallelUdpServer::Config config;
+	config.workerCount = workerCount;
+	if (server.start( port, nullptr, config ) != SocketError::Success)
+		return;
+
+	const size_t senderCount = 4;
+	const size_t pktCount = report.iters( 2000000 ) / senderCount;
+	std::vector< std::thread > senders;
+	auto start = Clock::now();
+	for (size_t s = 0; s < senderCount; ++s)
+	{
+		senders.emplace_back( [ & ]()
+		{
+			UdpSocket sender;
+			sender.open();
+			uint8_t packet [64] = {};
+			NativeEndpoint target( loopback( port ) );
+			for (size_t i = 0; i < pktCount; ++i)
+				sender.sendTo( target, make_span( packet, sizeof( packet ) ) );
+		});
+	}
+	for (auto & sender : senders)
+		sender.join();
+	double sendTime = secondsSince( start );
+	// let the workers drain their queues
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+	double totalTime = secondsSince( start ) - 0.1;
+
+	Result result( "parallel_udp_receive" );
+	result.param( "workers", double( server.workerCount() ) )
+	      .param( "senders", double( senderCount ) )
+	      .param( "pkt_size", 64.0 );
+	uint64_t totalReceived = 0, totalDropped = 0, maxReceived = 0;
+	for (size_t w = 0; w < server.workerCount(); ++w)
+	{
+		ParallelUdpServer::WorkerStats stats = server.workerStats( w );
+		totalReceived += stats.datagrams;
+		totalDropped += stats.dropped;
+		maxReceived = (std::max)( maxReceived, stats.datagrams );
+	}
+	server.stop();
+
+	size_t sentCount = pktCount * senderCount;
+	result.metric( "sent_pps", double( sentCount ) / sendTime )
+	      .metric( "received_pps", double( totalReceived ) / totalTime )
+	      .metric( "received_pps_per_worker", double( totalReceived ) / totalTime / double( workerCount ) )
+	      .metric( "busiest_worker_share", totalReceived > 0 ? double( maxReceived ) / double( totalReceived ) : 0.0 )
+	      .metric( "queue_drops", double( totalDropped ) )
+	      .metric( "loss_ratio", 1.0 - double( totalReceived ) / double( sentCount ) );
+	report.add( move( result ) );
+}
+
+CPPNETWORK_BENCHMARK( parallel_udp_receive )
+{
+	for (size_t workerCount : { size_t( 1 ), size_t( 2 ), size_t( 4 ) })
+		measureParallelReceive( report, workerCount );
+}
+
+/// Sends at a fixed rate and measures how evenly the datagrams arrive, the gaps are compared to the ideal one.
+/// The unpaced sender is the baseline, its datagrams arrive in bursts limited only by the speed of the system.
+static void measurePacing( Report & report, const char * modeName, PacingMode mode, bool paced, uint64_t targetPps )
+{
+	UdpSocket receiverSock;
+	uint16_t port = openOnFreePort( receiverSock );
+	if (port == 0)
+		return;
+	receiverSock.setTimeout( std::chrono::milliseconds( 300 ) );
+
+	UdpSocket senderSock;
+	senderSock.open();
+	PacedUdpSender sender( senderSock );
+	if (sender.setMode( mode ) != SocketError::Success)
+		return;
+	const size_t pktSize = 1200;
+	if (paced)
+		sender.setRate( targetPps * pktSize );
+
+	const size_t pktCount = (std::max)( size_t( 100 ), size_t( double( targetPps ) * (report.isQuick() ? 0.05 : 1.0) ) );
+	std::vector< Clock::time_point > arrivals;
+	arrivals.reserve( pktCount );
+
+	std::thread receiver( [ & ]()
+	{
+		std::vector< uint8_t > buffer( 2048 );
+		NativeEndpoint senderEp;
+		size_t received;
+		while (receiverSock.recvFrom( senderEp, make_span( buffer ), received ) == SocketError::Success)
+			arrivals.push_back( Clock::now() );
+	});
+
+	std::vector< uint8_t > packet( pktSize, 0x5A );
+	NativeEndpoint target( loopback( port ) );
+	auto start = Clock::now();
+	for (size_t i = 0; i < pktCount; ++i)
+		sender.sendTo( target, make_span( packet ) );
+	double sendTime = secondsSince( start );
+	receiver.join();
+
+	if (arrivals.size() < 2)
+		return;
+	const double idealGapUs = 1e6 / double( targetPps );
+	std::vector< double > gapErrors;
+	gapErrors.reserve( arrivals.size() - 1 );
+	for (size_t i = 1; i < arrivals.size(); ++i)
+	{
+		double gapUs = std::chrono::duration< double, std::micro >( arrivals[i] - arrivals[i-1] ).count();
+		gapErrors.push_back( std::abs( gapUs - idealGapUs ) );
+	}
+	double arrivalTime = std::chrono::duration< double >( arrivals.back() - arrivals.front() ).count();
+
+	report.add( Result( "udp_pacing" )
+		.param( "mode", modeName )
+		.param( "target_pps", double( targetPps ) )
+		.param( "pkt_size", double( pktSize ) )
+		.metric( "sent_pps", double( pktCount ) / sendTime )
+		.metric( "achieved_pps", arrivalTime > 0.0 ? double( arrivals.size() - 1 ) / arrivalTime : 0.0 )
+		.metric( "gap_jitter_p50_us", percentile( gapErrors, 0.50 ) )
+		.metric( "gap_jitter_p99_us", percentile( gapErrors, 0.99 ) )
+		.metric( "loss_ratio", 1.0 - double( arrivals.size() ) / double( pktCount ) )
+	);
+}
+
+CPPNETWORK_BENCHMARK( udp_pacing )
+{
+	for (uint64_t targetPps : { uint64_t( 10000 ), uint64_t( 100000 ) })
+	{
+		measurePacing( report, "unpaced", PacingMode::UserSpace, false, targetPps );
+		measurePacing( report, "user_space", PacingMode::UserSpace, true, targetPps );
+		// on the loopback the datagrams leave immediately unless the fq qdisc is set up, see PacedUdpSender
+		measurePacing( report, "kernel_txtime", PacingMode::KernelTxTime, true, targetPps );
+	}
+}
+
+static const size_t g_fanOutBurst = 16;
+
+/// One publisher delivers every datagram to all the subscribers on this machine, through the loopback interface,
+/// either with a single send to a multicast group, or with a send to each of the subscribers.
+static void measureFanOut( Report & report, size_t subscriberCount, bool multicast )
+{
+	const IPAddr group = IPv4Addr({ 239, 255, 77, 1 });
+	const uint32_t loopbackIndex = loopbackInterfaceIndex();
+
+	UdpSocket probe;
+	uint16_t groupPort = openOnFreePort( probe );
+	probe.close();
+	if (groupPort == 0)
+		return;
+
+	std::vector< UdpSocket > subscribers( subscriberCount );
+	std::vector< NativeEndpoint > destinations;
+	for (UdpSocket & subscriber : subscribers)
+	{
+		if (multicast)
+		{
+			if (subscriber.open( NativeEndpoint( IPAddr( IPv4Addr() ), groupPort ), true ) != SocketError::Success
+			 || subscriber.joinGroup( group, loopbackIndex ) != SocketError::Success)
+				return;
+		}
+		else
+		{
+			uint16_t port = openOnFreePort( subscriber );
+			if (port == 0)
+				return;
+			destinations.emplace_back( loopback( port ) );
+		}
+		subscriber.setBlockingMode( false );
+	}
+	if (multicast)
+		destinations.emplace_back( group, groupPort );
+
+	UdpSocket publisher;
+	publisher.open();
+	if (multicast && publisher.setMulticastInterface( loopbackIndex ) != SocketError::Success)
+		return;
+
+	const size_t rounds = report.iters( 20000 ) / g_fanOutBurst;
+	std::vector< uint8_t > datagram( 256, 0x3C );
+	std::vector< uint8_t > buffer( 2048 );
+	NativeEndpoint from;
+	size_t received, receivedCount = 0, sendCalls = 0;
+	double sendSeconds = 0.0;
+
+	auto start = Clock::now();
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		auto sendStart = Clock::now();
+		for (size_t i = 0; i < g_fanOutBurst; ++i)
+		{
+			for (const NativeEndpoint & destination : destinations)
+			{
+				publisher.sendTo( destination, make_span( datagram ) );
+				++sendCalls;
+			}
+		}
+		sendSeconds += secondsSince( sendStart );
+
+		for (UdpSocket & subscriber : subscribers)
+			while (subscriber.recvFrom( from, make_span( buffer ), received ) == SocketError::Success)
+				++receivedCount;
+	}
+	double seconds = secondsSince( start );
+
+	const double published = double( rounds * g_fanOutBurst );
+	report.add( Result( "udp_multicast_fanout" )
+		.param( "delivery", multicast ? "multicast" : "unicast" )
+		.param( "subscribers", double( subscriberCount ) )
+		.param( "msg_size", double( datagram.size() ) )
+		.metric( "send_calls_per_msg", double( sendCalls ) / published )
+		.metric( "publisher_us_per_msg", sendSeconds / published * 1e6 )
+		.metric( "delivered_ratio", double( receivedCount ) / (published * double( subscriberCount )) )
+		.metric( "msgs_per_sec", published / seconds )
+	);
+}
+
+CPPNETWORK_BENCHMARK( udp_multicast_fanout )
+{
+	for (size_t subscriberCount : { 1, 4, 16 })
+	{
+		measureFanOut( report, subscriberCount, false );
+		measureFanOut( report, subscriberCount, true );
+	}
+}
+
+
+//======================================================================================================================
+//  Unix domain sockets
+
+/// in the abstract namespace where it exists, so that no files are left behind by an interrupted run
+static std::string unixBenchPath( const char * name )
+{
+ #ifdef __linux__
+	return std::string( "@CppNetwork_Bench." ) + name;
+ #else
+	return std::string( "/tmp/CppNetwork_Bench." ) + name;
+ #endif // __linux__
+}
+
+/// the connection is accepted after it's already established, the system queues it until then
+static bool connectPair( TcpSocket & client, TcpSocket & server )
+{
+	TcpServerSocket listener;
+	uint16_t port = openOnFreePort( listener );
+	if (port == 0 || client.connect( IPAddr({ 127, 0, 0, 1 }), port ) != SocketError::Success)
+		return false;
+	Endpoint clientEp;
+	server = listener.accept( clientEp );
+	return server.isAccepted();
+}
+
+static bool connectPair( UnixStreamSocket & client, UnixStreamSocket & server, UnixSocketType type )
+{
+	UnixServerSocket listener;
+	std::string path = unixBenchPath( type == UnixSocketType::SeqPacket ? "seqpacket" : "stream" );
+	if (listener.open( path, type ) != SocketError::Success || client.connect( path, type ) != SocketError::Success)
+		return false;
+	server = listener.accept();
+	return server.isAccepted();
+}
+
+/// both sides are in this process, but the other one maps the memory again, the same way as another process would
+static bool connectPair( SharedMemoryChannel & client, SharedMemoryChannel & server )
+{
+	return client.create() == SocketError::Success && server.connect( client.getMemoryHandle() ) == SocketError::Success;
+}
+
+static const size_t g_ipcMessageSizes [] = { 64, 1024, 16 * 1024 };
+
+/// ping-pong of messages of the same size, the same for all the connection-oriented transports
+template< typename SocketType >
+static void measureIpcLatency( Report & report, const char * transport, SocketType & client, SocketType & server, size_t msgSize )
+{
+	const size_t roundTrips = report.iters( 50000 );
+
+	std::thread echoer( [ &server, msgSize, roundTrips ]()
+	{
+		std::vector< uint8_t > buffer( msgSize );
+		size_t received;
+		for (size_t i = 0; i < roundTrips; ++i)
+		{
+			if (server.receive( make_span( buffer ), received ) != SocketError::Success)
+				return;
+			server.send( make_span( buffer ) );
+		}
+	});
+
+	std::vector< uint8_t > message( msgSize, 0xCD );
+	std::vector< uint8_t > response( msgSize );
+	std::vector< double > samples;
+	samples.reserve( roundTrips );
+	size_t received;
+
+	for (size_t i = 0; i < roundTrips; ++i)
+	{
+		auto start = Clock::now();
+		client.send( make_span( message ) );
+		if (client.receive( make_span( response ), received ) != SocketError::Success)
+			break;
+		samples.push_back( secondsSince( start ) * 1e6 );
+	}
+
+	echoer.join();
+
+	report.add( Result( "unix_socket_latency" )
+		.param( "transport", transport )
+		.param( "msg_size", double( msgSize ) )
+		.metric( "rtt_p50_us", percentile( samples, 0.50 ) )
+		.metric( "rtt_p99_us", percentile( samples, 0.99 ) )
+	);
+}
+
+static void measureUnixDatagramLatency( Report & report, size_t msgSize )
+{
+	UnixDatagramSocket client, server;
+	std::string clientPath = unixBenchPath( "dgram_client" ), serverPath = unixBenchPath( "dgram_server" );
+	if (client.open( clientPath ) != SocketError::Success || server.open( serverPath ) != SocketError::Success)
+		return;
+
+	const size_t roundTrips = report.iters( 50000 );
+
+	std::thread echoer( [ &, msgSize, roundTrips ]()
+	{
+		std::vector< uint8_t > buffer( msgSize );
+		std::string sender;
+		size_t received;
+		for (size_t i = 0; i < roundTrips; ++i)
+		{
+			if (server.recvFrom( sender, make_span( buffer ), received ) != SocketError::Success)
+				return;
+			server.sendTo( clientPath, make_span( buffer.data(), received ) );
+		}
+	});
+
+	std::vector< uint8_t > message( msgSize, 0xCD );
+	std::vector< uint8_t > response( msgSize );
+	std::vector< double > samples;
+	samples.reserve( roundTrips );
+	std::string sender;
+	size_t received;
+
+	for (size_t i = 0; i < roundTrips; ++i)
+	{
+		auto start = Clock::now();
+		client.sendTo( serverPath, make_span( message ) );
+		if (client.recvFrom( sender, make_span( response ), received ) != SocketError::Success)
+			break;
+		samples.push_back( secondsSince( start ) * 1e6 );
+	}
+
+	echoer.join();
+
+	report.add( Result( "unix_socket_latency" )
+		.param( "transport", "unix_dgram" )
+		.param( "msg_size", double( msgSize ) )
+		.metric( "rtt_p50_us", percentile( samples, 0.50 ) )
+		.metric( "rtt_p99_us", percentile( samples, 0.99 ) )
+	);
+}
+
+CPPNETWORK_BENCHMARK( unix_socket_latency )
+{
+	for (size_t msgSize : g_ipcMessageSizes)
+	{
+		{
+			TcpSocket client, server;
+			if (connectPair( client, server ))
+				measureIpcLatency( report, "tcp", client, server, msgSize );
+		}
+		{
+			UnixStreamSocket client, server;
+			if (connectPair( client, server, UnixSocketType::Stream ))
+				measureIpcLatency( report, "unix_stream", client, server, msgSize );
+		}
+		{
+			UnixStreamSocket client, server;
+			if (connectPair( client, server, UnixSocketType::SeqPacket ))
+				measureIpcLatency( report, "unix_seqpacket", client, server, msgSize );
+		}
+		{
+			SharedMemoryChannel client, server;
+			if (connectPair( client, server ))
+				measureIpcLatency( report, "shared_memory", client, server, msgSize );
+		}
+		measureUnixDatagramLatency( report, msgSize );
+	}
+}
+
+template< typename SocketType >
+static void measureIpcThroughput( Report & report, const char * transport, SocketType & client, SocketType & server, size_t msgSize )
+{
+	const size_t totalBytes = report.iters( 1024 * 1024 * 1024 );
+	const size_t msgCount = totalBytes / msgSize > 0 ? totalBytes / msgSize : 1;
+
+	std::thread receiver( [ &server, msgSize, msgCount ]()
+	{
+		std::vector< uint8_t > buffer( msgSize );
+		size_t received;
+		for (size_t i = 0; i < msgCount; ++i)
+			if (server.receive( make_span( buffer ), received ) != SocketError::Success)
+				return;
+		server.send( "!" );  // let the sender know everything has arrived
+	});
+
+	std::vector< uint8_t > message( msgSize, 0xAB );
+	uint8_t ack [1];
+	size_t received;
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < msgCount; ++i)
+		client.send( make_span( message ) );
+	client.receive( make_span( ack, 1 ), received );
+	double elapsed = secondsSince( start );
+
+	receiver.join();
+
+	report.add( Result( "unix_socket_throughput" )
+		.param( "transport", transport )
+		.param( "msg_size", double( msgSize ) )
+		.metric( "MiB_per_s", double( msgSize * msgCount ) / elapsed / (1024.0 * 1024.0) )
+		.metric( "msgs_per_s", double( msgCount ) / elapsed )
+	);
+}
+
+CPPNETWORK_BENCHMARK( unix_socket_throughput )
+{
+	for (size_t msgSize : { size_t( 1024 ), size_t( 64 * 1024 ) })
+	{
+		{
+			TcpSocket client, server;
+			if (connectPair( client, server ))
+				measureIpcThroughput( report, "tcp", client, server, msgSize );
+		}
+		{
+			UnixStreamSocket client, server;
+			if (connectPair( client, server, UnixSocketType::Stream ))
+				measureIpcThroughput( report, "unix_stream", client, server, msgSize );
+		}
+		{
+			UnixStreamSocket client, server;
+			if (connectPair( client, server, UnixSocketType::SeqPacket ))
+				measureIpcThroughput( report, "unix_seqpacket", client, server, msgSize );
+		}
+		{
+			SharedMemoryChannel client, server;
+			if (connectPair( client, server ))
+				measureIpcThroughput( report, "shared_memory", client, server, msgSize );
+		}
+	}
+}
+
+
+//======================================================================================================================
+//  ReliableUdpChannel
+
+/// how many requests the client sends before waiting for their responses
+static const size_t g_pipelinedRequests = 4;
+static const size_t g_pipelinedRequestSize = 64;
+
+static void addPipelinedLatency( Report & report, const char * transport, size_t streamCount, double loss, std::vector< double > & samples, uint64_t retransmits )
+{
+	// the messages delayed by a loss, either their own or of a message before them in the same stream
+	size_t delayedCount = size_t( std::count_if( samples.begin(), samples.end(), []( double rtt ) { return rtt > 500.0; } ) );
+	report.add( Result( "reliable_udp_latency" )
+		.param( "transport", transport )
+		.param( "streams", double( streamCount ) )
+		.param( "loss", loss )
+		.param( "pipelined", double( g_pipelinedRequests ) )
+		.param( "msg_size", double( g_pipelinedRequestSize ) )
+		.metric( "rtt_p50_us", percentile( samples, 0.50 ) )
+		.metric( "rtt_p99_us", percentile( samples, 0.99 ) )
+		.metric( "rtt_p999_us", percentile( samples, 0.999 ) )
+		.metric( "delayed_over_500us_ratio", samples.empty() ? 0.0 : double( delayedCount ) / double( samples.size() ) )
+		.metric( "retransmits", double( retransmits ) )
+	);
+}
+
+/// The client sends a few requests at once, each on the next stream, and waits for all the echoed responses.
+/// With a single stream a lost request holds back the ones behind it, with more streams only itself.
+static void measureReliableUdpLatency( Report & report, size_t streamCount, double loss )
+{
+	UdpSocket probe;
+	uint16_t serverPort = openOnFreePort( probe );
+	probe.close();
+	uint16_t clientPort = openOnFreePort( probe );
+	probe.close();
+	if (serverPort == 0 || clientPort == 0)
+		return;
+
+	ReliableUdpConfig config;
+	config.simulatedLoss.ratio = loss;
+	ReliableUdpChannel server, client;
+	if (server.open( serverPort, NativeEndpoint( loopback( clientPort ) ), config ) != SocketError::Success)
+		return;
+	config.simulatedLoss.seed = 2;
+	if (client.open( clientPort, NativeEndpoint( loopback( serverPort ) ), config ) != SocketError::Success)
+		return;
+
+	std::atomic< bool > stop( false );
+	std::thread echoer( [ & ]()
+	{
+		uint16_t stream;
+		std::vector< uint8_t > message;
+		while (!stop)
+		{
+			server.update( std::chrono::milliseconds( 5 ) );
+			while (server.receive( stream, message ))
+				server.send( stream, make_span( message ) );
+		}
+	});
+
+	const size_t rounds = report.iters( 20000 );
+	std::vector< double > samples;
+	samples.reserve( rounds * g_pipelinedRequests );
+	std::vector< uint8_t > request( g_pipelinedRequestSize, 0xCD );
+	Clock::time_point sendTimes [g_pipelinedRequests];
+	uint16_t stream;
+	std::vector< uint8_t > response;
+
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		for (size_t i = 0; i < g_pipelinedRequests; ++i)
+		{
+			request[0] = uint8_t( i );
+			sendTimes[i] = Clock::now();
+			client.send( uint16_t( i % streamCount ), make_span( request ) );
+		}
+		for (size_t responses = 0; responses < g_pipelinedRequests; )
+		{
+			client.update( std::chrono::milliseconds( 5 ) );
+			while (client.receive( stream, response ))
+			{
+				samples.push_back( secondsSince( sendTimes[ response[0] ] ) * 1e6 );
+				++responses;
+			}
+		}
+	}
+
+	stop = true;
+	echoer.join();
+
+	addPipelinedLatency( report, "reliable_udp", streamCount, loss, samples, client.stats().retransmits + server.stats().retransmits );
+}
+
+/// The same exchange over TCP, only without loss, because it can't be injected into TCP from the user space.
+/// The requests are written at once and so are the responses, otherwise Nagle's algorithm would delay them.
+static void measureTcpPipelinedLatency( Report & report )
+{
+	TcpServerSocket server;
+	uint16_t port = openOnFreePort( server );
+	if (port == 0)
+		return;
+
+	const size_t rounds = report.iters( 20000 );
+	const size_t roundSize = g_pipelinedRequests * g_pipelinedRequestSize;
+
+	std::thread echoer( [ & ]()
+	{
+		Endpoint clientEp;
+		TcpSocket conn = server.accept( clientEp );
+		std::vector< uint8_t > buffer( roundSize );
+		size_t received;
+		for (size_t round = 0; round < rounds; ++round)
+		{
+			if (conn.receive( make_span( buffer ), received ) != SocketError::Success)
+				return;
+			conn.send( make_span( buffer ) );
+		}
+	});
+
+	TcpSocket client;
+	client.connect( IPAddr({ 127, 0, 0, 1 }), port );
+	std::vector< double > samples;
+	samples.reserve( rounds * g_pipelinedRequests );
+	std::vector< uint8_t > requests( roundSize, 0xCD );
+	std::vector< uint8_t > responses( roundSize );
+	size_t received;
+
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		auto start = Clock::now();
+		client.send( make_span( requests ) );
+		if (client.receive( make_span( responses ), received ) != SocketError::Success)
+			break;
+		double rtt = secondsSince( start ) * 1e6;
+		for (size_t i = 0; i < g_pipelinedRequests; ++i)
+			samples.push_back( rtt );
+	}
+
+	echoer.join();
+
+	addPipelinedLatency( report, "tcp", 1, 0.0, samples, 0 );
+}
+
+CPPNETWORK_BENCHMARK( reliable_udp_latency )
+{
+	measureTcpPipelinedLatency( report );
+	for (double loss : { 0.0, 0.01 })
+	{
+		measureReliableUdpLatency( report, 1, loss );
+		measureReliableUdpLatency( report, g_pipelinedRequests, loss );
+	}
+}
+
+
+//======================================================================================================================
+//  forward error correction
+
+static const size_t g_fecShardSize = 1200;
+static const std::pair< size_t, size_t > g_fecCodes [] = { { 8, 1 }, { 8, 2 }, { 16, 4 } };
+
+CPPNETWORK_BENCHMARK( fec_codec )
+{
+	for (auto code : g_fecCodes)
+	{
+		const size_t dataCount = code.first, parityCount = code.second, shardCount = dataCount + parityCount;
+		ReedSolomonCodec codec( dataCount, parityCount );
+
+		std::vector< uint8_t > storage( shardCount * g_fecShardSize );
+		for (size_t i = 0; i < storage.size(); ++i)
+			storage[i] = uint8_t( i * 131 + 7 );
+		std::vector< const uint8_t * > dataShards;
+		std::vector< uint8_t * > parityShards, allShards;
+		for (size_t s = 0; s < shardCount; ++s)
+		{
+			allShards.push_back( &storage[ s * g_fecShardSize ] );
+			if (s < dataCount)
+				dataShards.push_back( allShards.back() );
+			else
+				parityShards.push_back( allShards.back() );
+		}
+
+		const size_t iterations = report.iters( 100000 );
+		auto start = Clock::now();
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			codec.encode( make_span( dataShards ), make_span( parityShards ), g_fecShardSize );
+			doNotOptimize( storage[ dataCount * g_fecShardSize ] );
+		}
+		double encodeSeconds = secondsSince( start );
+
+		// the worst case, as many data shards missing as there are parity shards
+		std::unique_ptr< bool[] > present( new bool [shardCount] );
+		for (size_t s = 0; s < shardCount; ++s)
+			present[s] = s >= parityCount;
+		start = Clock::now();
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			codec.reconstruct( make_span( allShards ), span< const bool >( present.get(), shardCount ), g_fecShardSize );
+			doNotOptimize( storage[0] );
+		}
+		double decodeSeconds = secondsSince( start );
+
+		double blockMegabytes = double( dataCount * g_fecShardSize ) / 1e6;
+		report.add( Result( "fec_codec" )
+			.param( "data_shards", double( dataCount ) )
+			.param( "parity_shards", double( parityCount ) )
+			.param( "shard_size", double( g_fecShardSize ) )
+			.param( "kernel", ReedSolomonCodec::kernelName() )
+			.metric( "encode_mb_per_sec", blockMegabytes * double( iterations ) / encodeSeconds )
+			.metric( "decode_mb_per_sec", blockMegabytes * double( iterations ) / decodeSeconds )
+		);
+	}
+}
+
+/// Sends the datagrams over the loopback with the simulated loss and counts how many of them are still missing
+/// after the recovery, the loopback itself does not lose them as long as the receiver keeps up.
+static void measureFecRecovery( Report & report, size_t dataCount, size_t parityCount, double loss )
+{
+	UdpSocket sendSocket, recvSocket;
+	uint16_t recvPort = openOnFreePort( recvSocket );
+	if (recvPort == 0 || openOnFreePort( sendSocket ) == 0)
+		return;
+	recvSocket.setBlockingMode( false );
+
+	FecConfig config;
+	config.dataShards = dataCount;
+	config.parityShards = parityCount;
+	config.simulatedLoss.ratio = loss;
+	FecSender sender( sendSocket, config );
+	FecReceiver receiver( recvSocket );
+	NativeEndpoint destination( loopback( recvPort ) );
+
+	const size_t datagramCount = report.iters( 200000 ) / dataCount * dataCount;
+	std::vector< uint8_t > datagram( 512, 0xAB );
+	std::vector< uint8_t > buffer( 2048 );
+	NativeEndpoint from;
+	size_t received, deliveredCount = 0;
+
+	auto start = Clock::now();
+	for (size_t sent = 0; sent < datagramCount; )
+	{
+		for (size_t i = 0; i < dataCount; ++i, ++sent)
+			sender.sendTo( destination, make_span( datagram ) );
+		while (receiver.recvFrom( from, make_span( buffer ), received ) == SocketError::Success)
+			++deliveredCount;
+	}
+	recvSocket.setBlockingMode( true );
+	recvSocket.setTimeout( std::chrono::milliseconds( 50 ) );
+	while (deliveredCount < datagramCount && receiver.recvFrom( from, make_span( buffer ), received ) == SocketError::Success)
+		++deliveredCount;
+	double seconds = secondsSince( start );
+
+	FecReceiverStats stats = receiver.stats();
+	double sentCount = double( sender.stats().dataSent + sender.stats().paritySent );
+	report.add( Result( "fec_recovery" )
+		.param( "data_shards", double( dataCount ) )
+		.param( "parity_shards", double( parityCount ) )
+		.param( "loss", loss )
+		.metric( "raw_loss_ratio", double( sender.stats().simulatedDrops ) / sentCount )
+		.metric( "residual_loss_ratio", 1.0 - double( deliveredCount ) / double( datagramCount ) )
+		.metric( "recovered", double( stats.recovered ) )
+		.metric( "overhead_ratio", double( parityCount ) / double( dataCount ) )
+		.metric( "datagrams_per_sec", double( datagramCount ) / seconds )
+	);
+}
+
+CPPNETWORK_BENCHMARK( fec_recovery )
+{
+	for (double loss : { 0.01, 0.05, 0.10 })
+		for (auto code : g_fecCodes)
+			measureFecRecovery( report, code.first, code.second, loss );
+}
+
+
+//======================================================================================================================
+//  TcpServerSocket
+
+CPPNETWORK_BENCHMARK( tcp_accept_rate )
+{
+	TcpServerSocket server;
+	uint16_t port = openOnFreePort( server );
+	if (port == 0)
+		return;
+
+	const size_t connCount = report.iters( 5000 );
+
+	std::thread acceptor( [ &server, connCount ]()
+	{
+		Endpoint clientEp;
+		for (size_t i = 0; i < connCount; ++i)
+		{
+			TcpSocket conn = server.accept( clientEp );
+			if (!conn)
+				return;
+		}
+	});
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < connCount; ++i)
+	{
+		TcpSocket client;
+		if (client.connect( IPAddr({ 127, 0, 0, 1 }), port ) != SocketError::Success)
+			break;
+	}
+	acceptor.join();
+	double elapsed = secondsSince( start );
+
+	report.add( Result( "tcp_accept_rate" )
+		.param( "connections", double( connCount ) )
+		.metric( "accepts_per_s", double( connCount ) / elapsed )
+	);
+}
+
+
+/// Each client connects, sends a small request and waits for the response. The acceptor either serves the connection
+/// itself, or hands it over to a worker through a Unix socket, which is what an acceptor process does for the worker
+/// processes. The worker is a thread here, but the system calls are the same as between processes.
+static void measureConnectionHandoff( Report & report, bool handoff )
+{
+	TcpServerSocket server;
+	uint16_t port = openOnFreePort( server );
+	if (port == 0)
+		return;
+
+	UnixStreamSocket acceptorChannel, workerChannel;
+	if (handoff && !connectPair( acceptorChannel, workerChannel, UnixSocketType::SeqPacket ))
+		return;
+
+	const size_t connCount = report.iters( 5000 );
+	const size_t requestSize = 64;
+
+	auto serve = [ requestSize ]( TcpSocket & conn )
+	{
+		std::vector< uint8_t > request( requestSize );
+		size_t received;
+		if (conn.receive( make_span( request ), received ) == SocketError::Success)
+			conn.send( make_span( request ) );
+	};
+
+	std::thread worker( [ &, connCount ]()
+	{
+		uint8_t message [16];
+		size_t received;
+		for (size_t i = 0; handoff && i < connCount; ++i)
+		{
+			TcpSocket conn;
+			if (workerChannel.receiveSocket( conn, make_span( message, sizeof(message) ), received ) != SocketError::Success)
+				return;
+			serve( conn );
+		}
+	});
+
+	std::thread acceptor( [ &, connCount ]()
+	{
+		Endpoint clientEp;
+		const uint8_t message [1] = { 'C' };
+		for (size_t i = 0; i < connCount; ++i)
+		{
+			TcpSocket conn = server.accept( clientEp );
+			if (!conn)
+				return;
+			if (handoff)
+				acceptorChannel.sendSocket( conn, make_span( message, 1 ) );
+			else
+				serve( conn );
+		}
+	});
+
+	std::vector< uint8_t > request( requestSize, 0x42 ), response( requestSize );
+	std::vector< double > samples;
+	samples.reserve( connCount );
+	size_t received;
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < connCount; ++i)
+	{
+		auto connStart = Clock::now();
+		TcpSocket client;
+		if (client.connect( IPAddr({ 127, 0, 0, 1 }), port ) != SocketError::Success)
+			break;
+		client.send( make_span( request ) );
+		if (client.receive( make_span( response ), received ) != SocketError::Success)
+			break;
+		samples.push_back( secondsSince( connStart ) * 1e6 );
+	}
+	double elapsed = secondsSince( start );
+
+	acceptor.join();
+	worker.join();
+
+	report.add( Result( "tcp_connection_handoff" )
+		.param( "served_by", handoff ? "worker" : "acceptor" )
+		.param( "connections", double( connCount ) )
+		.metric( "connections_per_s", double( samples.size() ) / elapsed )
+		.metric( "request_p50_us", percentile( samples, 0.50 ) )
+		.metric( "request_p99_us", percentile( samples, 0.99 ) )
+	);
+}
+
+CPPNETWORK_BENCHMARK( tcp_connection_handoff )
+{
+	measureConnectionHandoff( report, false );
+	measureConnectionHandoff( report, true );
+}
+
+
+#ifndef _WIN32
+
+/// Accepts the connections waiting in the queue of the server and answers their one-byte requests.
+static void serveQueuedConnections( TcpServerSocket & server, size_t count )
+{
+	Endpoint clientEp;
+	for (size_t i = 0; i < count; ++i)
+	{
+		TcpSocket conn = server.accept( clientEp );
+		if (!conn)
+			return;
+		uint8_t request;
+		size_t received;
+		if (conn.receive( make_span( &request, 1 ), received ) == SocketError::Success)
+			conn.send( make_span( &request, 1 ) );
+	}
+}
+
+/// A server with connections waiting in its queue is replaced by a new process. Either the old process closes the port
+/// and the new one opens it again, or the new one adopts the listening socket of the old one through SocketManifest.
+/// The new process is only forked here, but it inherits the handle and the manifest the same way as across exec().
+static void measureServerRestart( Report & report, bool inherit )
+{
+	const size_t restartCount = report.iters( 40 );
+	const size_t queuedCount = 8;
+	const uint8_t request = 'R';
+
+	size_t served = 0;
+	std::vector< double > samples;
+	samples.reserve( restartCount );
+
+	for (size_t i = 0; i < restartCount; ++i)
+	{
+		TcpServerSocket server;
+		uint16_t port = openOnFreePort( server );
+		if (port == 0)
+			return;
+
+		std::vector< TcpSocket > clients( queuedCount );
+		for (TcpSocket & client : clients)
+		{
+			if (client.connect( IPAddr({ 127, 0, 0, 1 }), port ) != SocketError::Success)
+				return;
+			client.setTimeout( std::chrono::milliseconds( 1000 ) );
+			client.send( make_span( &request, 1 ) );
+		}
+
+		auto restartStart = Clock::now();
+		pid_t newProcess = -1;
+		if (inherit)
+		{
+			SocketManifest manifest;
+			manifest.add( "http", server );
+			manifest.exportToEnvironment();
+
+			newProcess = ::fork();
+			if (newProcess == 0)
+			{
+				socket_t handle;
+				TcpServerSocket newServer;
+				if (!SocketManifest::fromEnvironment().find( "http", handle ) || newServer.adopt( handle ) != SocketError::Success)
+					::_exit( 1 );
+				serveQueuedConnections( newServer, queuedCount );
+				::_exit( 0 );
+			}
+
+			SocketManifest().exportToEnvironment();
+			server.close();
+		}
+		else
+		{
+			server.close();
+			TcpServerSocket newServer;
+			if (newServer.open( port ) != SocketError::Success)
+				return;
+			newServer.setBlockingMode( false );  // the queue may be empty now
+			serveQueuedConnections( newServer, queuedCount );
+		}
+
+		for (TcpSocket & client : clients)
+		{
+			uint8_t response;
+			size_t received;
+			if (client.receive( make_span( &response, 1 ), received ) == SocketError::Success)
+				++served;
+		}
+		samples.push_back( secondsSince( restartStart ) * 1e6 );
+
+		if (newProcess > 0)
+			::waitpid( newProcess, nullptr, 0 );
+	}
+
+	report.add( Result( "tcp_server_restart" )
+		.param( "method", inherit ? "adopt_inherited" : "close_and_reopen" )
+		.param( "queued_connections", double( queuedCount ) )
+		.metric( "queued_served_pct", 100.0 * double( served ) / double( restartCount * queuedCount ) )
+		.metric( "restart_p50_us", percentile( samples, 0.50 ) )
+	);
+}
+
+CPPNETWORK_BENCHMARK( tcp_server_restart )
+{
+	measureServerRestart( report, false );
+	measureServerRestart( report, true );
+}
+
+#endif // _WIN32
+
+
+//======================================================================================================================
+//  message framing
+
+/// passes the calls through to the socket and counts the receive calls, which are system calls with TcpSocket
+struct CountingConnection
+{
+	TcpSocket & socket;
+	size_t receiveCalls = 0;
+
+	SocketError receiveOnce( byte_span buffer, size_t & received ) noexcept
+	{
+		++receiveCalls;
+		return socket.receiveOnce( buffer, received );
+	}
+};
+
+/// Streams length-prefixed messages through a TCP connection. The hand-rolled variant sends each message with its own
+/// call and receives the prefix and then the message into a new vector, the framed one collects a batch of messages
+/// into a FrameWriter and gets them out of a FrameReader.
+static void measureMessageFraming( Report & report, bool framed, size_t msgSize )
+{
+	TcpSocket client, server;
+	if (!connectPair( client, server ))
+		return;
+
+	const size_t msgCount = report.iters( 500000 );
+	const size_t batchSize = 32;
+
+	std::thread sender( [ &client, framed, msgSize, msgCount, batchSize ]()
+	{
+		FrameWriter writer;
+		std::vector< uint8_t > frame( 4 + msgSize, 0xAB );
+		encodeLengthPrefix( LengthPrefix::Fixed32, msgSize, frame.data() );
+		for (size_t i = 0; i < msgCount; ++i)
+		{
+			if (!framed)
+			{
+				client.send( make_span( frame ) );
+				continue;
+			}
+			writer.addMessage( const_byte_span( frame.data() + 4, msgSize ) );
+			if ((i + 1) % batchSize == 0)
+				writer.flush( client );
+		}
+		writer.flush( client );
+	});
+
+	CountingConnection connection{ server };
+	FrameReader reader;
+	size_t bytes = 0;
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < msgCount; ++i)
+	{
+		if (framed)
+		{
+			const_byte_span message;
+			if (reader.receiveMessage( connection, message ) != SocketError::Success)
+				break;
+			bytes += message.size();
+		}
+		else
+		{
+			uint8_t prefix [4];
+			size_t received;
+			++connection.receiveCalls;
+			if (server.receive( make_span( prefix, 4 ), received ) != SocketError::Success)
+				break;
+			uint64_t length;
+			size_t prefixSize;
+			decodeLengthPrefix( LengthPrefix::Fixed32, const_byte_span( prefix, 4 ), length, prefixSize );
+			std::vector< uint8_t > message;
+			++connection.receiveCalls;
+			if (server.receive( message, size_t( length ) ) != SocketError::Success)
+				break;
+			bytes += message.size();
+		}
+	}
+	double elapsed = secondsSince( start );
+
+	sender.join();
+
+	report.add( Result( "message_framing" )
+		.param( "method", framed ? "frame_reader_writer" : "hand_rolled" )
+		.param( "msg_size", double( msgSize ) )
+		.metric( "msgs_per_s", double( msgCount ) / elapsed )
+		.metric( "MiB_per_s", double( bytes ) / elapsed / (1024.0 * 1024.0) )
+		.metric( "receive_calls_per_msg", double( connection.receiveCalls ) / double( msgCount ) )
+	);
+}
+
+CPPNETWORK_BENCHMARK( message_framing )
+{
+	for (size_t msgSize : { size_t( 32 ), size_t( 512 ), size_t( 8 * 1024 ) })
+	{
+		measureMessageFraming( report, false, msgSize );
+		measureMessageFraming( report, true, msgSize );
+	}
+}
+
+
+/// Streams CRLF-terminated lines through a TCP connection. The byte-by-byte variant is the usual hand-written parser,
+/// which receives into a vector and copies each line char by char, the other one gets views from DelimitedReader.
+static void measureDelimitedFraming( Report & report, bool delimitedReader, size_t lineLength )
+{
+	TcpSocket client, server;
+	if (!connectPair( client, server ))
+		return;
+
+	// a chunk of lines of random lengths around the average, sent repeatedly
+	std::mt19937 random( 48 );
+	std::string chunk;
+	size_t chunkRecords = 0;
+	while (chunk.size() < 1024 * 1024)
+	{
+		size_t length = lineLength / 2 + random() % lineLength;
+		for (size_t i = 0; i < length; ++i)
+			chunk += char( 'a' + random() % 26 );
+		chunk += "\r\n";
+		++chunkRecords;
+	}
+	const size_t chunkCount = report.iters( 1024 );
+
+	std::thread sender( [ &client, &chunk, chunkCount ]()
+	{
+		for (size_t i = 0; i < chunkCount; ++i)
+			client.send( const_byte_span( reinterpret_cast< const uint8_t * >( chunk.data() ), chunk.size() ) );
+		client.disconnect();
+	});
+
+	size_t records = 0;
+	size_t bytes = 0;
+
+	auto start = Clock::now();
+	if (delimitedReader)
+	{
+		DelimitedReader reader( "\r\n", 4 * lineLength );
+		std::string_view record;
+		while (reader.receiveRecord( server, record ) == SocketError::Success)
+		{
+			bytes += record.size();
+			++records;
+		}
+	}
+	else
+	{
+		std::vector< uint8_t > buffer;
+		std::string line;
+		while (server.receiveOnce( buffer ) == SocketError::Success)
+		{
+			for (uint8_t c : buffer)
+			{
+				if (c == '\n' && !line.empty() && line.back() == '\r')
+				{
+					line.pop_back();
+					bytes += line.size();
+					++records;
+					line.clear();
+				}
+				else
+				{
+					line.push_back( char( c ) );
+				}
+			}
+		}
+	}
+	double elapsed = secondsSince( start );
+
+	sender.join();
+
+	if (records != chunkRecords * chunkCount)
+		return;  // something got lost, the numbers would be meaningless
+
+	report.add( Result( "delimited_framing" )
+		.param( "method", delimitedReader ? "delimited_reader" : "byte_by_byte" )
+		.param( "avg_line_length", double( lineLength ) )
+		.metric( "MiB_per_s", double( chunk.size() * chunkCount ) / elapsed / (1024.0 * 1024.0) )
+		.metric( "records_per_s", double( records ) / elapsed )
+	);
+	doNotOptimize( bytes );
+}
+
+CPPNETWORK_BENCHMARK( delimited_framing )
+{
+	for (size_t lineLength : { size_t( 64 ), size_t( 1024 ) })
+	{
+		measureDelimitedFraming( report, false, lineLength );
+		measureDelimitedFraming( report, true, lineLength );
+	}
+}
+
+
+enum class StreamBuffer
+{
+	PlainRing,     ///< circular buffer, a message split by its end is copied together into another buffer
+	FrameReader,   ///< linear buffer, the unfinished message is moved to the beginning when the end is reached
+	MirroredRing,  ///< MirroredRingBuffer filled by TcpSocket::receiveInto(), every message is contiguous in place
+};
+
+static const char * streamBufferName( StreamBuffer method )
+{
+	switch (method)
+	{
+		case StreamBuffer::PlainRing:     return "plain_ring";
+		case StreamBuffer::FrameReader:   return "frame_reader";
+		case StreamBuffer::MirroredRing:  return "mirrored_ring";
+		default:                          return "<invalid>";
+	}
+}
+
+/// Streams length-prefixed messages of random sizes through a TCP connection and parses them out of a 64 kB buffer
+/// of one of the kinds, so that many messages are split by the end of the buffer.
+static void measureStreamBuffer( Report & report, StreamBuffer method )
+{
+	TcpSocket client, server;
+	if (!connectPair( client, server ))
+		return;
+
+	const size_t capacity = 64 * 1024;
+	const size_t maxMsgSize = 16 * 1024;
+
+	std::mt19937 random( 50 );
+	std::vector< uint8_t > chunk;
+	size_t chunkMessages = 0;
+	while (chunk.size() < 1024 * 1024)
+	{
+		size_t msgSize = 64 + random() % (maxMsgSize - 64);
+		size_t prefixPos = chunk.size();
+		chunk.resize( prefixPos + 4 + msgSize, uint8_t( chunkMessages ) );
+		encodeLengthPrefix( LengthPrefix::Fixed32, msgSize, chunk.data() + prefixPos );
+		++chunkMessages;
+	}
+	const size_t chunkCount = report.iters( 512 );
+	const size_t msgCount = chunkMessages * chunkCount;
+
+	std::thread sender( [ &client, &chunk, chunkCount ]()
+	{
+		for (size_t i = 0; i < chunkCount; ++i)
+			client.send( make_span( chunk ) );
+	});
+
+	size_t receiveCalls = 0;
+	size_t copiedBytes = 0;
+	size_t checksum = 0;
+	size_t messages = 0;
+
+	auto start = Clock::now();
+	if (method == StreamBuffer::PlainRing)
+	{
+		std::vector< uint8_t > ring( capacity );
+		std::vector< uint8_t > joined;
+		size_t readPos = 0, size = 0;
+		while (messages < msgCount)
+		{
+			// the prefix and the message may be split by the end of the ring, so they are copied together first
+			auto contiguous = [&]( size_t offset, size_t length, std::vector< uint8_t > & scratch ) -> const uint8_t *
+			{
+				size_t pos = (readPos + offset) % capacity;
+				if (pos + length <= capacity)
+					return ring.data() + pos;
+				scratch.resize( length );
+				memcpy( scratch.data(), ring.data() + pos, capacity - pos );
+				memcpy( scratch.data() + capacity - pos, ring.data(), length - (capacity - pos) );
+				copiedBytes += length;
+				return scratch.data();
+			};
+
+			uint64_t length;
+			size_t prefixSize = 0;
+			if (size >= 4)
+				decodeLengthPrefix( LengthPrefix::Fixed32, const_byte_span( contiguous( 0, 4, joined ), 4 ), length, prefixSize );
+			if (prefixSize > 0 && size - 4 >= length)
+			{
+				const uint8_t * message = contiguous( 4, size_t( length ), joined );
+				checksum += message[0] + message[ length - 1 ];
+				readPos = (readPos + 4 + size_t( length )) % capacity;
+				size -= 4 + size_t( length );
+				++messages;
+				continue;
+			}
+
+			// a single receive can fill only the free space up to the end of the ring
+			size_t writePos = (readPos + size) % capacity;
+			size_t freeSpace = writePos >= readPos ? capacity - writePos : readPos - writePos;
+			size_t received;
+			++receiveCalls;
+			if (server.receiveOnce( make_span( ring.data() + writePos, freeSpace ), received ) != SocketError::Success)
+				break;
+			size += received;
+		}
+	}
+	else if (method == StreamBuffer::FrameReader)
+	{
+		CountingConnection connection{ server };
+		FrameReader reader( LengthPrefix::Fixed32, maxMsgSize );
+		const_byte_span message;
+		while (messages < msgCount && reader.receiveMessage( connection, message ) == SocketError::Success)
+		{
+			checksum += message[0] + message[ message.size() - 1 ];
+			++messages;
+		}
+		receiveCalls = connection.receiveCalls;
+	}
+	else
+	{
+		MirroredRingBuffer ring;
+		if (ring.allocate( capacity ) != SocketError::Success)
+		{
+			sender.join();
+			return;
+		}
+		while (messages < msgCount)
+		{
+			const_byte_span data = ring.readable();
+			uint64_t length;
+			size_t prefixSize;
+			decodeLengthPrefix( LengthPrefix::Fixed32, data, length, prefixSize );
+			if (prefixSize > 0 && data.size() - prefixSize >= length)
+			{
+				const_byte_span message = data.subspan( prefixSize, size_t( length ) );
+				checksum += message[0] + message[ message.size() - 1 ];
+				ring.consume( prefixSize + message.size() );
+				++messages;
+				continue;
+			}
+
+			size_t received;
+			++receiveCalls;
+			if (server.receiveInto( ring, received ) != SocketError::Success)
+				break;
+		}
+	}
+	double elapsed = secondsSince( start );
+
+	sender.join();
+
+	if (messages != msgCount)
+		return;  // something got lost, the numbers would be meaningless
+
+	Result result( "stream_buffer" );
+	result.param( "method", streamBufferName( method ) )
+		.metric( "MiB_per_s", double( chunk.size() * chunkCount ) / elapsed / (1024.0 * 1024.0) )
+		.metric( "msgs_per_s", double( msgCount ) / elapsed )
+		.metric( "receive_calls_per_msg", double( receiveCalls ) / double( msgCount ) );
+	if (method != StreamBuffer::FrameReader)  // its moving of the data is internal
+		result.metric( "copied_bytes_per_msg", double( copiedBytes ) / double( msgCount ) );
+	report.add( result );
+	doNotOptimize( checksum );
+}
+
+CPPNETWORK_BENCHMARK( stream_buffer )
+{
+	for (StreamBuffer method : { StreamBuffer::PlainRing, StreamBuffer::FrameReader, StreamBuffer::MirroredRing })
+	{
+		measureStreamBuffer( report, method );
+	}
+}
+
+
+//======================================================================================================================
+//  BufferedTcpWriter
+
+/// Serves pipelined HTTP-like requests, each answered by a response written in 5 small parts, as a handler writing
+/// the status line, the headers and the body separately would. The client sends the requests in batches of the pipeline
+/// depth and waits for all the responses of a batch before sending the next one. The plain server sends each part
+/// with its own call, the buffered one writes them into a BufferedTcpWriter and flushes it when it has answered all
+/// the requests it has received.
+static void measurePipelinedResponses( Report & report, bool buffered, size_t pipelineDepth )
+{
+	TcpSocket client, server;
+	if (!connectPair( client, server ))
+		return;
+	client.setNoDelay( true );
+	server.setNoDelay( true );
+
+	static const char * const responseParts [] = {
+		"HTTP/1.1 200 OK\r\n", "Content-Type: text/plain\r\n", "Content-Length: 13\r\n", "\r\n", "Hello, world!"
+	};
+	size_t responseSize = 0;
+	for (const char * part : responseParts)
+		responseSize += strlen( part );
+	const std::string request = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+	const size_t batchCount = report.iters( 20000 ) / pipelineDepth + 1;
+	const size_t requestCount = batchCount * pipelineDepth;
+
+	size_t serverCalls = 0;
+	std::thread serverThread( [ &server, &serverCalls, buffered, requestCount ]()
+	{
+		CountingConnection connection{ server };
+		DelimitedReader reader( "\r\n\r\n" );
+		BufferedTcpWriter writer( server );
+		size_t sendCalls = 0;
+
+		for (size_t served = 0; served < requestCount; ++served)
+		{
+			std::string_view received;
+			bool malformed;
+			if (!reader.nextBufferedRecord( received, malformed ))
+			{
+				// everything received so far is answered, which is the end of a tick of an event loop
+				if (buffered)
+					writer.flush();
+				if (reader.receiveRecord( connection, received ) != SocketError::Success)
+					break;
+			}
+			for (const char * part : responseParts)
+			{
+				if (buffered)
+				{
+					writer.write( part );
+				}
+				else
+				{
+					server.send( part );
+					++sendCalls;
+				}
+			}
+		}
+		writer.flush();
+
+		serverCalls = connection.receiveCalls + (buffered ? size_t( writer.sendCount() ) : sendCalls);
+	});
+
+	std::string batch;
+	for (size_t i = 0; i < pipelineDepth; ++i)
+		batch += request;
+	std::vector< uint8_t > responses;
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < batchCount; ++i)
+	{
+		client.send( batch.c_str() );
+		if (client.receive( responses, responseSize * pipelineDepth ) != SocketError::Success)
+			break;
+	}
+	double elapsed = secondsSince( start );
+
+	serverThread.join();
+
+	report.add( Result( "pipelined_responses" )
+		.param( "method", buffered ? "buffered_writer" : "send_per_write" )
+		.param( "pipeline_depth", double( pipelineDepth ) )
+		.metric( "requests_per_s", double( requestCount ) / elapsed )
+		.metric( "server_syscalls_per_request", double( serverCalls ) / double( requestCount ) )
+	);
+}
+
+CPPNETWORK_BENCHMARK( pipelined_responses )
+{
+	for (size_t pipelineDepth : { size_t( 1 ), size_t( 16 ) })
+	{
+		measurePipelinedResponses( report, false, pipelineDepth );
+		measurePipelinedResponses( report, true, pipelineDepth );
+	}
+}
+
+
+//======================================================================================================================
+//  multi-socket operations
+
+CPPNETWORK_BENCHMARK( wait_for_any_scaling )
+{
+	static const size_t socketCounts [] = { 1, 8, 64, 256, 512 };
+
+	for (size_t socketCount : socketCounts)
+	{
+		std::vector< std::unique_ptr< UdpSocket > > sockets;
+		std::unordered_set< ASocket * > activeSockets;
+		uint16_t lastPort = 0;
+		for (size_t i = 0; i < socketCount; ++i)
+		{
+			sockets.emplace_back( new UdpSocket );
+			lastPort = openOnFreePort( *sockets.back() );
+			if (lastPort == 0)
+				return;
+			activeSockets.insert( sockets.back().get() );
+		}
+
+		// make exactly one socket readable, the datagram is never read so it stays ready for the whole measurement
+		UdpSocket sender;
+		sender.open();
+		sender.sendTo( loopback( lastPort ), "x" );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+
+		const size_t calls = report.iters( 200000 );
+		std::vector< ASocket * > readySockets;
+		size_t readyTotal = 0;
+
+		auto start = Clock::now();
+		for (size_t i = 0; i < calls; ++i)
+		{
+			readySockets.clear();
+			waitForAny( activeSockets, readySockets, std::chrono::milliseconds( 0 ) );
+			readyTotal += readySockets.size();
+		}
+		double elapsed = secondsSince( start );
+
+		report.add( Result( "wait_for_any_scaling" )
+			.param( "sockets", double( socketCount ) )
+			.metric( "calls_per_s", double( calls ) / elapsed )
+			.metric( "ns_per_call", elapsed * 1e9 / double( calls ) )
+			.metric( "ready_per_call", double( readyTotal ) / double( calls ) )
+		);
+	}
+}
@@ -0,0 +1,174 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: TCP writer collecting small writes into bigger sends, with a bound on how long it may hold them
+//======================================================================================================================
+
+#include "BufferedTcpWriter.hpp"
+
+#include <cstring>  // strlen
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  WriteBufferPool
+
+std::vector< uint8_t > WriteBufferPool::acquire()
+{
+	{
+		std::lock_guard< std::mutex > lock( _mtx );
+		if (!_freeBuffers.empty())
+		{
+			std::vector< uint8_t > buffer = move( _freeBuffers.back() );
+			_freeBuffers.pop_back();
+			return buffer;
+		}
+	}
+
+	std::vector< uint8_t > buffer;
+	buffer.reserve( _bufferCapacity );
+	return buffer;
+}
+
+void WriteBufferPool::release( std::vector< uint8_t > && buffer )
+{
+	buffer.clear();
+	std::lock_guard< std::mutex > lock( _mtx );
+	_freeBuffers.push_back( move( buffer ) );
+}
+
+
+//======================================================================================================================
+//  BufferedTcpWriter
+
+BufferedTcpWriter::BufferedTcpWriter( TcpSocket & socket, WriteBufferPool * pool ) noexcept
+:
+	_socket( socket ),
+	_pool( pool ),
+	_buffer(),
+	_flushSize( 16 * 1024 ),
+	_latencyBudget( 1000 ),
+	_oldestWrite(),
+	_heldBySystem( false ),
+	_sendCount( 0 )
+{}
+
+BufferedTcpWriter::~BufferedTcpWriter() noexcept
+{
+	if (!empty())
+		flush();
+
+	if (_pool && _buffer.capacity() > 0)
+		_pool->release( move( _buffer ) );
+}
+
+SocketError BufferedTcpWriter::write( const_byte_span data ) noexcept
+{
+	if (data.empty())
+	{
+		return SocketError::Success;
+	}
+
+	if (empty())
+	{
+		_oldestWrite = Clock::now();
+	}
+
+	if (data.size() >= _flushSize)
+	{
+		if (!_buffer.empty())
+		{
+			SocketError error = _sendBuffer( true );
+			if (error != SocketError::Success)
+				return error;
+		}
+		// this one pushes out also what the system holds from the previous send
+		++_sendCount;
+		_heldBySystem = false;
+		return _socket.send( data );
+	}
+
+	if (_buffer.capacity() == 0 && _pool)
+	{
+		_buffer = _pool->acquire();
+	}
+	_buffer.insert( _buffer.end(), data.begin(), data.end() );
+
+	if (_latencyBudget.count() == 0 || Clock::now() - _oldestWrite >= _latencyBudget)
+	{
+		return flush();
+	}
+	if (_buffer.size() >= _flushSize)
+	{
+		return _sendBuffer( true );
+	}
+	return SocketError::Success;
+}
+
+SocketError BufferedTcpWriter::write( const char * message ) noexcept
+{
+	return write( make_span( reinterpret_cast< const uint8_t * >( message ), strlen( message ) ) );
+}
+
+SocketError BufferedTcpWriter::flush() noexcept
+{
+	if (!_buffer.empty())
+	{
+		return _sendBuffer( false );
+	}
+	if (_heldBySystem)
+	{
+		// there is nothing more to send that would push it out, uncorking does that even if the socket was not corked
+		++_sendCount;
+		_heldBySystem = false;
+		return _socket.setCork( false );
+	}
+	return SocketError::Success;
+}
+
+SocketError BufferedTcpWriter::flushIfDue() noexcept
+{
+	if (!empty() && Clock::now() >= deadline())
+	{
+		return flush();
+	}
+	return SocketError::Success;
+}
+
+BufferedTcpWriter::Clock::time_point BufferedTcpWriter::deadline() const noexcept
+{
+	if (empty())
+	{
+		return Clock::time_point::max();
+	}
+	return _oldestWrite + _latencyBudget;
+}
+
+SocketError BufferedTcpWriter::_sendBuffer( bool more ) noexcept
+{
+	SocketError error = more ? _socket.sendMore( make_span( _buffer ) ) : _socket.send( make_span( _buffer ) );
+	++_sendCount;
+ #ifdef __linux__
+	_heldBySystem = more && error == SocketError::Success;
+ #else
+	_heldBySystem = false;  // sendMore() is a plain send() elsewhere
+ #endif // __linux__
+
+	// the buffer is emptied even when the send fails, as the stream is broken then anyway
+	_buffer.clear();
+	if (_pool && !more)  // when more is coming, the buffer is going to be needed again right away
+	{
+		_pool->release( move( _buffer ) );
+		_buffer = std::vector< uint8_t >();
+	}
+	return error;
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
@@ -0,0 +1,138 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: TCP writer collecting small writes into bigger sends, with a bound on how long it may hold them
+//======================================================================================================================
+
+#ifndef CPPUTILS_BUFFEREDTCPWRITER_INCLUDED
+#define CPPUTILS_BUFFEREDTCPWRITER_INCLUDED
+
+
+#include "Socket.hpp"
+
+#include <CppUtils-Essential/Span.hpp>
+
+#include <chrono>
+#include <vector>
+#include <mutex>
+
+
+namespace own {
+
+
+//======================================================================================================================
+/// Buffers shared by the writers of many connections, so that only the connections that have something buffered
+/// at the moment take memory for it. Can be used from multiple threads.
+
+class WriteBufferPool
+{
+
+ public:
+
+	/// \param[in] bufferCapacity how many bytes each buffer has reserved when it's handed out
+	WriteBufferPool( size_t bufferCapacity = 16 * 1024 ) noexcept : _bufferCapacity( bufferCapacity ) {}
+
+	/// Returns an empty buffer, either one returned before or a new one.
+	std::vector< uint8_t > acquire();
+
+	/// Takes the buffer back for another writer.
+	void release( std::vector< uint8_t > && buffer );
+
+ private:
+
+	size_t _bufferCapacity;
+	std::mutex _mtx;
+	std::vector< std::vector< uint8_t > > _freeBuffers;
+
+};
+
+
+//======================================================================================================================
+/// Collects what's written to a TCP connection and sends it with fewer and bigger system calls.
+/** Each send is a system call and with TCP_NODELAY, which request-response protocols need, also a packet of its own.
+  * The writer appends the writes into its buffer and sends them together when one of these happens:
+  *  - the buffered data reach the flush size; they are sent with TcpSocket::sendMore() then, as more data are coming,
+  *    so the system keeps the last partial packet until the rest arrives,
+  *  - the owner calls flush(), typically at the end of an iteration of its event loop, after all the requests it got
+  *    from the connection have been answered,
+  *  - the oldest buffered byte has waited for the latency budget.
+  *
+  * The writer has no thread of its own, so the latency budget is kept by write() and by flushIfDue(), which the owner
+  * has to call no later than at deadline(), e.g. by using it for the timeout of waitForAny().
+  * With latency budget 0 every write is sent right away.
+  *
+  * Writes bigger than the flush size are not copied, they are sent right after what's already buffered. */
+
+class BufferedTcpWriter
+{
+
+ public:
+
+	using Clock = std::chrono::steady_clock;
+
+	/// The socket must stay valid for the whole lifetime of the writer, and so must the pool, if any.
+	/** Without a pool the writer keeps its own buffer. */
+	BufferedTcpWriter( TcpSocket & socket, WriteBufferPool * pool = nullptr ) noexcept;
+
+	/// Sends whatever is still buffered.
+	~BufferedTcpWriter() noexcept;
+
+	BufferedTcpWriter( const BufferedTcpWriter & other ) = delete;
+	BufferedTcpWriter & operator=( const BufferedTcpWriter & other ) = delete;
+
+	/// How many buffered bytes make the writer send them without waiting for flush().
+	void setFlushSize( size_t flushSize ) noexcept  { _flushSize = flushSize; }
+
+	/// The longest time the data may stay in the writer.
+	void setLatencyBudget( std::chrono::microseconds latencyBudget ) noexcept  { _latencyBudget = latencyBudget; }
+
+	/// Appends the data to the buffer, sending the buffer when it's full or when it has waited too long.
+	SocketError write( const_byte_span data ) noexcept;
+
+	/// Convenience wrapper of write( const_byte_span ) for textual data.
+	/** \param[in] message null-terminated array of chars */
+	SocketError write( const char * message ) noexcept;
+
+	/// Sends everything buffered, including what the system may be holding back after sendMore().
+	SocketError flush() noexcept;
+
+	/// Flushes if the oldest buffered data have reached the latency budget, otherwise does nothing.
+	SocketError flushIfDue() noexcept;
+
+	/// When flushIfDue() has to be called at the latest, Clock::time_point::max() when nothing is buffered.
+	Clock::time_point deadline() const noexcept;
+
+	/// How many bytes are waiting in the buffer.
+	size_t bufferedSize() const noexcept  { return _buffer.size(); }
+
+	/// Whether there is nothing waiting, neither in the buffer nor held back by the system.
+	bool empty() const noexcept  { return _buffer.empty() && !_heldBySystem; }
+
+	/// How many times the data have been handed to the system, for measuring how well the writes get coalesced.
+	uint64_t sendCount() const noexcept  { return _sendCount; }
+
+ private:
+
+	/// sends the buffer and gives it back to the pool
+	SocketError _sendBuffer( bool more ) noexcept;
+
+	TcpSocket & _socket;
+	WriteBufferPool * _pool;
+	std::vector< uint8_t > _buffer;
+	size_t _flushSize;
+	std::chrono::microseconds _latencyBudget;
+	Clock::time_point _oldestWrite;  ///< when the oldest data not yet pushed out were written
+	bool _heldBySystem;              ///< whether the last send was sendMore(), so the system may still hold its end
+	uint64_t _sendCount;
+
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_BUFFEREDTCPWRITER_INCLUDED
@@ -0,0 +1,685 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: forward error correction of UDP datagrams, parity datagrams rebuild the lost ones without a round trip
+//======================================================================================================================
+
+#include "ForwardErrorCorrection.hpp"
+
+#include <CppUtils-Essential/CriticalError.hpp>
+
+#include <cstring>  // memcpy, memset
+#include <algorithm>
+#include <memory>   // unique_ptr
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define CPPUTILS_GF_AVX2
+#elif defined(__SSSE3__)
+	#include <tmmintrin.h>
+	#define CPPUTILS_GF_SSSE3
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+	#define CPPUTILS_GF_NEON
+#endif
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  GF(2^8) arithmetic
+
+/// x^8 + x^4 + x^3 + x^2 + 1, the usual polynomial of Reed-Solomon erasure codes
+static constexpr unsigned GF_POLYNOMIAL = 0x11D;
+
+struct GaloisTables
+{
+	uint8_t exp [512];  ///< doubled, so that exp[log a + log b] needs no modulo
+	uint8_t log [256];
+	uint8_t mul [256][256];
+	/// products of each coefficient with the low and the high nibbles, for the shuffle-based SIMD multiplication
+	alignas( 16 ) uint8_t nibbleMul [256][2][16];
+
+	GaloisTables() noexcept
+	{
+		unsigned x = 1;
+		for (unsigned i = 0; i < 255; ++i)
+		{
+			exp[i] = exp[i + 255] = uint8_t( x );
+			log[x] = uint8_t( i );
+			x <<= 1;
+			if (x & 0x100)
+				x ^= GF_POLYNOMIAL;
+		}
+		exp[510] = exp[511] = 0;
+		log[0] = 0;  // undefined, callers handle 0 separately
+
+		for (unsigned a = 0; a < 256; ++a)
+			for (unsigned b = 0; b < 256; ++b)
+				mul[a][b] = (a == 0 || b == 0) ? 0 : exp[ log[a] + log[b] ];
+
+		for (unsigned c = 0; c < 256; ++c)
+		{
+			for (unsigned n = 0; n < 16; ++n)
+			{
+				nibbleMul[c][0][n] = mul[c][n];
+				nibbleMul[c][1][n] = mul[c][n << 4];
+			}
+		}
+	}
+};
+
+static const GaloisTables & gf() noexcept
+{
+	static const GaloisTables tables;
+	return tables;
+}
+
+static inline uint8_t gfMul( uint8_t a, uint8_t b ) noexcept
+{
+	return gf().mul[a][b];
+}
+
+static inline uint8_t gfInv( uint8_t a ) noexcept
+{
+	return gf().exp[ 255 - gf().log[a] ];
+}
+
+/// dst ^= src
+static void xorInto( uint8_t * dst, const uint8_t * src, size_t size ) noexcept
+{
+	size_t i = 0;
+ #if defined(CPPUTILS_GF_AVX2)
+	for (; i + 32 <= size; i += 32)
+	{
+		__m256i d = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( dst + i ) );
+		__m256i s = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( src + i ) );
+		_mm256_storeu_si256( reinterpret_cast< __m256i * >( dst + i ), _mm256_xor_si256( d, s ) );
+	}
+ #elif defined(CPPUTILS_GF_SSSE3)
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i d = _mm_loadu_si128( reinterpret_cast< const __m128i * >( dst + i ) );
+		__m128i s = _mm_loadu_si128( reinterpret_cast< const __m128i * >( src + i ) );
+		_mm_storeu_si128( reinterpret_cast< __m128i * >( dst + i ), _mm_xor_si128( d, s ) );
+	}
+ #elif defined(CPPUTILS_GF_NEON)
+	for (; i + 16 <= size; i += 16)
+	{
+		vst1q_u8( dst + i, veorq_u8( vld1q_u8( dst + i ), vld1q_u8( src + i ) ) );
+	}
+ #else
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t d, s;
+		memcpy( &d, dst + i, 8 );
+		memcpy( &s, src + i, 8 );
+		d ^= s;
+		memcpy( dst + i, &d, 8 );
+	}
+ #endif
+	for (; i < size; ++i)
+		dst[i] ^= src[i];
+}
+
+/// dst ^= coef * src
+/** The SIMD versions split each byte into nibbles and look up their products in two 16-entry tables with a shuffle,
+  * the product of the byte is then the XOR of the two, because the multiplication distributes over XOR. */
+static void mulAddInto( uint8_t * dst, const uint8_t * src, uint8_t coef, size_t size ) noexcept
+{
+	if (coef == 0)
+	{
+		return;
+	}
+	if (coef == 1)
+	{
+		xorInto( dst, src, size );
+		return;
+	}
+
+	const GaloisTables & tables = gf();
+	size_t i = 0;
+ #if defined(CPPUTILS_GF_AVX2)
+	const __m256i lowTable = _mm256_broadcastsi128_si256( _mm_load_si128( reinterpret_cast< const __m128i * >( tables.nibbleMul[coef][0] ) ) );
+	const __m256i highTable = _mm256_broadcastsi128_si256( _mm_load_si128( reinterpret_cast< const __m128i * >( tables.nibbleMul[coef][1] ) ) );
+	const __m256i nibbleMask = _mm256_set1_epi8( 0x0F );
+	for (; i + 32 <= size; i += 32)
+	{
+		__m256i s = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( src + i ) );
+		__m256i low = _mm256_shuffle_epi8( lowTable, _mm256_and_si256( s, nibbleMask ) );
+		__m256i high = _mm256_shuffle_epi8( highTable, _mm256_and_si256( _mm256_srli_epi64( s, 4 ), nibbleMask ) );
+		__m256i d = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( dst + i ) );
+		_mm256_storeu_si256( reinterpret_cast< __m256i * >( dst + i ), _mm256_xor_si256( d, _mm256_xor_si256( low, high ) ) );
+	}
+ #elif defined(CPPUTILS_GF_SSSE3)
+	const __m128i lowTable = _mm_load_si128( reinterpret_cast< const __m128i * >( tables.nibbleMul[coef][0] ) );
+	const __m128i highTable = _mm_load_si128( reinterpret_cast< const __m128i * >( tables.nibbleMul[coef][1] ) );
+	const __m128i nibbleMask = _mm_set1_epi8( 0x0F );
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i s = _mm_loadu_si128( reinterpret_cast< const __m128i * >( src + i ) );
+		__m128i low = _mm_shuffle_epi8( lowTable, _mm_and_si128( s, nibbleMask ) );
+		__m128i high = _mm_shuffle_epi8( highTable, _mm_and_si128( _mm_srli_epi64( s, 4 ), nibbleMask ) );
+		__m128i d = _mm_loadu_si128( reinterpret_cast< const __m128i * >( dst + i ) );
+		_mm_storeu_si128( reinterpret_cast< __m128i * >( dst + i ), _mm_xor_si128( d, _mm_xor_si128( low, high ) ) );
+	}
+ #elif defined(CPPUTILS_GF_NEON)
+	const uint8x16_t lowTable = vld1q_u8( tables.nibbleMul[coef][0] );
+	const uint8x16_t highTable = vld1q_u8( tables.nibbleMul[coef][1] );
+	const uint8x16_t nibbleMask = vdupq_n_u8( 0x0F );
+	for (; i + 16 <= size; i += 16)
+	{
+		uint8x16_t s = vld1q_u8( src + i );
+		uint8x16_t low = vqtbl1q_u8( lowTable, vandq_u8( s, nibbleMask ) );
+		uint8x16_t high = vqtbl1q_u8( highTable, vshrq_n_u8( s, 4 ) );
+		vst1q_u8( dst + i, veorq_u8( vld1q_u8( dst + i ), veorq_u8( low, high ) ) );
+	}
+ #endif
+	const uint8_t * row = tables.mul[coef];
+	for (; i < size; ++i)
+		dst[i] ^= row[ src[i] ];
+}
+
+/// Inverts the n x n matrix in place by Gauss-Jordan elimination, returns false when it's singular.
+static bool invertMatrix( std::vector< uint8_t > & matrix, size_t n )
+{
+	std::vector< uint8_t > inverse( n * n, 0 );
+	for (size_t i = 0; i < n; ++i)
+		inverse[ i * n + i ] = 1;
+
+	for (size_t col = 0; col < n; ++col)
+	{
+		size_t pivot = col;
+		while (pivot < n && matrix[ pivot * n + col ] == 0)
+			++pivot;
+		if (pivot == n)
+			return false;
+		if (pivot != col)
+		{
+			std::swap_ranges( &matrix[ pivot * n ], &matrix[ pivot * n ] + n, &matrix[ col * n ] );
+			std::swap_ranges( &inverse[ pivot * n ], &inverse[ pivot * n ] + n, &inverse[ col * n ] );
+		}
+
+		uint8_t scale = gfInv( matrix[ col * n + col ] );
+		for (size_t j = 0; j < n; ++j)
+		{
+			matrix[ col * n + j ] = gfMul( matrix[ col * n + j ], scale );
+			inverse[ col * n + j ] = gfMul( inverse[ col * n + j ], scale );
+		}
+
+		for (size_t row = 0; row < n; ++row)
+		{
+			uint8_t factor = matrix[ row * n + col ];
+			if (row != col && factor != 0)
+			{
+				mulAddInto( &matrix[ row * n ], &matrix[ col * n ], factor, n );
+				mulAddInto( &inverse[ row * n ], &inverse[ col * n ], factor, n );
+			}
+		}
+	}
+
+	matrix = move( inverse );
+	return true;
+}
+
+
+//======================================================================================================================
+//  ReedSolomonCodec
+
+ReedSolomonCodec::ReedSolomonCodec( size_t dataShards, size_t parityShards )
+:
+	_dataShards( dataShards ),
+	_parityShards( parityShards ),
+	_parityMatrix( dataShards * parityShards )
+{
+	if (dataShards == 0 || dataShards + parityShards > MAX_SHARDS)
+	{
+		critical_error( "Invalid number of shards of ReedSolomonCodec." );
+	}
+
+	// Cauchy matrix 1 / (x_i + y_j) with x_i = dataShards + i and y_j = j, every square submatrix of it is invertible,
+	// and it stays so when its columns are scaled, which is used to make the first row all ones
+	for (size_t j = 0; j < dataShards; ++j)
+	{
+		uint8_t firstRowInv = uint8_t( dataShards ^ j );  // inverse of 1 / (x_0 + y_j)
+		for (size_t i = 0; i < parityShards; ++i)
+		{
+			uint8_t cauchy = gfInv( uint8_t( (dataShards + i) ^ j ) );
+			_parityMatrix[ i * dataShards + j ] = gfMul( cauchy, firstRowInv );
+		}
+	}
+}
+
+void ReedSolomonCodec::encode( span< const uint8_t * const > data, span< uint8_t * const > parity, size_t shardSize ) const
+{
+	if (data.size() != _dataShards || parity.size() != _parityShards)
+	{
+		critical_error( "Wrong number of shards passed to ReedSolomonCodec::encode()." );
+	}
+
+	for (size_t i = 0; i < _parityShards; ++i)
+	{
+		const uint8_t * coefs = &_parityMatrix[ i * _dataShards ];
+		memset( parity[i], 0, shardSize );
+		for (size_t j = 0; j < _dataShards; ++j)
+			mulAddInto( parity[i], data[j], coefs[j], shardSize );
+	}
+}
+
+bool ReedSolomonCodec::reconstruct( span< uint8_t * const > shards, span< const bool > present, size_t shardSize ) const
+{
+	const size_t k = _dataShards;
+	if (shards.size() != k + _parityShards || present.size() != shards.size())
+	{
+		critical_error( "Wrong number of shards passed to ReedSolomonCodec::reconstruct()." );
+	}
+
+	std::vector< size_t > missing;
+	for (size_t j = 0; j < k; ++j)
+		if (!present[j])
+			missing.push_back( j );
+	if (missing.empty())
+	{
+		return true;
+	}
+
+	// take the first k present shards, their rows of the encoding matrix form an invertible square matrix
+	std::vector< size_t > chosen;
+	chosen.reserve( k );
+	for (size_t s = 0; s < shards.size() && chosen.size() < k; ++s)
+		if (present[s])
+			chosen.push_back( s );
+	if (chosen.size() < k)
+	{
+		return false;
+	}
+
+	std::vector< uint8_t > matrix( k * k, 0 );
+	for (size_t r = 0; r < k; ++r)
+	{
+		if (chosen[r] < k)
+			matrix[ r * k + chosen[r] ] = 1;
+		else
+			memcpy( &matrix[ r * k ], &_parityMatrix[ (chosen[r] - k) * k ], k );
+	}
+	if (!invertMatrix( matrix, k ))
+	{
+		return false;
+	}
+
+	// data shard j is the j-th row of the inverse applied to the chosen shards
+	for (size_t j : missing)
+	{
+		memset( shards[j], 0, shardSize );
+		for (size_t r = 0; r < k; ++r)
+			mulAddInto( shards[j], shards[ chosen[r] ], matrix[ j * k + r ], shardSize );
+	}
+	return true;
+}
+
+const char * ReedSolomonCodec::kernelName() noexcept
+{
+ #if defined(CPPUTILS_GF_AVX2)
+	return "avx2";
+ #elif defined(CPPUTILS_GF_SSSE3)
+	return "ssse3";
+ #elif defined(CPPUTILS_GF_NEON)
+	return "neon";
+ #else
+	return "scalar";
+ #endif
+}
+
+
+//======================================================================================================================
+//  datagram format
+//
+//  header: block id (4), index within the block (1), data datagrams in the block (1), parity datagrams (1), version (1)
+//
+//  Indexes below the data count are data datagrams followed by the original datagram, the others are parity datagrams
+//  followed by the parity shard. The data shards are the datagrams prefixed by their 2-byte length and padded by zeros
+//  to the longest one. A data datagram carries the configured data count, which the parity datagrams correct
+//  when the block was finished early. All the numbers are big-endian.
+
+static constexpr uint8_t FEC_VERSION = 1;
+static constexpr size_t LENGTH_SIZE = 2;
+static constexpr size_t MAX_UDP_PAYLOAD = 65507;
+
+static void putHeader( uint8_t * pos, uint32_t blockId, size_t index, size_t dataCount, size_t parityCount ) noexcept
+{
+	pos[0] = uint8_t( blockId >> 24 );
+	pos[1] = uint8_t( blockId >> 16 );
+	pos[2] = uint8_t( blockId >> 8 );
+	pos[3] = uint8_t( blockId );
+	pos[4] = uint8_t( index );
+	pos[5] = uint8_t( dataCount );
+	pos[6] = uint8_t( parityCount );
+	pos[7] = FEC_VERSION;
+}
+
+
+//======================================================================================================================
+//  FecSender
+
+FecSender::FecSender( UdpSocket & socket, const FecConfig & config )
+:
+	_socket( socket ),
+	_config( config ),
+	_codec( config.dataShards, config.parityShards ),
+	_blockId( 0 ),
+	_stats(),
+	_lossInjector( config.simulatedLoss )
+{
+	_blockData.reserve( config.dataShards );
+}
+
+SocketError FecSender::sendTo( const NativeEndpoint & endpoint, const_byte_span datagram )
+{
+	if (datagram.size() > MAX_UDP_PAYLOAD - HEADER_SIZE - LENGTH_SIZE)
+	{
+		return SocketError::SendFailed;  // the parity datagram would not fit
+	}
+
+	SocketError flushError = SocketError::Success;
+	if (!_blockData.empty() && _blockEndpoint != endpoint)
+	{
+		flushError = flush();
+	}
+	_blockEndpoint = endpoint;
+
+	// the copy must be kept even when the send fails, the parity covers the whole block
+	size_t index = _blockData.size();
+	_blockData.emplace_back( datagram.begin(), datagram.end() );
+
+	_sendBuffer.resize( HEADER_SIZE + datagram.size() );
+	putHeader( _sendBuffer.data(), _blockId, index, _config.dataShards, _config.parityShards );
+	std::copy( datagram.begin(), datagram.end(), _sendBuffer.begin() + HEADER_SIZE );
+	_stats.dataSent++;
+	SocketError error = _send( make_span( _sendBuffer ) );
+
+	if (_blockData.size() == _config.dataShards)
+	{
+		SocketError parityError = flush();
+		if (error == SocketError::Success)
+			error = parityError;
+	}
+	return error != SocketError::Success ? error : flushError;
+}
+
+SocketError FecSender::flush()
+{
+	if (_blockData.empty())
+	{
+		return SocketError::Success;
+	}
+
+	const size_t dataCount = _blockData.size();
+	const size_t parityCount = _config.parityShards;
+	size_t shardSize = 0;
+	for (const auto & datagram : _blockData)
+		shardSize = (std::max)( shardSize, LENGTH_SIZE + datagram.size() );
+
+	// each shard is stored right after the header of its parity datagram, so that it can be sent without copying
+	const size_t stride = HEADER_SIZE + shardSize;
+	_shards.assign( dataCount * shardSize + parityCount * stride, 0 );
+	std::vector< const uint8_t * > dataShards( dataCount );
+	std::vector< uint8_t * > parityShards( parityCount );
+	for (size_t j = 0; j < dataCount; ++j)
+	{
+		uint8_t * shard = &_shards[ j * shardSize ];
+		shard[0] = uint8_t( _blockData[j].size() >> 8 );
+		shard[1] = uint8_t( _blockData[j].size() );
+		std::copy( _blockData[j].begin(), _blockData[j].end(), shard + LENGTH_SIZE );
+		dataShards[j] = shard;
+	}
+	uint8_t * parityBegin = &_shards[ dataCount * shardSize ];
+	for (size_t i = 0; i < parityCount; ++i)
+		parityShards[i] = parityBegin + i * stride + HEADER_SIZE;
+
+	// a block finished early has its own code, which the receiver constructs from the data count in the header
+	if (dataCount == _codec.dataShards())
+		_codec.encode( make_span( dataShards ), make_span( parityShards ), shardSize );
+	else
+		ReedSolomonCodec( dataCount, parityCount ).encode( make_span( dataShards ), make_span( parityShards ), shardSize );
+
+	SocketError error = SocketError::Success;
+	for (size_t i = 0; i < parityCount; ++i)
+	{
+		uint8_t * datagram = parityBegin + i * stride;
+		putHeader( datagram, _blockId, dataCount + i, dataCount, parityCount );
+		_stats.paritySent++;
+		SocketError sendError = _send( make_span( datagram, stride ) );
+		if (error == SocketError::Success)
+			error = sendError;
+	}
+
+	_blockData.clear();
+	_blockId++;
+	return error;
+}
+
+SocketError FecSender::_send( const_byte_span datagram )
+{
+	if (_lossInjector.shouldDrop())
+	{
+		return SocketError::Success;
+	}
+	return _socket.sendTo( _blockEndpoint, datagram );
+}
+
+FecSenderStats FecSender::stats() const noexcept
+{
+	FecSenderStats stats = _stats;
+	stats.simulatedDrops = _lossInjector.dropCount();
+	return stats;
+}
+
+
+//======================================================================================================================
+//  FecReceiver
+
+FecReceiver::FecReceiver( UdpSocket & socket, size_t maxBlocks )
+:
+	_socket( socket ),
+	_maxBlocks( (std::max)( maxBlocks, size_t( 1 ) ) ),
+	_recvBuffer( MAX_UDP_PAYLOAD ),
+	_stats()
+{}
+
+SocketError FecReceiver::recvFrom( NativeEndpoint & endpoint, byte_span buffer, size_t & received )
+{
+	while (true)
+	{
+		if (!_recovered.empty())
+		{
+			const std::vector< uint8_t > & datagram = _recovered.front().second;
+			received = (std::min)( datagram.size(), buffer.size() );
+			std::copy( datagram.begin(), datagram.begin() + ptrdiff_t( received ), buffer.begin() );
+			endpoint = _recovered.front().first;
+			_recovered.pop_front();
+			return SocketError::Success;
+		}
+
+		NativeEndpoint sender;
+		size_t size;
+		SocketError error = _socket.recvFrom( sender, make_span( _recvBuffer ), size );
+		if (error != SocketError::Success)
+		{
+			return error;
+		}
+
+		const uint8_t * header = _recvBuffer.data();
+		if (size < FecSender::HEADER_SIZE || header[7] != FEC_VERSION)
+		{
+			continue;  // not ours
+		}
+		uint32_t blockId = (uint32_t( header[0] ) << 24) | (uint32_t( header[1] ) << 16) | (uint32_t( header[2] ) << 8) | header[3];
+		size_t index = header[4];
+		size_t dataCount = header[5];
+		size_t parityCount = header[6];
+		if (dataCount == 0 || dataCount + parityCount > ReedSolomonCodec::MAX_SHARDS || index >= dataCount + parityCount)
+		{
+			continue;
+		}
+
+		Block & block = _findBlock( sender, blockId, dataCount, parityCount );
+		const uint8_t * payload = header + FecSender::HEADER_SIZE;
+		const size_t payloadSize = size - FecSender::HEADER_SIZE;
+
+		if (index < dataCount)
+		{
+			_stats.dataReceived++;
+			if (index >= block.dataCount || block.delivered[ index ])
+			{
+				continue;  // a late copy of a rebuilt one
+			}
+			block.delivered[ index ] = true;
+			if (!block.done)
+			{
+				std::vector< uint8_t > & shard = block.data[ index ];
+				shard.resize( LENGTH_SIZE + payloadSize );
+				shard[0] = uint8_t( payloadSize >> 8 );
+				shard[1] = uint8_t( payloadSize );
+				std::copy( payload, payload + payloadSize, shard.begin() + LENGTH_SIZE );
+				_tryRecover( block );
+			}
+
+			received = (std::min)( payloadSize, buffer.size() );
+			std::copy( payload, payload + received, buffer.begin() );
+			endpoint = sender;
+			return SocketError::Success;
+		}
+		else
+		{
+			_stats.parityReceived++;
+			if (block.done)
+			{
+				continue;
+			}
+			// the parity datagrams carry the actual number of data datagrams of the block
+			if (block.shardSize == 0)
+			{
+				block.dataCount = dataCount;
+				block.parityCount = parityCount;
+				block.shardSize = payloadSize;
+				block.data.resize( dataCount );
+				block.delivered.resize( dataCount );
+				block.parity.resize( parityCount );
+			}
+			if (payloadSize != block.shardSize || dataCount != block.dataCount || parityCount != block.parityCount)
+			{
+				continue;  // inconsistent with the other parity datagrams
+			}
+			block.parity[ index - dataCount ].assign( payload, payload + payloadSize );
+			_tryRecover( block );
+		}
+	}
+}
+
+FecReceiver::Block & FecReceiver::_findBlock( const NativeEndpoint & sender, uint32_t id, size_t dataCount, size_t parityCount )
+{
+	// the datagrams mostly belong to one of the latest blocks
+	for (auto it = _blocks.rbegin(); it != _blocks.rend(); ++it)
+	{
+		if (it->id == id && it->sender == sender)
+		{
+			return *it;
+		}
+	}
+
+	if (_blocks.size() >= _maxBlocks)
+	{
+		_forgetBlock( _blocks.front() );
+		_blocks.pop_front();
+	}
+
+	_blocks.emplace_back();
+	Block & block = _blocks.back();
+	block.sender = sender;
+	block.id = id;
+	block.dataCount = dataCount;
+	block.parityCount = parityCount;
+	block.shardSize = 0;
+	block.done = false;
+	block.data.resize( dataCount );
+	block.delivered.resize( dataCount );
+	return block;
+}
+
+void FecReceiver::_forgetBlock( Block & block )
+{
+	if (!block.done)
+	{
+		// Without a parity datagram the actual size of the block is unknown, and a block finished early by flush()
+		// or by a switch of the endpoint has no tail to lose, so count only the gaps before the last one delivered.
+		auto knownEnd = block.delivered.end();
+		if (block.shardSize == 0)
+		{
+			while (knownEnd != block.delivered.begin() && !*(knownEnd - 1))
+				--knownEnd;
+		}
+		_stats.unrecoverable += uint64_t( std::count( block.delivered.begin(), knownEnd, false ) );
+	}
+}
+
+void FecReceiver::_tryRecover( Block & block )
+{
+	size_t dataPresent = 0, parityPresent = 0;
+	for (const auto & shard : block.data)
+		dataPresent += !shard.empty();
+	for (const auto & shard : block.parity)
+		parityPresent += !shard.empty();
+
+	bool complete = block.shardSize != 0 && dataPresent == block.dataCount;
+	bool recoverable = block.shardSize != 0 && dataPresent + parityPresent >= block.dataCount;
+	if (!complete && recoverable)
+	{
+		const size_t shardCount = block.dataCount + block.parityCount;
+		std::vector< uint8_t > shards( shardCount * block.shardSize, 0 );
+		std::vector< uint8_t * > shardPtrs( shardCount );
+		std::unique_ptr< bool[] > present( new bool [shardCount] );  // vector< bool > has no data()
+		for (size_t s = 0; s < shardCount; ++s)
+		{
+			shardPtrs[s] = &shards[ s * block.shardSize ];
+			const std::vector< uint8_t > & shard = s < block.dataCount ? block.data[s] : block.parity[ s - block.dataCount ];
+			present[s] = !shard.empty() && shard.size() <= block.shardSize;
+			if (present[s])
+				std::copy( shard.begin(), shard.end(), shardPtrs[s] );
+		}
+
+		ReedSolomonCodec codec( block.dataCount, block.parityCount );
+		if (!codec.reconstruct( make_span( shardPtrs ), span< const bool >( present.get(), shardCount ), block.shardSize ))
+		{
+			return;
+		}
+
+		for (size_t j = 0; j < block.dataCount; ++j)
+		{
+			if (present[j])
+				continue;
+			const uint8_t * shard = shardPtrs[j];
+			size_t length = (size_t( shard[0] ) << 8) | shard[1];
+			if (length + LENGTH_SIZE > block.shardSize)
+				continue;  // corrupted
+			block.delivered[j] = true;
+			_recovered.emplace_back( block.sender, std::vector< uint8_t >( shard + LENGTH_SIZE, shard + LENGTH_SIZE + length ) );
+			_stats.recovered++;
+		}
+		complete = true;
+	}
+
+	if (complete)
+	{
+		block.done = true;
+		block.data = {};
+		block.parity = {};
+	}
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
@@ -0,0 +1,183 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: forward error correction of UDP datagrams, parity datagrams rebuild the lost ones without a round trip
+//======================================================================================================================
+
+#ifndef CPPUTILS_FORWARDERRORCORRECTION_INCLUDED
+#define CPPUTILS_FORWARDERRORCORRECTION_INCLUDED
+
+
+#include "Socket.hpp"
+#include "LossInjector.hpp"
+
+#include <CppUtils-Essential/Span.hpp>
+
+#include <deque>
+#include <vector>
+
+
+namespace own {
+
+
+//======================================================================================================================
+/// Systematic Reed-Solomon erasure code over GF(2^8).
+/** Computes parityShards parity shards from dataShards data shards of the same size, and rebuilds any missing data
+  * shards from any dataShards of the dataShards + parityShards shards. The parity rows are a Cauchy matrix normalized
+  * so that the first one is all ones, therefore a single parity shard is a plain XOR of the data shards.
+  * The multiplication kernels use AVX2, SSSE3 or NEON when the compiler targets them, otherwise lookup tables. */
+
+class ReedSolomonCodec
+{
+
+ public:
+
+	static constexpr size_t MAX_SHARDS = 255;
+
+	/// dataShards + parityShards must not exceed MAX_SHARDS.
+	ReedSolomonCodec( size_t dataShards, size_t parityShards );
+
+	size_t dataShards() const noexcept  { return _dataShards; }
+	size_t parityShards() const noexcept  { return _parityShards; }
+
+	/// Computes the parity shards, all the shards must have shardSize bytes.
+	void encode( span< const uint8_t * const > data, span< uint8_t * const > parity, size_t shardSize ) const;
+
+	/// Rebuilds the missing data shards in place, the missing parity shards are left as they are.
+	/** \param[in,out] shards all the data shards followed by all the parity shards, each of shardSize bytes
+	  * \param[in] present which of the shards are valid
+	  * \return false if fewer than dataShards shards are present */
+	bool reconstruct( span< uint8_t * const > shards, span< const bool > present, size_t shardSize ) const;
+
+	/// Which of the multiplication kernels was compiled in ("avx2", "ssse3", "neon" or "scalar").
+	static const char * kernelName() noexcept;
+
+ private:
+
+	size_t _dataShards;
+	size_t _parityShards;
+	std::vector< uint8_t > _parityMatrix;  ///< parityShards rows of dataShards coefficients
+
+};
+
+
+//======================================================================================================================
+
+struct FecConfig
+{
+	size_t dataShards = 8;         ///< datagrams per block
+	size_t parityShards = 2;       ///< parity datagrams per block, 1 means a simple XOR parity
+	SimulatedLoss simulatedLoss;   ///< for testing, outgoing datagrams dropped on purpose
+};
+
+struct FecSenderStats
+{
+	uint64_t dataSent;        ///< including the dropped ones
+	uint64_t paritySent;      ///< including the dropped ones
+	uint64_t simulatedDrops;
+};
+
+struct FecReceiverStats
+{
+	uint64_t dataReceived;
+	uint64_t parityReceived;
+	uint64_t recovered;       ///< data datagrams rebuilt from the parity
+	uint64_t unrecoverable;   ///< data datagrams lost for good, counted when their block is forgotten
+};
+
+
+//======================================================================================================================
+/// Sends datagrams through an UDP socket in blocks, each followed by parity datagrams (see FecReceiver).
+/** Every datagram leaves immediately with a small header, the parity datagrams leave after the last datagram
+  * of the block. A block is sent to a single endpoint, sending to another one finishes the block early. */
+
+class FecSender
+{
+
+ public:
+
+	static constexpr size_t HEADER_SIZE = 8;
+
+	/// The socket must stay valid for the whole lifetime of the sender.
+	FecSender( UdpSocket & socket, const FecConfig & config = FecConfig() );
+
+	SocketError sendTo( const NativeEndpoint & endpoint, const_byte_span datagram );
+
+	/// Sends the parity of the current block without waiting for the rest of its datagrams.
+	/** Call this when the stream pauses, otherwise the last datagrams stay unprotected. */
+	SocketError flush();
+
+	FecSenderStats stats() const noexcept;
+
+ private:
+
+	SocketError _send( const_byte_span datagram );
+
+	UdpSocket & _socket;
+	FecConfig _config;
+	ReedSolomonCodec _codec;
+	NativeEndpoint _blockEndpoint;
+	uint32_t _blockId;
+	std::vector< std::vector< uint8_t > > _blockData;  ///< datagrams of the current block
+	std::vector< uint8_t > _shards;
+	std::vector< uint8_t > _sendBuffer;
+	FecSenderStats _stats;
+	LossInjector _lossInjector;
+
+};
+
+
+//======================================================================================================================
+/// Receives the datagrams sent by FecSender and rebuilds the lost ones from the parity.
+/** The datagrams are returned as they come, a rebuilt one is returned as soon as enough of its block arrives,
+  * so they are not necessarily in the order they were sent. Datagrams without the FEC header are ignored. */
+
+class FecReceiver
+{
+
+ public:
+
+	/// \param[in] maxBlocks how many recent blocks are kept waiting for their missing datagrams
+	FecReceiver( UdpSocket & socket, size_t maxBlocks = 32 );
+
+	SocketError recvFrom( NativeEndpoint & endpoint, byte_span buffer, size_t & received );
+
+	FecReceiverStats stats() const noexcept  { return _stats; }
+
+ private:
+
+	struct Block
+	{
+		NativeEndpoint sender;
+		uint32_t id;
+		size_t dataCount;    ///< the configured block size, until a parity datagram tells the actual one
+		size_t parityCount;
+		size_t shardSize;    ///< 0 until a parity datagram comes
+		bool done;           ///< all the data were delivered or rebuilt, the stored datagrams were freed
+		std::vector< std::vector< uint8_t > > data;    ///< by index, with the 2-byte length before, empty when missing
+		std::vector< std::vector< uint8_t > > parity;  ///< by index, empty when missing
+		std::vector< bool > delivered;                 ///< by index, to drop the late copies of the rebuilt ones
+	};
+
+	Block & _findBlock( const NativeEndpoint & sender, uint32_t id, size_t dataCount, size_t parityCount );
+	void _forgetBlock( Block & block );
+	void _tryRecover( Block & block );
+
+	UdpSocket & _socket;
+	size_t _maxBlocks;
+	std::deque< Block > _blocks;  ///< from the oldest
+	std::deque< std::pair< NativeEndpoint, std::vector< uint8_t > > > _recovered;
+	std::vector< uint8_t > _recvBuffer;
+	FecReceiverStats _stats;
+
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_FORWARDERRORCORRECTION_INCLUDED
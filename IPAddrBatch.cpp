@@ -0,0 +1,335 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: columnar container of IP addresses with bulk operations
+//======================================================================================================================
+
+#include "IPAddrBatch.hpp"
+
+#include <CppUtils-Essential/Essential.hpp>
+#include <CppUtils-Essential/CriticalError.hpp>
+
+#include <cstring>  // memcpy, memchr
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define CPPUTILS_BATCH_SSE2
+#endif
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  helpers
+
+static inline uint64_t blockMask( size_t elemCount ) noexcept
+{
+	return elemCount >= 64 ? ~uint64_t(0) : (uint64_t(1) << elemCount) - 1;
+}
+
+/// index of the n-th (from 0) set bit of the word
+static inline uint32_t selectBit( uint64_t word, uint32_t n ) noexcept
+{
+	for (; n > 0; --n)
+		word &= word - 1;
+	return priv::countTrailingZeros64( word );
+}
+
+/// bit mask of the lane elements equal to the searched word, the lane must have at most 64 elements
+static uint64_t matchV4( const uint32_t * lane, size_t count, uint32_t word ) noexcept
+{
+	uint64_t matches = 0;
+	size_t i = 0;
+ #ifdef CPPUTILS_BATCH_SSE2
+	const __m128i needle = _mm_set1_epi32( int( word ) );
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i equal = _mm_cmpeq_epi32( _mm_loadu_si128( reinterpret_cast< const __m128i * >( lane + i ) ), needle );
+		matches |= uint64_t( _mm_movemask_ps( _mm_castsi128_ps( equal ) ) ) << i;
+	}
+ #endif
+	for (; i < count; ++i)
+		matches |= uint64_t( lane[i] == word ) << i;
+	return matches;
+}
+
+static uint64_t matchV6( const IPAddrBatch::V6Words * lane, size_t count, const IPAddrBatch::V6Words & words ) noexcept
+{
+	uint64_t matches = 0;
+ #ifdef CPPUTILS_BATCH_SSE2
+	const __m128i needle = _mm_loadu_si128( reinterpret_cast< const __m128i * >( words.words ) );
+	for (size_t i = 0; i < count; ++i)
+	{
+		__m128i equal = _mm_cmpeq_epi8( _mm_loadu_si128( reinterpret_cast< const __m128i * >( lane[i].words ) ), needle );
+		matches |= uint64_t( _mm_movemask_epi8( equal ) == 0xFFFF ) << i;
+	}
+ #else
+	for (size_t i = 0; i < count; ++i)
+		matches |= uint64_t( ((lane[i].words[0] ^ words.words[0]) | (lane[i].words[1] ^ words.words[1])) == 0 ) << i;
+ #endif
+	return matches;
+}
+
+/// converts between the stored network-order word and a number that compares in the address order, works both ways
+static inline uint32_t swapToOrdered( uint32_t word ) noexcept
+{
+	return priv::loadBE32( reinterpret_cast< const uint8_t * >( &word ) );
+}
+static inline uint64_t swapToOrdered( uint64_t word ) noexcept
+{
+	return priv::loadBE64( reinterpret_cast< const uint8_t * >( &word ) );
+}
+
+static inline size_t hashV4( uint32_t word ) noexcept
+{
+	// same as IPAddr::hash(), which loads the 4 bytes followed by the zeroed rest of its storage
+	uint8_t bytes [8] = {};
+	std::memcpy( bytes, &word, 4 );
+	return priv::hashWords( priv::loadNative64( bytes ), uint64_t( IPVer::_4 ) );
+}
+
+static inline size_t hashV6( const IPAddrBatch::V6Words & words ) noexcept
+{
+	return priv::hashWords( words.words[0], words.words[1] ^ uint64_t( IPVer::_6 ) );
+}
+
+
+//======================================================================================================================
+//  IPAddrBatch
+
+void IPAddrBatch::reserve( size_t count )
+{
+	// the mix of the versions is not known in advance, so make room for any of them
+	_v4.reserve( count );
+	_v6.reserve( count );
+	_isV6.reserve( (count + 63) / 64 );
+	_v6Before.reserve( (count + 63) / 64 );
+}
+
+void IPAddrBatch::clear() noexcept
+{
+	_v4.clear();
+	_v6.clear();
+	_isV6.clear();
+	_v6Before.clear();
+	_size = 0;
+}
+
+void IPAddrBatch::_pushVersionBit( bool isV6 )
+{
+	if (_size % 64 == 0)
+	{
+		_isV6.push_back( 0 );
+		_v6Before.push_back( uint32_t( _v6.size() ) );
+	}
+	_isV6.back() |= uint64_t( isV6 ) << (_size % 64);
+	++_size;
+}
+
+void IPAddrBatch::push_back( const IPv4Addr & addr )
+{
+	_pushVersionBit( false );
+	uint32_t word;
+	std::memcpy( &word, addr.data().data(), 4 );
+	_v4.push_back( word );
+}
+
+void IPAddrBatch::push_back( const IPv6Addr & addr )
+{
+	_pushVersionBit( true );
+	V6Words words;
+	std::memcpy( words.words, addr.data().data(), 16 );
+	_v6.push_back( words );
+}
+
+void IPAddrBatch::push_back( const IPAddr & addr )
+{
+	if (addr.version() == IPVer::_4)
+		push_back( addr.v4() );
+	else if (addr.version() == IPVer::_6)
+		push_back( addr.v6() );
+	else
+		critical_error( "Attempted to add IPAddr of invalid version %d to IPAddrBatch.", int( addr.version() ) );
+}
+
+IPAddr IPAddrBatch::operator[]( size_t idx ) const noexcept
+{
+	size_t block = idx / 64;
+	uint64_t bitmap = _isV6[ block ];
+	uint64_t below = (uint64_t(1) << (idx % 64)) - 1;
+	size_t v6Rank = _v6Before[ block ] + priv::popCount64( bitmap & below );
+	if ((bitmap >> (idx % 64)) & 1)
+	{
+		IPv6Addr addr;
+		std::memcpy( addr.data().data(), _v6[ v6Rank ].words, 16 );
+		return addr;
+	}
+	else
+	{
+		IPv4Addr addr;
+		std::memcpy( addr.data().data(), &_v4[ idx - v6Rank ], 4 );
+		return addr;
+	}
+}
+
+size_t IPAddrBatch::appendParsed( std::string_view text )
+{
+	size_t invalidCount = 0;
+	const char * pos = text.data();
+	const char * const end = text.data() + text.size();
+	while (pos < end)
+	{
+		const char * lineEnd = static_cast< const char * >( std::memchr( pos, '\n', size_t( end - pos ) ) );
+		if (!lineEnd)
+			lineEnd = end;
+		std::string_view line( pos, size_t( lineEnd - pos ) );
+		pos = lineEnd + 1;
+
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix( 1 );
+		if (line.empty())
+			continue;
+
+		// choose the parser by the separator, so that each line is parsed only once
+		if (std::memchr( line.data(), ':', line.size() ) == nullptr)
+		{
+			if (std::optional< IPv4Addr > addr = IPv4Addr::parse( line ))
+				push_back( *addr );
+			else
+				++invalidCount;
+		}
+		else
+		{
+			if (std::optional< IPv6Addr > addr = IPv6Addr::parse( line ))
+				push_back( *addr );
+			else
+				++invalidCount;
+		}
+	}
+	return invalidCount;
+}
+
+void IPAddrBatch::maskToPrefix( uint8_t v4Length, uint8_t v6Length )
+{
+	if (v4Length > 32 || v6Length > 128)
+		critical_error( "Invalid prefix length for IPAddrBatch::maskToPrefix (/%u, /%u).", unsigned( v4Length ), unsigned( v6Length ) );
+
+	// build the masks from bytes, so that they have the same byte order as the stored words
+	uint8_t maskBytes [16];
+	for (size_t i = 0; i < 16; ++i)
+		maskBytes[i] = uint8_t( v4Length >= (i + 1) * 8 ? 0xFF : v4Length <= i * 8 ? 0x00 : 0xFF << (8 - v4Length % 8) );
+	const uint32_t v4Mask = priv::loadNative32( maskBytes );
+	for (size_t i = 0; i < 16; ++i)
+		maskBytes[i] = uint8_t( v6Length >= (i + 1) * 8 ? 0xFF : v6Length <= i * 8 ? 0x00 : 0xFF << (8 - v6Length % 8) );
+	const uint64_t v6Mask0 = priv::loadNative64( maskBytes );
+	const uint64_t v6Mask1 = priv::loadNative64( maskBytes + 8 );
+
+	// plain loops over contiguous arrays, the compiler vectorizes them
+	uint32_t * v4 = _v4.data();
+	for (size_t i = 0; i < _v4.size(); ++i)
+		v4[i] &= v4Mask;
+	V6Words * v6 = _v6.data();
+	for (size_t i = 0; i < _v6.size(); ++i)
+	{
+		v6[i].words[0] &= v6Mask0;
+		v6[i].words[1] &= v6Mask1;
+	}
+}
+
+void IPAddrBatch::findEqual( const IPAddr & addr, std::vector< size_t > & indexes ) const
+{
+	const bool isV6 = addr.version() == IPVer::_6;
+	if (!isV6 && addr.version() != IPVer::_4)
+		return;
+
+	uint32_t v4Word = 0;
+	V6Words v6Words = {};
+	if (isV6)
+		std::memcpy( v6Words.words, addr.data().data(), 16 );
+	else
+		std::memcpy( &v4Word, addr.data().data(), 4 );
+
+	// each block of the bitmap covers a contiguous slice of each lane, compare the slice and map the matches back
+	for (size_t block = 0; block < _isV6.size(); ++block)
+	{
+		uint64_t versionBits = (isV6 ? _isV6[ block ] : ~_isV6[ block ]) & blockMask( _size - block * 64 );
+		if (versionBits == 0)
+			continue;
+		size_t laneBegin = isV6 ? _v6Before[ block ] : block * 64 - _v6Before[ block ];
+		size_t laneCount = priv::popCount64( versionBits );
+		uint64_t matches = isV6 ? matchV6( _v6.data() + laneBegin, laneCount, v6Words )
+		                        : matchV4( _v4.data() + laneBegin, laneCount, v4Word );
+		for (; matches != 0; matches &= matches - 1)
+			indexes.push_back( block * 64 + selectBit( versionBits, priv::countTrailingZeros64( matches ) ) );
+	}
+}
+
+void IPAddrBatch::deduplicate()
+{
+	for (uint32_t & word : _v4)
+		word = swapToOrdered( word );
+	std::sort( _v4.begin(), _v4.end() );
+	_v4.erase( std::unique( _v4.begin(), _v4.end() ), _v4.end() );
+	for (uint32_t & word : _v4)
+		word = swapToOrdered( word );
+
+	for (V6Words & words : _v6)
+		words = { swapToOrdered( words.words[0] ), swapToOrdered( words.words[1] ) };
+	auto less = []( const V6Words & a, const V6Words & b )
+	{
+		return a.words[0] < b.words[0] || (a.words[0] == b.words[0] && a.words[1] < b.words[1]);
+	};
+	auto equal = []( const V6Words & a, const V6Words & b )
+	{
+		return a.words[0] == b.words[0] && a.words[1] == b.words[1];
+	};
+	std::sort( _v6.begin(), _v6.end(), less );
+	_v6.erase( std::unique( _v6.begin(), _v6.end(), equal ), _v6.end() );
+	for (V6Words & words : _v6)
+		words = { swapToOrdered( words.words[0] ), swapToOrdered( words.words[1] ) };
+
+	// all the IPv4 addresses now precede all the IPv6 ones
+	_size = _v4.size() + _v6.size();
+	size_t blockCount = (_size + 63) / 64;
+	_isV6.resize( blockCount );
+	_v6Before.resize( blockCount );
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		size_t blockBegin = block * 64;
+		uint64_t v6Bits = blockBegin >= _v4.size() ? ~uint64_t(0) : ~blockMask( _v4.size() - blockBegin );
+		_isV6[ block ] = v6Bits & blockMask( _size - blockBegin );  // the bits beyond the end must stay 0 for the next push_back
+		_v6Before[ block ] = uint32_t( blockBegin > _v4.size() ? blockBegin - _v4.size() : 0 );
+	}
+}
+
+void IPAddrBatch::hash( span< size_t > hashes ) const noexcept
+{
+	if (hashes.size() < _size)
+		critical_error( "The output span for IPAddrBatch::hash is smaller than the batch (%zu < %zu).", hashes.size(), _size );
+
+	// The hash is not vectorized, unlike the searches. It must stay equal to std::hash< IPAddr >, which is built on
+	// the full 64x64->128 bit multiplication, and neither SSE2 nor AVX2 has that, so emulating it from the 32-bit
+	// multiplications would be slower than the scalar MUL. What the batch gains here is the sequential reads of
+	// the lanes instead of the IPAddr objects, so hash each lane in order and scatter the results to the positions
+	// of the elements within the block.
+	const uint32_t * v4 = _v4.data();
+	const V6Words * v6 = _v6.data();
+	for (size_t block = 0; block < _isV6.size(); ++block)
+	{
+		size_t * blockHashes = hashes.data() + block * 64;
+		uint64_t valid = blockMask( _size - block * 64 );
+		for (uint64_t bits = ~_isV6[ block ] & valid; bits != 0; bits &= bits - 1)
+			blockHashes[ priv::countTrailingZeros64( bits ) ] = hashV4( *v4++ );
+		for (uint64_t bits = _isV6[ block ] & valid; bits != 0; bits &= bits - 1)
+			blockHashes[ priv::countTrailingZeros64( bits ) ] = hashV6( *v6++ );
+	}
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
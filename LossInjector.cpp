@@ -0,0 +1,31 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: dropping of outgoing datagrams on purpose, for testing how the protocols over UDP cope with loss
+//======================================================================================================================
+
+#include "LossInjector.hpp"
+
+#include <algorithm>  // min, max
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  LossInjector
+
+void LossInjector::reset( const SimulatedLoss & config ) noexcept
+{
+	_enabled = config.ratio > 0.0;
+	_random.seed( config.seed );
+	_distribution = std::bernoulli_distribution( (std::min)( (std::max)( config.ratio, 0.0 ), 1.0 ) );
+	_dropCount = 0;
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
@@ -0,0 +1,69 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: dropping of outgoing datagrams on purpose, for testing how the protocols over UDP cope with loss
+//======================================================================================================================
+
+#ifndef CPPUTILS_LOSSINJECTOR_INCLUDED
+#define CPPUTILS_LOSSINJECTOR_INCLUDED
+
+
+#include <cstdint>
+#include <random>
+
+
+namespace own {
+
+
+//======================================================================================================================
+
+struct SimulatedLoss
+{
+	double ratio = 0.0;  ///< ratio of outgoing datagrams dropped on purpose, 0 disables it
+	uint32_t seed = 1;   ///< the same seed drops the same datagrams, so that the tests are repeatable
+};
+
+
+//======================================================================================================================
+/// Decides which outgoing datagrams get dropped, shared by the transports that offer the simulated loss for testing.
+
+class LossInjector
+{
+
+ public:
+
+	LossInjector( const SimulatedLoss & config = SimulatedLoss() ) noexcept  { reset( config ); }
+
+	/// Starts over with another configuration and with the drop count zeroed.
+	void reset( const SimulatedLoss & config ) noexcept;
+
+	/// Returns true if the next datagram should be dropped instead of sent, and counts it.
+	bool shouldDrop() noexcept
+	{
+		if (!_enabled || !_distribution( _random ))
+			return false;
+		_dropCount++;
+		return true;
+	}
+
+	/// How many datagrams have been dropped since the last reset.
+	uint64_t dropCount() const noexcept  { return _dropCount; }
+
+ private:
+
+	bool _enabled;
+	std::minstd_rand _random;
+	std::bernoulli_distribution _distribution;
+	uint64_t _dropCount;
+
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_LOSSINJECTOR_INCLUDED
@@ -0,0 +1,372 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: splitting a byte stream into messages, either prefixed by their length or ended by a delimiter
+//======================================================================================================================
+
+#include "MessageFraming.hpp"
+
+#include <CppUtils-Essential/CriticalError.hpp>
+
+#include <cstring>    // memcpy, memmove, memchr, memcmp
+#include <algorithm>  // min, max
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define CPPUTILS_FRAMING_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define CPPUTILS_FRAMING_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+	#define CPPUTILS_FRAMING_NEON
+#endif
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  error strings
+
+const char * enumString( LengthPrefix prefix ) noexcept
+{
+	switch (prefix)
+	{
+		case LengthPrefix::Fixed16:  return "Fixed16";
+		case LengthPrefix::Fixed32:  return "Fixed32";
+		case LengthPrefix::Varint:   return "Varint";
+		default:                     return "<invalid>";
+	}
+}
+
+
+//======================================================================================================================
+//  length prefix
+
+size_t encodeLengthPrefix( LengthPrefix prefix, uint64_t length, uint8_t * dest ) noexcept
+{
+	switch (prefix)
+	{
+		case LengthPrefix::Fixed16:
+			if (length > 0xFFFF)
+			{
+				critical_error( "Message of %llu bytes doesn't fit into a 16-bit length prefix.", (unsigned long long)length );
+			}
+			dest[0] = uint8_t( length >> 8 );
+			dest[1] = uint8_t( length );
+			return 2;
+
+		case LengthPrefix::Fixed32:
+			if (length > 0xFFFFFFFF)
+			{
+				critical_error( "Message of %llu bytes doesn't fit into a 32-bit length prefix.", (unsigned long long)length );
+			}
+			dest[0] = uint8_t( length >> 24 );
+			dest[1] = uint8_t( length >> 16 );
+			dest[2] = uint8_t( length >> 8 );
+			dest[3] = uint8_t( length );
+			return 4;
+
+		default:
+		{
+			size_t size = 0;
+			while (length >= 0x80)
+			{
+				dest[ size++ ] = uint8_t( length | 0x80 );
+				length >>= 7;
+			}
+			dest[ size++ ] = uint8_t( length );
+			return size;
+		}
+	}
+}
+
+bool decodeLengthPrefix( LengthPrefix prefix, const_byte_span data, uint64_t & length, size_t & prefixSize ) noexcept
+{
+	prefixSize = 0;
+
+	switch (prefix)
+	{
+		case LengthPrefix::Fixed16:
+			if (data.size() < 2)
+				return true;
+			length = (uint64_t( data[0] ) << 8) | uint64_t( data[1] );
+			prefixSize = 2;
+			return true;
+
+		case LengthPrefix::Fixed32:
+			if (data.size() < 4)
+				return true;
+			length = (uint64_t( data[0] ) << 24) | (uint64_t( data[1] ) << 16) | (uint64_t( data[2] ) << 8) | uint64_t( data[3] );
+			prefixSize = 4;
+			return true;
+
+		default:
+		{
+			uint64_t value = 0;
+			size_t available = (std::min)( data.size(), MAX_LENGTH_PREFIX_SIZE );
+			for (size_t i = 0; i < available; ++i)
+			{
+				value |= uint64_t( data[i] & 0x7F ) << (7 * i);
+				if ((data[i] & 0x80) == 0)
+				{
+					// the 10th byte can hold only the highest bit of the 64
+					if (i == MAX_LENGTH_PREFIX_SIZE - 1 && data[i] > 1)
+						return false;
+					length = value;
+					prefixSize = i + 1;
+					return true;
+				}
+			}
+			return available < MAX_LENGTH_PREFIX_SIZE;  // all 10 bytes with the continuation bit is too long
+		}
+	}
+}
+
+
+//======================================================================================================================
+//  FrameReader
+
+FrameReader::FrameReader( LengthPrefix prefix, size_t maxMessageSize )
+:
+	_prefix( prefix ),
+	_maxMessageSize( maxMessageSize ),
+	// with room for two whole messages, there is always room for one after the unfinished one is moved to the beginning
+	_buffer( (std::max)( 2 * (maxMessageSize + MAX_LENGTH_PREFIX_SIZE), size_t( 64 * 1024 ) ) ),
+	_begin( 0 ),
+	_end( 0 )
+{}
+
+bool FrameReader::nextBufferedMessage( const_byte_span & message, bool & malformed ) noexcept
+{
+	malformed = false;
+
+	const_byte_span data( _buffer.data() + _begin, _end - _begin );
+	uint64_t length;
+	size_t prefixSize;
+	if (!decodeLengthPrefix( _prefix, data, length, prefixSize ) || (prefixSize > 0 && length > _maxMessageSize))
+	{
+		malformed = true;
+		return false;
+	}
+	if (prefixSize == 0 || data.size() - prefixSize < length)
+	{
+		return false;
+	}
+
+	message = data.subspan( prefixSize, size_t( length ) );
+	_begin += prefixSize + size_t( length );
+	if (_begin == _end)
+	{
+		_begin = _end = 0;  // the next receive can use the whole buffer without moving anything
+	}
+	return true;
+}
+
+byte_span FrameReader::_freeSpace() noexcept
+{
+	// Move the unfinished message to the beginning only when the rest of the buffer is too small for a whole message,
+	// so that the cost of moving is paid once per many messages.
+	if (_buffer.size() - _end < _maxMessageSize + MAX_LENGTH_PREFIX_SIZE && _begin > 0)
+	{
+		memmove( _buffer.data(), _buffer.data() + _begin, _end - _begin );
+		_end -= _begin;
+		_begin = 0;
+	}
+	return byte_span( _buffer.data() + _end, _buffer.size() - _end );
+}
+
+
+//======================================================================================================================
+//  FrameWriter
+
+void FrameWriter::addMessage( const_byte_span message )
+{
+	byte_span dest = addMessage( message.size() );
+	if (!message.empty())
+		memcpy( dest.data(), message.data(), message.size() );
+}
+
+byte_span FrameWriter::addMessage( size_t size )
+{
+	uint8_t prefix [MAX_LENGTH_PREFIX_SIZE];
+	size_t prefixSize = encodeLengthPrefix( _prefix, size, prefix );
+
+	size_t prefixPos = _buffer.size();
+	_buffer.resize( prefixPos + prefixSize + size );
+	memcpy( _buffer.data() + prefixPos, prefix, prefixSize );
+	return byte_span( _buffer.data() + prefixPos + prefixSize, size );
+}
+
+
+//======================================================================================================================
+//  delimiter
+
+static inline uint32_t countTrailingZeros( uint64_t bits ) noexcept  // bits must not be 0
+{
+ #if defined(__GNUC__) || defined(__clang__)
+	return uint32_t( __builtin_ctzll( bits ) );
+ #else
+	uint32_t count = 0;
+	for (; !(bits & 1); bits >>= 1)
+		++count;
+	return count;
+ #endif
+}
+
+/// whether the delimiter starts at the position, when its first and last byte are already known to match
+static inline bool matchesInside( const uint8_t * pos, std::string_view delimiter ) noexcept
+{
+	return delimiter.size() <= 2 || memcmp( pos + 1, delimiter.data() + 1, delimiter.size() - 2 ) == 0;
+}
+
+size_t findDelimiter( const_byte_span data, std::string_view delimiter ) noexcept
+{
+	const size_t size = data.size();
+	if (delimiter.empty() || size < delimiter.size())
+	{
+		return size;
+	}
+
+	const uint8_t * bytes = data.data();
+	const size_t lastOffset = delimiter.size() - 1;
+	const size_t candidates = size - lastOffset;  // the positions where the delimiter can start
+	const uint8_t first = uint8_t( delimiter.front() );
+	const uint8_t last = uint8_t( delimiter.back() );
+
+	// For a single byte both comparisons are the same, but it's cheaper to do it twice than to have another loop.
+	size_t i = 0;
+ #if defined(CPPUTILS_FRAMING_AVX2)
+	const __m256i firstVec = _mm256_set1_epi8( char( first ) );
+	const __m256i lastVec = _mm256_set1_epi8( char( last ) );
+	for (; i + 32 <= candidates; i += 32)
+	{
+		__m256i atFirst = _mm256_cmpeq_epi8( _mm256_loadu_si256( reinterpret_cast< const __m256i * >( bytes + i ) ), firstVec );
+		__m256i atLast = _mm256_cmpeq_epi8( _mm256_loadu_si256( reinterpret_cast< const __m256i * >( bytes + i + lastOffset ) ), lastVec );
+		for (uint32_t mask = uint32_t( _mm256_movemask_epi8( _mm256_and_si256( atFirst, atLast ) ) ); mask != 0; mask &= mask - 1)
+		{
+			size_t pos = i + countTrailingZeros( mask );
+			if (matchesInside( bytes + pos, delimiter ))
+				return pos;
+		}
+	}
+ #elif defined(CPPUTILS_FRAMING_SSE2)
+	const __m128i firstVec = _mm_set1_epi8( char( first ) );
+	const __m128i lastVec = _mm_set1_epi8( char( last ) );
+	for (; i + 16 <= candidates; i += 16)
+	{
+		__m128i atFirst = _mm_cmpeq_epi8( _mm_loadu_si128( reinterpret_cast< const __m128i * >( bytes + i ) ), firstVec );
+		__m128i atLast = _mm_cmpeq_epi8( _mm_loadu_si128( reinterpret_cast< const __m128i * >( bytes + i + lastOffset ) ), lastVec );
+		for (uint32_t mask = uint32_t( _mm_movemask_epi8( _mm_and_si128( atFirst, atLast ) ) ); mask != 0; mask &= mask - 1)
+		{
+			size_t pos = i + countTrailingZeros( mask );
+			if (matchesInside( bytes + pos, delimiter ))
+				return pos;
+		}
+	}
+ #elif defined(CPPUTILS_FRAMING_NEON)
+	const uint8x16_t firstVec = vdupq_n_u8( first );
+	const uint8x16_t lastVec = vdupq_n_u8( last );
+	for (; i + 16 <= candidates; i += 16)
+	{
+		uint8x16_t both = vandq_u8( vceqq_u8( vld1q_u8( bytes + i ), firstVec ), vceqq_u8( vld1q_u8( bytes + i + lastOffset ), lastVec ) );
+		// NEON has no movemask, so narrow each byte of the comparison to 4 bits of a 64-bit mask
+		uint64_t mask = vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16( vreinterpretq_u16_u8( both ), 4 ) ), 0 );
+		while (mask != 0)
+		{
+			uint32_t bit = countTrailingZeros( mask );
+			size_t pos = i + bit / 4;
+			if (matchesInside( bytes + pos, delimiter ))
+				return pos;
+			mask &= ~(uint64_t( 0xF ) << bit);  // all 4 bits of the byte
+		}
+	}
+ #else
+	// memchr of the C library is vectorized on most platforms, so let it find the candidates
+	while (i < candidates)
+	{
+		const void * found = memchr( bytes + i, first, candidates - i );
+		if (!found)
+			return size;
+		size_t pos = size_t( static_cast< const uint8_t * >( found ) - bytes );
+		if (bytes[ pos + lastOffset ] == last && matchesInside( bytes + pos, delimiter ))
+			return pos;
+		i = pos + 1;
+	}
+ #endif
+	for (; i < candidates; ++i)
+	{
+		if (bytes[i] == first && bytes[ i + lastOffset ] == last && matchesInside( bytes + i, delimiter ))
+			return i;
+	}
+	return size;
+}
+
+
+//======================================================================================================================
+//  DelimitedReader
+
+DelimitedReader::DelimitedReader( std::string_view delimiter, size_t maxRecordSize )
+:
+	_delimiter( delimiter ),
+	_maxRecordSize( maxRecordSize ),
+	// with room for two whole records, there is always room for one after the unfinished one is moved to the beginning
+	_buffer( (std::max)( 2 * (maxRecordSize + delimiter.size()), size_t( 64 * 1024 ) ) ),
+	_begin( 0 ),
+	_end( 0 ),
+	_searched( 0 )
+{
+	if (_delimiter.empty())
+	{
+		critical_error( "The delimiter of records must not be empty." );
+	}
+}
+
+bool DelimitedReader::nextBufferedRecord( std::string_view & record, bool & malformed ) noexcept
+{
+	malformed = false;
+
+	size_t searchFrom = (std::max)( _begin, _searched );
+	size_t found = searchFrom + findDelimiter( const_byte_span( _buffer.data() + searchFrom, _end - searchFrom ), _delimiter );
+	if (found == _end)
+	{
+		// the beginning of a delimiter at the end of the data can still be completed by the next receive
+		_searched = (std::max)( _begin, _end - (std::min)( _end, _delimiter.size() - 1 ) );
+		malformed = _end - _begin >= _maxRecordSize + _delimiter.size();
+		return false;
+	}
+	if (found - _begin > _maxRecordSize)
+	{
+		malformed = true;
+		return false;
+	}
+
+	record = std::string_view( reinterpret_cast< const char * >( _buffer.data() + _begin ), found - _begin );
+	_begin = found + _delimiter.size();
+	_searched = _begin;
+	if (_begin == _end)
+	{
+		_begin = _end = _searched = 0;  // the next receive can use the whole buffer without moving anything
+	}
+	return true;
+}
+
+byte_span DelimitedReader::_freeSpace() noexcept
+{
+	if (_buffer.size() - _end < _maxRecordSize + _delimiter.size() && _begin > 0)
+	{
+		memmove( _buffer.data(), _buffer.data() + _begin, _end - _begin );
+		_end -= _begin;
+		_searched -= _begin;
+		_begin = 0;
+	}
+	return byte_span( _buffer.data() + _end, _buffer.size() - _end );
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
@@ -0,0 +1,249 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: splitting a byte stream into messages, either prefixed by their length or ended by a delimiter
+//======================================================================================================================
+
+#ifndef CPPUTILS_MESSAGEFRAMING_INCLUDED
+#define CPPUTILS_MESSAGEFRAMING_INCLUDED
+
+
+#include "Socket.hpp"
+
+#include <CppUtils-Essential/Span.hpp>
+
+#include <vector>
+#include <string>
+#include <string_view>
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  length prefix
+
+enum class LengthPrefix
+{
+	Fixed16,  ///< 2 bytes in the network byte order, for messages up to 64 kB
+	Fixed32,  ///< 4 bytes in the network byte order
+	Varint,   ///< 7 bits in each byte, the lowest ones first, the highest bit set in all but the last byte (LEB128)
+};
+const char * enumString( LengthPrefix prefix ) noexcept;
+
+/// The most bytes a length prefix can take (a varint of 64 bits).
+constexpr size_t MAX_LENGTH_PREFIX_SIZE = 10;
+
+/// Writes the length prefix into dest, which must have room for MAX_LENGTH_PREFIX_SIZE bytes.
+/** \return how many bytes the prefix took */
+size_t encodeLengthPrefix( LengthPrefix prefix, uint64_t length, uint8_t * dest ) noexcept;
+
+/// Reads the length prefix at the beginning of the data.
+/** \param[out] prefixSize how many bytes the prefix took, 0 if the data end before the prefix does
+  * \return false if the prefix is malformed (a varint longer than 64 bits) */
+bool decodeLengthPrefix( LengthPrefix prefix, const_byte_span data, uint64_t & length, size_t & prefixSize ) noexcept;
+
+
+//======================================================================================================================
+/// Receives length-prefixed messages from a stream connection and returns each of them as a whole.
+/** Instead of receiving the prefix and then the message with separate system calls, the reader receives as much
+  * as fits into its buffer at once, often many messages with one call, and returns views of the messages pointing
+  * into the buffer, without copying them out. When the end of the buffer is reached, the unfinished message
+  * is moved to the beginning, so each byte is copied at most once, and only the part of a message that was split
+  * by a receive.
+  *
+  * The connection can be any class with receiveOnce( byte_span, size_t & ) like the one of TcpSocket,
+  * for example UnixStreamSocket or SharedMemoryChannel. */
+
+class FrameReader
+{
+
+ public:
+
+	/// \param[in] maxMessageSize longer messages are rejected as malformed, the buffer has room for two of them
+	FrameReader( LengthPrefix prefix = LengthPrefix::Fixed32, size_t maxMessageSize = 64 * 1024 );
+
+	/// Returns the next message, receiving from the connection only when there is no whole message in the buffer.
+	/** The view points into the buffer of the reader and it's valid until the next call of any of the methods.
+	  * Returns SocketError::MalformedMessage when the prefix is malformed or over the maximum size, after that
+	  * the stream can't be split into messages anymore and the connection should be closed.
+	  * The errors of the connection (WouldBlock, Timeout, ...) are passed through, nothing is lost by them. */
+	template< typename Connection >
+	SocketError receiveMessage( Connection & connection, const_byte_span & message ) noexcept
+	{
+		bool malformed;
+		while (!nextBufferedMessage( message, malformed ))
+		{
+			if (malformed)
+			{
+				return SocketError::MalformedMessage;
+			}
+
+			size_t received;
+			SocketError error = connection.receiveOnce( _freeSpace(), received );
+			if (error != SocketError::Success)
+			{
+				return error;
+			}
+			_end += received;
+		}
+		return SocketError::Success;
+	}
+
+	/// Takes the next message from what's already in the buffer, without receiving anything.
+	/** Returns false if there is no whole message, and sets malformed if there can't be any. */
+	bool nextBufferedMessage( const_byte_span & message, bool & malformed ) noexcept;
+
+	/// How many bytes have been received but not yet returned as messages.
+	size_t bufferedSize() const noexcept  { return _end - _begin; }
+
+	/// Forgets all the buffered data, e.g. when the reader is used for a new connection.
+	void reset() noexcept  { _begin = _end = 0; }
+
+ private:
+
+	/// makes room at the end of the buffer for the next receive
+	byte_span _freeSpace() noexcept;
+
+	LengthPrefix _prefix;
+	size_t _maxMessageSize;
+	std::vector< uint8_t > _buffer;
+	size_t _begin;  ///< start of the data not returned yet
+	size_t _end;    ///< end of the received data
+
+};
+
+
+//======================================================================================================================
+/// Collects length-prefixed messages and sends them all to a stream connection with a single call.
+/** Many small messages sent one by one cost a system call each, and with TCP_NODELAY also a packet each.
+  * The writer appends them into its buffer and flush() hands them over to the system at once.
+  *
+  * The connection can be any class with send( const_byte_span ) like the one of TcpSocket. */
+
+class FrameWriter
+{
+
+ public:
+
+	FrameWriter( LengthPrefix prefix = LengthPrefix::Fixed32 ) : _prefix( prefix ) {}
+
+	/// Appends the message with its length prefix to the buffer, nothing is sent yet.
+	void addMessage( const_byte_span message );
+
+	/// Appends the length prefix and reserves room for a message of the size, which the caller fills in place.
+	/** The returned view is valid until the next call of any of the methods. */
+	byte_span addMessage( size_t size );
+
+	/// Sends all the collected messages with a single send() and empties the buffer.
+	/** The buffer is emptied even when the send fails, as the stream is broken then anyway. */
+	template< typename Connection >
+	SocketError flush( Connection & connection ) noexcept
+	{
+		if (_buffer.empty())
+		{
+			return SocketError::Success;
+		}
+
+		SocketError error = connection.send( const_byte_span( _buffer.data(), _buffer.size() ) );
+		_buffer.clear();
+		return error;
+	}
+
+	/// How many bytes are waiting for flush(), including the prefixes.
+	size_t bufferedSize() const noexcept  { return _buffer.size(); }
+
+	bool empty() const noexcept  { return _buffer.empty(); }
+
+ private:
+
+	LengthPrefix _prefix;
+	std::vector< uint8_t > _buffer;
+
+};
+
+
+//======================================================================================================================
+//  delimiter
+
+/// Finds the first occurrence of the delimiter in the data, returns data.size() if there is none.
+/** Compares whole vectors of the data against the first and the last byte of the delimiter at once (AVX2, SSE2, NEON,
+  * whichever the compiler is allowed to use) and only the candidate positions against the rest of it. */
+size_t findDelimiter( const_byte_span data, std::string_view delimiter ) noexcept;
+
+
+//======================================================================================================================
+/// Receives records ended by a delimiter from a stream connection, e.g. lines of a text protocol.
+/** Like FrameReader, it receives as much as fits into its buffer at once and returns views of the records pointing
+  * into the buffer. The received data are searched for the delimiter only once, even when a record arrives in parts.
+  *
+  * The connection can be any class with receiveOnce( byte_span, size_t & ) like the one of TcpSocket. */
+
+class DelimitedReader
+{
+
+ public:
+
+	/// \param[in] delimiter one or more bytes that end each record, e.g. "\n" or "\r\n"
+	/// \param[in] maxRecordSize longer records are rejected as malformed, the buffer has room for two of them
+	DelimitedReader( std::string_view delimiter = "\r\n", size_t maxRecordSize = 64 * 1024 );
+
+	/// Returns the next record without the delimiter, receiving only when there is no whole record in the buffer.
+	/** The view points into the buffer of the reader and it's valid until the next call of any of the methods.
+	  * Returns SocketError::MalformedMessage when there is no delimiter within maxRecordSize bytes.
+	  * The errors of the connection (WouldBlock, Timeout, ...) are passed through, nothing is lost by them. */
+	template< typename Connection >
+	SocketError receiveRecord( Connection & connection, std::string_view & record ) noexcept
+	{
+		bool malformed;
+		while (!nextBufferedRecord( record, malformed ))
+		{
+			if (malformed)
+			{
+				return SocketError::MalformedMessage;
+			}
+
+			size_t received;
+			SocketError error = connection.receiveOnce( _freeSpace(), received );
+			if (error != SocketError::Success)
+			{
+				return error;
+			}
+			_end += received;
+		}
+		return SocketError::Success;
+	}
+
+	/// Takes the next record from what's already in the buffer, without receiving anything.
+	/** Returns false if there is no whole record, and sets malformed if there can't be any. */
+	bool nextBufferedRecord( std::string_view & record, bool & malformed ) noexcept;
+
+	/// How many bytes have been received but not yet returned as records.
+	size_t bufferedSize() const noexcept  { return _end - _begin; }
+
+	/// Forgets all the buffered data, e.g. when the reader is used for a new connection.
+	void reset() noexcept  { _begin = _end = _searched = 0; }
+
+ private:
+
+	/// makes room at the end of the buffer for the next receive
+	byte_span _freeSpace() noexcept;
+
+	std::string _delimiter;
+	size_t _maxRecordSize;
+	std::vector< uint8_t > _buffer;
+	size_t _begin;     ///< start of the data not returned yet
+	size_t _end;       ///< end of the received data
+	size_t _searched;  ///< where the search for the delimiter continues, the data before it don't contain it
+
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_MESSAGEFRAMING_INCLUDED
@@ -0,0 +1,258 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: ring buffer mapped twice back to back in the virtual memory, so that no part of it is ever split
+//======================================================================================================================
+
+#include "MirroredRingBuffer.hpp"
+
+#include <CppUtils-Essential/CriticalError.hpp>
+
+#ifdef _WIN32
+	#include <windows.h>       // CreateFileMapping, MapViewOfFileEx, VirtualAlloc
+#else
+	#include <unistd.h>        // close, ftruncate, sysconf, getpid
+	#include <fcntl.h>         // O_CREAT, O_RDWR
+	#include <sys/mman.h>      // mmap, munmap, memfd_create, shm_open
+	#include <atomic>
+	#include <string>
+	#ifndef MAP_ANONYMOUS
+		#define MAP_ANONYMOUS MAP_ANON
+	#endif
+#endif // _WIN32
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  mapping the memory twice
+
+/// the sizes and the addresses of the mappings must be multiples of this
+static size_t _mappingGranularity() noexcept
+{
+ #ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return size_t( info.dwAllocationGranularity );
+ #else
+	return size_t( ::sysconf( _SC_PAGESIZE ) );
+ #endif // _WIN32
+}
+
+#ifdef _WIN32
+
+static uint8_t * _mapMirrored( size_t capacity, system_error_t & lastSystemError ) noexcept
+{
+	HANDLE mapping = CreateFileMappingA(
+		INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD( uint64_t( capacity ) >> 32 ), DWORD( capacity ), nullptr
+	);
+	if (!mapping)
+	{
+		lastSystemError = getLastError();
+		return nullptr;
+	}
+
+	// There is no way to map into a reserved range that works on all versions of Windows, so find a free range
+	// by reserving it, release it and map the views there. Another thread may take the range in the meantime,
+	// then try it again elsewhere.
+	uint8_t * data = nullptr;
+	for (int attempt = 0; attempt < 16 && !data; ++attempt)
+	{
+		void * range = VirtualAlloc( nullptr, 2 * capacity, MEM_RESERVE, PAGE_NOACCESS );
+		if (!range)
+		{
+			lastSystemError = getLastError();
+			break;
+		}
+		VirtualFree( range, 0, MEM_RELEASE );
+
+		uint8_t * first = static_cast< uint8_t * >( MapViewOfFileEx( mapping, FILE_MAP_ALL_ACCESS, 0, 0, capacity, range ) );
+		if (!first)
+		{
+			lastSystemError = getLastError();
+			continue;
+		}
+		if (!MapViewOfFileEx( mapping, FILE_MAP_ALL_ACCESS, 0, 0, capacity, first + capacity ))
+		{
+			lastSystemError = getLastError();
+			UnmapViewOfFile( first );
+			continue;
+		}
+		data = first;
+	}
+
+	CloseHandle( mapping );  // the views keep the memory alive
+	return data;
+}
+
+static void _unmapMirrored( uint8_t * data, size_t capacity ) noexcept
+{
+	UnmapViewOfFile( data + capacity );
+	UnmapViewOfFile( data );
+}
+
+#else
+
+/// creates anonymous memory that can be mapped more than once, returns its handle or -1
+static int _createMemory() noexcept
+{
+ #ifdef __linux__
+	return ::memfd_create( "CppUtils-MirroredRingBuffer", MFD_CLOEXEC );
+ #else
+	// elsewhere there is only the named shared memory, so create it under a unique name and remove the name right away
+	static std::atomic< unsigned > counter( 0 );
+	std::string name = "/CppUtils-ring-" + std::to_string( ::getpid() ) + "-" + std::to_string( counter++ );
+	int memoryHandle = ::shm_open( name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600 );
+	if (memoryHandle >= 0)
+		::shm_unlink( name.c_str() );
+	return memoryHandle;
+ #endif // __linux__
+}
+
+static uint8_t * _mapMirrored( size_t capacity, system_error_t & lastSystemError ) noexcept
+{
+	int memoryHandle = _createMemory();
+	if (memoryHandle < 0)
+	{
+		lastSystemError = getLastError();
+		return nullptr;
+	}
+	if (::ftruncate( memoryHandle, off_t( capacity ) ) != 0)
+	{
+		lastSystemError = getLastError();
+		::close( memoryHandle );
+		return nullptr;
+	}
+
+	// reserve a range for both mappings first, so that nothing else can get between them, then replace its halves
+	void * range = ::mmap( nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if (range == MAP_FAILED)
+	{
+		lastSystemError = getLastError();
+		::close( memoryHandle );
+		return nullptr;
+	}
+	uint8_t * data = static_cast< uint8_t * >( range );
+	bool mapped = ::mmap( data, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memoryHandle, 0 ) != MAP_FAILED
+	           && ::mmap( data + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memoryHandle, 0 ) != MAP_FAILED;
+	lastSystemError = getLastError();
+	::close( memoryHandle );  // the mappings keep the memory alive
+	if (!mapped)
+	{
+		::munmap( data, 2 * capacity );
+		return nullptr;
+	}
+	return data;
+}
+
+static void _unmapMirrored( uint8_t * data, size_t capacity ) noexcept
+{
+	::munmap( data, 2 * capacity );
+}
+
+#endif // _WIN32
+
+
+//======================================================================================================================
+//  MirroredRingBuffer
+
+MirroredRingBuffer::MirroredRingBuffer() noexcept
+:
+	_data( nullptr ),
+	_capacity( 0 ),
+	_readPos( 0 ),
+	_size( 0 ),
+	_lastSystemError( 0 )
+{}
+
+MirroredRingBuffer::~MirroredRingBuffer() noexcept
+{
+	release();
+}
+
+MirroredRingBuffer::MirroredRingBuffer( MirroredRingBuffer && other ) noexcept
+:
+	MirroredRingBuffer()
+{
+	*this = move( other );
+}
+
+MirroredRingBuffer & MirroredRingBuffer::operator=( MirroredRingBuffer && other ) noexcept
+{
+	release();
+
+	_data = other._data;
+	_capacity = other._capacity;
+	_readPos = other._readPos;
+	_size = other._size;
+	_lastSystemError = other._lastSystemError;
+	other._data = nullptr;
+	other._capacity = 0;
+	other._readPos = 0;
+	other._size = 0;
+
+	return *this;
+}
+
+SocketError MirroredRingBuffer::allocate( size_t capacity ) noexcept
+{
+	release();
+
+	size_t granularity = _mappingGranularity();
+	size_t roundedCapacity = (capacity + granularity - 1) / granularity * granularity;
+	if (roundedCapacity == 0)
+		roundedCapacity = granularity;
+
+	uint8_t * data = _mapMirrored( roundedCapacity, _lastSystemError );
+	if (!data)
+	{
+		return SocketError::Other;
+	}
+
+	_data = data;
+	_capacity = roundedCapacity;
+	return SocketError::Success;
+}
+
+void MirroredRingBuffer::release() noexcept
+{
+	if (_data)
+	{
+		_unmapMirrored( _data, _capacity );
+	}
+	_data = nullptr;
+	_capacity = 0;
+	_readPos = 0;
+	_size = 0;
+}
+
+void MirroredRingBuffer::commitWrite( size_t count ) noexcept
+{
+	if (count > _capacity - _size)
+	{
+		critical_error( "Committed %zu bytes to a ring buffer that has only %zu free.", count, _capacity - _size );
+	}
+	_size += count;
+}
+
+void MirroredRingBuffer::consume( size_t count ) noexcept
+{
+	if (count > _size)
+	{
+		critical_error( "Consumed %zu bytes from a ring buffer that has only %zu.", count, _size );
+	}
+	_size -= count;
+	_readPos += count;
+	if (_readPos >= _capacity)
+	{
+		_readPos -= _capacity;
+	}
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
@@ -0,0 +1,103 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: ring buffer mapped twice back to back in the virtual memory, so that no part of it is ever split
+//======================================================================================================================
+
+#ifndef CPPUTILS_MIRROREDRINGBUFFER_INCLUDED
+#define CPPUTILS_MIRROREDRINGBUFFER_INCLUDED
+
+
+#include "Socket.hpp"  // SocketError
+#include "SystemErrorInfo.hpp"
+
+#include <CppUtils-Essential/Span.hpp>
+
+
+namespace own {
+
+
+//======================================================================================================================
+/// Ring buffer for received streams whose readable data and free space are always contiguous, even across the end.
+/** The same physical memory is mapped twice, one mapping right after the other, so the bytes past the end of the first
+  * mapping are the bytes at the beginning of the buffer. A message that wraps around the end can therefore be parsed
+  * and returned as a single span, and the free space can be filled by a single receive, without ever moving the data
+  * or copying a message together, unlike with a plain ring or with a linear buffer that has to be compacted.
+  *
+  * The capacity is rounded up to the granularity of the virtual memory mappings (a page on POSIX systems, 64 kB
+  * on Windows). Fill it with TcpSocket::receiveInto(), or write into writable() and call commitWrite(). */
+
+class MirroredRingBuffer
+{
+
+ public:
+
+	/// Creates an empty object, call allocate() before using it.
+	MirroredRingBuffer() noexcept;
+	~MirroredRingBuffer() noexcept;
+
+	MirroredRingBuffer( const MirroredRingBuffer & other ) = delete;
+	MirroredRingBuffer( MirroredRingBuffer && other ) noexcept;
+	MirroredRingBuffer & operator=( const MirroredRingBuffer & other ) = delete;
+	MirroredRingBuffer & operator=( MirroredRingBuffer && other ) noexcept;
+
+	/// Maps the memory, the previous one if any is released with all its data.
+	/** Fails with SocketError::Other when the system refuses to create or map the memory,
+	  * call getLastSystemError() for more info. */
+	SocketError allocate( size_t capacity ) noexcept;
+
+	/// Unmaps the memory.
+	void release() noexcept;
+
+	bool isAllocated() const noexcept  { return _data != nullptr; }
+
+	size_t capacity() const noexcept  { return _capacity; }
+
+	/// How many bytes are ready to be read.
+	size_t size() const noexcept  { return _size; }
+
+	bool empty() const noexcept  { return _size == 0; }
+
+	bool full() const noexcept  { return _size == _capacity; }
+
+	/// All the data ready to be read, as one contiguous span, valid until the next consume() or release().
+	const_byte_span readable() const noexcept  { return const_byte_span( _data + _readPos, _size ); }
+
+	/// All the free space, as one contiguous span, valid until the next commitWrite() or release().
+	byte_span writable() noexcept
+	{
+		size_t writePos = _readPos + _size;
+		return byte_span( _data + (writePos < _capacity ? writePos : writePos - _capacity), _capacity - _size );
+	}
+
+	/// Makes the first count bytes written into writable() ready to be read.
+	void commitWrite( size_t count ) noexcept;
+
+	/// Drops the first count bytes of readable().
+	void consume( size_t count ) noexcept;
+
+	/// Drops all the data.
+	void clear() noexcept  { _readPos = _size = 0; }
+
+	/// Returns the system error code that was recorded the last time allocate() failed.
+	system_error_t getLastSystemError() const noexcept  { return _lastSystemError; }
+
+ private:
+
+	uint8_t * _data;     ///< start of the first of the two mappings, nullptr when not allocated
+	size_t _capacity;    ///< size of one mapping
+	size_t _readPos;     ///< offset of the first readable byte in the first mapping
+	size_t _size;
+	system_error_t _lastSystemError;
+
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_MIRROREDRINGBUFFER_INCLUDED
@@ -12,8 +12,11 @@
 #include <CppUtils-Essential/CriticalError.hpp>
 using own::span;
 
-#include <cstring>  // memset
+#include <cstring>  // memset, memcpy, memchr
+#include <cstddef>  // offsetof
 #include <string>
+#include <string_view>
+#include <optional>
 #include <ostream>
 #include <istream>
 
@@ -36,47 +39,443 @@ using namespace priv;
 
 namespace priv {
 
-void genericCopy( const uint8_t * src, uint8_t * dst, size_t size ) noexcept
+//----------------------------------------------------------------------------------------------------------------------
+//  stream-free formatting
+
+// The writers below may write up to 3 characters of garbage past the returned length,
+// so they are always given a local buffer with FORMAT_SLACK extra characters and the result is then copied out.
+static constexpr size_t FORMAT_SLACK = 4;
+
+/// decimal representations of a byte: 3 digit characters followed by the number of valid digits
+struct DecByteTable
+{
+	char entries [256][4];
+
+	constexpr DecByteTable() : entries()
+	{
+		for (int i = 0; i < 256; ++i)
+		{
+			char * e = entries[i];
+			if (i >= 100)
+			{
+				e[0] = char( '0' + i / 100 );  e[1] = char( '0' + i / 10 % 10 );  e[2] = char( '0' + i % 10 );  e[3] = 3;
+			}
+			else if (i >= 10)
+			{
+				e[0] = char( '0' + i / 10 );  e[1] = char( '0' + i % 10 );  e[3] = 2;
+			}
+			else
+			{
+				e[0] = char( '0' + i );  e[3] = 1;
+			}
+		}
+	}
+};
+static constexpr DecByteTable decByteTable;
+
+/// lower-case hexadecimal representations of a byte
+struct HexByteTable
+{
+	char entries [256][2];
+
+	constexpr HexByteTable() : entries()
+	{
+		const char digits [] = "0123456789abcdef";
+		for (int i = 0; i < 256; ++i)
+		{
+			entries[i][0] = digits[ i >> 4 ];
+			entries[i][1] = digits[ i & 0xF ];
+		}
+	}
+};
+static constexpr HexByteTable hexByteTable;
+
+static inline char * writeDecByte( char * out, uint8_t value ) noexcept
+{
+	const char * entry = decByteTable.entries[ value ];
+	memcpy( out, entry, 4 );  // copying all 4 bytes at once is cheaper than copying the exact length
+	return out + entry[3];
+}
+
+static inline char * writeIPv4( char * out, const uint8_t * bytes ) noexcept
+{
+	out = writeDecByte( out, bytes[0] );  *out++ = '.';
+	out = writeDecByte( out, bytes[1] );  *out++ = '.';
+	out = writeDecByte( out, bytes[2] );  *out++ = '.';
+	return writeDecByte( out, bytes[3] );
+}
+
+/// writes a 16-bit group without leading zeros
+static inline char * writeHexGroup( char * out, uint32_t group ) noexcept
+{
+	char digits [8];
+	memcpy( digits, hexByteTable.entries[ group >> 8 ], 2 );
+	memcpy( digits + 2, hexByteTable.entries[ group & 0xFF ], 2 );
+	size_t length = 1 + (group > 0xF) + (group > 0xFF) + (group > 0xFFF);
+	memcpy( out, digits + 4 - length, 4 );
+	return out + length;
+}
+
+static inline char * writeIPv6( char * out, const uint8_t * bytes ) noexcept
+{
+	uint32_t groups [8];
+	for (size_t i = 0; i < 8; ++i)
+		groups[i] = uint32_t( bytes[ 2*i ] ) << 8 | bytes[ 2*i + 1 ];
+
+	// RFC 5952 section 5: IPv4-mapped addresses are written in the mixed notation
+	if ((groups[0] | groups[1] | groups[2] | groups[3] | groups[4]) == 0 && groups[5] == 0xFFFF)
+	{
+		memcpy( out, "::ffff:", 7 );
+		return writeIPv4( out + 7, bytes + 12 );
+	}
+
+	// RFC 5952 section 4.2: the longest run of 2 or more zero groups is shortened to "::", the first one on a tie
+	size_t bestStart = 8, bestLength = 1;
+	size_t runStart = 0, runLength = 0;
+	for (size_t i = 0; i < 8; ++i)
+	{
+		if (groups[i] == 0)
+		{
+			if (runLength++ == 0)
+				runStart = i;
+			if (runLength > bestLength)
+			{
+				bestStart = runStart;
+				bestLength = runLength;
+			}
+		}
+		else
+		{
+			runLength = 0;
+		}
+	}
+
+	bool needsColon = false;
+	for (size_t i = 0; i < 8; )
+	{
+		if (i == bestStart)
+		{
+			*out++ = ':';  *out++ = ':';
+			i += bestLength;
+			needsColon = false;
+			continue;
+		}
+		if (needsColon)
+			*out++ = ':';
+		out = writeHexGroup( out, groups[i] );
+		needsColon = true;
+		++i;
+	}
+	return out;
+}
+
+static inline char * writeMAC( char * out, const uint8_t * bytes ) noexcept
 {
-	memcpy( dst, src, size );
+	for (size_t i = 0; i < 6; ++i)
+	{
+		memcpy( out, hexByteTable.entries[ bytes[i] ], 2 );
+		out[2] = ':';
+		out += 3;
+	}
+	return out - 1;  // without the last ':'
 }
 
-int genericCompare( const uint8_t * a1, const uint8_t * a2, size_t size ) noexcept
+static inline char * writePort( char * out, uint16_t port ) noexcept
 {
-	return std::lexicographical_compare( a1, a1 + size, a2, a2 + size );
+	char digits [5];
+	char * begin = digits + sizeof(digits);
+	uint32_t value = port;
+	do
+	{
+		*--begin = char( '0' + value % 10 );
+		value /= 10;
+	}
+	while (value != 0);
+	size_t length = size_t( digits + sizeof(digits) - begin );
+	memcpy( out, begin, length );
+	return out + length;
+}
+
+static inline size_t copyOut( const char * formatted, const char * formattedEnd, char * buffer, size_t size ) noexcept
+{
+	size_t length = size_t( formattedEnd - formatted );
+	if (length > size)
+		return 0;
+	memcpy( buffer, formatted, length );
+	return length;
 }
 
 static std::ostream & ipv4ToStream( std::ostream & os, const uint8_t * bytes )
 {
-	char str [16];
-	struct in_addr addr;
-	priv::ownAddrToSysAddrV4( bytes, &addr );
-	if (!inet_ntop( AF_INET, &addr, str, sizeof(str) ))
-		critical_error( "Failed to convert IPv4 address to string." );
-	os << str;
-	return os;
+	char str [IPv4Addr::MAX_STR_LEN + FORMAT_SLACK];
+	const char * end = writeIPv4( str, bytes );
+	return os << std::string_view( str, size_t( end - str ) );
 }
 
 static std::ostream & ipv6ToStream( std::ostream & os, const uint8_t * bytes )
 {
-	char str [40];
-	struct in6_addr addr;
-	priv::ownAddrToSysAddrV6( bytes, &addr );
-	if (!inet_ntop( AF_INET6, &addr, str, sizeof(str) ))
-		critical_error( "Failed to convert IPv6 address to string." );
-	os << str;
-	return os;
+	char str [IPv6Addr::MAX_STR_LEN + FORMAT_SLACK];
+	const char * end = writeIPv6( str, bytes );
+	return os << std::string_view( str, size_t( end - str ) );
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+//  allocation-free parsing
+
+// SWAR (SIMD within a register) helpers, each classifies 8 characters at once
+namespace swar {
+
+static inline uint64_t load8( const char * chars ) noexcept
+{
+	uint64_t word;
+	memcpy( &word, chars, sizeof(word) );
+ #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap64( word );  // we want the first character in the lowest byte
+ #endif
+	return word;
+}
+
+static inline uint32_t load4( const char * chars ) noexcept
+{
+	uint32_t word;
+	memcpy( &word, chars, sizeof(word) );
+ #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap32( word );
+ #endif
+	return word;
+}
+
+static inline void store8( char * chars, uint64_t word ) noexcept
+{
+ #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap64( word );
+ #endif
+	memcpy( chars, &word, sizeof(word) );
+}
+
+static constexpr uint64_t ones = 0x0101010101010101ull;
+static constexpr uint64_t highBits = 0x8080808080808080ull;
+
+/// sets the high bit of every byte that is a decimal digit
+static inline uint64_t digitBytes( uint64_t word ) noexcept
+{
+	uint64_t offsets = word ^ (ones * '0');                   // digits become 0..9
+	uint64_t atLeast10 = (offsets | highBits) - ones * 10;    // high bit stays set where (byte & 0x7F) >= 10
+	return ~(atLeast10 | offsets) & highBits;                 // neither >= 10 nor >= 0x80
+}
+
+/// sets the high bit of every byte that is equal to c
+static inline uint64_t equalBytes( uint64_t word, char c ) noexcept
+{
+	uint64_t zeroed = word ^ (ones * uint8_t( c ));
+	return ~(((zeroed & ~highBits) + ~highBits) | zeroed) & highBits;
+}
+
+/// gathers the high bits of all bytes into the lowest 8 bits (equivalent of SSE2 movemask)
+static inline uint32_t gatherHighBits( uint64_t bytes ) noexcept
+{
+	return uint32_t( ((bytes >> 7) * 0x0102040810204080ull) >> 56 );
+}
+
+} // namespace swar
+
+static inline uint32_t countTrailingZeros( uint32_t bits ) noexcept  // bits must not be 0
+{
+ #if defined(__GNUC__) || defined(__clang__)
+	return uint32_t( __builtin_ctz( bits ) );
+ #else
+	uint32_t count = 0;
+	for (; !(bits & 1); bits >>= 1)
+		++count;
+	return count;
+ #endif
+}
+
+static bool parseIPv4( std::string_view str, uint8_t * bytes ) noexcept
+{
+	if (str.size() < 7 || str.size() > 15)  // "0.0.0.0" .. "255.255.255.255"
+		return false;
+
+	// Load the string into two words using overlapping loads, that way we never read past the input
+	// and avoid the store-forwarding stall of copying a variable-sized string into a padded buffer first.
+	const char * chars = str.data();
+	size_t size = str.size();
+	uint64_t lo, hi;
+	if (size >= 9)
+	{
+		lo = swar::load8( chars );
+		hi = swar::load8( chars + size - 8 ) >> (8 * (16 - size));
+	}
+	else if (size == 8)
+	{
+		lo = swar::load8( chars );
+		hi = 0;
+	}
+	else  // 7
+	{
+		lo = uint64_t( swar::load4( chars ) ) | uint64_t( swar::load4( chars + 3 ) ) << 24;
+		hi = 0;
+	}
+
+	uint32_t digits = swar::gatherHighBits( swar::digitBytes( lo ) ) | swar::gatherHighBits( swar::digitBytes( hi ) ) << 8;
+	uint32_t dots = swar::gatherHighBits( swar::equalBytes( lo, '.' ) ) | swar::gatherHighBits( swar::equalBytes( hi, '.' ) ) << 8;
+	uint32_t thirdDotAndAbove = dots & (dots - 1);
+	thirdDotAndAbove &= thirdDotAndAbove - 1;
+	bool exactly3Dots = thirdDotAndAbove != 0 && (thirdDotAndAbove & (thirdDotAndAbove - 1)) == 0;
+	if ((digits | dots) != (1u << size) - 1 || !exactly3Dots)
+		return false;
+
+	// the digits are then read from a zero-padded copy, whole words are stored so that the reads are forwarded
+	// from the stores, the padding allows to read 3 digits from any field start, even the last one
+	char block [24];
+	swar::store8( block, lo );
+	swar::store8( block + 8, hi );
+	swar::store8( block + 16, 0 );
+
+	// digit weights by field length, so that the conversion doesn't have to branch on the number of digits
+	static constexpr uint32_t weights [4][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 10, 1, 0 }, { 100, 10, 1 } };
+
+	// there are exactly 3 dots and the end of string acts as the 4th field terminator
+	uint32_t terminators = dots | (1u << str.size());
+	uint32_t fieldStart = 0;
+	bool invalid = false;
+	for (size_t i = 0; i < 4; ++i)
+	{
+		uint32_t fieldEnd = countTrailingZeros( terminators );
+		terminators &= terminators - 1;
+		uint32_t length = fieldEnd - fieldStart;
+
+		invalid |= length - 1 > 2;  // empty or too long
+		const uint32_t * w = weights[ length & 3 ];
+		const char * field = block + fieldStart;
+		// non-digit characters after the field are multiplied by 0, the unsigned overflow doesn't matter then
+		uint32_t value = uint32_t( field[0] - '0' ) * w[0] + uint32_t( field[1] - '0' ) * w[1] + uint32_t( field[2] - '0' ) * w[2];
+		invalid |= value > 255;
+		invalid |= field[0] == '0' && length > 1;  // inet_pton also rejects leading zeros
+
+		bytes[i] = uint8_t( value );
+		fieldStart = fieldEnd + 1;
+	}
+
+	return !invalid;
+}
+
+struct HexTable
+{
+	int8_t values [256];
+
+	constexpr HexTable() : values()
+	{
+		for (int c = 0; c < 256; ++c)
+			values[c] = -1;
+		for (int c = '0'; c <= '9'; ++c)
+			values[c] = int8_t( c - '0' );
+		for (int c = 'a'; c <= 'f'; ++c)
+			values[c] = int8_t( c - 'a' + 10 );
+		for (int c = 'A'; c <= 'F'; ++c)
+			values[c] = int8_t( c - 'A' + 10 );
+	}
+};
+static constexpr HexTable hexTable;
+
+static bool parseIPv6( std::string_view str, uint8_t * bytes ) noexcept
+{
+	if (str.size() < 2 || str.size() > 45)  // "::" .. "ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255"
+		return false;
+
+	uint8_t result [16] = {};
+	size_t written = 0;
+	int gapPos = -1;  // where the "::" was found
+
+	const char * pos = str.data();
+	const char * end = str.data() + str.size();
+	if (*pos == ':' && *++pos != ':')  // leading ':' is only allowed as a part of "::"
+		return false;
+
+	const char * groupStart = pos;
+	uint32_t group = 0;
+	uint32_t groupDigits = 0;
+	while (pos < end)
+	{
+		char c = *pos++;
+		int8_t hexValue = hexTable.values[ uint8_t( c ) ];
+		if (hexValue >= 0)
+		{
+			if (++groupDigits > 4)
+				return false;
+			group = (group << 4) | uint32_t( hexValue );
+		}
+		else if (c == ':')
+		{
+			groupStart = pos;
+			if (groupDigits == 0)  // "::"
+			{
+				if (gapPos >= 0)
+					return false;
+				gapPos = int( written );
+				continue;
+			}
+			if (pos == end || written + 2 > sizeof(result))  // trailing single ':' or too many groups
+				return false;
+			result[ written++ ] = uint8_t( group >> 8 );
+			result[ written++ ] = uint8_t( group );
+			group = 0;
+			groupDigits = 0;
+		}
+		else if (c == '.' && written + 4 <= sizeof(result))
+		{
+			// embedded IPv4 suffix (e.g. "::ffff:10.0.0.1"), must be the last thing in the string
+			if (!parseIPv4( std::string_view( groupStart, size_t( end - groupStart ) ), result + written ))
+				return false;
+			written += 4;
+			groupDigits = 0;
+			break;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	if (groupDigits > 0)
+	{
+		if (written + 2 > sizeof(result))
+			return false;
+		result[ written++ ] = uint8_t( group >> 8 );
+		result[ written++ ] = uint8_t( group );
+	}
+
+	if (gapPos >= 0)
+	{
+		if (written == sizeof(result))  // "::" must stand for at least one group
+			return false;
+		// move the groups after "::" to the end and fill the gap with zeros
+		size_t tailSize = written - size_t( gapPos );
+		memmove( result + sizeof(result) - tailSize, result + gapPos, tailSize );
+		memset( result + gapPos, 0, sizeof(result) - tailSize - size_t( gapPos ) );
+		written = sizeof(result);
+	}
+	if (written != sizeof(result))
+		return false;
+
+	fastCopy16( result, bytes );
+	return true;
+}
+
+static inline bool looksLikeIPv6( std::string_view str ) noexcept
+{
+	return memchr( str.data(), ':', str.size() ) != nullptr;
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+//  stream parsing
+
 static std::istream & ipv4FromStream( std::istream & is, uint8_t * bytes ) noexcept
 {
 	std::string ipStr;
 	if (!(is >> ipStr))
 		return is;
-	struct in_addr addr;
-	if (inet_pton( AF_INET, ipStr.c_str(), &addr ) != 1)
+	if (!parseIPv4( ipStr, bytes ))
 		is.setstate( std::ios::failbit );
-	priv::sysAddrToOwnAddrV4( &addr, bytes );
 	return is;
 }
 
@@ -85,10 +484,8 @@ static std::istream & ipv6FromStream( std::istream & is, uint8_t * bytes ) noexc
 	std::string ipStr;
 	if (!(is >> ipStr))
 		return is;
-	struct in6_addr addr;
-	if (inet_pton( AF_INET, ipStr.c_str(), &bytes ) != 1)
+	if (!parseIPv6( ipStr, bytes ))
 		is.setstate( std::ios::failbit );
-	priv::sysAddrToOwnAddrV6( &addr, bytes );
 	return is;
 }
 
@@ -97,23 +494,11 @@ static IPVer ipAnyFromStream( std::istream & is, uint8_t * bytes ) noexcept
 	std::string ipStr;
 	if (!(is >> ipStr))
 		return static_cast<IPVer>(0);
-	struct in_addr addr4;
-	struct in6_addr addr6;
-	if (inet_pton( AF_INET, ipStr.c_str(), &addr4 ) == 1)
-	{
-		priv::sysAddrToOwnAddrV4( &addr4, bytes );
-		return IPVer::_4;
-	}
-	else if (inet_pton( AF_INET6, ipStr.c_str(), &addr6 ) == 1)
-	{
-		priv::sysAddrToOwnAddrV6( &addr6, bytes );
-		return IPVer::_6;
-	}
-	else
-	{
-		is.setstate( std::ios::failbit );
-		return static_cast<IPVer>(0);
-	}
+	bool isV6 = looksLikeIPv6( ipStr );
+	if (isV6 ? parseIPv6( ipStr, bytes ) : parseIPv4( ipStr, bytes ))
+		return isV6 ? IPVer::_6 : IPVer::_4;
+	is.setstate( std::ios::failbit );
+	return static_cast<IPVer>(0);
 }
 
 } // namespace priv
@@ -132,6 +517,26 @@ std::istream & operator>>( std::istream & is, IPv4Addr & addr ) noexcept
 	return priv::ipv4FromStream( is, addr.data().data() );
 }
 
+std::optional< IPv4Addr > IPv4Addr::parse( std::string_view str ) noexcept
+{
+	uint8_t bytes [4];
+	if (!priv::parseIPv4( str, bytes ))
+		return std::nullopt;
+	return IPv4Addr( make_fixed_const_span( bytes ) );
+}
+
+size_t IPv4Addr::toChars( char * buffer, size_t size ) const noexcept
+{
+	char str [MAX_STR_LEN + FORMAT_SLACK];
+	return copyOut( str, writeIPv4( str, _data ), buffer, size );
+}
+
+std::string IPv4Addr::toString() const
+{
+	char str [MAX_STR_LEN + FORMAT_SLACK];
+	return std::string( str, writeIPv4( str, _data ) );
+}
+
 
 //======================================================================================================================
 //  IPv6Addr
@@ -146,89 +551,159 @@ std::istream & operator>>( std::istream & is, IPv6Addr & addr ) noexcept
 	return priv::ipv6FromStream( is, addr.data().data() );
 }
 
+std::optional< IPv6Addr > IPv6Addr::parse( std::string_view str ) noexcept
+{
+	uint8_t bytes [16];
+	if (!priv::parseIPv6( str, bytes ))
+		return std::nullopt;
+	return IPv6Addr( make_fixed_const_span( bytes ) );
+}
+
+size_t IPv6Addr::toChars( char * buffer, size_t size ) const noexcept
+{
+	char str [MAX_STR_LEN + FORMAT_SLACK];
+	return copyOut( str, writeIPv6( str, _data ), buffer, size );
+}
+
+std::string IPv6Addr::toString() const
+{
+	char str [MAX_STR_LEN + FORMAT_SLACK];
+	return std::string( str, writeIPv6( str, _data ) );
+}
+
 
 //======================================================================================================================
 //  IPAddr
 
-IPAddr::IPAddr( std::initializer_list< uint8_t > initList )
+std::ostream & operator<<( std::ostream & os, const IPAddr & addr )
 {
-	if (initList.size() == 4)
-	{
-		priv::fastCopy4( initList.begin(), _data );
-		_version = IPVer::_4;
-	}
-	else if (initList.size() == 16)
-	{
-		priv::fastCopy16( initList.begin(), _data );
-		_version = IPVer::_6;
-	}
+	if (addr.version() == IPVer::_4)
+		return priv::ipv4ToStream( os, addr.data().data() );
+	else if (addr.version() == IPVer::_6)
+		return priv::ipv6ToStream( os, addr.data().data() );
 	else
-	{
-		critical_error(
-			"IP address can only be constructed from a buffer of size 4 or 16, current size: %zu", initList.size()
-		);
-	}
+		critical_error( "Attempted to print uninitialized IPAddr." );
 }
 
-IPAddr::IPAddr( const_byte_span data )
+std::istream & operator>>( std::istream & is, IPAddr & addr ) noexcept
 {
-	if (data.size() == 4)
-	{
-		priv::fastCopy4( data.data(), _data );
-		_version = IPVer::_4;
-	}
-	else if (data.size() == 16)
+	// parse into a fresh address, so that an IPv4 one doesn't keep the rest of the previous IPv6 one
+	IPAddr parsed;
+	parsed._version = priv::ipAnyFromStream( is, parsed._data );
+	addr = parsed;
+	return is;
+}
+
+std::optional< IPAddr > IPAddr::parse( std::string_view str ) noexcept
+{
+	IPAddr addr;
+	if (priv::looksLikeIPv6( str ))
 	{
-		priv::fastCopy16( data.data(), _data );
-		_version = IPVer::_6;
+		if (!priv::parseIPv6( str, addr._data ))
+			return std::nullopt;
+		addr._version = IPVer::_6;
 	}
 	else
 	{
-		critical_error(
-			"IP address can only be constructed from a buffer of size 4 or 16, current size: %zu", data.size()
-		);
+		if (!priv::parseIPv4( str, addr._data ))
+			return std::nullopt;
+		addr._version = IPVer::_4;
 	}
+	return addr;
 }
 
-std::ostream & operator<<( std::ostream & os, const IPAddr & addr )
+size_t IPAddr::toChars( char * buffer, size_t size ) const noexcept
 {
-	if (addr.version() == IPVer::_4)
-		return priv::ipv4ToStream( os, addr.data().data() );
-	else if (addr.version() == IPVer::_6)
-		return priv::ipv6ToStream( os, addr.data().data() );
+	char str [MAX_STR_LEN + FORMAT_SLACK];
+	if (_version == IPVer::_4)
+		return copyOut( str, writeIPv4( str, _data ), buffer, size );
+	else if (_version == IPVer::_6)
+		return copyOut( str, writeIPv6( str, _data ), buffer, size );
 	else
-		critical_error( "Attempted to print uninitialized IPAddr." );
+		return 0;
 }
 
-std::istream & operator>>( std::istream & is, IPAddr & addr ) noexcept
+std::string IPAddr::toString() const
 {
-	addr._version = priv::ipAnyFromStream( is, addr.data().data() );
-	return is;
+	char str [MAX_STR_LEN];
+	return std::string( str, toChars( str, sizeof(str) ) );
 }
 
 
 //======================================================================================================================
+//  MACAddr
+
+size_t MACAddr::toChars( char * buffer, size_t size ) const noexcept
+{
+	char str [MAX_STR_LEN + FORMAT_SLACK];
+	return copyOut( str, writeMAC( str, _data ), buffer, size );
+}
+
+std::string MACAddr::toString() const
+{
+	char str [MAX_STR_LEN + FORMAT_SLACK];
+	return std::string( str, writeMAC( str, _data ) );
+}
 
-std::ostream & operator<<( std::ostream & /*os*/, const MACAddr & /*addr*/ )
+std::ostream & operator<<( std::ostream & os, const MACAddr & addr )
 {
-	TODO
+	char str [MACAddr::MAX_STR_LEN + FORMAT_SLACK];
+	const char * end = writeMAC( str, addr.data().data() );
+	return os << std::string_view( str, size_t( end - str ) );
 }
 
-std::istream & operator>>( std::istream & /*os*/, MACAddr & /*addr*/ ) noexcept
+std::istream & operator>>( std::istream & is, MACAddr & addr ) noexcept
 {
-	TODO
+	std::string macStr;
+	if (!(is >> macStr))
+		return is;
+	std::optional< MACAddr > parsed = MACAddr::parse( macStr );
+	if (parsed)
+		addr = *parsed;
+	else
+		is.setstate( std::ios::failbit );
+	return is;
 }
 
 
 //======================================================================================================================
-//  Endpoint utils
+//  Endpoint
+
+size_t Endpoint::toChars( char * buffer, size_t size ) const noexcept
+{
+	char str [MAX_STR_LEN + FORMAT_SLACK];
+	char * end = str;
+	if (addr.version() == IPVer::_4)
+	{
+		end = writeIPv4( end, addr.data().data() );
+	}
+	else if (addr.version() == IPVer::_6)
+	{
+		*end++ = '[';
+		end = writeIPv6( end, addr.data().data() );
+		*end++ = ']';
+	}
+	else
+	{
+		return 0;
+	}
+	*end++ = ':';
+	end = writePort( end, port );
+	return copyOut( str, end, buffer, size );
+}
+
+std::string Endpoint::toString() const
+{
+	char str [MAX_STR_LEN];
+	return std::string( str, toChars( str, sizeof(str) ) );
+}
 
 void endpointToSockaddr( const Endpoint & ep, struct sockaddr * saddr, int & addrlen )
 {
-	memset( saddr, 0, sizeof(*saddr) );
 	if (ep.addr.version() == IPVer::_4)
 	{
 		auto saddr4 = reinterpret_cast< struct sockaddr_in * >( saddr );
+		memset( saddr4, 0, sizeof(*saddr4) );
 		saddr4->sin_family = AF_INET;
 		priv::ownAddrToSysAddrV4( ep.addr.data().data(), &saddr4->sin_addr );
 		saddr4->sin_port = htons( ep.port );
@@ -237,6 +712,7 @@ void endpointToSockaddr( const Endpoint & ep, struct sockaddr * saddr, int & add
 	else if (ep.addr.version() == IPVer::_6)
 	{
 		auto saddr6 = reinterpret_cast< struct sockaddr_in6 * >( saddr );
+		memset( saddr6, 0, sizeof(*saddr6) );  // including the scope id and flow info
 		saddr6->sin6_family = AF_INET6;
 		priv::ownAddrToSysAddrV6( ep.addr.data().data(), &saddr6->sin6_addr );
 		saddr6->sin6_port = htons( ep.port );
@@ -250,21 +726,18 @@ void endpointToSockaddr( const Endpoint & ep, struct sockaddr * saddr, int & add
 
 bool sockaddrToEndpoint( const struct sockaddr * saddr, Endpoint & ep ) noexcept
 {
+	// system addresses are in the same byte order as ours, so the address is constructed directly from the system structure
 	if (saddr->sa_family == AF_INET)
 	{
 		auto saddr4 = reinterpret_cast< const struct sockaddr_in * >( saddr );
-		uint8_t bytes [4];
-		priv::sysAddrToOwnAddrV4( &saddr4->sin_addr, bytes );
-		ep.addr = IPAddr( make_fixed_span( bytes ) );  // TODO: is it possible to get rid of the second copy?
+		ep.addr = IPAddr( fixed_const_byte_span< 4 >( reinterpret_cast< const uint8_t * >( &saddr4->sin_addr ) ) );
 		ep.port = ntohs( saddr4->sin_port );
 		return true;
 	}
 	else if (saddr->sa_family == AF_INET6)
 	{
 		auto saddr6 = reinterpret_cast< const struct sockaddr_in6 * >( saddr );
-		uint8_t bytes [16];
-		priv::sysAddrToOwnAddrV6( &saddr6->sin6_addr, bytes );
-		ep.addr = IPAddr( make_fixed_span( bytes ) );
+		ep.addr = IPAddr( fixed_const_byte_span< 16 >( reinterpret_cast< const uint8_t * >( &saddr6->sin6_addr ) ) );
 		ep.port = ntohs( saddr6->sin6_port );
 		return true;
 	}
@@ -275,6 +748,103 @@ bool sockaddrToEndpoint( const struct sockaddr * saddr, Endpoint & ep ) noexcept
 }
 
 
+//======================================================================================================================
+//  NativeEndpoint
+
+static_assert( NativeEndpoint::CAPACITY >= int( sizeof(sockaddr_in6) ) && alignof(sockaddr_in6) <= 4, "NativeEndpoint storage is too small" );
+static_assert( sizeof(sockaddr_in) == 16 && sizeof(sockaddr_in6) == 28, "unexpected size of system address structures" );
+static_assert( offsetof( sockaddr_in, sin_port ) == 2 && offsetof( sockaddr_in6, sin6_port ) == 2, "unexpected position of the port" );
+static_assert( offsetof( sockaddr_in, sin_addr ) == 4 && offsetof( sockaddr_in6, sin6_addr ) == 8, "unexpected position of the address" );
+
+bool NativeEndpoint::assign( const struct sockaddr * saddr, int addrlen ) noexcept
+{
+	if (addrlen < 0 || addrlen > CAPACITY)
+	{
+		_addrlen = 0;
+		return false;
+	}
+	memcpy( _storage, saddr, size_t( addrlen ) );
+	return setSaddrLen( addrlen );
+}
+
+bool NativeEndpoint::setSaddrLen( int addrlen ) noexcept
+{
+	auto family = reinterpret_cast< const struct sockaddr * >( _storage )->sa_family;
+	if (family == AF_INET && addrlen >= V4_LEN)
+	{
+		_addrlen = V4_LEN;
+		return true;
+	}
+	else if (family == AF_INET6 && addrlen >= V6_LEN)
+	{
+		_addrlen = V6_LEN;
+		return true;
+	}
+	else
+	{
+		_addrlen = 0;
+		return false;
+	}
+}
+
+
+//======================================================================================================================
+//  IPPrefix
+
+std::optional< IPPrefix > IPPrefix::parse( std::string_view str ) noexcept
+{
+	size_t slashPos = str.rfind( '/' );
+	if (slashPos == std::string_view::npos)
+		return std::nullopt;
+
+	std::optional< IPAddr > addr = IPAddr::parse( str.substr( 0, slashPos ) );
+	if (!addr)
+		return std::nullopt;
+
+	std::string_view lengthStr = str.substr( slashPos + 1 );
+	if (lengthStr.empty() || lengthStr.size() > 3)
+		return std::nullopt;
+	uint length = 0;
+	for (char c : lengthStr)
+	{
+		if (c < '0' || c > '9')
+			return std::nullopt;
+		length = length * 10 + uint( c - '0' );
+	}
+	if (length > maxLength( addr->version() ))
+		return std::nullopt;
+
+	return IPPrefix( *addr, uint8_t( length ) );
+}
+
+size_t IPPrefix::toChars( char * buffer, size_t size ) const noexcept
+{
+	char str [MAX_STR_LEN + FORMAT_SLACK];
+	char * end = str;
+	if (_addr.version() == IPVer::_4)
+		end = writeIPv4( end, _addr.data().data() );
+	else if (_addr.version() == IPVer::_6)
+		end = writeIPv6( end, _addr.data().data() );
+	else
+		return 0;
+	*end++ = '/';
+	end = writePort( end, _length );
+	return copyOut( str, end, buffer, size );
+}
+
+std::string IPPrefix::toString() const
+{
+	char str [MAX_STR_LEN];
+	return std::string( str, toChars( str, sizeof(str) ) );
+}
+
+std::ostream & operator<<( std::ostream & os, const IPPrefix & prefix )
+{
+	char str [IPPrefix::MAX_STR_LEN];
+	return os << std::string_view( str, prefix.toChars( str, sizeof(str) ) );
+}
+
+
 //======================================================================================================================
 
 
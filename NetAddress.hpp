@@ -15,7 +15,40 @@
 #include <CppUtils-Essential/CriticalError.hpp>
 
 #include <iosfwd>
+#include <string>
 #include <initializer_list>
+#include <string_view>
+#include <optional>
+#include <functional>   // hash
+#include <type_traits>  // is_constant_evaluated
+#include <cstring>      // memcpy, memcmp
+
+// user-defined literals are validated at compile time when the compiler supports it, otherwise only when used in
+// a constexpr context (e.g. when initializing a constexpr table of addresses)
+#if defined(__cpp_consteval)
+	#define CPPUTILS_NETADDR_LITERAL consteval
+#else
+	#define CPPUTILS_NETADDR_LITERAL constexpr
+#endif
+
+// the comparisons use word operations at runtime and plain loops at compile time, if the compiler can tell the difference
+#if defined(__cpp_lib_is_constant_evaluated)
+	#define CPPUTILS_NETADDR_IS_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif defined(__has_builtin)
+	#if __has_builtin(__builtin_is_constant_evaluated)
+		#define CPPUTILS_NETADDR_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+	#endif
+#elif (defined(__GNUC__) && __GNUC__ >= 9) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+	#define CPPUTILS_NETADDR_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#ifndef CPPUTILS_NETADDR_IS_CONSTANT_EVALUATED
+	#define CPPUTILS_NETADDR_IS_CONSTANT_EVALUATED() true  // always take the constexpr path, slower but correct
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+	#include <cstdlib>  // _byteswap_*
+	#include <intrin.h>  // __popcnt64, _BitScanForward64
+#endif
 
 // forward declaration of OS-dependent types
 struct in_addr;
@@ -34,7 +67,6 @@ namespace own {
 
 namespace priv {
 
-	void genericCopy( const uint8_t * src, uint8_t * dst, size_t size ) noexcept;
 	inline void fastCopy4( const uint8_t * src, uint8_t * dst ) noexcept
 	{
 		*reinterpret_cast< uint32_t * >( dst ) = *reinterpret_cast< const uint32_t * >( src );
@@ -45,26 +77,198 @@ namespace priv {
 		reinterpret_cast< uint64_t * >( dst )[1] = reinterpret_cast< const uint64_t * >( src )[1];
 	}
 
-	inline void copyFromDynamic( uint8_t * addr, size_t addrSize, const uint8_t * data, size_t dataSize )
+	// These loops can be evaluated at compile time, at runtime the compiler turns them into a few plain moves,
+	// because the size is always a small compile-time constant.
+	template< size_t Size >
+	constexpr void constCopy( const uint8_t * src, uint8_t * dst ) noexcept
 	{
-		if (dataSize != addrSize)
-			critical_error( "Attempted to construct address of size %zu from buffer of size %zu.", addrSize, dataSize );
-		genericCopy( data, addr, addrSize );
+		for (size_t i = 0; i < Size; ++i)
+			dst[i] = src[i];
 	}
-	inline void copy4FromDynamic( uint8_t * addr, const uint8_t * data, size_t dataSize )
+	template< size_t Size >
+	constexpr int constCompare( const uint8_t * a1, const uint8_t * a2 ) noexcept
 	{
-		if (dataSize != 4)
-			critical_error( "Attempted to construct address of size 4 from buffer of size %zu.", dataSize );
-		fastCopy4( data, addr );
+		for (size_t i = 0; i < Size; ++i)
+			if (a1[i] != a2[i])
+				return a1[i] < a2[i] ? -1 : 1;
+		return 0;
 	}
-	inline void copy16FromDynamic( uint8_t * addr, const uint8_t * data, size_t dataSize )
+
+	//-- word-wise runtime operations ---------------------------------------------------------------------------------
+
+	inline uint64_t loadNative64( const uint8_t * bytes ) noexcept
+	{
+		uint64_t word;
+		memcpy( &word, bytes, sizeof(word) );
+		return word;
+	}
+	inline uint32_t loadNative32( const uint8_t * bytes ) noexcept
 	{
-		if (dataSize != 16)
-			critical_error( "Attempted to construct address of size 16 from buffer of size %zu.", dataSize );
-		fastCopy16( data, addr );
+		uint32_t word;
+		memcpy( &word, bytes, sizeof(word) );
+		return word;
+	}
+	inline uint16_t loadNative16( const uint8_t * bytes ) noexcept
+	{
+		uint16_t word;
+		memcpy( &word, bytes, sizeof(word) );
+		return word;
 	}
 
-	int genericCompare( const uint8_t * a1, const uint8_t * a2, size_t size ) noexcept;
+	// big-endian loads make the numeric order of the words equal to the lexicographical order of the bytes
+	inline uint64_t loadBE64( const uint8_t * bytes ) noexcept
+	{
+		uint64_t word = loadNative64( bytes );
+	 #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		return word;
+	 #elif defined(_MSC_VER) && !defined(__clang__)
+		return _byteswap_uint64( word );
+	 #else
+		return __builtin_bswap64( word );
+	 #endif
+	}
+	inline uint32_t loadBE32( const uint8_t * bytes ) noexcept
+	{
+		uint32_t word = loadNative32( bytes );
+	 #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		return word;
+	 #elif defined(_MSC_VER) && !defined(__clang__)
+		return _byteswap_ulong( word );
+	 #else
+		return __builtin_bswap32( word );
+	 #endif
+	}
+	inline uint16_t loadBE16( const uint8_t * bytes ) noexcept
+	{
+		return uint16_t( bytes[0] << 8 | bytes[1] );
+	}
+
+	/// branchless three-way comparison of numbers
+	template< typename Int >
+	constexpr int threeWay( Int a, Int b ) noexcept
+	{
+		return int( a > b ) - int( a < b );
+	}
+
+	template< size_t Size >
+	inline bool wordEqual( const uint8_t * a1, const uint8_t * a2 ) noexcept
+	{
+		if constexpr (Size == 16)
+		{
+		 #if defined(__SIZEOF_INT128__)
+			__uint128_t w1, w2;
+			memcpy( &w1, a1, sizeof(w1) );
+			memcpy( &w2, a2, sizeof(w2) );
+			return w1 == w2;
+		 #else
+			return ((loadNative64( a1 ) ^ loadNative64( a2 )) | (loadNative64( a1 + 8 ) ^ loadNative64( a2 + 8 ))) == 0;
+		 #endif
+		}
+		else if constexpr (Size == 6)
+			return ((loadNative32( a1 ) ^ loadNative32( a2 )) | uint32_t( loadNative16( a1 + 4 ) ^ loadNative16( a2 + 4 ) )) == 0;
+		else if constexpr (Size == 4)
+			return loadNative32( a1 ) == loadNative32( a2 );
+		else
+			return memcmp( a1, a2, Size ) == 0;
+	}
+
+	template< size_t Size >
+	inline int wordCompare( const uint8_t * a1, const uint8_t * a2 ) noexcept
+	{
+		if constexpr (Size == 16)
+		{
+			int high = threeWay( loadBE64( a1 ), loadBE64( a2 ) );
+			int low = threeWay( loadBE64( a1 + 8 ), loadBE64( a2 + 8 ) );
+			return high != 0 ? high : low;  // compiles to a conditional move
+		}
+		else if constexpr (Size == 6)
+			return threeWay( uint64_t( loadBE32( a1 ) ) << 16 | loadBE16( a1 + 4 ), uint64_t( loadBE32( a2 ) ) << 16 | loadBE16( a2 + 4 ) );
+		else if constexpr (Size == 4)
+			return threeWay( loadBE32( a1 ), loadBE32( a2 ) );
+		else
+			return memcmp( a1, a2, Size );
+	}
+
+	template< size_t Size >
+	constexpr bool addrEqual( const uint8_t * a1, const uint8_t * a2 ) noexcept
+	{
+		if (CPPUTILS_NETADDR_IS_CONSTANT_EVALUATED())
+			return constCompare< Size >( a1, a2 ) == 0;
+		else
+			return wordEqual< Size >( a1, a2 );
+	}
+
+	template< size_t Size >
+	constexpr int addrCompare( const uint8_t * a1, const uint8_t * a2 ) noexcept
+	{
+		if (CPPUTILS_NETADDR_IS_CONSTANT_EVALUATED())
+			return constCompare< Size >( a1, a2 );
+		else
+			return wordCompare< Size >( a1, a2 );
+	}
+
+	//-- bit operations ------------------------------------------------------------------------------------------------
+
+	inline uint32_t popCount64( uint64_t word ) noexcept
+	{
+	 #if defined(_MSC_VER) && !defined(__clang__)
+		return uint32_t( __popcnt64( word ) );
+	 #elif defined(__POPCNT__) || !(defined(__x86_64__) || defined(__i386__))
+		return uint32_t( __builtin_popcountll( word ) );
+	 #else
+		// without the POPCNT instruction enabled the builtin is a library call, which is slower than this
+		word = word - ((word >> 1) & 0x5555555555555555);
+		word = (word & 0x3333333333333333) + ((word >> 2) & 0x3333333333333333);
+		word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0F;
+		return uint32_t( (word * 0x0101010101010101) >> 56 );
+	 #endif
+	}
+
+	/// index of the lowest set bit, the word must not be 0
+	inline uint32_t countTrailingZeros64( uint64_t word ) noexcept
+	{
+	 #if defined(_MSC_VER) && !defined(__clang__)
+		unsigned long index;
+		_BitScanForward64( &index, word );
+		return uint32_t( index );
+	 #else
+		return uint32_t( __builtin_ctzll( word ) );
+	 #endif
+	}
+
+	//-- hashing -------------------------------------------------------------------------------------------------------
+
+	/// multiplies two 64-bit numbers into 128-bit result and folds its halves together
+	inline uint64_t mulFold( uint64_t a, uint64_t b ) noexcept
+	{
+	 #if defined(__SIZEOF_INT128__)
+		__uint128_t product = __uint128_t( a ) * b;
+		return uint64_t( product ) ^ uint64_t( product >> 64 );
+	 #else
+		uint64_t aLo = a & 0xFFFFFFFF, aHi = a >> 32, bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+		uint64_t lolo = aLo * bLo, lohi = aLo * bHi, hilo = aHi * bLo, hihi = aHi * bHi;
+		uint64_t cross = (lolo >> 32) + (lohi & 0xFFFFFFFF) + hilo;
+		uint64_t low = (cross << 32) | (lolo & 0xFFFFFFFF);
+		uint64_t high = hihi + (lohi >> 32) + (cross >> 32);
+		return low ^ high;
+	 #endif
+	}
+
+	/// Hash of up to 128 bits of key. Every input bit affects all output bits, so it's suitable even for flat
+	/// hash tables that take the bucket index from the low bits and the metadata from the high bits.
+	inline size_t hashWords( uint64_t first, uint64_t second ) noexcept
+	{
+		uint64_t mixed = mulFold( first ^ 0xA0761D6478BD642Full, second ^ 0xE7037ED1A0B428DBull );
+		return size_t( mulFold( mixed, 0x8EBC6AF09C88C6E3ull ) );
+	}
+
+	template< size_t AddrSize >
+	constexpr void copyFromDynamic( uint8_t * addr, const uint8_t * data, size_t dataSize )
+	{
+		if (dataSize != AddrSize)
+			critical_error( "Attempted to construct address of size %zu from buffer of size %zu.", AddrSize, dataSize );
+		constCopy< AddrSize >( data, addr );
+	}
 
 	// system addresses are in the same byte order as ours
 	inline void ownAddrToSysAddrV4( const uint8_t * ownAddr, struct in_addr * sysAddr ) noexcept
@@ -84,6 +288,120 @@ namespace priv {
 		fastCopy16( reinterpret_cast< const uint8_t * >( sysAddr ), ownAddr );
 	}
 
+	//-- compile-time parsers ------------------------------------------------------------------------------------------
+	// Simple scalar versions of the parsers, used for the user-defined literals. They accept the same formats
+	// as the runtime parsers, but the runtime ones are optimized in ways that can't be evaluated at compile time.
+
+	constexpr int constHexValue( char c ) noexcept
+	{
+		return c >= '0' && c <= '9' ? c - '0'
+		     : c >= 'a' && c <= 'f' ? c - 'a' + 10
+		     : c >= 'A' && c <= 'F' ? c - 'A' + 10
+		     : -1;
+	}
+
+	constexpr bool constParseIPv4( std::string_view str, uint8_t * bytes ) noexcept
+	{
+		size_t pos = 0;
+		for (size_t i = 0; i < 4; ++i)
+		{
+			if (i > 0 && (pos >= str.size() || str[ pos++ ] != '.'))
+				return false;
+			size_t fieldStart = pos;
+			uint32_t value = 0;
+			while (pos < str.size() && str[ pos ] >= '0' && str[ pos ] <= '9' && pos - fieldStart < 3)
+				value = value * 10 + uint32_t( str[ pos++ ] - '0' );
+			size_t length = pos - fieldStart;
+			if (length == 0 || value > 255 || (length > 1 && str[ fieldStart ] == '0'))
+				return false;
+			bytes[i] = uint8_t( value );
+		}
+		return pos == str.size();
+	}
+
+	constexpr bool constParseIPv6( std::string_view str, uint8_t * bytes ) noexcept
+	{
+		uint8_t head [16] = {}, tail [16] = {};  // groups before and after "::"
+		size_t headSize = 0, tailSize = 0;
+		bool gapFound = false;
+		size_t pos = 0;
+
+		if (str.size() >= 2 && str[0] == ':' && str[1] == ':')
+		{
+			gapFound = true;
+			pos = 2;
+		}
+		while (pos < str.size())
+		{
+			uint8_t * groups = gapFound ? tail : head;
+			size_t & groupsSize = gapFound ? tailSize : headSize;
+			if (headSize + tailSize > 14)
+				return false;
+
+			// embedded IPv4 suffix
+			if (str.find( '.', pos ) != std::string_view::npos && str.find( ':', pos ) == std::string_view::npos)
+			{
+				if (headSize + tailSize > 12 || !constParseIPv4( str.substr( pos ), groups + groupsSize ))
+					return false;
+				groupsSize += 4;
+				pos = str.size();
+				break;
+			}
+
+			size_t groupStart = pos;
+			uint32_t group = 0;
+			while (pos < str.size() && constHexValue( str[ pos ] ) >= 0 && pos - groupStart < 4)
+				group = (group << 4) | uint32_t( constHexValue( str[ pos++ ] ) );
+			if (pos == groupStart)
+				return false;
+			groups[ groupsSize++ ] = uint8_t( group >> 8 );
+			groups[ groupsSize++ ] = uint8_t( group );
+
+			if (pos == str.size())
+				break;
+			if (str[ pos++ ] != ':')
+				return false;
+			if (pos < str.size() && str[ pos ] == ':')
+			{
+				if (gapFound)
+					return false;
+				gapFound = true;
+				++pos;
+			}
+			else if (pos == str.size())  // trailing single ':'
+			{
+				return false;
+			}
+		}
+
+		if (gapFound ? headSize + tailSize > 14 : headSize != 16)
+			return false;
+		for (size_t i = 0; i < 16; ++i)
+			bytes[i] = i < headSize ? head[i] : i >= 16 - tailSize ? tail[ i - (16 - tailSize) ] : 0;
+		return true;
+	}
+
+	constexpr bool constParseMAC( std::string_view str, uint8_t * bytes ) noexcept
+	{
+		// "aa:bb:cc:dd:ee:ff" or "aa-bb-cc-dd-ee-ff"
+		if (str.size() != 17)
+			return false;
+		for (size_t i = 0; i < 6; ++i)
+		{
+			int high = constHexValue( str[ 3*i ] ), low = constHexValue( str[ 3*i + 1 ] );
+			if (high < 0 || low < 0 || (i < 5 && str[ 3*i + 2 ] != str[2]) || (str[2] != ':' && str[2] != '-'))
+				return false;
+			bytes[i] = uint8_t( high << 4 | low );
+		}
+		return true;
+	}
+
+	// not constexpr on purpose, calling it during constant evaluation makes the compilation fail
+	inline void invalidAddrLiteral( const char * addrType, std::string_view literal )
+	{
+		critical_error( "Invalid %s literal: %.*s", addrType, int( literal.size() ), literal.data() );
+	}
+
 }
 
 
@@ -100,63 +418,73 @@ class GenericAddr
 
  public:
 
-	GenericAddr() noexcept {}
+	constexpr GenericAddr() noexcept : _data{} {}
 
-	GenericAddr( std::initializer_list< uint8_t > initList )
-	{
-		priv::copyFromDynamic( _data, Size, &*initList.begin(), initList.size() );
-	}
-	GenericAddr( const_byte_span data )
+	constexpr GenericAddr( std::initializer_list< uint8_t > initList ) : _data{}
 	{
-		priv::copyFromDynamic( _data, Size, data.data(), data.size() );
+		priv::copyFromDynamic< Size >( _data, initList.begin(), initList.size() );
 	}
-	GenericAddr( fixed_const_byte_span< Size > data ) noexcept
+	constexpr GenericAddr( const_byte_span data ) : _data{}
 	{
-		priv::genericCopy( data.data(), _data, Size );
+		priv::copyFromDynamic< Size >( _data, data.data(), data.size() );
 	}
-	GenericAddr( const GenericAddr< Size > & other ) noexcept
+	constexpr GenericAddr( fixed_const_byte_span< Size > data ) noexcept : _data{}
 	{
-		priv::genericCopy( other._data, _data, Size );
+		priv::constCopy< Size >( data.data(), _data );
 	}
+	constexpr GenericAddr( const GenericAddr< Size > & other ) noexcept = default;
 
-	GenericAddr< Size > & operator=( std::initializer_list< uint8_t > initList )
-	{
-		priv::copyFromDynamic( _data, Size, &*initList.begin(), initList.size() );
-		return *this;
-	}
-	GenericAddr< Size > & operator=( const_byte_span data )
+	constexpr GenericAddr< Size > & operator=( std::initializer_list< uint8_t > initList )
 	{
-		priv::copyFromDynamic( _data, Size, data.data(), data.size() );
+		priv::copyFromDynamic< Size >( _data, initList.begin(), initList.size() );
 		return *this;
 	}
-	GenericAddr< Size > & operator=( fixed_const_byte_span< Size > data ) noexcept
+	constexpr GenericAddr< Size > & operator=( const_byte_span data )
 	{
-		priv::genericCopy( data.data(), _data, Size );
+		priv::copyFromDynamic< Size >( _data, data.data(), data.size() );
 		return *this;
 	}
-	GenericAddr< Size > & operator=( const GenericAddr< Size > & other ) noexcept
+	constexpr GenericAddr< Size > & operator=( fixed_const_byte_span< Size > data ) noexcept
 	{
-		priv::genericCopy( other._data, _data, Size );
+		priv::constCopy< Size >( data.data(), _data );
 		return *this;
 	}
+	constexpr GenericAddr< Size > & operator=( const GenericAddr< Size > & other ) noexcept = default;
 
 	fixed_byte_span< Size >       data()       noexcept  { return make_fixed_span( _data ) ; }
 	fixed_const_byte_span< Size > data() const noexcept  { return make_fixed_const_span( _data ); }
 
-	      uint8_t & operator[]( size_t idx )        { return _data[ idx ]; }
-	const uint8_t & operator[]( size_t idx ) const  { return _data[ idx ]; }
+	constexpr       uint8_t & operator[]( size_t idx )        { return _data[ idx ]; }
+	constexpr const uint8_t & operator[]( size_t idx ) const  { return _data[ idx ]; }
 
-	bool operator==( const GenericAddr< Size > & other ) const noexcept
+	constexpr bool operator==( const GenericAddr< Size > & other ) const noexcept
 	{
-		return priv::genericCompare( _data, other._data ) == 0;
+		return priv::addrEqual< Size >( _data, other._data );
 	}
-	bool operator< ( const GenericAddr< Size > & other ) const noexcept
+	constexpr bool operator!=( const GenericAddr< Size > & other ) const noexcept
 	{
-		return priv::genericCompare( _data, other._data ) < 0;
+		return !priv::addrEqual< Size >( _data, other._data );
 	}
-	bool operator> ( const GenericAddr< Size > & other ) const noexcept
+	constexpr bool operator< ( const GenericAddr< Size > & other ) const noexcept
 	{
-		return priv::genericCompare( _data, other._data ) > 0;
+		return priv::addrCompare< Size >( _data, other._data ) < 0;
+	}
+	constexpr bool operator> ( const GenericAddr< Size > & other ) const noexcept
+	{
+		return priv::addrCompare< Size >( _data, other._data ) > 0;
+	}
+
+	/// Hash suitable for both node-based and flat hash tables, std::hash is specialized using this.
+	size_t hash() const noexcept
+	{
+		if constexpr (Size == 16)
+			return priv::hashWords( priv::loadNative64( _data ), priv::loadNative64( _data + 8 ) );
+		else if constexpr (Size == 6)
+			return priv::hashWords( priv::loadNative32( _data ), priv::loadNative16( _data + 4 ) );
+		else if constexpr (Size == 4)
+			return priv::hashWords( priv::loadNative32( _data ), 0 );
+		else
+			static_assert( Size == 4 || Size == 6 || Size == 16, "hash is not implemented for this size" );
 	}
 
 };
@@ -167,7 +495,7 @@ class GenericAddr
 
 class IPAddr;
 
-enum class IPVer
+enum class IPVer : uint8_t
 {
 	_4 = 4,
 	_6 = 6
@@ -183,43 +511,19 @@ class IPv4Addr : public GenericAddr<4>
 
 	using GenericAddr<4>::GenericAddr;
 
-	IPv4Addr( std::initializer_list< uint8_t > initList )
-	{
-		priv::copy4FromDynamic( _data, &*initList.begin(), initList.size() );
-	}
-	IPv4Addr( const_byte_span data )
-	{
-		priv::copy4FromDynamic( _data, data.data(), data.size() );
-	}
-	IPv4Addr( fixed_const_byte_span<4> data ) noexcept
-	{
-		priv::fastCopy4( data.data(), _data );
-	}
-	IPv4Addr( const IPv4Addr & other ) noexcept : GenericAddr<4>()
-	{
-		priv::fastCopy4( other.data().data(), _data );
-	}
+	constexpr IPv4Addr() noexcept = default;
 
-	IPv4Addr & operator=( std::initializer_list< uint8_t > initList )
-	{
-		priv::copy4FromDynamic( _data, &*initList.begin(), initList.size() );
-		return *this;
-	}
-	IPv4Addr & operator=( const_byte_span data )
-	{
-		priv::copy4FromDynamic( _data, data.data(), data.size() );
-		return *this;
-	}
-	IPv4Addr & operator=( fixed_const_byte_span<4> data ) noexcept
-	{
-		priv::fastCopy4( data.data(), _data );
-		return *this;
-	}
-	IPv4Addr & operator=( const IPv4Addr & other ) noexcept
-	{
-		priv::fastCopy4( other.data().data(), _data );
-		return *this;
-	}
+	/// Parses the dotted-decimal notation (e.g. "192.168.0.1") without any allocation or stream.
+	/** Accepts the same format as inet_pton(AF_INET), returns empty optional if the string is not a valid address. */
+	static std::optional< IPv4Addr > parse( std::string_view str ) noexcept;
+
+	/// maximum length of the string produced by toChars() and toString()
+	static constexpr size_t MAX_STR_LEN = 15;
+
+	/// Writes the dotted-decimal notation into the buffer, without stream and without the terminating null character.
+	/** Returns the number of characters written, or 0 if the buffer is too small. */
+	size_t toChars( char * buffer, size_t size ) const noexcept;
+	std::string toString() const;
 
 	friend std::ostream & operator<<( std::ostream & os, IPv4Addr addr );
 	friend std::istream & operator>>( std::istream & is, IPv4Addr & addr ) noexcept;
@@ -235,43 +539,19 @@ class IPv6Addr : public GenericAddr<16>
 
 	using GenericAddr<16>::GenericAddr;
 
-	IPv6Addr( std::initializer_list< uint8_t > initList )
-	{
-		priv::copy16FromDynamic( _data, &*initList.begin(), initList.size() );
-	}
-	IPv6Addr( const_byte_span data )
-	{
-		priv::copy16FromDynamic( _data, data.data(), data.size() );
-	}
-	IPv6Addr( fixed_const_byte_span<4> data ) noexcept
-	{
-		priv::fastCopy16( data.data(), _data );
-	}
-	IPv6Addr( const IPv6Addr & other ) noexcept : GenericAddr<16>()
-	{
-		priv::fastCopy16( other.data().data(), _data );
-	}
+	constexpr IPv6Addr() noexcept = default;
 
-	IPv6Addr & operator=( std::initializer_list< uint8_t > initList )
-	{
-		priv::copy16FromDynamic( _data, &*initList.begin(), initList.size() );
-		return *this;
-	}
-	IPv6Addr & operator=( const_byte_span data )
-	{
-		priv::copy16FromDynamic( _data, data.data(), data.size() );
-		return *this;
-	}
-	IPv6Addr & operator=( fixed_const_byte_span<4> data ) noexcept
-	{
-		priv::fastCopy16( data.data(), _data );
-		return *this;
-	}
-	IPv6Addr & operator=( const IPv6Addr & other ) noexcept
-	{
-		priv::fastCopy16( other.data().data(), _data );
-		return *this;
-	}
+	/// Parses the colon-hexadecimal notation (e.g. "fe80::1" or "::ffff:10.0.0.1") without any allocation or stream.
+	/** Accepts the same format as inet_pton(AF_INET6), returns empty optional if the string is not a valid address. */
+	static std::optional< IPv6Addr > parse( std::string_view str ) noexcept;
+
+	/// maximum length of the string produced by toChars() and toString()
+	static constexpr size_t MAX_STR_LEN = 39;
+
+	/// Writes the canonical text representation (RFC 5952) into the buffer, without the terminating null character.
+	/** Returns the number of characters written, or 0 if the buffer is too small. */
+	size_t toChars( char * buffer, size_t size ) const noexcept;
+	std::string toString() const;
 
 	friend std::ostream & operator<<( std::ostream & os, const IPv6Addr & addr );
 	friend std::istream & operator>>( std::istream & is, IPv6Addr & addr ) noexcept;
@@ -279,58 +559,126 @@ class IPv6Addr : public GenericAddr<16>
 
 
 /// universal container capable of storing both IPv4 and IPv6 address
+/** IPv4 address occupies the first 4 bytes, the rest is always zero, so that the whole storage can be compared.
+  * The version is stored in a single byte, so the whole address takes 17 bytes and Endpoint 20 bytes. */
 class IPAddr : public GenericAddr<16>
 {
 	IPVer _version;
 
- public:
-
-	using GenericAddr<16>::GenericAddr;
+	friend class IPPrefix;  // only clears the bits beyond the prefix length, which keeps the rest zero
 
-	IPAddr() noexcept : _version( static_cast<IPVer>(0) ) {}
+ public:
 
-	IPAddr( std::initializer_list< uint8_t > initList );
-	IPAddr( const_byte_span data );
+	constexpr IPAddr() noexcept : _version( static_cast<IPVer>(0) ) {}
 
-	IPAddr( fixed_const_byte_span<4> data ) noexcept
+	constexpr IPAddr( std::initializer_list< uint8_t > initList ) : _version( static_cast<IPVer>(0) )
+	{
+		_assign( initList.begin(), initList.size() );
+	}
+	IPAddr( const_byte_span data ) : _version( static_cast<IPVer>(0) )
+	{
+		_assign( data.data(), data.size() );
+	}
+	IPAddr( fixed_const_byte_span<4> data ) noexcept : _version( IPVer::_4 )
 	{
-		priv::fastCopy4( data.data(), _data );
-		_version = IPVer::_4;
+		priv::constCopy<4>( data.data(), _data );
 	}
-	IPAddr( fixed_const_byte_span<16> data ) noexcept
+	IPAddr( fixed_const_byte_span<16> data ) noexcept : _version( IPVer::_6 )
 	{
-		priv::fastCopy16( data.data(), _data );
-		_version = IPVer::_6;
+		priv::constCopy<16>( data.data(), _data );
 	}
-	IPAddr( const IPv4Addr & addr ) noexcept
+	constexpr IPAddr( const IPv4Addr & addr ) noexcept : _version( IPVer::_4 )
 	{
-		priv::fastCopy4( addr._data, _data );
-		_version = IPVer::_4;
+		priv::constCopy<4>( addr._data, _data );
 	}
-	IPAddr( const IPv6Addr & addr ) noexcept
+	constexpr IPAddr( const IPv6Addr & addr ) noexcept : _version( IPVer::_6 )
 	{
-		priv::fastCopy16( addr._data, _data );
-		_version = IPVer::_6;
+		priv::constCopy<16>( addr._data, _data );
 	}
 
-	IPVer version() const noexcept { return _version; }
+	constexpr IPVer version() const noexcept { return _version; }
+
+	// The bytes are read-only, writing an IPv4 address through them could leave a part of a previous IPv6 address
+	// behind the first 4 bytes and break the comparison and the hash. Assign a whole new IPAddr instead.
+	fixed_const_byte_span<16> data() const noexcept  { return make_fixed_const_span( _data ); }
+	constexpr const uint8_t & operator[]( size_t idx ) const  { return _data[ idx ]; }
 
-	IPv4Addr v4() const
+	constexpr IPv4Addr v4() const
 	{
 		if (_version != IPVer::_4)
-			critical_error( "Attempted to convert IPAddr of version %zu to IPv4Addr.", _version );
-		return IPv4Addr( make_fixed_span( _data ).shorter<4>() );
+			critical_error( "Attempted to convert IPAddr of version %d to IPv4Addr.", int( _version ) );
+		IPv4Addr addr;
+		priv::constCopy<4>( _data, addr._data );
+		return addr;
 	}
-	IPv6Addr v6() const
+	constexpr IPv6Addr v6() const
 	{
 		if (_version != IPVer::_6)
-			critical_error( "Attempted to convert IPAddr of version %zu to IPv6Addr.", _version );
-		return IPv6Addr( make_fixed_span( _data ) );
+			critical_error( "Attempted to convert IPAddr of version %d to IPv6Addr.", int( _version ) );
+		IPv6Addr addr;
+		priv::constCopy<16>( _data, addr._data );
+		return addr;
 	}
 
+	// addresses of different versions are never equal, IPv4 addresses are ordered before IPv6 addresses
+	constexpr bool operator==( const IPAddr & other ) const noexcept
+	{
+		return (_version == other._version) & priv::addrEqual<16>( _data, other._data );
+	}
+	constexpr bool operator!=( const IPAddr & other ) const noexcept
+	{
+		return !(*this == other);
+	}
+	constexpr bool operator< ( const IPAddr & other ) const noexcept
+	{
+		int versionCmp = priv::threeWay( int( _version ), int( other._version ) );
+		return (versionCmp != 0 ? versionCmp : priv::addrCompare<16>( _data, other._data )) < 0;
+	}
+	constexpr bool operator> ( const IPAddr & other ) const noexcept
+	{
+		return other < *this;
+	}
+
+	size_t hash() const noexcept
+	{
+		return priv::hashWords( priv::loadNative64( _data ), priv::loadNative64( _data + 8 ) ^ uint64_t( _version ) );
+	}
+
+	/// Parses either IPv4 or IPv6 address, the version is decided from the string before parsing, not by trial and error.
+	static std::optional< IPAddr > parse( std::string_view str ) noexcept;
+
+	/// maximum length of the string produced by toChars() and toString()
+	static constexpr size_t MAX_STR_LEN = IPv6Addr::MAX_STR_LEN;
+
+	/// Writes the address in the notation of its version into the buffer, without the terminating null character.
+	/** Returns the number of characters written, or 0 if the buffer is too small or the address is uninitialized. */
+	size_t toChars( char * buffer, size_t size ) const noexcept;
+	std::string toString() const;
+
 	friend std::ostream & operator<<( std::ostream & os, const IPAddr & addr );
 	friend std::istream & operator>>( std::istream & is, IPAddr & addr ) noexcept;
+
+ private:
+
+	constexpr void _assign( const uint8_t * data, size_t size )
+	{
+		if (size == 4)
+		{
+			priv::constCopy<4>( data, _data );  // the rest has been zeroed by the base constructor
+			_version = IPVer::_4;
+		}
+		else if (size == 16)
+		{
+			priv::constCopy<16>( data, _data );
+			_version = IPVer::_6;
+		}
+		else
+		{
+			critical_error( "IP address can only be constructed from a buffer of size 4 or 16, current size: %zu", size );
+		}
+	}
 };
+static_assert( sizeof( IPAddr ) == 17, "IPAddr should consist only of the 16 bytes of the address and 1 byte of the version" );
 
 
 //======================================================================================================================
@@ -342,6 +690,25 @@ class MACAddr : public GenericAddr<6>
 
 	using GenericAddr<6>::GenericAddr;
 
+	constexpr MACAddr() noexcept = default;
+
+	/// Parses the form "aa:bb:cc:dd:ee:ff" or "aa-bb-cc-dd-ee-ff", returns empty optional if the string is invalid.
+	static constexpr std::optional< MACAddr > parse( std::string_view str ) noexcept
+	{
+		MACAddr addr;
+		if (!priv::constParseMAC( str, addr._data ))
+			return std::nullopt;
+		return addr;
+	}
+
+	/// maximum length of the string produced by toChars() and toString()
+	static constexpr size_t MAX_STR_LEN = 17;
+
+	/// Writes the address in the form "aa:bb:cc:dd:ee:ff" into the buffer, without the terminating null character.
+	/** Returns the number of characters written, or 0 if the buffer is too small. */
+	size_t toChars( char * buffer, size_t size ) const noexcept;
+	std::string toString() const;
+
 	friend std::ostream & operator<<( std::ostream & os, const MACAddr & addr );
 	friend std::istream & operator>>( std::istream & is, MACAddr & addr ) noexcept;
 };
@@ -353,17 +720,274 @@ struct Endpoint
 {
 	IPAddr addr;
 	uint16_t port;
+
+	constexpr bool operator==( const Endpoint & other ) const noexcept
+	{
+		return addr == other.addr && port == other.port;
+	}
+	constexpr bool operator!=( const Endpoint & other ) const noexcept
+	{
+		return !(*this == other);
+	}
+	constexpr bool operator< ( const Endpoint & other ) const noexcept
+	{
+		return addr != other.addr ? addr < other.addr : port < other.port;
+	}
+
+	size_t hash() const noexcept
+	{
+		return priv::hashWords(
+			priv::loadNative64( addr.data().data() ),
+			priv::loadNative64( addr.data().data() + 8 ) ^ (uint64_t( addr.version() ) << 16 | port)
+		);
+	}
+
+	/// maximum length of the string produced by toChars() and toString()
+	static constexpr size_t MAX_STR_LEN = 1 + IPAddr::MAX_STR_LEN + 2 + 5;  // "[addr]:port"
+
+	/// Writes "address:port" for IPv4 or "[address]:port" for IPv6 into the buffer, without the terminating null character.
+	/** Returns the number of characters written, or 0 if the buffer is too small or the address is uninitialized. */
+	size_t toChars( char * buffer, size_t size ) const noexcept;
+	std::string toString() const;
 };
+static_assert( sizeof( Endpoint ) <= 20, "Endpoint is stored in large connection tables, keep it compact" );
 
 void endpointToSockaddr( const Endpoint & ep, struct sockaddr * saddr, int & addrlen );
 
 bool sockaddrToEndpoint( const struct sockaddr * saddr, Endpoint & ep ) noexcept;
 
 
+//======================================================================================================================
+/// Endpoint stored directly in the form of the system sockaddr_in or sockaddr_in6 structure.
+/** Endpoint has to be converted to the system structure on every send and back on every receive. This class keeps
+  * the system structure itself, so the sockets pass it to the system calls as it is, and the accessors read the address
+  * and port directly from it. Use it for peers that are sent to repeatedly or for received addresses that are only
+  * used to send a reply. It also preserves the IPv6 scope id, which Endpoint drops. */
+
+class NativeEndpoint
+{
+ public:
+
+	/// size of the largest supported system structure (sockaddr_in6)
+	static constexpr int CAPACITY = 28;
+
+	/// Constructs an empty endpoint, to be filled by a receive operation.
+	NativeEndpoint() noexcept : _storage{}, _addrlen( 0 ) {}
+
+	explicit NativeEndpoint( const Endpoint & ep )  { endpointToSockaddr( ep, saddrBuffer(), _addrlen ); }
+	NativeEndpoint( const IPAddr & addr, uint16_t port )  { endpointToSockaddr( { addr, port }, saddrBuffer(), _addrlen ); }
+
+	/// Copies the system structure, returns false if it's not an IPv4 or IPv6 address.
+	bool assign( const struct sockaddr * saddr, int addrlen ) noexcept;
+
+	bool isValid() const noexcept  { return _addrlen != 0; }
+
+	IPVer version() const noexcept  { return _addrlen == V6_LEN ? IPVer::_6 : IPVer::_4; }
+
+	uint16_t port() const noexcept  { return priv::loadBE16( _storage + PORT_OFFSET ); }
+
+	IPAddr addr() const noexcept
+	{
+		if (_addrlen == V6_LEN)
+			return IPAddr( fixed_const_byte_span< 16 >( _storage + V6_ADDR_OFFSET ) );
+		else
+			return IPAddr( fixed_const_byte_span< 4 >( _storage + V4_ADDR_OFFSET ) );
+	}
+
+	Endpoint toEndpoint() const noexcept  { return { addr(), port() }; }
+
+	bool operator==( const NativeEndpoint & other ) const noexcept
+	{
+		return _addrlen == other._addrlen && memcmp( _storage, other._storage, size_t( _addrlen ) ) == 0;
+	}
+	bool operator!=( const NativeEndpoint & other ) const noexcept
+	{
+		return !(*this == other);
+	}
+
+	/// the system structure to be passed to the system calls
+	const struct sockaddr * saddr() const noexcept  { return reinterpret_cast< const struct sockaddr * >( _storage ); }
+	int saddrLen() const noexcept  { return _addrlen; }
+
+	/// For filling the endpoint directly by a system call, such as recvfrom() or accept().
+	/** Pass this buffer with the length of CAPACITY to the system call, and then setSaddrLen() with the length it returned. */
+	struct sockaddr * saddrBuffer() noexcept  { return reinterpret_cast< struct sockaddr * >( _storage ); }
+	/// Completes filling by a system call, returns false and leaves the endpoint empty if it's not an IPv4 or IPv6 address.
+	bool setSaddrLen( int addrlen ) noexcept;
+
+	/// Writes "address:port" for IPv4 or "[address]:port" for IPv6, see Endpoint::toChars().
+	size_t toChars( char * buffer, size_t size ) const noexcept  { return isValid() ? toEndpoint().toChars( buffer, size ) : 0; }
+	std::string toString() const  { return isValid() ? toEndpoint().toString() : std::string(); }
+
+ private:
+
+	// the positions of the fields are the same on all supported systems, NetAddress.cpp checks them at compile time
+	static constexpr int V4_LEN = 16;
+	static constexpr int V6_LEN = 28;
+	static constexpr size_t PORT_OFFSET = 2;
+	static constexpr size_t V4_ADDR_OFFSET = 4;
+	static constexpr size_t V6_ADDR_OFFSET = 8;
+
+	alignas( 4 ) uint8_t _storage [CAPACITY];
+	int _addrlen;  ///< 0 when empty
+};
+
+
+//======================================================================================================================
+/// IP network prefix (subnet) in the CIDR notation, for example 10.0.0.0/8 or 2001:db8::/32
+/** The address bits beyond the prefix length are always zero. */
+
+class IPPrefix
+{
+	IPAddr _addr;
+	uint8_t _length;
+
+ public:
+
+	constexpr IPPrefix() noexcept : _addr(), _length( 0 ) {}
+
+	/// The bits of the address beyond the prefix length are cleared.
+	constexpr IPPrefix( const IPAddr & addr, uint8_t length ) : _addr( addr ), _length( length )
+	{
+		if (_length > maxLength( addr.version() ))
+			critical_error( "Prefix length %u is out of range for IP address of version %d.", uint( length ), int( addr.version() ) );
+		for (size_t i = 0; i < 16; ++i)
+		{
+			size_t bitPos = i * 8;
+			if (bitPos >= _length)
+				_addr._data[i] = 0;
+			else if (bitPos + 8 > _length)
+				_addr._data[i] = uint8_t( _addr._data[i] & (0xFF << (bitPos + 8 - _length)) );
+		}
+	}
+
+	/// maximum prefix length of an address of the given version, 0 for an uninitialized version
+	static constexpr uint8_t maxLength( IPVer version ) noexcept
+	{
+		return version == IPVer::_4 ? 32 : version == IPVer::_6 ? 128 : 0;
+	}
+
+	constexpr const IPAddr & addr() const noexcept { return _addr; }
+	constexpr uint8_t length() const noexcept { return _length; }
+	constexpr IPVer version() const noexcept { return _addr.version(); }
+
+	/// Whether the address belongs to this network. Addresses of a different version never do.
+	constexpr bool contains( const IPAddr & addr ) const noexcept
+	{
+		if (addr.version() != _addr.version())
+			return false;
+		size_t fullBytes = _length / 8;
+		for (size_t i = 0; i < fullBytes; ++i)
+			if (addr[i] != _addr[i])
+				return false;
+		uint8_t restBits = _length % 8;
+		return restBits == 0 || uint8_t( addr[ fullBytes ] & (0xFF << (8 - restBits)) ) == _addr[ fullBytes ];
+	}
+
+	constexpr bool operator==( const IPPrefix & other ) const noexcept
+	{
+		return _addr == other._addr && _length == other._length;
+	}
+	constexpr bool operator!=( const IPPrefix & other ) const noexcept
+	{
+		return !(*this == other);
+	}
+	/// ordered by address, prefixes with the same address from the shortest
+	constexpr bool operator< ( const IPPrefix & other ) const noexcept
+	{
+		return _addr != other._addr ? _addr < other._addr : _length < other._length;
+	}
+
+	size_t hash() const noexcept
+	{
+		// mixed in like the version, so that prefixes differing only in the length don't land in nearby buckets
+		return priv::hashWords(
+			priv::loadNative64( _addr.data().data() ),
+			priv::loadNative64( _addr.data().data() + 8 ) ^ (uint64_t( _addr.version() ) << 8 | _length)
+		);
+	}
+
+	/// Parses "address/length", for example "192.168.0.0/16" or "fe80::/10", returns empty optional if it's invalid.
+	/** Non-zero bits beyond the prefix length are accepted and cleared, so that "10.1.2.3/8" means 10.0.0.0/8. */
+	static std::optional< IPPrefix > parse( std::string_view str ) noexcept;
+
+	/// maximum length of the string produced by toChars() and toString()
+	static constexpr size_t MAX_STR_LEN = IPAddr::MAX_STR_LEN + 4;  // "addr/128"
+
+	/// Writes "address/length" into the buffer, without the terminating null character.
+	/** Returns the number of characters written, or 0 if the buffer is too small or the address is uninitialized. */
+	size_t toChars( char * buffer, size_t size ) const noexcept;
+	std::string toString() const;
+
+	friend std::ostream & operator<<( std::ostream & os, const IPPrefix & prefix );
+};
+
+
+//======================================================================================================================
+/// compile-time address literals
+/** Usage: using namespace own::literals;  constexpr IPv4Addr localhost = "127.0.0.1"_ipv4;
+  * An invalid literal makes the compilation fail (in C++17 only when it's used in a constexpr context). */
+
+namespace literals {
+
+	CPPUTILS_NETADDR_LITERAL IPv4Addr operator""_ipv4( const char * str, size_t length )
+	{
+		IPv4Addr addr;
+		uint8_t bytes [4] = {};
+		if (!priv::constParseIPv4( std::string_view( str, length ), bytes ))
+			priv::invalidAddrLiteral( "IPv4 address", std::string_view( str, length ) );
+		for (size_t i = 0; i < 4; ++i)
+			addr[i] = bytes[i];
+		return addr;
+	}
+
+	CPPUTILS_NETADDR_LITERAL IPv6Addr operator""_ipv6( const char * str, size_t length )
+	{
+		IPv6Addr addr;
+		uint8_t bytes [16] = {};
+		if (!priv::constParseIPv6( std::string_view( str, length ), bytes ))
+			priv::invalidAddrLiteral( "IPv6 address", std::string_view( str, length ) );
+		for (size_t i = 0; i < 16; ++i)
+			addr[i] = bytes[i];
+		return addr;
+	}
+
+	/// accepts both IPv4 and IPv6 address
+	CPPUTILS_NETADDR_LITERAL IPAddr operator""_ip( const char * str, size_t length )
+	{
+		std::string_view literal( str, length );
+		if (literal.find( ':' ) != std::string_view::npos)
+			return IPAddr( operator""_ipv6( str, length ) );
+		else
+			return IPAddr( operator""_ipv4( str, length ) );
+	}
+
+	CPPUTILS_NETADDR_LITERAL MACAddr operator""_mac( const char * str, size_t length )
+	{
+		std::optional< MACAddr > addr = MACAddr::parse( std::string_view( str, length ) );
+		if (!addr)
+			priv::invalidAddrLiteral( "MAC address", std::string_view( str, length ) );
+		return *addr;
+	}
+
+} // namespace literals
+
+
 //======================================================================================================================
 
 
 } // namespace own
 
 
+//======================================================================================================================
+//  hashing support for the standard containers
+
+template<> struct std::hash< own::IPv4Addr > { size_t operator()( const own::IPv4Addr & addr ) const noexcept { return addr.hash(); } };
+template<> struct std::hash< own::IPv6Addr > { size_t operator()( const own::IPv6Addr & addr ) const noexcept { return addr.hash(); } };
+template<> struct std::hash< own::IPAddr >   { size_t operator()( const own::IPAddr & addr ) const noexcept   { return addr.hash(); } };
+template<> struct std::hash< own::MACAddr >  { size_t operator()( const own::MACAddr & addr ) const noexcept  { return addr.hash(); } };
+template<> struct std::hash< own::Endpoint > { size_t operator()( const own::Endpoint & ep ) const noexcept    { return ep.hash(); } };
+template<> struct std::hash< own::IPPrefix > { size_t operator()( const own::IPPrefix & pfx ) const noexcept   { return pfx.hash(); } };
+
+
 #endif // CPPUTILS_NETADDRESS_INCLUDED
@@ -0,0 +1,128 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: std::format and fmt formatters for network addresses
+//======================================================================================================================
+
+#ifndef CPPUTILS_NETADDRESS_FORMAT_INCLUDED
+#define CPPUTILS_NETADDRESS_FORMAT_INCLUDED
+
+
+// This is a separate header, so that users who don't need it don't pay for including <format>.
+// The std::formatter specializations are enabled automatically when compiling as C++20 with <format> available,
+// the fmt::formatter specializations when fmt has been included before this header or CPPUTILS_USE_FMT is defined.
+
+
+#include "NetAddress.hpp"
+
+#include <algorithm>  // copy_n
+
+#if __cplusplus >= 202002L && __has_include(<format>)
+	#include <format>
+	#if defined(__cpp_lib_format)
+		#define CPPUTILS_NETADDRESS_STD_FORMAT
+	#endif
+#endif
+
+#if defined(CPPUTILS_USE_FMT) && !defined(FMT_VERSION)
+	#include <fmt/format.h>
+#endif
+
+
+namespace own {
+namespace priv {
+
+	/// common implementation of formatters from all supported formatting libraries
+	template< typename Addr >
+	struct AddrFormatter
+	{
+		/// only the empty format spec "{}" is supported
+		template< typename ParseIter >
+		static constexpr bool isEmptySpec( ParseIter begin, ParseIter end )
+		{
+			return begin == end || *begin == '}';
+		}
+
+		template< typename OutIter >
+		static OutIter format( const Addr & addr, OutIter out )
+		{
+			char str [Addr::MAX_STR_LEN];
+			size_t length = addr.toChars( str, sizeof(str) );
+			return std::copy_n( str, length, out );
+		}
+	};
+
+} // namespace priv
+} // namespace own
+
+
+//======================================================================================================================
+//  std::format
+
+#ifdef CPPUTILS_NETADDRESS_STD_FORMAT
+
+#define CPPUTILS_DEFINE_STD_ADDR_FORMATTER( Addr ) \
+	template<> \
+	struct std::formatter< Addr, char > \
+	{ \
+		constexpr auto parse( std::format_parse_context & ctx ) \
+		{ \
+			if (!own::priv::AddrFormatter< Addr >::isEmptySpec( ctx.begin(), ctx.end() )) \
+				throw std::format_error( "network addresses don't support any format spec" ); \
+			return ctx.begin(); \
+		} \
+		template< typename FormatContext > \
+		auto format( const Addr & addr, FormatContext & ctx ) const \
+		{ \
+			return own::priv::AddrFormatter< Addr >::format( addr, ctx.out() ); \
+		} \
+	};
+
+CPPUTILS_DEFINE_STD_ADDR_FORMATTER( own::IPv4Addr )
+CPPUTILS_DEFINE_STD_ADDR_FORMATTER( own::IPv6Addr )
+CPPUTILS_DEFINE_STD_ADDR_FORMATTER( own::IPAddr )
+CPPUTILS_DEFINE_STD_ADDR_FORMATTER( own::MACAddr )
+CPPUTILS_DEFINE_STD_ADDR_FORMATTER( own::Endpoint )
+CPPUTILS_DEFINE_STD_ADDR_FORMATTER( own::IPPrefix )
+
+#undef CPPUTILS_DEFINE_STD_ADDR_FORMATTER
+
+#endif // CPPUTILS_NETADDRESS_STD_FORMAT
+
+
+//======================================================================================================================
+//  fmt
+
+#ifdef FMT_VERSION
+
+#define CPPUTILS_DEFINE_FMT_ADDR_FORMATTER( Addr ) \
+	template<> \
+	struct fmt::formatter< Addr > \
+	{ \
+		constexpr auto parse( fmt::format_parse_context & ctx ) \
+		{ \
+			if (!own::priv::AddrFormatter< Addr >::isEmptySpec( ctx.begin(), ctx.end() )) \
+				throw fmt::format_error( "network addresses don't support any format spec" ); \
+			return ctx.begin(); \
+		} \
+		template< typename FormatContext > \
+		auto format( const Addr & addr, FormatContext & ctx ) const \
+		{ \
+			return own::priv::AddrFormatter< Addr >::format( addr, ctx.out() ); \
+		} \
+	};
+
+CPPUTILS_DEFINE_FMT_ADDR_FORMATTER( own::IPv4Addr )
+CPPUTILS_DEFINE_FMT_ADDR_FORMATTER( own::IPv6Addr )
+CPPUTILS_DEFINE_FMT_ADDR_FORMATTER( own::IPAddr )
+CPPUTILS_DEFINE_FMT_ADDR_FORMATTER( own::MACAddr )
+CPPUTILS_DEFINE_FMT_ADDR_FORMATTER( own::Endpoint )
+CPPUTILS_DEFINE_FMT_ADDR_FORMATTER( own::IPPrefix )
+
+#undef CPPUTILS_DEFINE_FMT_ADDR_FORMATTER
+
+#endif // FMT_VERSION
+
+
+#endif // CPPUTILS_NETADDRESS_FORMAT_INCLUDED
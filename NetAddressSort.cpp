@@ -0,0 +1,121 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: sorting of large address arrays
+//======================================================================================================================
+
+#include "NetAddressSort.hpp"
+
+#include <algorithm>  // sort, copy
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  MSD radix sort
+
+// below this size the bucket histogram costs more than a comparison sort
+static constexpr size_t SMALL_BUCKET_SIZE = 64;
+
+/// Sorts the elements by their key, which is a sequence of bytes in the order of significance.
+/** \param keyByte function returning the byte of the element's key at the given position */
+template< typename Elem, typename KeyByteFunc >
+static void msdRadixSort( Elem * elems, Elem * scratch, size_t count, size_t depth, size_t keyLength, KeyByteFunc keyByte )
+{
+	while (true)
+	{
+		if (count <= SMALL_BUCKET_SIZE)
+		{
+			std::sort( elems, elems + count );  // operator< agrees with the order of the key bytes
+			return;
+		}
+		if (depth == keyLength)  // all the keys are equal
+		{
+			return;
+		}
+
+		size_t counts [256] = {};
+		for (size_t i = 0; i < count; ++i)
+			++counts[ keyByte( elems[i], depth ) ];
+
+		// all the elements share this byte, move on to the next one without shuffling anything
+		if (counts[ keyByte( elems[0], depth ) ] == count)
+		{
+			++depth;
+			continue;
+		}
+
+		size_t offsets [256];
+		size_t offset = 0;
+		for (size_t b = 0; b < 256; ++b)
+		{
+			offsets[b] = offset;
+			offset += counts[b];
+		}
+		for (size_t i = 0; i < count; ++i)
+			scratch[ offsets[ keyByte( elems[i], depth ) ]++ ] = elems[i];
+		std::copy( scratch, scratch + count, elems );
+
+		size_t bucketStart = 0;
+		for (size_t b = 0; b < 256; ++b)
+		{
+			if (counts[b] > 1)
+				msdRadixSort( elems + bucketStart, scratch + bucketStart, counts[b], depth + 1, keyLength, keyByte );
+			bucketStart += counts[b];
+		}
+		return;
+	}
+}
+
+// key of IPAddr is its version followed by its 16 bytes (the unused bytes of IPv4 are always zero)
+static constexpr size_t IPADDR_KEY_LENGTH = 1 + 16;
+
+static inline uint8_t addrKeyByte( const IPAddr & addr, size_t pos ) noexcept
+{
+	return pos == 0 ? uint8_t( addr.version() ) : addr[ pos - 1 ];
+}
+
+
+//======================================================================================================================
+
+void radixSort( std::vector< IPAddr > & addrs )
+{
+	if (addrs.size() <= SMALL_BUCKET_SIZE)
+	{
+		std::sort( addrs.begin(), addrs.end() );
+		return;
+	}
+
+	std::vector< IPAddr > scratch( addrs.size() );
+	msdRadixSort( addrs.data(), scratch.data(), addrs.size(), 0, IPADDR_KEY_LENGTH,
+		[]( const IPAddr & addr, size_t pos ) { return addrKeyByte( addr, pos ); }
+	);
+}
+
+void radixSort( std::vector< Endpoint > & endpoints )
+{
+	if (endpoints.size() <= SMALL_BUCKET_SIZE)
+	{
+		std::sort( endpoints.begin(), endpoints.end() );
+		return;
+	}
+
+	std::vector< Endpoint > scratch( endpoints.size() );
+	msdRadixSort( endpoints.data(), scratch.data(), endpoints.size(), 0, IPADDR_KEY_LENGTH + 2,
+		[]( const Endpoint & ep, size_t pos )
+		{
+			if (pos < IPADDR_KEY_LENGTH)
+				return addrKeyByte( ep.addr, pos );
+			else
+				return uint8_t( pos == IPADDR_KEY_LENGTH ? ep.port >> 8 : ep.port );
+		}
+	);
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
@@ -0,0 +1,38 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: sorting of large address arrays
+//======================================================================================================================
+
+#ifndef CPPUTILS_NETADDRESS_SORT_INCLUDED
+#define CPPUTILS_NETADDRESS_SORT_INCLUDED
+
+
+#include "NetAddress.hpp"
+
+#include <vector>
+
+
+namespace own {
+
+
+//======================================================================================================================
+
+/// Sorts the addresses into the order defined by operator<, IPv4 addresses come first.
+/** Uses MSD radix sort that skips the bytes shared by all the addresses in a bucket (e.g. common network prefixes),
+  * which is several times faster than std::sort for large arrays. It needs a temporary copy of the array. */
+void radixSort( std::vector< IPAddr > & addrs );
+
+/// Sorts the endpoints into the order defined by operator<, first by address and then by port.
+/** \copydetails radixSort( std::vector< IPAddr > & ) */
+void radixSort( std::vector< Endpoint > & endpoints );
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_NETADDRESS_SORT_INCLUDED
@@ -0,0 +1,118 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: UDP sender spreading the datagrams evenly in time instead of sending them in bursts
+//======================================================================================================================
+
+#include "PacedUdpSender.hpp"
+
+#include <thread>
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  error strings
+
+const char * enumString( PacingMode mode ) noexcept
+{
+	switch (mode)
+	{
+		case PacingMode::UserSpace:     return "UserSpace";
+		case PacingMode::KernelTxTime:  return "KernelTxTime";
+		default:                        return "<invalid>";
+	}
+}
+
+
+//======================================================================================================================
+//  PacedUdpSender
+
+/// Sleeping is precise only to tens of microseconds (timer slack, scheduler latency), so the last part is spinning.
+static constexpr std::chrono::microseconds SPIN_DURATION( 200 );
+
+PacedUdpSender::PacedUdpSender( UdpSocket & socket ) noexcept
+:
+	_socket( socket ),
+	_mode( PacingMode::UserSpace ),
+	_bytesPerSecond( 0 ),
+	_maxLag( 0 ),
+	_nextDeparture(),
+	_lastDeparture()
+{}
+
+void PacedUdpSender::setRate( uint64_t bytesPerSecond, size_t maxBurst ) noexcept
+{
+	_bytesPerSecond = bytesPerSecond;
+	_maxLag = bytesPerSecond > 0
+		? std::chrono::duration_cast< Clock::duration >( std::chrono::nanoseconds( maxBurst * 1000000000ull / bytesPerSecond ) )
+		: Clock::duration( 0 );
+}
+
+SocketError PacedUdpSender::setMode( PacingMode mode ) noexcept
+{
+	if (mode == PacingMode::KernelTxTime && _mode != PacingMode::KernelTxTime)
+	{
+		SocketError error = _socket.enableTransmitTime();
+		if (error != SocketError::Success)
+			return error;
+	}
+	// the option can stay enabled, without the control message the datagrams simply leave immediately
+	_mode = mode;
+	return SocketError::Success;
+}
+
+void PacedUdpSender::reset() noexcept
+{
+	_nextDeparture = Clock::time_point();
+}
+
+SocketError PacedUdpSender::sendTo( const NativeEndpoint & endpoint, const_byte_span buffer )
+{
+	if (_bytesPerSecond == 0)  // pacing disabled
+	{
+		_lastDeparture = Clock::now();
+		return _socket.sendTo( endpoint, buffer );
+	}
+
+	// don't let the sender catch up on more than the allowed burst after it stalled
+	Clock::time_point earliestAllowed = Clock::now() - _maxLag;
+	if (_nextDeparture < earliestAllowed)
+		_nextDeparture = earliestAllowed;
+
+	Clock::time_point departure = _nextDeparture;
+	_nextDeparture += std::chrono::duration_cast< Clock::duration >(
+		std::chrono::nanoseconds( uint64_t( buffer.size() ) * 1000000000ull / _bytesPerSecond )
+	);
+	_lastDeparture = departure;
+
+	if (_mode == PacingMode::KernelTxTime)
+	{
+		return _socket.sendAt( endpoint, buffer, departure );
+	}
+	else
+	{
+		_waitUntil( departure );
+		return _socket.sendTo( endpoint, buffer );
+	}
+}
+
+void PacedUdpSender::_waitUntil( Clock::time_point departure ) noexcept
+{
+	if (Clock::now() + SPIN_DURATION < departure)
+	{
+		std::this_thread::sleep_until( departure - SPIN_DURATION );
+	}
+	while (Clock::now() < departure)
+	{
+		std::this_thread::yield();  // let the other threads on this core run, they may be the ones we wait for
+	}
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
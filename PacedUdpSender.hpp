@@ -0,0 +1,95 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: UDP sender spreading the datagrams evenly in time instead of sending them in bursts
+//======================================================================================================================
+
+#ifndef CPPUTILS_PACEDUDPSENDER_INCLUDED
+#define CPPUTILS_PACEDUDPSENDER_INCLUDED
+
+
+#include "Socket.hpp"
+
+#include <CppUtils-Essential/Span.hpp>
+
+#include <chrono>
+
+
+namespace own {
+
+
+//======================================================================================================================
+
+enum class PacingMode
+{
+	UserSpace,     ///< the sender waits until the departure time of each datagram and then sends it
+	KernelTxTime,  ///< the datagrams are handed to the system with their departure times (see UdpSocket::sendAt())
+};
+const char * enumString( PacingMode mode ) noexcept;
+
+
+//======================================================================================================================
+/// Sends datagrams through an UDP socket at a configured rate, so that they don't overflow the receive buffers
+/// of the receiver or of the devices on the way.
+/** Each datagram gets a departure time, which is the departure time of the previous one plus the time the previous one
+  * takes at the configured rate. When the sender falls behind, it may catch up by at most maxBurst bytes sent
+  * without waiting, the rest of the delay is forgotten.
+  *
+  * KernelTxTime releases the calling thread immediately, but it needs the fq or etf queueing discipline on the outgoing
+  * interface, which is not the default anywhere (tc qdisc replace dev eth0 root fq). The sender can't check that,
+  * so it is up to the user to select it. UserSpace works everywhere, it sleeps until shortly before the departure
+  * and then spins for the rest of the time to be precise. */
+
+class PacedUdpSender
+{
+
+ public:
+
+	using Clock = std::chrono::steady_clock;
+
+	/// The socket must stay valid for the whole lifetime of the sender.
+	PacedUdpSender( UdpSocket & socket ) noexcept;
+
+	/// \param[in] bytesPerSecond rate of the datagram payloads, the headers are not counted
+	/// \param[in] maxBurst how many bytes may be sent without waiting when the sender is behind
+	void setRate( uint64_t bytesPerSecond, size_t maxBurst = 0 ) noexcept;
+
+	uint64_t rate() const noexcept  { return _bytesPerSecond; }
+
+	/// Switches the pacing mode, KernelTxTime returns SocketError::NotSupported where the system doesn't have it.
+	SocketError setMode( PacingMode mode ) noexcept;
+
+	PacingMode mode() const noexcept  { return _mode; }
+
+	/// Sends the datagram at its departure time, in UserSpace mode this blocks until then.
+	SocketError sendTo( const NativeEndpoint & endpoint, const_byte_span buffer );
+
+	/// The departure time assigned to the last sent datagram.
+	Clock::time_point lastDeparture() const noexcept  { return _lastDeparture; }
+
+	/// Forgets the schedule, the next datagram departs immediately.
+	void reset() noexcept;
+
+ private:
+
+	/// waits precisely until the time point, sleeping for most of the time and spinning for the rest
+	static void _waitUntil( Clock::time_point departure ) noexcept;
+
+	UdpSocket & _socket;
+	PacingMode _mode;
+	uint64_t _bytesPerSecond;
+	Clock::duration _maxLag;
+	Clock::time_point _nextDeparture;
+	Clock::time_point _lastDeparture;
+
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_PACEDUDPSENDER_INCLUDED
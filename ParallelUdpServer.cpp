@@ -0,0 +1,198 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: UDP server receiving on multiple threads, each with its own socket sharing the same port
+//======================================================================================================================
+
+#include "ParallelUdpServer.hpp"
+
+#ifdef __linux__
+	#include <pthread.h>  // pthread_setaffinity_np
+	#include <sched.h>    // sched_getaffinity, CPU_SET
+#endif // __linux__
+
+#include <chrono>
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  helpers
+
+/// how often the workers check whether they should stop
+static constexpr std::chrono::milliseconds STOP_CHECK_INTERVAL( 50 );
+
+/// Binds the calling thread to the n-th of the CPU cores the process is allowed to run on.
+static void pinCurrentThread( size_t n ) noexcept
+{
+ #ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO( &allowed );
+	if (::sched_getaffinity( 0, sizeof(allowed), &allowed ) != 0)
+		return;
+	size_t allowedCount = size_t( CPU_COUNT( &allowed ) );
+	if (allowedCount == 0)
+		return;
+	n %= allowedCount;
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (CPU_ISSET( cpu, &allowed ) && n-- == 0)
+		{
+			cpu_set_t selected;
+			CPU_ZERO( &selected );
+			CPU_SET( cpu, &selected );
+			::pthread_setaffinity_np( ::pthread_self(), sizeof(selected), &selected );
+			return;
+		}
+	}
+ #else
+	(void)n;
+ #endif // __linux__
+}
+
+
+//======================================================================================================================
+//  ParallelUdpServer
+
+struct ParallelUdpServer::Worker
+{
+	UdpSocket socket;
+	std::thread thread;
+	std::atomic< uint64_t > datagrams { 0 };
+	std::atomic< uint64_t > bytes { 0 };
+	std::atomic< uint32_t > dropped { 0 };
+};
+
+ParallelUdpServer::ParallelUdpServer() noexcept
+:
+	_stopRequested( false ),
+	_lastSystemError( 0 )
+{}
+
+ParallelUdpServer::~ParallelUdpServer() noexcept
+{
+	stop();
+}
+
+SocketError ParallelUdpServer::start( uint16_t port, Handler handler, const Config & config )
+{
+	if (isRunning())
+	{
+		return SocketError::AlreadyConnected;
+	}
+	if (port == 0)
+	{
+		return SocketError::BindFailed;  // each socket would get a different random port
+	}
+
+	size_t workerCount = config.workerCount;
+	if (workerCount == 0)
+		workerCount = std::thread::hardware_concurrency();
+	if (workerCount == 0)
+		workerCount = 1;
+	size_t batchSize = config.batchSize > 0 ? config.batchSize : 1;
+
+	NativeEndpoint local( config.bindAddress, port );
+
+	// open all the sockets first, so that a failure doesn't leave some workers running
+	std::vector< std::unique_ptr< Worker > > workers;
+	workers.reserve( workerCount );
+	for (size_t i = 0; i < workerCount; ++i)
+	{
+		workers.push_back( std::unique_ptr< Worker >( new Worker ) );
+		UdpSocket & socket = workers.back()->socket;
+
+		SocketError error = socket.openLoadBalanced( local );
+		if (error == SocketError::Success && !socket.setTimeout( STOP_CHECK_INTERVAL ))
+			error = SocketError::Other;
+		if (error == SocketError::Success)
+			error = socket.setDropCounting( true );
+		if (error != SocketError::Success)
+		{
+			_lastSystemError = socket.getLastSystemError();
+			return error;
+		}
+	}
+
+	_handler = move( handler );
+	_stopRequested = false;
+	_workers = move( workers );
+	for (size_t i = 0; i < _workers.size(); ++i)
+	{
+		Worker & worker = *_workers[i];
+		bool pin = config.pinWorkers;
+		size_t maxDatagramSize = config.maxDatagramSize;
+		worker.thread = std::thread( [ this, &worker, i, pin, batchSize, maxDatagramSize ]()
+		{
+			if (pin)
+				pinCurrentThread( i );
+			_runWorker( worker, i, batchSize, maxDatagramSize );
+		});
+	}
+
+	return SocketError::Success;
+}
+
+void ParallelUdpServer::stop() noexcept
+{
+	_stopRequested = true;
+	for (auto & worker : _workers)
+		if (worker->thread.joinable())
+			worker->thread.join();
+	_workers.clear();
+	_handler = nullptr;
+}
+
+ParallelUdpServer::WorkerStats ParallelUdpServer::workerStats( size_t worker ) const noexcept
+{
+	if (worker >= _workers.size())
+	{
+		return { 0, 0, 0 };
+	}
+	const Worker & w = *_workers[ worker ];
+	return { w.datagrams.load( std::memory_order_relaxed ), w.bytes.load( std::memory_order_relaxed ),
+	         w.dropped.load( std::memory_order_relaxed ) };
+}
+
+void ParallelUdpServer::_runWorker( Worker & worker, size_t index, size_t batchSize, size_t maxDatagramSize )
+{
+	// one contiguous buffer for the whole batch, so that it's allocated only once
+	std::vector< uint8_t > buffer( batchSize * maxDatagramSize );
+	std::vector< UdpDatagram > datagrams( batchSize );
+
+	while (!_stopRequested.load( std::memory_order_relaxed ))
+	{
+		for (size_t i = 0; i < batchSize; ++i)
+			datagrams[i].buffer = make_span( buffer.data() + i * maxDatagramSize, maxDatagramSize );
+
+		size_t received = 0;
+		SocketError error = worker.socket.recvBatch( make_span( datagrams ), received );
+		if (error == SocketError::Timeout || error == SocketError::WouldBlock)
+		{
+			continue;
+		}
+		else if (error != SocketError::Success)
+		{
+			break;  // the socket is broken, nothing more will come
+		}
+
+		uint64_t bytes = 0;
+		for (size_t i = 0; i < received; ++i)
+			bytes += datagrams[i].size;
+		worker.datagrams.store( worker.datagrams.load( std::memory_order_relaxed ) + received, std::memory_order_relaxed );
+		worker.bytes.store( worker.bytes.load( std::memory_order_relaxed ) + bytes, std::memory_order_relaxed );
+		worker.dropped.store( worker.socket.droppedCount(), std::memory_order_relaxed );
+
+		if (_handler)
+			_handler( index, worker.socket, span< const UdpDatagram >( datagrams.data(), received ) );
+	}
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
@@ -0,0 +1,105 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: UDP server receiving on multiple threads, each with its own socket sharing the same port
+//======================================================================================================================
+
+#ifndef CPPUTILS_PARALLELUDPSERVER_INCLUDED
+#define CPPUTILS_PARALLELUDPSERVER_INCLUDED
+
+
+#include "Socket.hpp"
+
+#include <CppUtils-Essential/Span.hpp>
+
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+namespace own {
+
+
+//======================================================================================================================
+
+struct ParallelUdpServerConfig
+{
+	IPAddr bindAddress = IPAddr({ 0, 0, 0, 0 });  ///< address of one local interface, or 0.0.0.0 or :: for all of them
+	size_t workerCount = 0;         ///< 0 means one worker per CPU core
+	bool pinWorkers = true;         ///< bind each worker thread to its own CPU core
+	size_t batchSize = 32;          ///< max number of datagrams taken from the socket with one system call
+	size_t maxDatagramSize = 2048;  ///< longer datagrams are truncated
+};
+
+
+//======================================================================================================================
+/// UDP server that opens one load-balanced socket per worker thread (see UdpSocket::openLoadBalanced()).
+/** The system distributes the incoming datagrams between the sockets by the hash of the sender address, so each worker
+  * has its own receive queue and the workers don't compete for a single socket. Each worker receives in batches
+  * and passes them to the handler, which runs on the worker's thread and may reply using the socket it gets.
+  * Supported only on Linux, elsewhere start() returns SocketError::NotSupported. */
+
+class ParallelUdpServer
+{
+
+ public:
+
+	using Config = ParallelUdpServerConfig;
+
+	/// Called on the worker's thread for every received batch, the datagrams are valid only during the call.
+	using Handler = std::function< void ( size_t worker, UdpSocket & socket, span< const UdpDatagram > datagrams ) >;
+
+	struct WorkerStats
+	{
+		uint64_t datagrams;  ///< datagrams received by this worker
+		uint64_t bytes;      ///< their total size
+		uint32_t dropped;    ///< datagrams the system dropped, because the receive queue of this worker's socket was full
+	};
+
+	ParallelUdpServer() noexcept;
+	~ParallelUdpServer() noexcept;
+
+	ParallelUdpServer( const ParallelUdpServer & other ) = delete;
+	ParallelUdpServer & operator=( const ParallelUdpServer & other ) = delete;
+
+	/// Opens the sockets on the port of Config::bindAddress and starts the workers.
+	/** The port must be specified, because the sockets of all the workers must be bound to the same one. */
+	SocketError start( uint16_t port, Handler handler, const Config & config = Config() );
+
+	/// Stops the workers and closes the sockets. The workers notice the request within a few tens of milliseconds.
+	void stop() noexcept;
+
+	bool isRunning() const noexcept  { return !_workers.empty(); }
+
+	size_t workerCount() const noexcept  { return _workers.size(); }
+
+	/// Statistics of a worker, can be read while the server is running.
+	WorkerStats workerStats( size_t worker ) const noexcept;
+
+	/// Error of the last system call, when start() fails.
+	system_error_t getLastSystemError() const noexcept  { return _lastSystemError; }
+
+ private:
+
+	struct Worker;
+
+	void _runWorker( Worker & worker, size_t index, size_t batchSize, size_t maxDatagramSize );
+
+	Handler _handler;
+	std::vector< std::unique_ptr< Worker > > _workers;
+	std::atomic< bool > _stopRequested;
+	system_error_t _lastSystemError;
+
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_PARALLELUDPSERVER_INCLUDED
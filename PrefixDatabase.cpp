@@ -0,0 +1,582 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: prefix table stored in a file that is memory-mapped and queried in place
+//======================================================================================================================
+
+#include "PrefixDatabase.hpp"
+
+#include <CppUtils-Essential/CriticalError.hpp>
+
+#ifdef _WIN32
+	#include <windows.h>       // CreateFile, CreateFileMapping, MapViewOfFile
+	#include <atomic>
+#else
+	#include <unistd.h>        // close, write, fsync
+	#include <fcntl.h>         // open, fcntl
+	#include <stdlib.h>        // mkstemp
+	#include <sys/stat.h>      // fstat, fchmod
+	#include <sys/mman.h>      // mmap, munmap
+	#include <cstdio>          // rename
+#endif // _WIN32
+
+#include <cstring>  // memcmp, memset
+#include <cerrno>
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  error strings
+
+const char * enumString( PrefixDbError error ) noexcept
+{
+	switch (error)
+	{
+		case PrefixDbError::Success:            return "Success";
+		case PrefixDbError::NotOpen:            return "NotOpen";
+		case PrefixDbError::CannotOpenFile:     return "CannotOpenFile";
+		case PrefixDbError::CannotMapFile:      return "CannotMapFile";
+		case PrefixDbError::CannotWriteFile:    return "CannotWriteFile";
+		case PrefixDbError::InvalidFormat:      return "InvalidFormat";
+		case PrefixDbError::UnsupportedVersion: return "UnsupportedVersion";
+		case PrefixDbError::ValueTypeMismatch:  return "ValueTypeMismatch";
+		default:                                return "Other";
+	}
+}
+
+
+namespace priv {
+
+
+//======================================================================================================================
+//  file system helpers
+
+/// Maps the whole file read-only, returns nullptr on failure. The mapping stays valid after the file is closed.
+static const uint8_t * mapFile( const std::string & filePath, size_t & size, PrefixDbError & error, system_error_t & lastSystemError ) noexcept
+{
+ #ifdef _WIN32
+	HANDLE file = CreateFileA( filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		lastSystemError = getLastError();
+		error = PrefixDbError::CannotOpenFile;
+		return nullptr;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx( file, &fileSize ))
+	{
+		lastSystemError = getLastError();
+		CloseHandle( file );
+		error = PrefixDbError::CannotOpenFile;
+		return nullptr;
+	}
+	if (uint64_t( fileSize.QuadPart ) < sizeof(PrefixDbHeader) || uint64_t( fileSize.QuadPart ) > SIZE_MAX)
+	{
+		CloseHandle( file );
+		error = PrefixDbError::InvalidFormat;
+		return nullptr;
+	}
+	HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	lastSystemError = getLastError();
+	CloseHandle( file );
+	if (!mapping)
+	{
+		error = PrefixDbError::CannotMapFile;
+		return nullptr;
+	}
+	void * data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	lastSystemError = getLastError();
+	CloseHandle( mapping );  // the view keeps the mapping alive
+	if (!data)
+	{
+		error = PrefixDbError::CannotMapFile;
+		return nullptr;
+	}
+	size = size_t( fileSize.QuadPart );
+	return static_cast< const uint8_t * >( data );
+ #else
+	int fd = ::open( filePath.c_str(), O_RDONLY | O_CLOEXEC );
+	if (fd < 0)
+	{
+		lastSystemError = getLastError();
+		error = PrefixDbError::CannotOpenFile;
+		return nullptr;
+	}
+	struct stat fileInfo;
+	if (fstat( fd, &fileInfo ) != 0)
+	{
+		lastSystemError = getLastError();
+		::close( fd );
+		error = PrefixDbError::CannotOpenFile;
+		return nullptr;
+	}
+	if (uint64_t( fileInfo.st_size ) < sizeof(PrefixDbHeader))
+	{
+		::close( fd );
+		error = PrefixDbError::InvalidFormat;
+		return nullptr;
+	}
+	void * data = mmap( nullptr, size_t( fileInfo.st_size ), PROT_READ, MAP_SHARED, fd, 0 );
+	lastSystemError = getLastError();
+	::close( fd );  // the mapping keeps the file referenced
+	if (data == MAP_FAILED)
+	{
+		error = PrefixDbError::CannotMapFile;
+		return nullptr;
+	}
+	size = size_t( fileInfo.st_size );
+	return static_cast< const uint8_t * >( data );
+ #endif // _WIN32
+}
+
+static void unmapFile( const uint8_t * data, size_t size ) noexcept
+{
+ #ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile( data );
+ #else
+	munmap( const_cast< uint8_t * >( data ), size );
+ #endif // _WIN32
+}
+
+/// Writes a file sequentially, while keeping track of the current offset.
+class FileWriter
+{
+ public:
+
+	FileWriter() noexcept : _offset( 0 ), _lastSystemError( 0 )
+	{
+	 #ifdef _WIN32
+		_file = INVALID_HANDLE_VALUE;
+	 #else
+		_fd = -1;
+	 #endif
+	}
+
+	~FileWriter() noexcept
+	{
+		close();
+	}
+
+	/// creates a new file under a unique name next to the target, so that concurrent writers of the same target
+	/// don't write into each other's file
+	bool openTemporary( const std::string & targetPath, std::string & tempPath ) noexcept
+	{
+	 #ifdef _WIN32
+		static std::atomic< unsigned > counter( 0 );
+		do
+		{
+			tempPath = targetPath + "." + std::to_string( GetCurrentProcessId() ) + "-" + std::to_string( counter++ ) + ".tmp";
+			_file = CreateFileA( tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr );
+		}
+		while (_file == INVALID_HANDLE_VALUE && GetLastError() == ERROR_FILE_EXISTS);
+		if (_file == INVALID_HANDLE_VALUE)
+	 #else
+		tempPath = targetPath + ".XXXXXX";
+		_fd = ::mkstemp( &tempPath[0] );
+		if (_fd >= 0)
+		{
+			::fcntl( _fd, F_SETFD, FD_CLOEXEC );
+			::fchmod( _fd, 0644 );  // mkstemp creates it readable only by the owner, unlike the file it replaces
+		}
+		if (_fd < 0)
+	 #endif
+		{
+			_lastSystemError = getLastError();
+			return false;
+		}
+		return true;
+	}
+
+	bool write( const void * data, size_t size ) noexcept
+	{
+		const uint8_t * pos = static_cast< const uint8_t * >( data );
+		while (size > 0)
+		{
+		 #ifdef _WIN32
+			DWORD written;
+			if (!WriteFile( _file, pos, DWORD( (std::min)( size, size_t( 1 << 30 ) ) ), &written, nullptr ))
+		 #else
+			ssize_t written = ::write( _fd, pos, size );
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written <= 0)
+		 #endif
+			{
+				_lastSystemError = getLastError();
+				return false;
+			}
+			pos += written;
+			size -= size_t( written );
+			_offset += uint64_t( written );
+		}
+		return true;
+	}
+
+	/// writes zeros until the offset is a multiple of the alignment
+	bool pad( uint64_t alignment ) noexcept
+	{
+		static const uint8_t zeros [PrefixDbHeader::SECTION_ALIGNMENT] = {};
+		size_t padding = size_t( (alignment - _offset % alignment) % alignment );
+		return write( zeros, padding );
+	}
+
+	/// makes sure the content is on the disk before the file replaces the previous version
+	bool flush() noexcept
+	{
+	 #ifdef _WIN32
+		if (!FlushFileBuffers( _file ))
+	 #else
+		if (fsync( _fd ) != 0)
+	 #endif
+		{
+			_lastSystemError = getLastError();
+			return false;
+		}
+		return true;
+	}
+
+	void close() noexcept
+	{
+	 #ifdef _WIN32
+		if (_file != INVALID_HANDLE_VALUE)
+			CloseHandle( _file );
+		_file = INVALID_HANDLE_VALUE;
+	 #else
+		if (_fd >= 0)
+			::close( _fd );
+		_fd = -1;
+	 #endif
+	}
+
+	uint64_t offset() const noexcept  { return _offset; }
+	system_error_t getLastSystemError() const noexcept  { return _lastSystemError; }
+
+ private:
+
+ #ifdef _WIN32
+	HANDLE _file;
+ #else
+	int _fd;
+ #endif
+	uint64_t _offset;
+	system_error_t _lastSystemError;
+};
+
+static bool replaceFile( const std::string & srcPath, const std::string & dstPath ) noexcept
+{
+ #ifdef _WIN32
+	return MoveFileExA( srcPath.c_str(), dstPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != 0;
+ #else
+	return std::rename( srcPath.c_str(), dstPath.c_str() ) == 0;
+ #endif // _WIN32
+}
+
+static void removeFile( const std::string & filePath ) noexcept
+{
+ #ifdef _WIN32
+	DeleteFileA( filePath.c_str() );
+ #else
+	unlink( filePath.c_str() );
+ #endif // _WIN32
+}
+
+
+//======================================================================================================================
+//  validation
+
+static uint64_t alignUp( uint64_t offset ) noexcept
+{
+	constexpr uint64_t ALIGNMENT = PrefixDbHeader::SECTION_ALIGNMENT;
+	return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+/// whether an array of the given number of elements fits within the file at the given offset, after the header
+static bool isSectionValid( uint64_t offset, uint64_t count, uint64_t elemSize, uint64_t headerSize, uint64_t fileSize ) noexcept
+{
+	return offset % PrefixDbHeader::SECTION_ALIGNMENT == 0
+	    && offset >= headerSize
+	    && offset <= fileSize
+	    && count <= (fileSize - offset) / elemSize;
+}
+
+static bool isTrieValid( const PrefixDbTrie & trie, const PrefixDbHeader & header ) noexcept
+{
+	if (trie.directOffset == 0)
+		return trie.nodeCount == 0 && trie.leafCount == 0;
+	return isSectionValid( trie.directOffset, Poptrie::DIRECT_SIZE, sizeof(uint32_t), header.headerSize, header.fileSize )
+	    && isSectionValid( trie.nodesOffset, trie.nodeCount, sizeof(Poptrie::Node), header.headerSize, header.fileSize )
+	    && isSectionValid( trie.leavesOffset, trie.leafCount, sizeof(uint32_t), header.headerSize, header.fileSize )
+	    && trie.nodeCount < Poptrie::DIRECT_LEAF_FLAG;
+}
+
+static PrefixDbError checkHeader( const PrefixDbHeader & header, uint64_t fileSize, uint32_t valueSize ) noexcept
+{
+	if (memcmp( header.magic, PrefixDbHeader::MAGIC, sizeof(header.magic) ) != 0)
+		return PrefixDbError::InvalidFormat;
+	if (header.byteOrderMark != PrefixDbHeader::BYTE_ORDER_MARK)
+		return PrefixDbError::UnsupportedVersion;  // written on a machine with a different byte order
+	if (header.majorVersion != PrefixDbHeader::MAJOR_VERSION)
+		return PrefixDbError::UnsupportedVersion;
+	if (header.directBits != Poptrie::DIRECT_BITS || header.stride != Poptrie::STRIDE)
+		return PrefixDbError::UnsupportedVersion;
+	if (header.headerSize < sizeof(PrefixDbHeader) || header.fileSize != fileSize)
+		return PrefixDbError::InvalidFormat;
+	if (header.valueSize != valueSize)
+		return PrefixDbError::ValueTypeMismatch;
+	if (!isSectionValid( header.valuesOffset, header.valueCount, valueSize, header.headerSize, fileSize )
+	 || header.valueCount >= Poptrie::DIRECT_LEAF_FLAG)
+		return PrefixDbError::InvalidFormat;
+	if (!isTrieValid( header.v4, header ) || !isTrieValid( header.v6, header ))
+		return PrefixDbError::InvalidFormat;
+	return PrefixDbError::Success;
+}
+
+/// Checks every index stored in the trie, so that no lookup can get outside of the arrays or loop forever.
+static bool verifyTrie( const Poptrie::View & trie, const PrefixDbTrie & info, uint64_t valueCount, uint32_t keyBits )
+{
+	if (!trie.direct)
+		return true;
+
+	for (uint64_t i = 0; i < info.leafCount; ++i)
+		if (trie.leaves[i] > valueCount)
+			return false;
+
+	// Children are always stored after their parent, so the level of each node is known before it's checked.
+	constexpr uint8_t UNREACHABLE = 0xFF;
+	std::vector< uint8_t > levels( size_t( info.nodeCount ), UNREACHABLE );
+	for (uint32_t i = 0; i < Poptrie::DIRECT_SIZE; ++i)
+	{
+		uint32_t directEntry = trie.direct[i];
+		if (directEntry & Poptrie::DIRECT_LEAF_FLAG)
+		{
+			if ((directEntry & ~Poptrie::DIRECT_LEAF_FLAG) > valueCount)
+				return false;
+		}
+		else
+		{
+			if (directEntry >= info.nodeCount || levels[ directEntry ] != UNREACHABLE)
+				return false;
+			levels[ directEntry ] = 0;
+		}
+	}
+
+	for (uint64_t i = 0; i < info.nodeCount; ++i)
+	{
+		if (levels[i] == UNREACHABLE)
+			continue;
+		const Poptrie::Node & node = trie.nodes[i];
+		uint32_t offset = Poptrie::DIRECT_BITS + levels[i] * Poptrie::STRIDE;
+
+		// every leaf position must be preceded by the start of a run, otherwise the leaf index would underflow
+		uint64_t leafPositions = ~node.vector;
+		if (leafPositions != 0 && !(node.leafvec & leafPositions & (~leafPositions + 1)))
+			return false;
+		if (uint64_t( node.base0 ) + popCount64( node.leafvec ) > info.leafCount)
+			return false;
+
+		if (node.vector != 0)
+		{
+			if (offset + Poptrie::STRIDE >= keyBits || node.base1 <= i || uint64_t( node.base1 ) + popCount64( node.vector ) > info.nodeCount)
+				return false;
+			for (uint32_t child = node.base1; child < node.base1 + popCount64( node.vector ); ++child)
+			{
+				if (levels[ child ] != UNREACHABLE)
+					return false;
+				levels[ child ] = uint8_t( levels[i] + 1 );
+			}
+		}
+	}
+
+	return true;
+}
+
+
+//======================================================================================================================
+//  MappedPrefixDb
+
+MappedPrefixDb::MappedPrefixDb() noexcept
+:
+	_data( nullptr ),
+	_size( 0 ),
+	_v4{ nullptr, nullptr, nullptr },
+	_v6{ nullptr, nullptr, nullptr },
+	_values( nullptr ),
+	_valueCount( 0 ),
+	_lastSystemError( 0 )
+{}
+
+MappedPrefixDb::~MappedPrefixDb() noexcept
+{
+	close();
+}
+
+MappedPrefixDb::MappedPrefixDb( MappedPrefixDb && other ) noexcept
+:
+	MappedPrefixDb()
+{
+	*this = move( other );
+}
+
+MappedPrefixDb & MappedPrefixDb::operator=( MappedPrefixDb && other ) noexcept
+{
+	close();
+	_data = other._data;
+	_size = other._size;
+	_v4 = other._v4;
+	_v6 = other._v6;
+	_values = other._values;
+	_valueCount = other._valueCount;
+	_lastSystemError = other._lastSystemError;
+
+	other._data = nullptr;
+	other.close();
+	return *this;
+}
+
+PrefixDbError MappedPrefixDb::open( const std::string & filePath, uint32_t valueSize ) noexcept
+{
+	close();
+
+	PrefixDbError error = PrefixDbError::Success;
+	size_t size = 0;
+	const uint8_t * data = mapFile( filePath, size, error, _lastSystemError );
+	if (!data)
+		return error;
+
+	const PrefixDbHeader & header = *reinterpret_cast< const PrefixDbHeader * >( data );
+	error = checkHeader( header, size, valueSize );
+	if (error != PrefixDbError::Success)
+	{
+		unmapFile( data, size );
+		return error;
+	}
+
+	auto trieView = [ data ]( const PrefixDbTrie & trie ) -> Poptrie::View
+	{
+		if (trie.directOffset == 0)
+			return { nullptr, nullptr, nullptr };
+		return {
+			reinterpret_cast< const uint32_t * >( data + trie.directOffset ),
+			reinterpret_cast< const Poptrie::Node * >( data + trie.nodesOffset ),
+			reinterpret_cast< const uint32_t * >( data + trie.leavesOffset )
+		};
+	};
+
+	_data = data;
+	_size = size;
+	_v4 = trieView( header.v4 );
+	_v6 = trieView( header.v6 );
+	_values = data + header.valuesOffset;
+	_valueCount = header.valueCount;
+	return PrefixDbError::Success;
+}
+
+void MappedPrefixDb::close() noexcept
+{
+	if (_data)
+		unmapFile( _data, _size );
+	_data = nullptr;
+	_size = 0;
+	_v4 = { nullptr, nullptr, nullptr };
+	_v6 = { nullptr, nullptr, nullptr };
+	_values = nullptr;
+	_valueCount = 0;
+}
+
+PrefixDbError MappedPrefixDb::verify() const noexcept
+{
+	if (!_data)
+		return PrefixDbError::NotOpen;
+
+	const PrefixDbHeader & header = *reinterpret_cast< const PrefixDbHeader * >( _data );
+	if (!verifyTrie( _v4, header.v4, _valueCount, 32 ) || !verifyTrie( _v6, header.v6, _valueCount, 128 ))
+		return PrefixDbError::InvalidFormat;
+	return PrefixDbError::Success;
+}
+
+PrefixDbError MappedPrefixDb::write(
+	const std::string & filePath, const Poptrie & v4, const Poptrie & v6,
+	const void * values, uint64_t valueCount, uint32_t valueSize
+) noexcept
+{
+	// first lay out the sections, so that the header can be written at the beginning
+	PrefixDbHeader header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, PrefixDbHeader::MAGIC, sizeof(header.magic) );
+	header.majorVersion = PrefixDbHeader::MAJOR_VERSION;
+	header.minorVersion = PrefixDbHeader::MINOR_VERSION;
+	header.headerSize = sizeof(PrefixDbHeader);
+	header.byteOrderMark = PrefixDbHeader::BYTE_ORDER_MARK;
+	header.directBits = Poptrie::DIRECT_BITS;
+	header.stride = Poptrie::STRIDE;
+	header.valueSize = valueSize;
+
+	uint64_t offset = alignUp( sizeof(PrefixDbHeader) );
+	auto layoutTrie = [ &offset ]( const Poptrie & trie, PrefixDbTrie & info )
+	{
+		if (trie.direct().empty())
+			return;
+		info.directOffset = offset;
+		offset = alignUp( offset + trie.direct().size() * sizeof(uint32_t) );
+		info.nodesOffset = offset;
+		info.nodeCount = trie.nodes().size();
+		offset = alignUp( offset + trie.nodes().size() * sizeof(Poptrie::Node) );
+		info.leavesOffset = offset;
+		info.leafCount = trie.leaves().size();
+		offset = alignUp( offset + trie.leaves().size() * sizeof(uint32_t) );
+	};
+	layoutTrie( v4, header.v4 );
+	layoutTrie( v6, header.v6 );
+	header.valuesOffset = offset;
+	header.valueCount = valueCount;
+	header.fileSize = offset + valueCount * valueSize;
+
+	// write it under a temporary name and replace the old file only when it's complete
+	std::string tempPath;
+	FileWriter file;
+	if (!file.openTemporary( filePath, tempPath ))
+	{
+		_lastSystemError = file.getLastSystemError();
+		return PrefixDbError::CannotWriteFile;
+	}
+
+	auto writeTrie = [ &file ]( const Poptrie & trie )
+	{
+		if (trie.direct().empty())
+			return true;
+		return file.pad( PrefixDbHeader::SECTION_ALIGNMENT ) && file.write( trie.direct().data(), trie.direct().size() * sizeof(uint32_t) )
+		    && file.pad( PrefixDbHeader::SECTION_ALIGNMENT ) && file.write( trie.nodes().data(), trie.nodes().size() * sizeof(Poptrie::Node) )
+		    && file.pad( PrefixDbHeader::SECTION_ALIGNMENT ) && file.write( trie.leaves().data(), trie.leaves().size() * sizeof(uint32_t) );
+	};
+	bool written = file.write( &header, sizeof(header) )
+	            && writeTrie( v4 )
+	            && writeTrie( v6 )
+	            && file.pad( PrefixDbHeader::SECTION_ALIGNMENT )
+	            && file.write( values, size_t( valueCount * valueSize ) )
+	            && file.flush();
+	if (written && file.offset() != header.fileSize)
+		critical_error( "Size of the written prefix database (%llu) differs from the planned one (%llu).",
+		                (unsigned long long)file.offset(), (unsigned long long)header.fileSize );
+	file.close();
+
+	if (!written || !replaceFile( tempPath, filePath ))
+	{
+		_lastSystemError = written ? getLastError() : file.getLastSystemError();
+		removeFile( tempPath );
+		return PrefixDbError::CannotWriteFile;
+	}
+	return PrefixDbError::Success;
+}
+
+
+} // namespace priv
+
+
+//======================================================================================================================
+
+
+} // namespace own
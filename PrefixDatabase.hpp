@@ -0,0 +1,235 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: prefix table stored in a file that is memory-mapped and queried in place
+//======================================================================================================================
+
+#ifndef CPPUTILS_PREFIXDATABASE_INCLUDED
+#define CPPUTILS_PREFIXDATABASE_INCLUDED
+
+
+#include "PrefixTable.hpp"
+#include "SystemErrorInfo.hpp"
+
+#include <string>
+#include <type_traits>
+
+
+namespace own {
+
+
+//======================================================================================================================
+
+enum class PrefixDbError
+{
+	Success = 0,              ///< The operation was successful.
+	NotOpen = 1,              ///< Operation failed because the database has not been opened. Call open() first.
+	// errors of the file system
+	CannotOpenFile = 10,      ///< The file does not exist or it cannot be accessed. Call getLastSystemError() for more info.
+	CannotMapFile = 11,       ///< The file could not be mapped into memory. Call getLastSystemError() for more info.
+	CannotWriteFile = 12,     ///< The file could not be created or written. Call getLastSystemError() for more info.
+	// errors of the file content
+	InvalidFormat = 20,       ///< The file is not a prefix database, or it is truncated or corrupted.
+	UnsupportedVersion = 21,  ///< The file was written in an incompatible version of the format.
+	ValueTypeMismatch = 22,   ///< The values stored in the file have a different size than the requested value type.
+};
+const char * enumString( PrefixDbError error ) noexcept;
+
+
+//======================================================================================================================
+/// private implementation details
+
+namespace priv {
+
+	/// position of the arrays of one trie within the file, all offsets are from the beginning of the file
+	struct PrefixDbTrie
+	{
+		uint64_t directOffset;  ///< 0 when the trie is empty
+		uint64_t nodesOffset;
+		uint64_t nodeCount;
+		uint64_t leavesOffset;
+		uint64_t leafCount;
+	};
+
+	/// Header at the beginning of the file.
+	/** The arrays that follow are stored exactly as they are in memory, each aligned to SECTION_ALIGNMENT.
+	  * The numbers are in the byte order of the machine that wrote the file, the reader rejects a different one.
+	  * New fields can only be appended in a new minor version, a reader accepts any minor version of its major version. */
+	struct PrefixDbHeader
+	{
+		char magic [8];
+		uint16_t majorVersion;
+		uint16_t minorVersion;
+		uint32_t headerSize;     ///< size of the header written by the writer, it may be bigger than this struct
+		uint32_t byteOrderMark;  ///< BYTE_ORDER_MARK in the native byte order of the writer
+		uint32_t directBits;     ///< the parameters of the trie, they must match the reader's ones
+		uint32_t stride;
+		uint32_t valueSize;
+		uint64_t fileSize;
+		uint64_t valuesOffset;
+		uint64_t valueCount;
+		PrefixDbTrie v4;
+		PrefixDbTrie v6;
+
+		static constexpr char MAGIC [8] = { 'C', 'P', 'U', 'P', 'F', 'X', 'D', 'B' };
+		static constexpr uint16_t MAJOR_VERSION = 1;
+		static constexpr uint16_t MINOR_VERSION = 0;
+		static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+		static constexpr uint64_t SECTION_ALIGNMENT = 64;
+	};
+
+	/// The part of PrefixDatabase that doesn't depend on the value type.
+	class MappedPrefixDb
+	{
+	 public:
+
+		MappedPrefixDb() noexcept;
+		~MappedPrefixDb() noexcept;
+
+		MappedPrefixDb( const MappedPrefixDb & other ) = delete;
+		MappedPrefixDb( MappedPrefixDb && other ) noexcept;
+		MappedPrefixDb & operator=( const MappedPrefixDb & other ) = delete;
+		MappedPrefixDb & operator=( MappedPrefixDb && other ) noexcept;
+
+		PrefixDbError open( const std::string & filePath, uint32_t valueSize ) noexcept;
+		void close() noexcept;
+		bool isOpen() const noexcept  { return _data != nullptr; }
+
+		PrefixDbError verify() const noexcept;
+
+		PrefixDbError write(
+			const std::string & filePath, const Poptrie & v4, const Poptrie & v6,
+			const void * values, uint64_t valueCount, uint32_t valueSize
+		) noexcept;
+
+		system_error_t getLastSystemError() const noexcept  { return _lastSystemError; }
+
+		const Poptrie::View & v4Trie() const noexcept  { return _v4; }
+		const Poptrie::View & v6Trie() const noexcept  { return _v6; }
+		const uint8_t * values() const noexcept  { return _values; }
+		uint64_t valueCount() const noexcept  { return _valueCount; }
+
+	 private:
+
+		const uint8_t * _data;
+		size_t _size;
+		Poptrie::View _v4;
+		Poptrie::View _v6;
+		const uint8_t * _values;
+		uint64_t _valueCount;
+		system_error_t _lastSystemError;
+	};
+
+} // namespace priv
+
+
+//======================================================================================================================
+/// Read-only prefix table stored in a file, which is mapped into memory and queried in place.
+/** Opening the database only validates the header, so it takes the same short time regardless of the number of prefixes,
+  * and the pages of the file are loaded by the system on demand and shared between all processes that map the file.
+  * The values are stored as raw bytes, so they must be trivially copyable and must not contain pointers.
+  * The file is portable only between machines with the same byte order. */
+
+template< typename Value >
+class PrefixDatabase
+{
+	static_assert( std::is_trivially_copyable< Value >::value, "values of PrefixDatabase are stored in the file as raw bytes" );
+	static_assert( alignof( Value ) <= priv::PrefixDbHeader::SECTION_ALIGNMENT, "the values section of the file is not aligned enough" );
+
+ public:
+
+	PrefixDatabase() noexcept = default;
+	~PrefixDatabase() noexcept = default;
+
+	PrefixDatabase( const PrefixDatabase & other ) = delete;
+	PrefixDatabase( PrefixDatabase && other ) noexcept = default;
+	PrefixDatabase & operator=( const PrefixDatabase & other ) = delete;
+	PrefixDatabase & operator=( PrefixDatabase && other ) noexcept = default;
+
+	/// Maps an existing database file into memory.
+	/** Only the header is checked, the arrays are trusted to be consistent. Call verify() when the file comes from an untrusted source. */
+	PrefixDbError open( const std::string & filePath ) noexcept
+	{
+		return _db.open( filePath, sizeof( Value ) );
+	}
+
+	/// Writes the table into a file and opens it.
+	/** The file is written under a temporary name and then renamed, so processes that have the previous version
+	  * of the file open keep using it undisturbed. */
+	PrefixDbError create( const std::string & filePath, const PrefixTable< Value > & table ) noexcept
+	{
+		PrefixDbError error = _db.write( filePath, table._v4, table._v6, table._values.data(), table._values.size(), sizeof( Value ) );
+		if (error != PrefixDbError::Success)
+			return error;
+		return open( filePath );
+	}
+
+	void close() noexcept  { _db.close(); }
+
+	bool isOpen() const noexcept  { return _db.isOpen(); }
+
+	/// Checks that all the indexes in the file point within the arrays, so that lookups can't read outside of the file.
+	/** This reads the whole file, so it takes time proportional to its size. */
+	PrefixDbError verify() const noexcept  { return _db.verify(); }
+
+	/// Returns the system error code that was recorded the last time an operation on this database failed.
+	system_error_t getLastSystemError() const noexcept  { return _db.getLastSystemError(); }
+
+	/// number of distinct prefixes
+	size_t size() const noexcept  { return size_t( _db.valueCount() ); }
+
+	/// Returns the value of the longest prefix containing the address, or nullptr if there is no such prefix or the database is not open.
+	/** The returned pointer points into the mapped file, it's valid until the database is closed. */
+	const Value * lookup( const IPv4Addr & addr ) const noexcept
+	{
+		return _valueOf( priv::Poptrie::lookup( _db.v4Trie(), priv::toPoptrieKey( addr ) ) );
+	}
+	const Value * lookup( const IPv6Addr & addr ) const noexcept
+	{
+		return _valueOf( priv::Poptrie::lookup( _db.v6Trie(), priv::toPoptrieKey( addr ) ) );
+	}
+	const Value * lookup( const IPAddr & addr ) const noexcept
+	{
+		if (addr.version() == IPVer::_4)
+			return _valueOf( priv::Poptrie::lookup( _db.v4Trie(), priv::toPoptrieKey( addr ) ) );
+		else if (addr.version() == IPVer::_6)
+			return _valueOf( priv::Poptrie::lookup( _db.v6Trie(), priv::toPoptrieKey( addr ) ) );
+		else
+			return nullptr;
+	}
+
+	/// Looks up many addresses at once, the value for addrs[i] is stored to values[i]. See PrefixTable::lookup().
+	void lookup( span< const IPAddr > addrs, span< const Value * > values ) const noexcept
+	{
+		if (values.size() < addrs.size())
+			critical_error( "The output span for batch lookup is smaller than the input (%zu < %zu).", values.size(), addrs.size() );
+
+		uint32_t leaves [priv::Poptrie::BATCH_SIZE];
+		for (size_t begin = 0; begin < addrs.size(); begin += priv::Poptrie::BATCH_SIZE)
+		{
+			size_t count = std::min( priv::Poptrie::BATCH_SIZE, addrs.size() - begin );
+			priv::lookupAddrBatch( _db.v4Trie(), _db.v6Trie(), addrs.data() + begin, leaves, count );
+			for (size_t i = 0; i < count; ++i)
+				values[ begin + i ] = _valueOf( leaves[i] );
+		}
+	}
+
+ private:
+
+	const Value * _valueOf( uint32_t leaf ) const noexcept
+	{
+		return leaf != 0 ? reinterpret_cast< const Value * >( _db.values() ) + (leaf - 1) : nullptr;
+	}
+
+	priv::MappedPrefixDb _db;
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_PREFIXDATABASE_INCLUDED
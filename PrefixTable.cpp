@@ -0,0 +1,271 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: longest-prefix-match table mapping IP prefixes to values
+//======================================================================================================================
+
+#include "PrefixTable.hpp"
+
+#include <thread>
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  Poptrie
+
+namespace priv {
+
+
+static bool keyLess( const Poptrie::Entry & e1, const Poptrie::Entry & e2 ) noexcept
+{
+	if (e1.key.hi != e2.key.hi)
+		return e1.key.hi < e2.key.hi;
+	if (e1.key.lo != e2.key.lo)
+		return e1.key.lo < e2.key.lo;
+	return e1.length < e2.length;
+}
+
+/// Sets the leaf for all slots covered by the prefix that ends within the stride at the given offset.
+static void expandPrefix( uint32_t * slots, uint32_t slotBits, uint32_t slotIdx, uint32_t bitsInStride, uint32_t leaf ) noexcept
+{
+	uint32_t span = 1u << (slotBits - bitsInStride);
+	uint32_t first = slotIdx & ~(span - 1);
+	for (uint32_t i = first; i < first + span; ++i)
+		slots[i] = leaf;
+}
+
+void Poptrie::build( std::vector< Entry > & entries )
+{
+	std::sort( entries.begin(), entries.end(), keyLess );
+
+	_direct.clear();
+	_nodes.clear();
+	_leaves.clear();
+
+	// The prefixes that end within the direct table are expanded from the shortest, so that the longer ones win.
+	std::vector< uint32_t > directLeaves( DIRECT_SIZE, 0 );
+	std::vector< const Entry * > shortEntries;
+	for (const Entry & entry : entries)
+		if (entry.length <= DIRECT_BITS)
+			shortEntries.push_back( &entry );
+	std::stable_sort( shortEntries.begin(), shortEntries.end(), []( const Entry * e1, const Entry * e2 ) { return e1->length < e2->length; } );
+	for (const Entry * entry : shortEntries)
+	{
+		uint32_t slotIdx = uint32_t( entry->key.hi >> (64 - DIRECT_BITS) );
+		expandPrefix( directLeaves.data(), DIRECT_BITS, slotIdx, entry->length, entry->leaf );
+	}
+
+	_direct.resize( DIRECT_SIZE );
+	for (uint32_t slotIdx = 0; slotIdx < DIRECT_SIZE; ++slotIdx)
+		_direct[ slotIdx ] = directLeaves[ slotIdx ] | DIRECT_LEAF_FLAG;
+
+	// The longer prefixes with the same top bits are adjacent after sorting, each such group becomes a subtree.
+	const Entry * pos = entries.data();
+	const Entry * end = entries.data() + entries.size();
+	while (pos != end)
+	{
+		uint32_t slotIdx = uint32_t( pos->key.hi >> (64 - DIRECT_BITS) );
+		const Entry * groupEnd = pos;
+		bool hasLong = false;
+		while (groupEnd != end && uint32_t( groupEnd->key.hi >> (64 - DIRECT_BITS) ) == slotIdx)
+		{
+			hasLong |= groupEnd->length > DIRECT_BITS;
+			++groupEnd;
+		}
+		if (hasLong)
+		{
+			uint32_t nodeIdx = uint32_t( _nodes.size() );
+			_nodes.emplace_back();
+			_buildNode( nodeIdx, pos, groupEnd, DIRECT_BITS, directLeaves[ slotIdx ] );
+			_direct[ slotIdx ] = nodeIdx;
+		}
+		pos = groupEnd;
+	}
+
+	if (_nodes.size() >= DIRECT_LEAF_FLAG || _leaves.size() >= UINT32_MAX)
+		critical_error( "Too many prefixes for a Poptrie." );
+
+	_nodes.shrink_to_fit();
+	_leaves.shrink_to_fit();
+}
+
+/// The entries must all lie within the key range of the node and prefixes not longer than the offset are ignored,
+/// because they are already accounted for in the inherited leaf.
+void Poptrie::_buildNode( uint32_t nodeIdx, const Entry * begin, const Entry * end, uint32_t offset, uint32_t inheritedLeaf )
+{
+	constexpr uint32_t SLOT_COUNT = 1u << STRIDE;
+
+	uint32_t slotLeaves [SLOT_COUNT];
+	for (uint32_t & leaf : slotLeaves)
+		leaf = inheritedLeaf;
+
+	// prefixes ending within this stride, expanded from the shortest
+	for (uint32_t bits = 1; bits <= STRIDE; ++bits)
+		for (const Entry * entry = begin; entry != end; ++entry)
+			if (entry->length == offset + bits)
+				expandPrefix( slotLeaves, STRIDE, chunkAt( entry->key, offset ), bits, entry->leaf );
+
+	// prefixes continuing below this stride make the slot an internal node
+	uint64_t vector = 0;
+	const Entry * childBegin [SLOT_COUNT];
+	const Entry * childEnd [SLOT_COUNT];
+	for (const Entry * entry = begin; entry != end; ++entry)
+	{
+		uint32_t slotIdx = chunkAt( entry->key, offset );
+		if (entry->length > offset + STRIDE)
+		{
+			if (!(vector & (uint64_t(1) << slotIdx)))
+				childBegin[ slotIdx ] = entry;
+			childEnd[ slotIdx ] = entry + 1;
+			vector |= uint64_t(1) << slotIdx;
+		}
+	}
+
+	// the remaining slots are leaves, only the first of each run of equal leaves is stored
+	uint64_t leafvec = 0;
+	uint32_t base0 = uint32_t( _leaves.size() );
+	bool first = true;
+	for (uint32_t slotIdx = 0; slotIdx < SLOT_COUNT; ++slotIdx)
+	{
+		if (vector & (uint64_t(1) << slotIdx))
+			continue;
+		if (first || slotLeaves[ slotIdx ] != _leaves.back())
+		{
+			leafvec |= uint64_t(1) << slotIdx;
+			_leaves.push_back( slotLeaves[ slotIdx ] );
+			first = false;
+		}
+	}
+
+	// the internal children must be stored next to each other
+	uint32_t base1 = uint32_t( _nodes.size() );
+	_nodes.resize( _nodes.size() + popCount64( vector ) );
+	_nodes[ nodeIdx ] = { vector, leafvec, base0, base1 };
+
+	uint32_t childIdx = base1;
+	for (uint32_t slotIdx = 0; slotIdx < SLOT_COUNT; ++slotIdx)
+	{
+		if (vector & (uint64_t(1) << slotIdx))
+		{
+			// the entries between the first and the last long prefix of the slot all belong to the slot, because they're sorted
+			_buildNode( childIdx, childBegin[ slotIdx ], childEnd[ slotIdx ], offset + STRIDE, slotLeaves[ slotIdx ] );
+			++childIdx;
+		}
+	}
+}
+
+void Poptrie::lookupBatch( const View * const * tries, const Key * keys, uint32_t * leaves, size_t count ) noexcept
+{
+	constexpr uint32_t NOT_FOUND_YET = UINT32_MAX;
+
+	const Node * nodes [BATCH_SIZE];
+	uint32_t offsets [BATCH_SIZE];
+	uint32_t leafIdxs [BATCH_SIZE];
+
+	for (size_t i = 0; i < count; ++i)
+		if (tries[i]->direct)
+			prefetch( &tries[i]->direct[ keys[i].hi >> (64 - DIRECT_BITS) ] );
+
+	size_t active = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		nodes[i] = nullptr;
+		leafIdxs[i] = NOT_FOUND_YET;
+		leaves[i] = 0;
+		if (!tries[i]->direct)
+			continue;
+		uint32_t directEntry = tries[i]->direct[ keys[i].hi >> (64 - DIRECT_BITS) ];
+		if (directEntry & DIRECT_LEAF_FLAG)
+		{
+			leaves[i] = directEntry & ~DIRECT_LEAF_FLAG;
+			continue;
+		}
+		nodes[i] = tries[i]->nodes + directEntry;
+		offsets[i] = DIRECT_BITS;
+		prefetch( nodes[i] );
+		++active;
+	}
+
+	// one level of all the tries at a time, by the time we get back to a node it's hopefully already in the cache
+	while (active > 0)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!nodes[i])
+				continue;
+			if (step( *tries[i], nodes[i], keys[i], offsets[i], leafIdxs[i] ))
+			{
+				prefetch( nodes[i] );
+			}
+			else
+			{
+				prefetch( &tries[i]->leaves[ leafIdxs[i] ] );
+				nodes[i] = nullptr;
+				--active;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < count; ++i)
+		if (leafIdxs[i] != NOT_FOUND_YET)
+			leaves[i] = tries[i]->leaves[ leafIdxs[i] ];
+}
+
+void lookupAddrBatch( const Poptrie::View & v4Trie, const Poptrie::View & v6Trie, const IPAddr * addrs, uint32_t * leaves, size_t count ) noexcept
+{
+	static constexpr Poptrie::View emptyTrie = { nullptr, nullptr, nullptr };
+
+	const Poptrie::View * tries [Poptrie::BATCH_SIZE];
+	Poptrie::Key keys [Poptrie::BATCH_SIZE];
+	for (size_t i = 0; i < count; ++i)
+	{
+		IPVer version = addrs[i].version();
+		tries[i] = version == IPVer::_4 ? &v4Trie : version == IPVer::_6 ? &v6Trie : &emptyTrie;
+		keys[i] = toPoptrieKey( addrs[i] );
+	}
+	Poptrie::lookupBatch( tries, keys, leaves, count );
+}
+
+
+//======================================================================================================================
+//  ReaderTracker
+
+uint32_t ReaderTracker::currentStripe() noexcept
+{
+	static std::atomic< uint32_t > threadCounter = 0;
+	static thread_local uint32_t stripe = threadCounter.fetch_add( 1, std::memory_order_relaxed ) % STRIPE_COUNT;
+	return stripe;
+}
+
+void ReaderTracker::synchronize() noexcept
+{
+	// After the first flip new readers go to the other counter set, so the old one eventually drains.
+	// But a reader that loaded the phase just before the flip may increment the old set only after it was seen empty,
+	// which is harmless, because such reader loads the protected pointer after the writer replaced it.
+	// The second flip waits for the readers in the other set, that may have entered before the replacement.
+	for (int flip = 0; flip < 2; ++flip)
+	{
+		uint32_t oldPhase = _phase.fetch_xor( 1, std::memory_order_seq_cst ) & 1;
+		while (true)
+		{
+			int64_t total = 0;
+			for (const Stripe & stripe : _stripes)
+				total += stripe.counts[ oldPhase ].load( std::memory_order_seq_cst );
+			if (total == 0)
+				break;
+			std::this_thread::yield();
+		}
+	}
+}
+
+
+} // namespace priv
+
+
+//======================================================================================================================
+
+
+} // namespace own
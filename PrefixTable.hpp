@@ -0,0 +1,415 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: longest-prefix-match table mapping IP prefixes to values
+//======================================================================================================================
+
+#ifndef CPPUTILS_PREFIXTABLE_INCLUDED
+#define CPPUTILS_PREFIXTABLE_INCLUDED
+
+
+#include "NetAddress.hpp"
+
+#include <vector>
+#include <utility>    // pair
+#include <algorithm>  // stable_sort, min
+#include <atomic>
+#include <mutex>
+#include <optional>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+	#include <intrin.h>  // _mm_prefetch
+#endif
+
+
+namespace own {
+
+
+//======================================================================================================================
+/// private implementation details
+
+namespace priv {
+
+	inline void prefetch( const void * addr ) noexcept
+	{
+	 #if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch( addr );
+	 #elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		_mm_prefetch( static_cast< const char * >( addr ), _MM_HINT_T0 );
+	 #else
+		(void)addr;
+	 #endif
+	}
+
+	/// Compressed multiway trie for the longest prefix match, based on Poptrie (Asai & Ohara, SIGCOMM 2015).
+	/** The top 18 bits of the key index a direct table, the rest is walked in 6-bit strides through nodes
+	  * whose 64 children and leaves are stored compressed and located by population count of a bitmap.
+	  * Keys are up to 128 bits long, most significant bit first. The trie resolves to a leaf number, 0 means no match.
+	  * The structure consists of 3 flat arrays without pointers, so it can be also used directly from a mapped file. */
+	class Poptrie
+	{
+	 public:
+
+		struct Key
+		{
+			uint64_t hi;
+			uint64_t lo;
+		};
+
+		struct Node
+		{
+			uint64_t vector;   ///< which of the 64 children are internal nodes
+			uint64_t leafvec;  ///< where a run of equal leaves starts, among the children that are not internal nodes
+			uint32_t base0;    ///< index of the first leaf of this node
+			uint32_t base1;    ///< index of the first internal child of this node
+		};
+
+		struct Entry
+		{
+			Key key;
+			uint8_t length;
+			uint32_t leaf;
+		};
+
+		static constexpr uint32_t DIRECT_BITS = 18;
+		static constexpr uint32_t DIRECT_SIZE = 1u << DIRECT_BITS;
+		static constexpr uint32_t DIRECT_LEAF_FLAG = 0x80000000;
+		static constexpr uint32_t STRIDE = 6;
+
+		/// Builds the trie from prefixes that are all distinct and have the bits beyond their length cleared.
+		/** The entries are sorted in the process. */
+		void build( std::vector< Entry > & entries );
+
+		/// the arrays of the trie, wherever they are stored
+		struct View
+		{
+			const uint32_t * direct;  ///< either DIRECT_SIZE entries or null when the trie is empty
+			const Node * nodes;
+			const uint32_t * leaves;
+		};
+
+		View view() const noexcept
+		{
+			return { _direct.empty() ? nullptr : _direct.data(), _nodes.data(), _leaves.data() };
+		}
+
+		uint32_t lookup( const Key & key ) const noexcept
+		{
+			return lookup( view(), key );
+		}
+
+		static uint32_t lookup( const View & trie, const Key & key ) noexcept
+		{
+			if (!trie.direct)
+				return 0;
+			uint32_t directEntry = trie.direct[ key.hi >> (64 - DIRECT_BITS) ];
+			if (directEntry & DIRECT_LEAF_FLAG)
+				return directEntry & ~DIRECT_LEAF_FLAG;
+
+			const Node * node = trie.nodes + directEntry;
+			uint32_t offset = DIRECT_BITS;
+			while (true)
+			{
+				uint32_t leafIdx;
+				if (!step( trie, node, key, offset, leafIdx ))
+					return trie.leaves[ leafIdx ];
+			}
+		}
+
+		/// maximum number of keys processed by lookupBatch() at once
+		static constexpr size_t BATCH_SIZE = 16;
+
+		/// Looks up multiple keys at once, each in its own trie, walking the tries level by level and prefetching
+		/// the next level of all of them, so that the memory accesses of independent lookups overlap.
+		static void lookupBatch( const View * const * tries, const Key * keys, uint32_t * leaves, size_t count ) noexcept;
+
+		/// Descends one level, returns false and the index into leaves when the node's child is a leaf.
+		static bool step( const View & trie, const Node * & node, const Key & key, uint32_t & offset, uint32_t & leafIdx ) noexcept
+		{
+			uint64_t bit = uint64_t(1) << chunkAt( key, offset );
+			uint64_t upToBit = (bit << 1) - 1;  // wraps around to all ones for the last bit
+			if (!(node->vector & bit))
+			{
+				leafIdx = node->base0 + popCount64( node->leafvec & upToBit ) - 1;
+				return false;
+			}
+			node = trie.nodes + node->base1 + popCount64( node->vector & upToBit ) - 1;
+			offset += STRIDE;
+			return true;
+		}
+
+		/// the 6 bits of the key starting at the given bit position, positions beyond the key read as zeros
+		static uint32_t chunkAt( const Key & key, uint32_t offset ) noexcept
+		{
+			if (offset + STRIDE <= 64)
+				return uint32_t( key.hi >> (64 - STRIDE - offset) ) & 0x3F;
+			else if (offset >= 64 && offset + STRIDE <= 128)
+				return uint32_t( key.lo >> (128 - STRIDE - offset) ) & 0x3F;
+			else if (offset >= 64)
+				return uint32_t( key.lo << (offset + STRIDE - 128) ) & 0x3F;
+			else
+				return uint32_t( (key.hi << (offset + STRIDE - 64)) | (key.lo >> (128 - STRIDE - offset)) ) & 0x3F;
+		}
+
+		const std::vector< uint32_t > & direct() const noexcept  { return _direct; }
+		const std::vector< Node > & nodes() const noexcept       { return _nodes; }
+		const std::vector< uint32_t > & leaves() const noexcept  { return _leaves; }
+
+		size_t memoryUsage() const noexcept
+		{
+			return _direct.size() * sizeof(uint32_t) + _nodes.size() * sizeof(Node) + _leaves.size() * sizeof(uint32_t);
+		}
+
+	 private:
+
+		void _buildNode( uint32_t nodeIdx, const Entry * begin, const Entry * end, uint32_t offset, uint32_t inheritedLeaf );
+
+		std::vector< uint32_t > _direct;  ///< leaf number with DIRECT_LEAF_FLAG, or index of a node
+		std::vector< Node > _nodes;
+		std::vector< uint32_t > _leaves;
+	};
+
+	inline Poptrie::Key toPoptrieKey( const IPv4Addr & addr ) noexcept
+	{
+		return { uint64_t( loadBE32( addr.data().data() ) ) << 32, 0 };
+	}
+	inline Poptrie::Key toPoptrieKey( const IPv6Addr & addr ) noexcept
+	{
+		return { loadBE64( addr.data().data() ), loadBE64( addr.data().data() + 8 ) };
+	}
+	inline Poptrie::Key toPoptrieKey( const IPAddr & addr ) noexcept
+	{
+		// IPv4 address occupies the first bytes and the rest is zero, so this works for both versions
+		return { loadBE64( addr.data().data() ), loadBE64( addr.data().data() + 8 ) };
+	}
+
+	/// Looks up at most Poptrie::BATCH_SIZE addresses of any version at once, each in the trie of its version.
+	void lookupAddrBatch( const Poptrie::View & v4Trie, const Poptrie::View & v6Trie, const IPAddr * addrs, uint32_t * leaves, size_t count ) noexcept;
+
+	/// Tracks readers of a shared object, so that a writer can wait until none of them can see the old version.
+	/** Readers only increment and decrement a counter in one of several cache-line-sized stripes, so they never
+	  * block and don't contend with each other. The writer swaps the active counter set twice and waits each time
+	  * until the previous set drains (the same scheme as in the counter-based userspace RCU). */
+	class ReaderTracker
+	{
+	 public:
+
+		static constexpr size_t STRIPE_COUNT = 16;
+
+		/// returns a ticket that must be passed to exit()
+		uint32_t enter() const noexcept
+		{
+			uint32_t phase = _phase.load( std::memory_order_relaxed ) & 1;
+			uint32_t stripe = currentStripe();
+			// sequentially consistent, so that the read of the protected pointer can't be ordered before it
+			_stripes[ stripe ].counts[ phase ].fetch_add( 1, std::memory_order_seq_cst );
+			return stripe << 1 | phase;
+		}
+
+		void exit( uint32_t ticket ) const noexcept
+		{
+			_stripes[ ticket >> 1 ].counts[ ticket & 1 ].fetch_sub( 1, std::memory_order_release );
+		}
+
+		/// Waits until all readers that entered before this call exited. Must not be called from multiple threads at once.
+		void synchronize() noexcept;
+
+	 private:
+
+		static uint32_t currentStripe() noexcept;
+
+		struct alignas(64) Stripe
+		{
+			std::atomic< int64_t > counts [2] = {};
+		};
+
+		mutable Stripe _stripes [STRIPE_COUNT];
+		std::atomic< uint32_t > _phase = 0;
+	};
+
+} // namespace priv
+
+
+template< typename Value > class PrefixDatabase;
+
+
+//======================================================================================================================
+/// Immutable table mapping IP prefixes to values, finds the value of the longest prefix that contains an address.
+/** Both IPv4 and IPv6 prefixes can be stored, each version is looked up only among prefixes of the same version.
+  * A lookup visits the direct table and at most 3 nodes for IPv4, every 6 bits of IPv6 prefix length add one more node. */
+
+template< typename Value >
+class PrefixTable
+{
+ public:
+
+	PrefixTable() = default;
+
+	/// Builds the table, if the same prefix occurs multiple times, the value of the last occurrence is used.
+	explicit PrefixTable( std::vector< std::pair< IPPrefix, Value > > entries )
+	{
+		std::stable_sort( entries.begin(), entries.end(), []( const auto & e1, const auto & e2 ) { return e1.first < e2.first; } );
+
+		std::vector< priv::Poptrie::Entry > v4Entries, v6Entries;
+		_values.reserve( entries.size() );
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			const IPPrefix & prefix = entries[i].first;
+			if (i + 1 < entries.size() && entries[i + 1].first == prefix)
+				continue;  // overridden by a later occurrence
+			if (prefix.version() != IPVer::_4 && prefix.version() != IPVer::_6)
+				critical_error( "Attempted to insert a prefix with uninitialized IPAddr into PrefixTable." );
+
+			_values.push_back( std::move( entries[i].second ) );
+			priv::Poptrie::Entry entry = { priv::toPoptrieKey( prefix.addr() ), prefix.length(), uint32_t( _values.size() ) };
+			(prefix.version() == IPVer::_4 ? v4Entries : v6Entries).push_back( entry );
+		}
+
+		if (!v4Entries.empty())
+			_v4.build( v4Entries );
+		if (!v6Entries.empty())
+			_v6.build( v6Entries );
+	}
+
+	/// Returns the value of the longest prefix containing the address, or nullptr if there is no such prefix.
+	const Value * lookup( const IPv4Addr & addr ) const noexcept
+	{
+		return _valueOf( _v4.lookup( priv::toPoptrieKey( addr ) ) );
+	}
+	const Value * lookup( const IPv6Addr & addr ) const noexcept
+	{
+		return _valueOf( _v6.lookup( priv::toPoptrieKey( addr ) ) );
+	}
+	const Value * lookup( const IPAddr & addr ) const noexcept
+	{
+		if (addr.version() == IPVer::_4)
+			return _valueOf( _v4.lookup( priv::toPoptrieKey( addr ) ) );
+		else if (addr.version() == IPVer::_6)
+			return _valueOf( _v6.lookup( priv::toPoptrieKey( addr ) ) );
+		else
+			return nullptr;
+	}
+
+	/// Looks up many addresses at once, the value for addrs[i] is stored to values[i].
+	/** This is several times faster than separate lookups when the table doesn't fit into the CPU cache,
+	  * because the memory accesses of the independent lookups overlap. */
+	void lookup( span< const IPAddr > addrs, span< const Value * > values ) const noexcept
+	{
+		if (values.size() < addrs.size())
+			critical_error( "The output span for batch lookup is smaller than the input (%zu < %zu).", values.size(), addrs.size() );
+
+		const priv::Poptrie::View v4Trie = _v4.view();
+		const priv::Poptrie::View v6Trie = _v6.view();
+		uint32_t leaves [priv::Poptrie::BATCH_SIZE];
+		for (size_t begin = 0; begin < addrs.size(); begin += priv::Poptrie::BATCH_SIZE)
+		{
+			size_t count = std::min( priv::Poptrie::BATCH_SIZE, addrs.size() - begin );
+			priv::lookupAddrBatch( v4Trie, v6Trie, addrs.data() + begin, leaves, count );
+			for (size_t i = 0; i < count; ++i)
+				values[ begin + i ] = _valueOf( leaves[i] );
+		}
+	}
+
+	/// number of distinct prefixes
+	size_t size() const noexcept { return _values.size(); }
+
+	/// memory occupied by the lookup structures, not counting the values
+	size_t memoryUsage() const noexcept { return _v4.memoryUsage() + _v6.memoryUsage(); }
+
+ private:
+
+	template< typename > friend class PrefixDatabase;  // saves the lookup structures into a file
+
+	const Value * _valueOf( uint32_t leaf ) const noexcept
+	{
+		return leaf != 0 ? &_values[ leaf - 1 ] : nullptr;
+	}
+
+	priv::Poptrie _v4;
+	priv::Poptrie _v6;
+	std::vector< Value > _values;  ///< indexed by the leaf number - 1
+};
+
+
+//======================================================================================================================
+/// PrefixTable that can be replaced by a newly built one while other threads keep looking up in it.
+/** Lookups never block and never wait for the replacement, they see either the old or the new table as a whole.
+  * The replacing thread waits until no lookup uses the old table anymore and then destroys it. */
+
+template< typename Value >
+class ConcurrentPrefixTable
+{
+ public:
+
+	ConcurrentPrefixTable() : _current( new PrefixTable< Value >() ) {}
+	explicit ConcurrentPrefixTable( PrefixTable< Value > && table ) : _current( new PrefixTable< Value >( move( table ) ) ) {}
+	~ConcurrentPrefixTable() { delete _current.load(); }
+
+	ConcurrentPrefixTable( const ConcurrentPrefixTable & other ) = delete;
+	ConcurrentPrefixTable & operator=( const ConcurrentPrefixTable & other ) = delete;
+
+	/// Keeps the current table alive while it exists, use this to do a batch of lookups at the cost of one.
+	class ReadGuard
+	{
+		const priv::ReaderTracker * _tracker;
+		uint32_t _ticket;
+		const PrefixTable< Value > * _table;
+
+		friend class ConcurrentPrefixTable;
+		ReadGuard( const priv::ReaderTracker & tracker, const std::atomic< PrefixTable< Value > * > & current ) noexcept
+			: _tracker( &tracker ), _ticket( tracker.enter() ), _table( current.load( std::memory_order_seq_cst ) ) {}
+
+	 public:
+
+		ReadGuard( const ReadGuard & other ) = delete;
+		ReadGuard & operator=( const ReadGuard & other ) = delete;
+		~ReadGuard() { _tracker->exit( _ticket ); }
+
+		const PrefixTable< Value > & table() const noexcept { return *_table; }
+
+		template< typename Addr >
+		const Value * lookup( const Addr & addr ) const noexcept { return _table->lookup( addr ); }
+
+		void lookup( span< const IPAddr > addrs, span< const Value * > values ) const noexcept { _table->lookup( addrs, values ); }
+	};
+
+	ReadGuard read() const noexcept
+	{
+		return ReadGuard( _tracker, _current );
+	}
+
+	/// Returns a copy of the value of the longest prefix containing the address, or empty optional if there is none.
+	template< typename Addr >
+	std::optional< Value > lookup( const Addr & addr ) const
+	{
+		ReadGuard guard = read();
+		const Value * value = guard.lookup( addr );
+		return value ? std::optional< Value >( *value ) : std::nullopt;
+	}
+
+	/// Replaces the current table with a new one and destroys the old one once no reader uses it.
+	void replace( PrefixTable< Value > && table )
+	{
+		PrefixTable< Value > * newTable = new PrefixTable< Value >( move( table ) );
+		std::lock_guard< std::mutex > lock( _writerMtx );
+		PrefixTable< Value > * oldTable = _current.exchange( newTable, std::memory_order_seq_cst );
+		_tracker.synchronize();
+		delete oldTable;
+	}
+
+ private:
+
+	std::atomic< PrefixTable< Value > * > _current;
+	priv::ReaderTracker _tracker;
+	std::mutex _writerMtx;
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_PREFIXTABLE_INCLUDED
@@ -0,0 +1,612 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: reliable ordered delivery of messages over UDP, with independent streams
+//======================================================================================================================
+
+#include "ReliableUdp.hpp"
+
+#include <CppUtils-Essential/CriticalError.hpp>
+
+#include <algorithm>  // min, max
+
+
+namespace own {
+
+
+//======================================================================================================================
+//  wire format
+//
+//  DATA: type (1), flags (1), stream (2), packet number (4), stream sequence (4), lowest unacknowledged (4), payload
+//  ACK:  type (1), range count (1), cumulative (4), ranges: start (4), end (4)
+//
+//  All the numbers are big-endian. The cumulative number of an ACK is the lowest packet number not yet received,
+//  the ranges [start, end) list the packets received above it, the highest first. A lost packet number is never
+//  received, its data go in a new packet, so the sender tells the receiver the lowest number it still waits for,
+//  and the receiver moves its cumulative number there.
+//
+//  Packet numbers and stream sequences are 64-bit on both sides and never wrap around, only their lowest 32 bits
+//  are sent. The receiving side completes them to the number closest to the one it expects, which is correct as long
+//  as the numbers in use at the same time span less than 2^31 (RFC 9000, appendix A.3).
+
+static constexpr uint8_t TYPE_DATA = 1;
+static constexpr uint8_t TYPE_ACK = 2;
+
+static constexpr uint8_t FLAG_LAST_FRAGMENT = 0x01;
+
+static constexpr size_t DATA_HEADER_SIZE = 16;
+static constexpr size_t ACK_HEADER_SIZE = 6;
+static constexpr size_t ACK_RANGE_SIZE = 8;
+static constexpr size_t MAX_ACK_RANGES = 32;
+
+/// how many later packets must be acknowledged before an unacknowledged one is considered lost
+static constexpr uint32_t REORDER_THRESHOLD = 3;
+/// or how long after a later packet was acknowledged, in multiples of the RTT (8 = 1 RTT)
+static constexpr int REORDER_TIME_EIGHTHS = 9;
+static constexpr std::chrono::milliseconds MIN_REORDER_TIME( 1 );
+
+static void putU16( uint8_t * pos, uint16_t value ) noexcept
+{
+	pos[0] = uint8_t( value >> 8 );
+	pos[1] = uint8_t( value );
+}
+
+static void putU32( uint8_t * pos, uint32_t value ) noexcept
+{
+	pos[0] = uint8_t( value >> 24 );
+	pos[1] = uint8_t( value >> 16 );
+	pos[2] = uint8_t( value >> 8 );
+	pos[3] = uint8_t( value );
+}
+
+static uint16_t getU16( const uint8_t * pos ) noexcept
+{
+	return uint16_t( (pos[0] << 8) | pos[1] );
+}
+
+static uint32_t getU32( const uint8_t * pos ) noexcept
+{
+	return (uint32_t( pos[0] ) << 24) | (uint32_t( pos[1] ) << 16) | (uint32_t( pos[2] ) << 8) | uint32_t( pos[3] );
+}
+
+/// Reads the lowest 32 bits of a number and completes them to the full number closest to the expected one.
+static uint64_t getTruncated( const uint8_t * pos, uint64_t expected ) noexcept
+{
+	const uint64_t window = uint64_t( 1 ) << 32;
+	uint64_t number = (expected & ~(window - 1)) | getU32( pos );
+	if (number + window / 2 <= expected && number <= UINT64_MAX - window)
+		number += window;
+	else if (number > expected + window / 2 && number >= window)
+		number -= window;
+	return number;
+}
+
+
+//======================================================================================================================
+//  ReliableUdpChannel
+
+ReliableUdpChannel::ReliableUdpChannel() noexcept
+:
+	_maxPayloadSize( 0 ),
+	_nextPacketNum( 0 ),
+	_largestAcked( 0 ),
+	_anyAcked( false ),
+	_congestionWindow( 0 ),
+	_slowStartThreshold( 0 ),
+	_bytesInFlight( 0 ),
+	_smoothedRtt( 0 ),
+	_rttVariance( 0 ),
+	_retransmitTimeout( 0 ),
+	_hasRttSample( false ),
+	_probePending( false ),
+	_recvCumulative( 0 ),
+	_ackPending( false ),
+	_stats()
+{}
+
+ReliableUdpChannel::~ReliableUdpChannel() noexcept
+{
+	close();
+}
+
+SocketError ReliableUdpChannel::open( uint16_t localPort, const NativeEndpoint & remote, const ReliableUdpConfig & config )
+{
+	if (isOpen())
+	{
+		return SocketError::AlreadyConnected;
+	}
+	if (config.maxDatagramSize <= (std::max)( DATA_HEADER_SIZE, ACK_HEADER_SIZE + ACK_RANGE_SIZE ))
+	{
+		critical_error( "ReliableUdpConfig::maxDatagramSize is too small to carry any data." );
+	}
+
+	SocketError error = _peer.connect( remote, localPort );
+	if (error != SocketError::Success)
+	{
+		return error;
+	}
+	_peer.setBlockingMode( false );
+
+	_config = config;
+	_maxPayloadSize = config.maxDatagramSize - DATA_HEADER_SIZE;
+
+	_nextPacketNum = 0;
+	_largestAcked = 0;
+	_anyAcked = false;
+	_congestionWindow = (std::max)( config.initialWindow, size_t( 2 ) ) * config.maxDatagramSize;
+	_slowStartThreshold = SIZE_MAX;
+	_bytesInFlight = 0;
+	_recoveryStart = Clock::time_point();
+	_smoothedRtt = Clock::duration( 0 );
+	_rttVariance = Clock::duration( 0 );
+	_retransmitTimeout = (std::max)( Clock::duration( std::chrono::milliseconds( 100 ) ), Clock::duration( config.minRetransmitTimeout ) );
+	_hasRttSample = false;
+	_probePending = false;
+	_recvCumulative = 0;
+	_ackPending = false;
+
+	_recvBuffer.resize( config.maxDatagramSize );
+	_sendBuffer.resize( config.maxDatagramSize );
+	_waitSet = { &_peer };
+
+	_stats = ReliableUdpStats();
+	_lossInjector.reset( config.simulatedLoss );
+
+	return SocketError::Success;
+}
+
+void ReliableUdpChannel::close() noexcept
+{
+	_peer.disconnect();
+	_nextStreamSeq.clear();
+	_sendQueue.clear();
+	_retransmitQueue.clear();
+	_inFlight.clear();
+	_recvAbove.clear();
+	_recvStreams.clear();
+	_delivered.clear();
+	_waitSet.clear();
+}
+
+SocketError ReliableUdpChannel::send( uint16_t stream, const_byte_span message )
+{
+	if (!isOpen())
+	{
+		return SocketError::NotConnected;
+	}
+
+	uint64_t & nextSeq = _nextStreamSeq[ stream ];
+	size_t offset = 0;
+	do
+	{
+		size_t fragmentSize = (std::min)( message.size() - offset, _maxPayloadSize );
+		Fragment fragment;
+		fragment.stream = stream;
+		fragment.flags = offset + fragmentSize == message.size() ? FLAG_LAST_FRAGMENT : 0;
+		fragment.streamSeq = nextSeq++;
+		fragment.payload.assign( message.data() + offset, message.data() + offset + fragmentSize );
+		_sendQueue.push_back( move( fragment ) );
+		offset += fragmentSize;
+	}
+	while (offset < message.size());
+
+	_flush( Clock::now() );
+	return SocketError::Success;
+}
+
+SocketError ReliableUdpChannel::update( std::chrono::milliseconds timeout )
+{
+	if (!isOpen())
+	{
+		return SocketError::NotConnected;
+	}
+
+	uint64_t receivedBefore = _stats.datagramsReceived;
+	SocketError error = _receiveAll();
+	if (error != SocketError::Success)
+	{
+		return error;
+	}
+
+	// nothing came, wait for the first datagram or the retransmission timeout, whichever comes first
+	if (_stats.datagramsReceived == receivedBefore && timeout.count() > 0)
+	{
+		std::chrono::milliseconds waitTime = timeout;
+		if (_anyAcked && !_inFlight.empty() && _inFlight.begin()->first < _largestAcked)
+		{
+			waitTime = (std::min)( waitTime, MIN_REORDER_TIME );  // some packet may be declared lost soon
+		}
+		if (!_inFlight.empty())
+		{
+			Clock::duration untilTimeout = _inFlight.begin()->second.sentTime + _retransmitTimeout - Clock::now();
+			auto untilTimeoutMs = std::chrono::duration_cast< std::chrono::milliseconds >( untilTimeout + std::chrono::milliseconds( 1 ) - Clock::duration( 1 ) );
+			waitTime = (std::max)( (std::min)( waitTime, untilTimeoutMs ), std::chrono::milliseconds( 0 ) );
+		}
+		if (waitTime.count() > 0)
+		{
+			_readySockets.clear();
+			if (waitForAny( _waitSet, _readySockets, waitTime ) && !_readySockets.empty())
+			{
+				error = _receiveAll();
+				if (error != SocketError::Success)
+				{
+					return error;
+				}
+			}
+		}
+	}
+
+	Clock::time_point now = Clock::now();
+	_detectLosses( now );
+	_checkRetransmitTimeout( now );
+	_flush( now );
+	return SocketError::Success;
+}
+
+bool ReliableUdpChannel::receive( uint16_t & stream, std::vector< uint8_t > & message )
+{
+	if (_delivered.empty())
+	{
+		return false;
+	}
+	stream = _delivered.front().first;
+	message = move( _delivered.front().second );
+	_delivered.pop_front();
+	return true;
+}
+
+bool ReliableUdpChannel::hasUnacknowledged() const noexcept
+{
+	return !_inFlight.empty() || !_sendQueue.empty() || !_retransmitQueue.empty();
+}
+
+ReliableUdpStats ReliableUdpChannel::stats() const noexcept
+{
+	ReliableUdpStats stats = _stats;
+	stats.smoothedRtt = std::chrono::duration_cast< std::chrono::microseconds >( _smoothedRtt );
+	stats.rttVariance = std::chrono::duration_cast< std::chrono::microseconds >( _rttVariance );
+	stats.retransmitTimeout = std::chrono::duration_cast< std::chrono::microseconds >( _retransmitTimeout );
+	stats.congestionWindow = _congestionWindow;
+	stats.bytesInFlight = _bytesInFlight;
+	stats.simulatedDrops = _lossInjector.dropCount();
+	return stats;
+}
+
+//-- receiving ---------------------------------------------------------------------------------------------------------
+
+SocketError ReliableUdpChannel::_receiveAll()
+{
+	while (true)
+	{
+		size_t received;
+		SocketError error = _peer.receive( make_span( _recvBuffer ), received );
+		if (error == SocketError::Success)
+		{
+			_stats.datagramsReceived++;
+			_processDatagram( make_span( _recvBuffer.data(), received ), Clock::now() );
+		}
+		else if (error == SocketError::WouldBlock)
+		{
+			return SocketError::Success;
+		}
+		else if (error != SocketError::ConnectionClosed)  // the other side is not open yet, the data will be retransmitted
+		{
+			return error;
+		}
+	}
+}
+
+void ReliableUdpChannel::_processDatagram( const_byte_span datagram, Clock::time_point now )
+{
+	if (datagram.empty())
+	{
+		return;
+	}
+
+	if (datagram[0] == TYPE_DATA && datagram.size() >= DATA_HEADER_SIZE)
+	{
+		Fragment fragment;
+		fragment.flags = datagram[1];
+		fragment.stream = getU16( datagram.data() + 2 );
+		uint64_t packetNum = getTruncated( datagram.data() + 4, _recvCumulative );
+		auto recvStreamIt = _recvStreams.find( fragment.stream );
+		fragment.streamSeq = getTruncated( datagram.data() + 8, recvStreamIt != _recvStreams.end() ? recvStreamIt->second.nextSeq : 0 );
+		uint64_t lowestUnacked = getTruncated( datagram.data() + 12, _recvCumulative );
+		fragment.payload.assign( datagram.data() + DATA_HEADER_SIZE, datagram.data() + datagram.size() );
+		_processData( move( fragment ), packetNum, lowestUnacked );
+	}
+	else if (datagram[0] == TYPE_ACK && datagram.size() >= ACK_HEADER_SIZE)
+	{
+		_processAck( datagram, now );
+	}
+}
+
+void ReliableUdpChannel::_processData( Fragment && fragment, uint64_t packetNum, uint64_t lowestUnacked )
+{
+	// acknowledge even the duplicates, the acknowledgement of the original may have been lost
+	_ackPending = true;
+
+	// the sender doesn't wait for the packets below this anymore, they were either received or declared lost
+	if (lowestUnacked > _recvCumulative)
+	{
+		_recvCumulative = lowestUnacked;
+		_recvAbove.erase( _recvAbove.begin(), _recvAbove.lower_bound( lowestUnacked ) );
+	}
+
+	if (packetNum < _recvCumulative || !_recvAbove.insert( packetNum ).second)
+	{
+		return;
+	}
+	while (!_recvAbove.empty() && *_recvAbove.begin() == _recvCumulative)
+	{
+		_recvAbove.erase( _recvAbove.begin() );
+		++_recvCumulative;
+	}
+
+	// the same fragment may come in different packets, when a retransmission was spurious
+	RecvStream & recvStream = _recvStreams[ fragment.stream ];
+	if (fragment.streamSeq < recvStream.nextSeq)
+	{
+		return;
+	}
+	if (fragment.streamSeq != recvStream.nextSeq)
+	{
+		uint64_t streamSeq = fragment.streamSeq;
+		recvStream.outOfOrder.emplace( streamSeq, move( fragment ) );
+		return;
+	}
+
+	_deliver( recvStream, fragment.stream, fragment );
+	while (!recvStream.outOfOrder.empty() && recvStream.outOfOrder.begin()->first == recvStream.nextSeq)
+	{
+		_deliver( recvStream, fragment.stream, recvStream.outOfOrder.begin()->second );
+		recvStream.outOfOrder.erase( recvStream.outOfOrder.begin() );
+	}
+}
+
+void ReliableUdpChannel::_deliver( RecvStream & recvStream, uint16_t stream, Fragment & fragment )
+{
+	recvStream.nextSeq++;
+	if (recvStream.message.empty())
+		recvStream.message = move( fragment.payload );
+	else
+		recvStream.message.insert( recvStream.message.end(), fragment.payload.begin(), fragment.payload.end() );
+
+	if (fragment.flags & FLAG_LAST_FRAGMENT)
+	{
+		_delivered.emplace_back( stream, move( recvStream.message ) );
+		recvStream.message.clear();
+	}
+}
+
+void ReliableUdpChannel::_processAck( const_byte_span datagram, Clock::time_point now )
+{
+	size_t rangeCount = datagram[1];
+	if (datagram.size() < ACK_HEADER_SIZE + rangeCount * ACK_RANGE_SIZE)
+	{
+		return;
+	}
+
+	bool anyNewlyAcked = false;
+	uint64_t largestNewlyAcked = 0;
+	Clock::time_point largestSentTime;
+	auto recordAcked = [&]( InFlightIter it )
+	{
+		if (!anyNewlyAcked || it->first > largestNewlyAcked)
+		{
+			largestNewlyAcked = it->first;
+			largestSentTime = it->second.sentTime;
+		}
+		anyNewlyAcked = true;
+	};
+
+	// the acknowledged numbers are below the next one to be sent
+	uint64_t cumulative = getTruncated( datagram.data() + 2, _nextPacketNum );
+	while (!_inFlight.empty() && _inFlight.begin()->first < cumulative)
+	{
+		recordAcked( _inFlight.begin() );
+		_acknowledge( _inFlight.begin() );
+	}
+	for (size_t i = 0; i < rangeCount; ++i)
+	{
+		const uint8_t * range = datagram.data() + ACK_HEADER_SIZE + i * ACK_RANGE_SIZE;
+		uint64_t rangeStart = getTruncated( range, _nextPacketNum );
+		uint64_t rangeEnd = getTruncated( range + 4, _nextPacketNum );
+		for (auto it = _inFlight.lower_bound( rangeStart ); it != _inFlight.end() && it->first < rangeEnd; )
+		{
+			recordAcked( it );
+			it = _acknowledge( it );
+		}
+	}
+
+	if (!anyNewlyAcked)
+	{
+		return;
+	}
+	// only the largest acknowledged packet gives a valid RTT sample, the others may have been acknowledged late
+	if (!_anyAcked || largestNewlyAcked > _largestAcked)
+	{
+		_largestAcked = largestNewlyAcked;
+		_anyAcked = true;
+		_updateRtt( now - largestSentTime );
+	}
+
+	_detectLosses( now );
+}
+
+//-- congestion control and loss recovery ------------------------------------------------------------------------------
+
+ReliableUdpChannel::InFlightIter ReliableUdpChannel::_acknowledge( InFlightIter packetIt )
+{
+	size_t size = DATA_HEADER_SIZE + packetIt->second.fragment.payload.size();
+	_bytesInFlight -= size;
+
+	// don't grow the window while recovering from a loss, or when the sender doesn't use the window it has
+	bool sentInRecovery = packetIt->second.sentTime <= _recoveryStart;
+	bool windowLimited = _bytesInFlight + size >= _congestionWindow / 2;
+	if (!sentInRecovery && windowLimited)
+	{
+		if (_congestionWindow < _slowStartThreshold)
+			_congestionWindow += size;
+		else
+			_congestionWindow += (std::max)( _config.maxDatagramSize * size / _congestionWindow, size_t( 1 ) );
+	}
+
+	return _inFlight.erase( packetIt );
+}
+
+ReliableUdpChannel::InFlightIter ReliableUdpChannel::_markLost( InFlightIter packetIt, Clock::time_point now )
+{
+	_bytesInFlight -= DATA_HEADER_SIZE + packetIt->second.fragment.payload.size();
+	_stats.retransmits++;
+
+	// all the losses of the packets sent before the first loss was detected count as one event
+	if (packetIt->second.sentTime > _recoveryStart)
+	{
+		_congestionWindow = (std::max)( _congestionWindow / 2, 2 * _config.maxDatagramSize );
+		_slowStartThreshold = _congestionWindow;
+		_recoveryStart = now;
+	}
+
+	_retransmitQueue.push_back( move( packetIt->second.fragment ) );
+	return _inFlight.erase( packetIt );
+}
+
+void ReliableUdpChannel::_detectLosses( Clock::time_point now )
+{
+	// a packet sent before an acknowledged one is lost, when it's not acknowledged after a few more packets
+	// or after a while, which catches the losses at the end of a burst (RFC 9002)
+	Clock::duration reorderTime = (std::max)( _smoothedRtt * REORDER_TIME_EIGHTHS / 8, Clock::duration( MIN_REORDER_TIME ) );
+	for (auto it = _inFlight.begin(); it != _inFlight.end() && _anyAcked && it->first < _largestAcked; )
+	{
+		if (it->first + REORDER_THRESHOLD <= _largestAcked || now - it->second.sentTime >= reorderTime)
+			it = _markLost( it, now );
+		else
+			++it;
+	}
+}
+
+void ReliableUdpChannel::_checkRetransmitTimeout( Clock::time_point now )
+{
+	if (_inFlight.empty() || now - _inFlight.begin()->second.sentTime < _retransmitTimeout)
+	{
+		return;
+	}
+
+	// Often only the acknowledgements were lost, so retransmit just the oldest packet as a probe. Its acknowledgement
+	// then either covers the others, or makes them lost by the reorder threshold, because the probe has a higher number.
+	_markLost( _inFlight.begin(), now );
+	_probePending = true;
+
+	// back off, in case the other side is gone (RFC 6298)
+	_retransmitTimeout = (std::min)( _retransmitTimeout * 2, Clock::duration( _config.maxRetransmitTimeout ) );
+}
+
+void ReliableUdpChannel::_updateRtt( Clock::duration sample ) noexcept
+{
+	if (!_hasRttSample)
+	{
+		_smoothedRtt = sample;
+		_rttVariance = sample / 2;
+		_hasRttSample = true;
+	}
+	else
+	{
+		Clock::duration deviation = _smoothedRtt > sample ? _smoothedRtt - sample : sample - _smoothedRtt;
+		_rttVariance = (3 * _rttVariance + deviation) / 4;
+		_smoothedRtt = (7 * _smoothedRtt + sample) / 8;
+	}
+
+	_retransmitTimeout = _smoothedRtt + 4 * _rttVariance;
+	_retransmitTimeout = (std::max)( _retransmitTimeout, Clock::duration( _config.minRetransmitTimeout ) );
+	_retransmitTimeout = (std::min)( _retransmitTimeout, Clock::duration( _config.maxRetransmitTimeout ) );
+}
+
+//-- sending -----------------------------------------------------------------------------------------------------------
+
+void ReliableUdpChannel::_flush( Clock::time_point now )
+{
+	while (true)
+	{
+		std::deque< Fragment > * queue = !_retransmitQueue.empty() ? &_retransmitQueue
+		                               : !_sendQueue.empty() ? &_sendQueue
+		                               : nullptr;
+		if (!queue)
+		{
+			break;
+		}
+
+		Fragment & fragment = queue->front();
+		size_t size = DATA_HEADER_SIZE + fragment.payload.size();
+		// the probe must go even when the window is full, otherwise a lost acknowledgement could block the channel
+		if (_bytesInFlight > 0 && _bytesInFlight + size > _congestionWindow && !_probePending)
+		{
+			break;
+		}
+		_probePending = false;
+
+		uint64_t packetNum = _nextPacketNum++;
+		uint8_t * datagram = _sendBuffer.data();
+		datagram[0] = TYPE_DATA;
+		datagram[1] = fragment.flags;
+		putU16( datagram + 2, fragment.stream );
+		putU32( datagram + 4, uint32_t( packetNum ) );
+		putU32( datagram + 8, uint32_t( fragment.streamSeq ) );
+		putU32( datagram + 12, uint32_t( _inFlight.empty() ? packetNum : _inFlight.begin()->first ) );
+		std::copy( fragment.payload.begin(), fragment.payload.end(), datagram + DATA_HEADER_SIZE );
+		_sendDatagram( make_span( datagram, size ) );
+
+		_inFlight.emplace_hint( _inFlight.end(), packetNum, SentPacket{ move( fragment ), now } );
+		_bytesInFlight += size;
+		queue->pop_front();
+	}
+
+	if (_ackPending)
+	{
+		_sendAck();
+	}
+}
+
+void ReliableUdpChannel::_sendAck()
+{
+	uint8_t * datagram = _sendBuffer.data();
+	datagram[0] = TYPE_ACK;
+	putU32( datagram + 2, uint32_t( _recvCumulative ) );
+
+	// the highest ranges are the most useful, the lower ones were most likely already reported
+	const size_t maxRanges = (std::min)( MAX_ACK_RANGES, (_config.maxDatagramSize - ACK_HEADER_SIZE) / ACK_RANGE_SIZE );
+	size_t rangeCount = 0;
+	for (auto it = _recvAbove.rbegin(); it != _recvAbove.rend() && rangeCount < maxRanges; )
+	{
+		uint64_t rangeEnd = *it + 1;
+		uint64_t rangeStart = *it;
+		for (++it; it != _recvAbove.rend() && *it + 1 == rangeStart; ++it)
+			--rangeStart;
+		uint8_t * range = datagram + ACK_HEADER_SIZE + rangeCount * ACK_RANGE_SIZE;
+		putU32( range, uint32_t( rangeStart ) );
+		putU32( range + 4, uint32_t( rangeEnd ) );
+		++rangeCount;
+	}
+	datagram[1] = uint8_t( rangeCount );
+
+	_sendDatagram( make_span( datagram, ACK_HEADER_SIZE + rangeCount * ACK_RANGE_SIZE ) );
+	_ackPending = false;
+}
+
+void ReliableUdpChannel::_sendDatagram( const_byte_span datagram )
+{
+	_stats.datagramsSent++;
+	if (_lossInjector.shouldDrop())
+	{
+		return;
+	}
+	// a failed send is no different from a datagram lost on the way, it will be retransmitted
+	_peer.send( datagram );
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
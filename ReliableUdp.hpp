@@ -0,0 +1,200 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: reliable ordered delivery of messages over UDP, with independent streams
+//======================================================================================================================
+
+#ifndef CPPUTILS_RELIABLEUDP_INCLUDED
+#define CPPUTILS_RELIABLEUDP_INCLUDED
+
+
+#include "Socket.hpp"
+#include "LossInjector.hpp"
+
+#include <CppUtils-Essential/Span.hpp>
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+namespace own {
+
+
+//======================================================================================================================
+
+struct ReliableUdpConfig
+{
+	size_t maxDatagramSize = 1200;                        ///< including the header, longer messages are split
+	std::chrono::milliseconds minRetransmitTimeout { 5 };  ///< lower than in TCP (200 ms), meant for local networks
+	std::chrono::milliseconds maxRetransmitTimeout { 2000 };
+	size_t initialWindow = 10;                            ///< in datagrams of maxDatagramSize
+	SimulatedLoss simulatedLoss;                          ///< for testing, outgoing datagrams dropped on purpose
+};
+
+struct ReliableUdpStats
+{
+	uint64_t datagramsSent;      ///< including the retransmitted ones and the acknowledgements
+	uint64_t datagramsReceived;
+	uint64_t retransmits;        ///< datagrams declared lost and sent again
+	uint64_t simulatedDrops;     ///< datagrams dropped on purpose, see ReliableUdpConfig::simulatedLoss
+	std::chrono::microseconds smoothedRtt;
+	std::chrono::microseconds rttVariance;
+	std::chrono::microseconds retransmitTimeout;
+	size_t congestionWindow;     ///< in bytes
+	size_t bytesInFlight;
+};
+
+
+//======================================================================================================================
+/// Two-way channel delivering messages reliably and in order over a connected UDP socket (UdpPeer).
+/** Each message belongs to one of up to 65536 streams and it is delivered in order with the other messages
+  * of the same stream. A lost datagram holds back only its own stream, unlike in TCP, where it holds back everything.
+  *
+  * Every datagram gets a new packet number, also when it carries retransmitted data, so the acknowledgements
+  * (cumulative + selective ranges) are never ambiguous and every one of them gives an RTT sample. A datagram is lost
+  * when 3 later ones are acknowledged, or a while after a later one was acknowledged (RFC 9002). When nothing is
+  * acknowledged within the retransmission timeout (RFC 6298), the oldest packet is sent again as a probe.
+  * The congestion window follows NewReno: slow start, additive increase and halving once per loss event.
+  *
+  * The channel has no thread of its own, update() must be called regularly to receive, acknowledge and retransmit.
+  * Both sides must know the address and port of the other one, there is no handshake. */
+
+class ReliableUdpChannel
+{
+
+ public:
+
+	using Clock = std::chrono::steady_clock;
+
+	ReliableUdpChannel() noexcept;
+	~ReliableUdpChannel() noexcept;
+
+	ReliableUdpChannel( const ReliableUdpChannel & other ) = delete;
+	ReliableUdpChannel & operator=( const ReliableUdpChannel & other ) = delete;
+
+	/// Opens the socket on the local port and connects it to the other side.
+	SocketError open( uint16_t localPort, const NativeEndpoint & remote, const ReliableUdpConfig & config = ReliableUdpConfig() );
+
+	/// Closes the socket and forgets everything that was not delivered.
+	void close() noexcept;
+
+	bool isOpen() const noexcept  { return _peer.isConnected(); }
+
+	/// Queues the message for the stream and sends as much as the congestion window allows.
+	SocketError send( uint16_t stream, const_byte_span message );
+
+	/// Receives and acknowledges the incoming datagrams, retransmits the lost ones and sends the queued messages.
+	/** When there is nothing to receive, it waits up to timeout for the incoming datagrams or the next retransmission. */
+	SocketError update( std::chrono::milliseconds timeout );
+
+	/// Takes the next completely received message, the messages of each stream come in the order they were sent.
+	bool receive( uint16_t & stream, std::vector< uint8_t > & message );
+
+	/// Whether some sent data are not yet acknowledged by the other side.
+	bool hasUnacknowledged() const noexcept;
+
+	ReliableUdpStats stats() const noexcept;
+
+	system_error_t getLastSystemError() const noexcept  { return _peer.getLastSystemError(); }
+
+ private: // types
+
+	struct Fragment
+	{
+		uint16_t stream;
+		uint8_t flags;
+		uint64_t streamSeq;  ///< order of the fragment within its stream
+		std::vector< uint8_t > payload;
+	};
+
+	struct SentPacket
+	{
+		Fragment fragment;
+		Clock::time_point sentTime;
+	};
+
+	struct RecvStream
+	{
+		uint64_t nextSeq = 0;
+		std::map< uint64_t, Fragment > outOfOrder;
+		std::vector< uint8_t > message;  ///< fragments of the message that is being completed
+	};
+
+	using InFlightIter = std::map< uint64_t, SentPacket >::iterator;
+
+ private: // methods
+
+	SocketError _receiveAll();
+	void _processDatagram( const_byte_span datagram, Clock::time_point now );
+	void _processData( Fragment && fragment, uint64_t packetNum, uint64_t lowestUnacked );
+	void _processAck( const_byte_span datagram, Clock::time_point now );
+	InFlightIter _acknowledge( InFlightIter packetIt );
+	InFlightIter _markLost( InFlightIter packetIt, Clock::time_point now );
+	void _detectLosses( Clock::time_point now );
+	void _checkRetransmitTimeout( Clock::time_point now );
+	void _updateRtt( Clock::duration sample ) noexcept;
+	void _deliver( RecvStream & recvStream, uint16_t stream, Fragment & fragment );
+	void _flush( Clock::time_point now );
+	void _sendAck();
+	void _sendDatagram( const_byte_span datagram );
+
+ private: // members
+
+	UdpPeer _peer;
+	ReliableUdpConfig _config;
+	size_t _maxPayloadSize;
+
+	// sending
+	// the numbers are 64-bit so that they never wrap around, only their lowest 32 bits go over the wire
+	uint64_t _nextPacketNum;
+	std::unordered_map< uint16_t, uint64_t > _nextStreamSeq;
+	std::deque< Fragment > _sendQueue;        ///< fragments that were not sent yet
+	std::deque< Fragment > _retransmitQueue;  ///< fragments declared lost, they go before the new ones
+	std::map< uint64_t, SentPacket > _inFlight;  ///< by packet number, which grows with the sent time
+	uint64_t _largestAcked;
+	bool _anyAcked;
+
+	// congestion control and RTT estimation
+	size_t _congestionWindow;
+	size_t _slowStartThreshold;
+	size_t _bytesInFlight;
+	Clock::time_point _recoveryStart;  ///< losses of datagrams sent before this belong to the same loss event
+	Clock::duration _smoothedRtt;
+	Clock::duration _rttVariance;
+	Clock::duration _retransmitTimeout;
+	bool _hasRttSample;
+	bool _probePending;                ///< the retransmission timeout expired, the next packet goes regardless of the window
+
+	// receiving
+	uint64_t _recvCumulative;             ///< all the packets with lower numbers were received
+	std::set< uint64_t > _recvAbove;      ///< received packets above the cumulative one
+	bool _ackPending;
+	std::unordered_map< uint16_t, RecvStream > _recvStreams;
+	std::deque< std::pair< uint16_t, std::vector< uint8_t > > > _delivered;
+	std::vector< uint8_t > _recvBuffer;
+	std::vector< uint8_t > _sendBuffer;
+
+	// waiting
+	std::unordered_set< ASocket * > _waitSet;
+	std::vector< ASocket * > _readySockets;
+
+	// statistics and testing
+	ReliableUdpStats _stats;
+	LossInjector _lossInjector;
+
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_RELIABLEUDP_INCLUDED
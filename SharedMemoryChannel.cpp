@@ -0,0 +1,688 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: byte stream between processes on the same machine through a pair of rings in shared memory
+//======================================================================================================================
+
+#include "SharedMemoryChannel.hpp"
+
+#include <CppUtils-Essential/CriticalError.hpp>
+
+#ifdef __linux__
+	#include <unistd.h>        // close, ftruncate, syscall, getpid
+	#include <sys/mman.h>      // memfd_create, mmap, munmap
+	#include <sys/stat.h>      // fstat
+	#include <sys/syscall.h>   // SYS_futex, SYS_pidfd_open
+	#include <linux/futex.h>   // FUTEX_WAIT, FUTEX_WAKE
+	#include <time.h>          // timespec
+	#include <signal.h>        // kill
+	#include <poll.h>          // poll
+#endif // __linux__
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>     // _mm_pause
+#endif
+
+#include <atomic>
+#include <thread>     // hardware_concurrency
+#include <algorithm>  // min, max
+#include <climits>    // INT_MAX
+#include <cstring>    // memcpy, memcmp
+#include <cerrno>
+
+
+namespace own {
+
+
+#ifdef __linux__
+
+//======================================================================================================================
+//  layout of the shared memory
+
+/// One direction of the channel, written by one side and read by the other.
+/** The positions only grow and wrap around the ring by masking, so the ring is empty when they are equal
+  * and full when they differ by the ring size. Each side writes only its own cache line. */
+struct SharedRing
+{
+	// written by the producer
+	alignas( 64 ) std::atomic< uint64_t > head;   ///< how many bytes have been written in total
+	std::atomic< uint32_t > dataSignal;           ///< futex the consumer sleeps on, changed when data are added
+	std::atomic< uint32_t > producerSleeping;     ///< set while the producer may be sleeping on spaceSignal
+
+	// written by the consumer
+	alignas( 64 ) std::atomic< uint64_t > tail;   ///< how many bytes have been read in total
+	std::atomic< uint32_t > spaceSignal;          ///< futex the producer sleeps on, changed when space is freed
+	std::atomic< uint32_t > consumerSleeping;     ///< set while the consumer may be sleeping on dataSignal
+};
+
+/// Beginning of the shared memory, the data of the two rings follow it.
+struct SharedChannelHeader
+{
+	char magic [8];
+	uint64_t ringSize;
+	std::atomic< uint32_t > secondSideConnected;
+	std::atomic< uint32_t > closed [2];           ///< set when the side disconnects
+	std::atomic< int32_t > pids [2];              ///< process of each side, to notice when it dies without disconnecting
+	SharedRing rings [2];                         ///< rings[i] is written by side i
+
+	static constexpr char MAGIC [8] = { 'C', 'P', 'U', 'S', 'H', 'M', 'C', 'H' };
+};
+constexpr char SharedChannelHeader::MAGIC [8];
+
+static_assert( std::atomic< uint64_t >::is_always_lock_free && std::atomic< uint32_t >::is_always_lock_free,
+               "the atomics in shared memory must not be implemented with a lock private to the process" );
+
+static constexpr size_t DATA_OFFSET = (sizeof(SharedChannelHeader) + 63) & ~size_t(63);
+static constexpr size_t MIN_RING_SIZE = 4096;
+
+static SharedChannelHeader & _header( void * shared ) noexcept
+{
+	return *static_cast< SharedChannelHeader * >( shared );
+}
+
+static uint8_t * _ringData( void * shared, unsigned side ) noexcept
+{
+	return static_cast< uint8_t * >( shared ) + DATA_OFFSET + side * _header( shared ).ringSize;
+}
+
+
+//======================================================================================================================
+//  waiting for the other side
+
+static inline void _cpuRelax() noexcept
+{
+ #if defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+ #elif defined(__aarch64__) || defined(__arm__)
+	asm volatile( "yield" );
+ #endif
+}
+
+/// returns false if the timeout has expired
+static bool _futexWait( std::atomic< uint32_t > & word, uint32_t expected, const struct timespec * timeout ) noexcept
+{
+	// not FUTEX_PRIVATE_FLAG, the other side is in another process
+	long result = ::syscall( SYS_futex, reinterpret_cast< uint32_t * >( &word ), FUTEX_WAIT, expected, timeout, nullptr, 0 );
+	return result == 0 || errno != ETIMEDOUT;
+}
+
+static void _futexWake( std::atomic< uint32_t > & word ) noexcept
+{
+	::syscall( SYS_futex, reinterpret_cast< uint32_t * >( &word ), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0 );
+}
+
+/// Whether the process still runs, a process that has ended but hasn't been reaped by its parent yet counts as ended.
+static bool _isProcessAlive( int32_t pid ) noexcept
+{
+ #ifdef SYS_pidfd_open
+	int pidHandle = int( ::syscall( SYS_pidfd_open, pid_t( pid ), 0 ) );
+	if (pidHandle >= 0)
+	{
+		// the handle becomes readable when the process ends
+		struct pollfd pollEntry = { pidHandle, POLLIN, 0 };
+		int readyCount = ::poll( &pollEntry, 1, 0 );
+		::close( pidHandle );
+		return readyCount != 1;
+	}
+	if (errno == ESRCH)
+	{
+		return false;
+	}
+ #endif // SYS_pidfd_open
+	// kernels older than 5.3, this one takes an unreaped process as alive
+	return ::kill( pid_t( pid ), 0 ) == 0 || errno == EPERM;
+}
+
+/// whether the other side may still send something or free some space
+static bool _isPeerAlive( const SharedChannelHeader & header, unsigned side ) noexcept
+{
+	int32_t peerPid = header.pids[ 1 - side ].load( std::memory_order_acquire );
+	return peerPid == 0 || _isProcessAlive( peerPid );  // 0 when the second side hasn't connected yet
+}
+
+/// how often a side sleeping on the signal checks whether the other side hasn't died without disconnecting
+static constexpr std::chrono::milliseconds PEER_CHECK_PERIOD { 100 };
+
+enum class WaitResult
+{
+	Ready,
+	TimedOut,
+	PeerDead,
+};
+
+/// Waits until ready() holds, first polling it for the spin time and then sleeping on the signal.
+/** Before sleeping it announces it in the sleeping flag and checks the condition once more, while the other side first
+  * makes the condition true and then checks the flag, so at least one of them always sees the other's change.
+  * Zero timeout means waiting forever. The sleep is cut into PEER_CHECK_PERIOD long parts, after each of them
+  * peerAlive() is checked, because a process that crashes or gets killed never sets its closed flag. */
+template< typename Ready, typename PeerAlive >
+static WaitResult _waitUntil(
+	const Ready & ready, const PeerAlive & peerAlive, std::atomic< uint32_t > & signal, std::atomic< uint32_t > & sleeping,
+	std::chrono::microseconds spinTime, std::chrono::milliseconds timeout
+) noexcept
+{
+	using Clock = std::chrono::steady_clock;
+
+	if (ready())
+		return WaitResult::Ready;
+
+	auto start = Clock::now();
+	if (spinTime.count() > 0)
+	{
+		do
+		{
+			for (unsigned i = 0; i < 64; ++i)
+			{
+				_cpuRelax();
+				if (ready())
+					return WaitResult::Ready;
+			}
+		}
+		while (Clock::now() - start < spinTime);
+	}
+
+	while (true)
+	{
+		uint32_t signalValue = signal.load( std::memory_order_acquire );
+		sleeping.store( 1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if (ready())
+		{
+			sleeping.store( 0, std::memory_order_relaxed );
+			return WaitResult::Ready;
+		}
+
+		std::chrono::nanoseconds sleepTime = PEER_CHECK_PERIOD;
+		if (timeout.count() > 0)
+		{
+			auto left = std::chrono::duration_cast< std::chrono::nanoseconds >( timeout - (Clock::now() - start) );
+			if (left.count() <= 0)
+			{
+				sleeping.store( 0, std::memory_order_relaxed );
+				return WaitResult::TimedOut;
+			}
+			sleepTime = (std::min)( sleepTime, left );
+		}
+		struct timespec sleepSpec;
+		sleepSpec.tv_sec = time_t( sleepTime.count() / 1000000000 );
+		sleepSpec.tv_nsec = long( sleepTime.count() % 1000000000 );
+
+		// returns immediately if the signal has changed since we read it, so a wake-up can't get lost
+		bool woken = _futexWait( signal, signalValue, &sleepSpec );
+		sleeping.store( 0, std::memory_order_relaxed );
+
+		if (!woken && !peerAlive())
+		{
+			// whatever it managed to do before dying still counts
+			return ready() ? WaitResult::Ready : WaitResult::PeerDead;
+		}
+	}
+}
+
+/// Wakes the other side if it's sleeping, called after the condition it waits for has been made true.
+static void _wakeIfSleeping( std::atomic< uint32_t > & signal, std::atomic< uint32_t > & sleeping ) noexcept
+{
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	if (sleeping.load( std::memory_order_relaxed ))
+	{
+		signal.fetch_add( 1, std::memory_order_release );
+		_futexWake( signal );
+	}
+}
+
+static void _wakeAlways( std::atomic< uint32_t > & signal ) noexcept
+{
+	signal.fetch_add( 1, std::memory_order_release );
+	_futexWake( signal );
+}
+
+/// free space of a ring, where the tail is written by the other process, which may be broken and write nonsense
+static uint64_t _freeSpace( uint64_t head, uint64_t tail, uint64_t ringSize ) noexcept
+{
+	uint64_t used = head - tail;
+	return used < ringSize ? ringSize - used : 0;
+}
+
+#endif // __linux__
+
+
+//======================================================================================================================
+//  SharedMemoryChannel
+
+static std::chrono::microseconds _defaultSpinTime() noexcept
+{
+	// with a single core the other side can't make any progress while we spin
+	return std::chrono::microseconds( std::thread::hardware_concurrency() > 1 ? 50 : 0 );
+}
+
+SharedMemoryChannel::SharedMemoryChannel() noexcept
+:
+	_shared( nullptr ),
+	_sharedSize( 0 ),
+	_memoryHandle( -1 ),
+	_side( 0 ),
+	_peerClosed( false ),
+	_timeout( 0 ),
+	_spinTime( _defaultSpinTime() ),
+	_lastSystemError( 0 )
+{}
+
+SharedMemoryChannel::~SharedMemoryChannel() noexcept
+{
+	if (isConnected())
+		disconnect();
+}
+
+SharedMemoryChannel::SharedMemoryChannel( SharedMemoryChannel && other ) noexcept
+:
+	SharedMemoryChannel()
+{
+	*this = move( other );
+}
+
+SharedMemoryChannel & SharedMemoryChannel::operator=( SharedMemoryChannel && other ) noexcept
+{
+	if (isConnected())
+		disconnect();
+
+	_shared = other._shared;
+	_sharedSize = other._sharedSize;
+	_memoryHandle = other._memoryHandle;
+	_side = other._side;
+	_peerClosed = other._peerClosed;
+	_timeout = other._timeout;
+	_spinTime = other._spinTime;
+	_lastSystemError = other._lastSystemError;
+	other._shared = nullptr;
+	other._sharedSize = 0;
+	other._memoryHandle = -1;
+
+	return *this;
+}
+
+SocketError SharedMemoryChannel::create( size_t ringSize ) noexcept
+{
+	if (isConnected())
+	{
+		return SocketError::AlreadyConnected;
+	}
+
+ #ifdef __linux__
+	size_t roundedSize = MIN_RING_SIZE;
+	while (roundedSize < ringSize)
+		roundedSize *= 2;
+	size_t size = DATA_OFFSET + 2 * roundedSize;
+
+	// the memory is anonymous, it exists only while some process has it mapped or holds the handle
+	// close-on-exec like the sockets, the caller decides whether a program it starts gets the handle
+	int memoryHandle = ::memfd_create( "CppUtils-SharedMemoryChannel", MFD_CLOEXEC );
+	if (memoryHandle < 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+
+	if (::ftruncate( memoryHandle, off_t( size ) ) != 0)
+	{
+		_lastSystemError = getLastError();
+		::close( memoryHandle );
+		return SocketError::Other;
+	}
+
+	SocketError error = _map( memoryHandle, size );
+	if (error != SocketError::Success)
+	{
+		::close( memoryHandle );
+		return error;
+	}
+
+	// the new memory is zeroed, which is the initial state of all the positions and flags
+	SharedChannelHeader & header = _header( _shared );
+	memcpy( header.magic, SharedChannelHeader::MAGIC, sizeof(header.magic) );
+	header.ringSize = roundedSize;
+	header.pids[0].store( int32_t( ::getpid() ), std::memory_order_release );
+
+	_memoryHandle = memoryHandle;
+	_side = 0;
+	_peerClosed = false;
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #else
+	(void)ringSize;
+	return SocketError::NotSupported;
+ #endif // __linux__
+}
+
+SocketError SharedMemoryChannel::connect( int memoryHandle ) noexcept
+{
+	if (isConnected())
+	{
+		return SocketError::AlreadyConnected;
+	}
+
+ #ifdef __linux__
+	struct stat memoryInfo;
+	if (::fstat( memoryHandle, &memoryInfo ) != 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::ConnectFailed;
+	}
+	size_t size = size_t( memoryInfo.st_size );
+	if (size < DATA_OFFSET)
+	{
+		return SocketError::ConnectFailed;
+	}
+
+	SocketError error = _map( memoryHandle, size );
+	if (error != SocketError::Success)
+	{
+		return error;
+	}
+
+	SharedChannelHeader & header = _header( _shared );
+	bool valid = memcmp( header.magic, SharedChannelHeader::MAGIC, sizeof(header.magic) ) == 0
+	          && header.ringSize >= MIN_RING_SIZE && size == DATA_OFFSET + 2 * header.ringSize;
+	if (!valid || header.secondSideConnected.exchange( 1 ) != 0)
+	{
+		_unmap();
+		return SocketError::ConnectFailed;
+	}
+	header.pids[1].store( int32_t( ::getpid() ), std::memory_order_release );
+
+	_memoryHandle = -1;
+	_side = 1;
+	_peerClosed = false;
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #else
+	(void)memoryHandle;
+	return SocketError::NotSupported;
+ #endif // __linux__
+}
+
+SocketError SharedMemoryChannel::disconnect() noexcept
+{
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+ #ifdef __linux__
+	SharedChannelHeader & header = _header( _shared );
+	header.closed[ _side ].store( 1, std::memory_order_release );
+
+	// the other side may be sleeping either until we send something or until we free some space
+	_wakeAlways( header.rings[ _side ].dataSignal );
+	_wakeAlways( header.rings[ 1 - _side ].spaceSignal );
+
+	_unmap();
+	if (_memoryHandle >= 0)
+	{
+		::close( _memoryHandle );  // the memory lives on while the other side has it mapped
+		_memoryHandle = -1;
+	}
+ #endif // __linux__
+
+	_lastSystemError = 0;
+	return SocketError::Success;
+}
+
+bool SharedMemoryChannel::setTimeout( std::chrono::milliseconds timeout ) noexcept
+{
+	_timeout = timeout;
+	return true;
+}
+
+SocketError SharedMemoryChannel::_map( int memoryHandle, size_t size ) noexcept
+{
+ #ifdef __linux__
+	void * shared = ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memoryHandle, 0 );
+	if (shared == MAP_FAILED)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+	_shared = shared;
+	_sharedSize = size;
+	return SocketError::Success;
+ #else
+	(void)memoryHandle;
+	(void)size;
+	return SocketError::NotSupported;
+ #endif // __linux__
+}
+
+void SharedMemoryChannel::_unmap() noexcept
+{
+ #ifdef __linux__
+	::munmap( _shared, _sharedSize );
+ #endif // __linux__
+	_shared = nullptr;
+	_sharedSize = 0;
+}
+
+//-- sending -----------------------------------------------------------------------------------------------------------
+
+SocketError SharedMemoryChannel::send( const_byte_span buffer ) noexcept
+{
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+ #ifdef __linux__
+	SharedChannelHeader & header = _header( _shared );
+	SharedRing & ring = header.rings[ _side ];
+	std::atomic< uint32_t > & peerClosed = header.closed[ 1 - _side ];
+	uint8_t * data = _ringData( _shared, _side );
+	const uint64_t ringSize = header.ringSize;
+
+	const uint8_t * sendBegin = buffer.data();
+	size_t sendSize = buffer.size();
+	uint64_t head = ring.head.load( std::memory_order_relaxed );
+	while (sendSize > 0)
+	{
+		uint64_t freeSpace = _freeSpace( head, ring.tail.load( std::memory_order_acquire ), ringSize );
+		bool peerDead = false;
+		if (freeSpace == 0)
+		{
+			auto ready = [&]()
+			{
+				return head - ring.tail.load( std::memory_order_acquire ) < ringSize
+				    || peerClosed.load( std::memory_order_acquire ) != 0;
+			};
+			auto peerAlive = [&]()  { return _isPeerAlive( header, _side ); };
+			WaitResult waitResult = _waitUntil(
+				ready, peerAlive, ring.spaceSignal, ring.producerSleeping, _spinTime, std::chrono::milliseconds( 0 )
+			);
+			peerDead = waitResult == WaitResult::PeerDead;
+			freeSpace = _freeSpace( head, ring.tail.load( std::memory_order_acquire ), ringSize );
+		}
+		if (peerDead || peerClosed.load( std::memory_order_acquire ) != 0)
+		{
+			_lastSystemError = EPIPE;
+			return SocketError::SendFailed;
+		}
+
+		size_t chunk = size_t( (std::min)( uint64_t( sendSize ), freeSpace ) );
+		size_t offset = size_t( head & (ringSize - 1) );
+		size_t firstPart = (std::min)( chunk, size_t( ringSize ) - offset );
+		memcpy( data + offset, sendBegin, firstPart );
+		memcpy( data, sendBegin + firstPart, chunk - firstPart );
+
+		head += chunk;
+		ring.head.store( head, std::memory_order_release );
+		_wakeIfSleeping( ring.dataSignal, ring.consumerSleeping );
+
+		sendBegin += chunk;
+		sendSize -= chunk;
+	}
+
+	_lastSystemError = 0;
+	return SocketError::Success;
+ #else
+	(void)buffer;
+	return SocketError::NotSupported;
+ #endif // __linux__
+}
+
+SocketError SharedMemoryChannel::send( const char * message ) noexcept
+{
+	return send( make_span( reinterpret_cast< const uint8_t * >( message ), strlen( message ) ) );
+}
+
+//-- receiving ---------------------------------------------------------------------------------------------------------
+
+SocketError SharedMemoryChannel::_waitForData( uint64_t & available ) noexcept
+{
+	if (_peerClosed)
+	{
+		available = 0;
+		return SocketError::ConnectionClosed;
+	}
+
+ #ifdef __linux__
+	SharedChannelHeader & header = _header( _shared );
+	SharedRing & ring = header.rings[ 1 - _side ];
+	std::atomic< uint32_t > & peerClosed = header.closed[ 1 - _side ];
+	const uint64_t tail = ring.tail.load( std::memory_order_relaxed );
+
+	auto ready = [&]()
+	{
+		return ring.head.load( std::memory_order_acquire ) != tail || peerClosed.load( std::memory_order_acquire ) != 0;
+	};
+	auto peerAlive = [&]()  { return _isPeerAlive( header, _side ); };
+	WaitResult waitResult = _waitUntil( ready, peerAlive, ring.dataSignal, ring.consumerSleeping, _spinTime, _timeout );
+	if (waitResult == WaitResult::TimedOut)
+	{
+		available = 0;
+		_lastSystemError = ETIMEDOUT;
+		return SocketError::Timeout;
+	}
+
+	// the other side closes only after its last write, so what's in the ring now is everything,
+	// and a dead one doesn't write anything more either
+	bool closed = waitResult == WaitResult::PeerDead || peerClosed.load( std::memory_order_acquire ) != 0;
+	// the positions are written by the other process, so don't let a broken one make us read past the ring
+	available = (std::min)( ring.head.load( std::memory_order_acquire ) - tail, uint64_t( header.ringSize ) );
+	if (available == 0 && closed)
+	{
+		// Only remember it, unmapping here would pull the memory from under send() running in another thread,
+		// the owner releases it with disconnect().
+		_peerClosed = true;
+		return SocketError::ConnectionClosed;
+	}
+
+	return SocketError::Success;
+ #else
+	available = 0;
+	return SocketError::NotSupported;
+ #endif // __linux__
+}
+
+size_t SharedMemoryChannel::_read( uint8_t * dest, size_t size, uint64_t available ) noexcept
+{
+ #ifdef __linux__
+	SharedChannelHeader & header = _header( _shared );
+	SharedRing & ring = header.rings[ 1 - _side ];
+	const uint8_t * data = _ringData( _shared, 1 - _side );
+	const uint64_t ringSize = header.ringSize;
+
+	uint64_t tail = ring.tail.load( std::memory_order_relaxed );
+	size_t chunk = size_t( (std::min)( uint64_t( size ), available ) );
+	size_t offset = size_t( tail & (ringSize - 1) );
+	size_t firstPart = (std::min)( chunk, size_t( ringSize ) - offset );
+	memcpy( dest, data + offset, firstPart );
+	memcpy( dest + firstPart, data, chunk - firstPart );
+
+	ring.tail.store( tail + chunk, std::memory_order_release );
+	_wakeIfSleeping( ring.spaceSignal, ring.producerSleeping );
+
+	return chunk;
+ #else
+	(void)dest;
+	(void)size;
+	(void)available;
+	return 0;
+ #endif // __linux__
+}
+
+SocketError SharedMemoryChannel::receive( byte_span buffer, size_t & totalReceived ) noexcept
+{
+	totalReceived = 0;
+
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	while (totalReceived < buffer.size())
+	{
+		uint64_t available;
+		SocketError error = _waitForData( available );
+		if (error != SocketError::Success)
+		{
+			return error;
+		}
+		totalReceived += _read( buffer.data() + totalReceived, buffer.size() - totalReceived, available );
+	}
+
+	_lastSystemError = 0;
+	return SocketError::Success;
+}
+
+SocketError SharedMemoryChannel::receive( std::vector< uint8_t > & buffer, size_t size ) noexcept
+{
+	buffer.resize( size );
+	size_t received;
+	SocketError result = receive( make_span( buffer ), received );
+	buffer.resize( received );
+	return result;
+}
+
+SocketError SharedMemoryChannel::receiveOnce( byte_span buffer, size_t & received ) noexcept
+{
+	received = 0;
+
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	uint64_t available;
+	SocketError error = _waitForData( available );
+	if (error != SocketError::Success)
+	{
+		return error;
+	}
+	received = _read( buffer.data(), buffer.size(), available );
+
+	_lastSystemError = 0;
+	return SocketError::Success;
+}
+
+SocketError SharedMemoryChannel::receiveOnce( std::vector< uint8_t > & buffer ) noexcept
+{
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	uint64_t available;
+	SocketError error = _waitForData( available );
+	if (error != SocketError::Success)
+	{
+		return error;
+	}
+	buffer.resize( size_t( available ) );
+	_read( buffer.data(), buffer.size(), available );
+
+	_lastSystemError = 0;
+	return SocketError::Success;
+}
+
+
+//======================================================================================================================
+
+
+} // namespace own
@@ -0,0 +1,136 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: byte stream between processes on the same machine through a pair of rings in shared memory
+//======================================================================================================================
+
+#ifndef CPPUTILS_SHAREDMEMORYCHANNEL_INCLUDED
+#define CPPUTILS_SHAREDMEMORYCHANNEL_INCLUDED
+
+
+#include "Socket.hpp"
+
+#include <CppUtils-Essential/Span.hpp>
+
+#include <chrono>
+#include <vector>
+
+
+namespace own {
+
+
+//======================================================================================================================
+/// Bidirectional byte stream between two processes through shared memory, with the same send and receive operations
+/// as TcpSocket, so that code written as a template over the connection type can use either of them.
+/** One process creates the shared memory, which holds a ring buffer for each direction, and the other process connects
+  * to it through its handle, which it has to get from the first one, most simply by inheriting it (fork, or exec with
+  * the handle made inheritable, as it's created close-on-exec). Each ring has a single writer and a single reader,
+  * so the data pass without any system call and without any lock. A side that waits for data or for free space first
+  * polls the ring for the spin time and only then goes to sleep in the system (futex), and the other side then has
+  * to wake it with a system call.
+  * With the spin time longer than the gap between the messages, the one-way latency is a fraction of a microsecond,
+  * but it costs a busy CPU core on each side, so on a machine with a single core the default spin time is 0.
+  *
+  * A side that crashes or gets killed can't say it's leaving, so the sleeping side checks every 100 ms whether
+  * the process that created or connected the other side still runs, and treats its end as a disconnect.
+  *
+  * Like the socket classes, one object must not be used from more than one thread at a time, but one thread may send
+  * while another one receives. Only on Linux, elsewhere the operations return SocketError::NotSupported. */
+
+class SharedMemoryChannel
+{
+
+ public:
+
+	SharedMemoryChannel() noexcept;
+	~SharedMemoryChannel() noexcept;
+
+	SharedMemoryChannel( const SharedMemoryChannel & other ) = delete;
+	SharedMemoryChannel( SharedMemoryChannel && other ) noexcept;
+	SharedMemoryChannel & operator=( const SharedMemoryChannel & other ) = delete;
+	SharedMemoryChannel & operator=( SharedMemoryChannel && other ) noexcept;
+
+	/// Creates the shared memory and connects to it as the first side.
+	/** \param[in] ringSize capacity of each of the two directions, rounded up to a power of two,
+	  *                     a single send bigger than that is passed in parts */
+	SocketError create( size_t ringSize = 256 * 1024 ) noexcept;
+
+	/// Connects as the second side to the shared memory created by another process.
+	/** The channel doesn't take over the handle, the caller may close it afterwards.
+	  * Fails with SocketError::ConnectFailed if the memory is not a channel or another process has already connected to it.
+	  * \param[in] memoryHandle getMemoryHandle() of the creating side */
+	SocketError connect( int memoryHandle ) noexcept;
+
+	/// Closes this side, the other side receives the remaining data and then SocketError::ConnectionClosed,
+	/// the same as when the process of this side ends.
+	/** Unlike with the sockets, receiving ConnectionClosed doesn't close this side, because a send may be running
+	  * in another thread at that moment, so the channel has to be closed by this or by the destructor. */
+	SocketError disconnect() noexcept;
+
+	bool isConnected() const noexcept  { return _shared != nullptr; }
+
+	/// The system handle of the shared memory, to be passed to the process that connects to it, -1 on the connecting side.
+	int getMemoryHandle() const noexcept  { return _memoryHandle; }
+
+	/// Sets the timeout for further receive operations.
+	bool setTimeout( std::chrono::milliseconds timeout ) noexcept;
+
+	/// How long to poll the ring for data or free space before going to sleep.
+	void setSpinTime( std::chrono::microseconds spinTime ) noexcept  { _spinTime = spinTime; }
+
+	/// Writes all the bytes into the ring, waiting for free space when it's full.
+	/** Fails with SocketError::SendFailed when the other side disconnects or its process ends. */
+	SocketError send( const_byte_span buffer ) noexcept;
+
+	/// Convenience wrapper of send( const_byte_span ) for sending textual data.
+	/** \param[in] message null-terminated array of chars */
+	SocketError send( const char * message ) noexcept;
+
+	/// Receives the given number of bytes, waiting until all of them arrive.
+	/** \param[out] received how many bytes were really received */
+	SocketError receive( byte_span buffer, size_t & received ) noexcept;
+
+	/// Receives the given number of bytes, waiting until all of them arrive.
+	/** After the call, the size of the vector will be equal to the number of bytes actually received.
+	  * \param[in] size how many bytes to receive */
+	SocketError receive( std::vector< uint8_t > & buffer, size_t size ) noexcept;
+
+	/// Waits until some data arrive and returns all that fit into the buffer.
+	SocketError receiveOnce( byte_span buffer, size_t & received ) noexcept;
+
+	/// Waits until some data arrive and returns all of them.
+	SocketError receiveOnce( std::vector< uint8_t > & buffer ) noexcept;
+
+	/// Returns the system error code that was recorded the last time an operation on this channel failed.
+	system_error_t getLastSystemError() const noexcept  { return _lastSystemError; }
+
+ private:
+
+	SocketError _map( int memoryHandle, size_t size ) noexcept;
+	void _unmap() noexcept;
+
+	/// waits until there are data to read or the other side is gone, returns how many bytes can be read
+	SocketError _waitForData( uint64_t & available ) noexcept;
+	/// copies out what's available and lets the other side know there is free space again
+	size_t _read( uint8_t * dest, size_t size, uint64_t available ) noexcept;
+
+	void * _shared;           ///< start of the mapping, nullptr when not connected
+	size_t _sharedSize;
+	int _memoryHandle;
+	unsigned _side;           ///< 0 for the creating one, 1 for the connecting one
+	bool _peerClosed;         ///< the other side has closed and everything it sent has been received
+	std::chrono::milliseconds _timeout;  ///< 0 means no timeout
+	std::chrono::microseconds _spinTime;
+	system_error_t _lastSystemError;
+
+};
+
+
+//======================================================================================================================
+
+
+} // namespace own
+
+
+#endif // CPPUTILS_SHAREDMEMORYCHANNEL_INCLUDED
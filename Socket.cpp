@@ -6,6 +6,7 @@
 //======================================================================================================================
 
 #include "Socket.hpp"
+#include "MirroredRingBuffer.hpp"
 
 #include <CppUtils-Essential/LangUtils.hpp>   // scope_guard
 #include <CppUtils-Essential/CriticalError.hpp>
@@ -13,12 +14,14 @@
 #ifdef _WIN32
 	#include <winsock2.h>      // socket, closesocket
 	#include <ws2tcpip.h>      // addrinfo
+	#include <afunix.h>        // sockaddr_un
 
 	using in_addr_t = unsigned long;  // linux has in_addr_t, windows has unsigned long
 	using socklen_t = int;            // linux has socklen_t, windows has int
 
 	constexpr own::socket_t INVALID_SOCK = INVALID_SOCKET;
 	constexpr own::system_error_t SUCCESS = ERROR_SUCCESS;
+	constexpr own::system_error_t NAME_TOO_LONG = WSAENAMETOOLONG;
 #else
 	#include <unistd.h>        // open, close, read, write
 	#include <fcntl.h>         // fnctl, O_NONBLOCK
@@ -26,14 +29,45 @@
 	#include <sys/socket.h>    // socket
 	#include <netdb.h>         // getaddrinfo, gethostbyname
 	#include <netinet/in.h>    // sockaddr_in, in_addr, ntoh, hton
+	#include <netinet/tcp.h>   // TCP_NODELAY, TCP_CORK
 	#include <arpa/inet.h>     // inet_addr, inet_ntoa
+	#include <sys/uio.h>       // iovec
+	#include <sys/un.h>        // sockaddr_un
+ #ifdef __linux__
+	#include <netinet/udp.h>   // UDP_SEGMENT, UDP_GRO
+	#ifndef UDP_SEGMENT
+		#define UDP_SEGMENT 103  // older system headers don't have it, but the kernel may still support it
+	#endif
+	#ifndef UDP_GRO
+		#define UDP_GRO 104
+	#endif
+	#ifndef SOL_UDP
+		#define SOL_UDP 17
+	#endif
+	#include <time.h>          // CLOCK_MONOTONIC
+	#ifndef IP_MULTICAST_ALL
+		#define IP_MULTICAST_ALL 49
+	#endif
+	#ifndef IPV6_MULTICAST_ALL
+		#define IPV6_MULTICAST_ALL 29
+	#endif
+	#ifndef SO_TXTIME
+		#define SO_TXTIME 61
+		#define SCM_TXTIME SO_TXTIME
+	#endif
+ #endif // __linux__
 
 	constexpr own::socket_t INVALID_SOCK = -1;
 	constexpr own::system_error_t SUCCESS = 0;
+	constexpr own::system_error_t NAME_TOO_LONG = ENAMETOOLONG;
 #endif // _WIN32
 
 #include <mutex>
 #include <cstring>  // memset, strlen
+#include <cstddef>  // offsetof
+#include <cstdio>   // remove
+#include <cstdlib>  // getenv, setenv, strtoull
+#include <algorithm>  // min
 
 
 namespace own {
@@ -56,9 +90,13 @@ const char * enumString( SocketError error ) noexcept
 		case SocketError::ConnectionClosed:     return "ConnectionClosed";
 		case SocketError::Timeout:              return "Timeout";
 		case SocketError::WouldBlock:           return "WouldBlock";
+		case SocketError::MalformedMessage:     return "MalformedMessage";
 		case SocketError::AlreadyOpen:          return "AlreadyOpen";
 		case SocketError::BindFailed:           return "BindFailed";
 		case SocketError::ListenFailed:         return "ListenFailed";
+		case SocketError::WrongSocketType:      return "WrongSocketType";
+		case SocketError::NotSupported:         return "NotSupported";
+		case SocketError::MembershipFailed:     return "MembershipFailed";
 		default:                                return "Other";
 	}
 }
@@ -185,6 +223,43 @@ static bool _isWouldBlock( system_error_t errorCode ) noexcept
  #endif // _WIN32
 }
 
+static bool _setReuseAddr( socket_t sock ) noexcept
+{
+	// for UDP this allows multiple sockets to bind the same address and port,
+	// the system then delivers each datagram to the socket that matches its source most specifically
+	int enable = 1;
+	return ::setsockopt( sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&enable, sizeof(enable) ) == 0;
+}
+
+static bool _setReusePort( socket_t sock ) noexcept
+{
+ #ifdef SO_REUSEPORT
+	int enable = 1;
+	return ::setsockopt( sock, SOL_SOCKET, SO_REUSEPORT, (const char *)&enable, sizeof(enable) ) == 0;
+ #else
+	(void)sock;
+	return false;
+ #endif
+}
+
+static bool _isConnectionRefused( system_error_t errorCode ) noexcept
+{
+ #ifdef _WIN32
+	return errorCode == WSAECONNRESET || errorCode == WSAECONNREFUSED;
+ #else
+	return errorCode == ECONNREFUSED;
+ #endif // _WIN32
+}
+
+static bool _isNotConnected( system_error_t errorCode ) noexcept
+{
+ #ifdef _WIN32
+	return errorCode == WSAENOTCONN;
+ #else
+	return errorCode == ENOTCONN;
+ #endif // _WIN32
+}
+
 static bool _setBlockingMode( socket_t sock, bool enable ) noexcept
 {
 #ifdef _WIN32
@@ -204,6 +279,83 @@ static bool _setBlockingMode( socket_t sock, bool enable ) noexcept
 #endif
 }
 
+/// Reads the blocking mode of a handle that was created elsewhere.
+static bool _getBlockingMode( socket_t sock ) noexcept
+{
+ #ifdef _WIN32
+	(void)sock;
+	return true;  // Windows can't tell, sockets are created blocking and it's the usual state of inherited ones too
+ #else
+	return (::fcntl( sock, F_GETFL, 0 ) & O_NONBLOCK) == 0;
+ #endif // _WIN32
+}
+
+static bool _setInheritable( socket_t sock, bool enable ) noexcept
+{
+ #ifdef _WIN32
+	return ::SetHandleInformation( (HANDLE)sock, HANDLE_FLAG_INHERIT, enable ? HANDLE_FLAG_INHERIT : 0 ) != 0;
+ #else
+	int flags = ::fcntl( sock, F_GETFD, 0 );
+	if (flags == -1)
+		return false;
+
+	if (enable)
+		flags &= ~FD_CLOEXEC;
+	else
+		flags |= FD_CLOEXEC;
+
+	return ::fcntl( sock, F_SETFD, flags ) == 0;
+ #endif // _WIN32
+}
+
+/// AF_INET or AF_INET6, it decides which of the two variants of the socket options has to be used
+static int _getSocketFamily( socket_t sock ) noexcept
+{
+ #ifdef _WIN32
+	WSAPROTOCOL_INFOW info;
+	int infoLen = sizeof(info);
+	if (::getsockopt( sock, SOL_SOCKET, SO_PROTOCOL_INFOW, (char *)&info, &infoLen ) != 0)
+		return AF_UNSPEC;
+	return info.iAddressFamily;
+ #else
+	// works also on a socket that is not bound yet
+	struct sockaddr_storage addr;
+	socklen_t addrlen = sizeof(addr);
+	if (::getsockname( sock, (struct sockaddr *)&addr, &addrlen ) != 0)
+		return AF_UNSPEC;
+	return addr.ss_family;
+ #endif // _WIN32
+}
+
+/// Checks that a handle this process got from elsewhere is an IP socket of the expected type before it is adopted.
+static SocketError _checkAdoptable( socket_t sock, int type, bool listening, system_error_t & error ) noexcept
+{
+	// this fails also when the handle is not a socket at all or it's not open in this process
+	int actualType = 0;
+	socklen_t optlen = sizeof(actualType);
+	if (::getsockopt( sock, SOL_SOCKET, SO_TYPE, (char *)&actualType, &optlen ) != 0)
+	{
+		error = getLastError();
+		return SocketError::Other;
+	}
+
+	int acceptsConnections = 0;
+	optlen = sizeof(acceptsConnections);
+	if (::getsockopt( sock, SOL_SOCKET, SO_ACCEPTCONN, (char *)&acceptsConnections, &optlen ) != 0)
+	{
+		error = getLastError();
+		return SocketError::Other;
+	}
+
+	int family = _getSocketFamily( sock );
+	if (actualType != type || (family != AF_INET && family != AF_INET6) || (acceptsConnections != 0) != listening)
+	{
+		return SocketError::WrongSocketType;
+	}
+
+	return SocketError::Success;
+}
+
 
 //======================================================================================================================
 //  ASocket
@@ -251,6 +403,14 @@ bool ASocket::setBlockingMode( bool enable ) noexcept
 	return success;
 }
 
+bool ASocket::setInheritable( bool enable ) noexcept
+{
+	bool success = _setInheritable( _socket, enable );
+	if (!success)
+		_lastSystemError = getLastError();
+	return success;
+}
+
 
 //======================================================================================================================
 //  TcpSocket
@@ -321,13 +481,69 @@ SocketError TcpSocket::connect( const IPAddr & addr, uint16_t port )
 		return SocketError::NetworkingInitFailed;
 	}
 
-	struct sockaddr_storage saddr; int addrlen;
-	endpointToSockaddr( { addr, port }, (struct sockaddr *)&saddr, addrlen );
+	NativeEndpoint endpoint( addr, port );
+	return _connect( endpoint.saddr()->sa_family, endpoint.saddrLen(), endpoint.saddr() );
+}
+
+SocketError TcpSocket::connect( const NativeEndpoint & endpoint )
+{
+	if (isConnected())
+	{
+		return SocketError::AlreadyConnected;
+	}
+
+	if (!endpoint.isValid())
+	{
+		critical_error( "Attempted socket operation with empty NativeEndpoint." );
+	}
+
+	bool initialized = g_netSystem.initializeIfNotAlready();
+	if (!initialized)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::NetworkingInitFailed;
+	}
+
+	return _connect( endpoint.saddr()->sa_family, endpoint.saddrLen(), endpoint.saddr() );
+}
+
+SocketError TcpSocket::adopt( socket_t handle ) noexcept
+{
+	if (isConnected())
+	{
+		return SocketError::AlreadyConnected;
+	}
+
+	bool initialized = g_netSystem.initializeIfNotAlready();
+	if (!initialized)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::NetworkingInitFailed;
+	}
+
+	SocketError error = _checkAdoptable( handle, SOCK_STREAM, false, _lastSystemError );
+	if (error != SocketError::Success)
+	{
+		return error;
+	}
+
+	// a TCP socket that is neither listening nor connected is of no use
+	struct sockaddr_storage peer;
+	socklen_t peerLen = sizeof(peer);
+	if (::getpeername( handle, (struct sockaddr *)&peer, &peerLen ) != 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::WrongSocketType;
+	}
 
-	return _connect( saddr.ss_family, addrlen, (struct sockaddr *)&saddr );
+	_socket = handle;
+	_isBlocking = _getBlockingMode( handle );
+	_setInheritable( handle, false );  // not to the children of this process, SocketManifest::add() sets it again
+	_lastSystemError = getLastError();
+	return SocketError::Success;
 }
 
-SocketError TcpSocket::_connect( int family, int addrlen, struct sockaddr * addr ) noexcept
+SocketError TcpSocket::_connect( int family, int addrlen, const struct sockaddr * addr ) noexcept
 {
 	// create a corresponding socket
 	// The Winsock2 sockets are not reusable (after calling shutdown(), a new socket has to be created),
@@ -358,7 +574,8 @@ SocketError TcpSocket::disconnect() noexcept
 		return SocketError::NotConnected;
 	}
 
-	if (!_shutdownSocket( _socket ))
+	// the connection may have been already reset by the other side, then there is nothing left to shut down
+	if (!_shutdownSocket( _socket ) && !_isNotConnected( getLastError() ))
 	{
 		critical_error( "shutdown(socket) should not fail, please investigate, error code = %d", getLastError() );
 	}
@@ -390,7 +607,45 @@ bool TcpSocket::setTimeout( std::chrono::milliseconds timeout ) noexcept
 	return success;
 }
 
+bool TcpSocket::setNoDelay( bool enable ) noexcept
+{
+	int value = enable ? 1 : 0;
+	bool success = ::setsockopt( _socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&value, sizeof(value) ) == 0;
+	_lastSystemError = getLastError();
+	return success;
+}
+
+SocketError TcpSocket::setCork( bool enable ) noexcept
+{
+ #ifdef __linux__
+	int value = enable ? 1 : 0;
+	if (::setsockopt( _socket, IPPROTO_TCP, TCP_CORK, &value, sizeof(value) ) != 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #else
+	return enable ? SocketError::NotSupported : SocketError::Success;
+ #endif // __linux__
+}
+
 SocketError TcpSocket::send( const_byte_span buffer ) noexcept
+{
+	return _send( buffer, 0 );
+}
+
+SocketError TcpSocket::sendMore( const_byte_span buffer ) noexcept
+{
+ #ifdef __linux__
+	return _send( buffer, MSG_MORE );
+ #else
+	return _send( buffer, 0 );
+ #endif // __linux__
+}
+
+SocketError TcpSocket::_send( const_byte_span buffer, int flags ) noexcept
 {
 	if (!isConnected())
 	{
@@ -401,7 +656,7 @@ SocketError TcpSocket::send( const_byte_span buffer ) noexcept
 	size_t sendSize = buffer.size();
 	while (sendSize > 0)
 	{
-		int sent = ::send( _socket, (const char *)sendBegin, (int)sendSize, 0 );
+		int sent = ::send( _socket, (const char *)sendBegin, (int)sendSize, flags );
 		if (sent < 0)
 		{
 			_lastSystemError = getLastError();
@@ -476,11 +731,37 @@ SocketError TcpSocket::receiveOnce( std::vector< uint8_t > & buffer ) noexcept
 	// of the cases while not requiring second dynamic allocation and not using too much stack.
 	uint8_t tempBuffer [10*1024];
 
-	int received = ::recv( _socket, (char *)tempBuffer, (int)sizeof(tempBuffer), 0 );
-	if (received <= 0)
+	size_t received;
+	SocketError result = receiveOnce( make_span( tempBuffer, sizeof(tempBuffer) ), received );
+	if (result != SocketError::Success)
+	{
+		return result;
+	}
+
+	buffer.resize( received );
+	buffer.assign( tempBuffer, tempBuffer + received );
+
+	return SocketError::Success;
+}
+
+SocketError TcpSocket::receiveOnce( byte_span buffer, size_t & received ) noexcept
+{
+	received = 0;
+
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	int result = ::recv( _socket, (char *)buffer.data(), (int)buffer.size(), 0 );
+	if (result <= 0)
 	{
 		_lastSystemError = getLastError();
-		if (received == 0)
+		if (result == 0 && buffer.empty())
+		{
+			return SocketError::Success;  // nothing was asked for
+		}
+		else if (result == 0)
 		{
 			_closeSocket( _socket );  // server closed, so let's close on our side too
 			_socket = INVALID_SOCK;
@@ -500,13 +781,28 @@ SocketError TcpSocket::receiveOnce( std::vector< uint8_t > & buffer ) noexcept
 		}
 	}
 
-	buffer.resize( received );
-	buffer.assign( tempBuffer, tempBuffer + received );
-
+	received = size_t( result );
 	_lastSystemError = getLastError();
 	return SocketError::Success;
 }
 
+SocketError TcpSocket::receiveInto( MirroredRingBuffer & ring, size_t & received ) noexcept
+{
+	received = 0;
+	if (!ring.isAllocated())  // it would look full, as the capacity is 0
+	{
+		return SocketError::NotOpen;
+	}
+	if (ring.full())
+	{
+		critical_error( "Received into a full ring buffer, consume some of the data first." );
+	}
+
+	SocketError result = receiveOnce( ring.writable(), received );
+	ring.commitWrite( received );
+	return result;
+}
+
 //======================================================================================================================
 //  TcpServerSocket
 
@@ -595,29 +891,64 @@ SocketError TcpServerSocket::close() noexcept
 	return SocketError::Success;
 }
 
+SocketError TcpServerSocket::adopt( socket_t handle ) noexcept
+{
+	if (_socket != INVALID_SOCK)
+	{
+		return SocketError::AlreadyOpen;
+	}
+
+	bool initialized = g_netSystem.initializeIfNotAlready();
+	if (!initialized)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::NetworkingInitFailed;
+	}
+
+	SocketError error = _checkAdoptable( handle, SOCK_STREAM, true, _lastSystemError );
+	if (error != SocketError::Success)
+	{
+		return error;
+	}
+
+	_socket = handle;
+	_isBlocking = _getBlockingMode( handle );
+	_setInheritable( handle, false );  // not to the children of this process, SocketManifest::add() sets it again
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
 bool TcpServerSocket::isOpen() const noexcept
 {
 	return _socket != INVALID_SOCK;
 }
 
 TcpSocket TcpServerSocket::accept( Endpoint & endpoint )
+{
+	NativeEndpoint nativeEndpoint;
+	TcpSocket clientSocket = accept( nativeEndpoint );
+	if (clientSocket.isAccepted())
+		endpoint = nativeEndpoint.toEndpoint();
+	return clientSocket;
+}
+
+TcpSocket TcpServerSocket::accept( NativeEndpoint & endpoint )
 {
 	if (!isOpen())
 	{
 		return TcpSocket();
 	}
 
-	struct sockaddr_storage clientAddr;
-	socklen_t claddrSize = sizeof(clientAddr);
+	socklen_t claddrSize = NativeEndpoint::CAPACITY;
 
-	socket_t clientSocket = ::accept( _socket, (struct sockaddr *)&clientAddr, &claddrSize );
+	socket_t clientSocket = ::accept( _socket, endpoint.saddrBuffer(), &claddrSize );
 	if (clientSocket == INVALID_SOCK)
 	{
 		_lastSystemError = getLastError();
 		return TcpSocket();
 	}
 
-	if (!sockaddrToEndpoint( (struct sockaddr *)&clientAddr, endpoint ))
+	if (!endpoint.setSaddrLen( int( claddrSize ) ))
 	{
 		critical_error( "Socket operation returned unexpected address family." );
 	}
@@ -630,9 +961,12 @@ TcpSocket TcpServerSocket::accept( Endpoint & endpoint )
 //======================================================================================================================
 //  UdpSocket
 
-UdpSocket::UdpSocket() noexcept : ASocket() {}
+UdpSocket::UdpSocket() noexcept : ASocket(), _droppedCount( 0 ) {}
 
-UdpSocket::~UdpSocket() noexcept {}  // delegate to ASocket
+UdpSocket::~UdpSocket() noexcept
+{
+	close();
+}
 
 UdpSocket::UdpSocket( UdpSocket && other ) noexcept
 {
@@ -641,10 +975,41 @@ UdpSocket::UdpSocket( UdpSocket && other ) noexcept
 
 UdpSocket & UdpSocket::operator=( UdpSocket && other ) noexcept
 {
-	return static_cast< UdpSocket & >( ASocket::operator=( move( other ) ) );
+	ASocket::operator=( move( other ) );
+	_droppedCount = other._droppedCount;
+	other._droppedCount = 0;
+	return *this;
 }
 
 SocketError UdpSocket::open( uint16_t port ) noexcept
+{
+	return _open( port, PortSharing::None );
+}
+
+SocketError UdpSocket::openLoadBalanced( uint16_t port ) noexcept
+{
+ #ifdef __linux__
+	return _open( port, PortSharing::LoadBalanced );
+ #else
+	(void)port;
+	return SocketError::NotSupported;  // elsewhere SO_REUSEPORT doesn't distribute the datagrams, or it doesn't exist
+ #endif // __linux__
+}
+
+SocketError UdpSocket::openLoadBalanced( const NativeEndpoint & local ) noexcept
+{
+	if (!local.isValid())
+	{
+		critical_error( "Attempted socket operation with empty NativeEndpoint." );
+	}
+ #ifdef __linux__
+	return _open( &local, PortSharing::LoadBalanced );
+ #else
+	return SocketError::NotSupported;
+ #endif // __linux__
+}
+
+SocketError UdpSocket::adopt( socket_t handle ) noexcept
 {
 	if (_socket != INVALID_SOCK)
 	{
@@ -658,84 +1023,1546 @@ SocketError UdpSocket::open( uint16_t port ) noexcept
 		return SocketError::NetworkingInitFailed;
 	}
 
-	// TODO: IPv4 vs IPv6
-	struct sockaddr_in saddr;
-	inet_pton( AF_INET, "127.0.0.1", &saddr.sin_addr );
-	saddr.sin_family = AF_INET;
-	saddr.sin_port = htons( port );
-
-	// create a corresponding socket
-	_socket = ::socket( AF_INET, SOCK_DGRAM, 0 );
-	if (_socket == INVALID_SOCK)
-	{
-		_lastSystemError = getLastError();
-		return SocketError::Other;
-	}
-
-	// bind the socket to a local port
-	if (port != 0)
+	SocketError error = _checkAdoptable( handle, SOCK_DGRAM, false, _lastSystemError );
+	if (error != SocketError::Success)
 	{
-		if (::bind( _socket, (sockaddr *)&saddr, sizeof(saddr) ) != 0)
-		{
-			_lastSystemError = getLastError();
-			_closeSocket( _socket );
-			_socket = INVALID_SOCK;
-			return SocketError::BindFailed;
-		}
+		return error;
 	}
 
+	_socket = handle;
+	_isBlocking = _getBlockingMode( handle );
+	_setInheritable( handle, false );  // not to the children of this process, SocketManifest::add() sets it again
 	_lastSystemError = getLastError();
 	return SocketError::Success;
 }
 
-SocketError UdpSocket::close() noexcept
+SocketError UdpSocket::open( const NativeEndpoint & local, bool shareAddress ) noexcept
 {
-	if (!isOpen())
+	if (!local.isValid())
 	{
-		return SocketError::NotOpen;
+		critical_error( "Attempted socket operation with empty NativeEndpoint." );
 	}
+	return _open( &local, shareAddress ? PortSharing::Multicast : PortSharing::None );
+}
+
+SocketError UdpSocket::open( const Endpoint & local, bool shareAddress )
+{
+	return open( NativeEndpoint( local ), shareAddress );
+}
 
-	if (!_shutdownSocket( _socket ))
+SocketError UdpSocket::_open( uint16_t port, PortSharing sharing ) noexcept
+{
+	// TODO: IPv4 vs IPv6
+	// a shared one must be bound even to a random port, so that others can join it
+	if (port != 0 || sharing != PortSharing::None)
 	{
-		critical_error( "shutdown(socket) should not fail, please investigate, error code = %d", getLastError() );
+		NativeEndpoint local( IPAddr({ 127, 0, 0, 1 }), port );
+		return _open( &local, sharing );
 	}
-
-	if (!_closeSocket( _socket ))
+	else
 	{
-		critical_error( "close(socket) should not fail, please investigate, error code = %d", getLastError() );
+		return _open( nullptr, sharing );
 	}
-
-	_lastSystemError = getLastError();
-	_socket = INVALID_SOCK;
-	return SocketError::Success;
-}
-
-bool UdpSocket::isOpen() const noexcept
-{
-	return _socket != INVALID_SOCK;
 }
 
-SocketError UdpSocket::sendTo( const Endpoint & endpoint, const_byte_span buffer )
+SocketError UdpSocket::_open( const NativeEndpoint * local, PortSharing sharing ) noexcept
 {
-	struct sockaddr_storage saddr; int addrlen;
-	endpointToSockaddr( endpoint, (struct sockaddr *)&saddr, addrlen );
+	if (_socket != INVALID_SOCK)
+	{
+		return SocketError::AlreadyOpen;
+	}
 
-	int sent = ::sendto( _socket, (const char *)buffer.data(), (int)buffer.size(), 0, (struct sockaddr *)&saddr, addrlen );
-	if (sent < 0)
+	bool initialized = g_netSystem.initializeIfNotAlready();
+	if (!initialized)
 	{
 		_lastSystemError = getLastError();
-		return SocketError::SendFailed;
+		return SocketError::NetworkingInitFailed;
 	}
 
-	_lastSystemError = getLastError();
-	return SocketError::Success;
-}
-
+	// create a corresponding socket
+	_socket = ::socket( local ? local->saddr()->sa_family : AF_INET, SOCK_DGRAM, 0 );
+	if (_socket == INVALID_SOCK)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+
+	bool sharingSet = sharing == PortSharing::WithPeers || sharing == PortSharing::Multicast ? _setReuseAddr( _socket )
+	                : sharing == PortSharing::LoadBalanced ? _setReusePort( _socket )
+	                : true;
+	if (!sharingSet)
+	{
+		_lastSystemError = getLastError();
+		_closeSocket( _socket );
+		_socket = INVALID_SOCK;
+		return SocketError::Other;
+	}
+
+	// bind the socket to a local address and port
+	if (local && ::bind( _socket, local->saddr(), local->saddrLen() ) != 0)
+	{
+		_lastSystemError = getLastError();
+		_closeSocket( _socket );
+		_socket = INVALID_SOCK;
+		return SocketError::BindFailed;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UdpSocket::close() noexcept
+{
+	if (!isOpen())
+	{
+		return SocketError::NotOpen;
+	}
+
+	// UDP has no connection to shut down, shutdown() would only fail with "not connected" here
+
+	if (!_closeSocket( _socket ))
+	{
+		critical_error( "close(socket) should not fail, please investigate, error code = %d", getLastError() );
+	}
+
+	_lastSystemError = getLastError();
+	_socket = INVALID_SOCK;
+	return SocketError::Success;
+}
+
+bool UdpSocket::isOpen() const noexcept
+{
+	return _socket != INVALID_SOCK;
+}
+
+bool UdpSocket::setTimeout( std::chrono::milliseconds timeout ) noexcept
+{
+	bool success = _setTimeout( _socket, timeout );
+	_lastSystemError = getLastError();
+	return success;
+}
+
+SocketError UdpSocket::sendTo( const Endpoint & endpoint, const_byte_span buffer )
+{
+	return sendTo( NativeEndpoint( endpoint ), buffer );
+}
+
+SocketError UdpSocket::sendTo( const NativeEndpoint & endpoint, const_byte_span buffer )
+{
+	if (!endpoint.isValid())
+	{
+		critical_error( "Attempted socket operation with empty NativeEndpoint." );
+	}
+
+	int sent = ::sendto( _socket, (const char *)buffer.data(), (int)buffer.size(), 0, endpoint.saddr(), endpoint.saddrLen() );
+	if (sent < 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::SendFailed;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
 SocketError UdpSocket::recvFrom( Endpoint & endpoint, byte_span buffer, size_t & totalReceived )
 {
-	struct sockaddr_storage saddr; socklen_t addrlen;
-	memset( &saddr, 0, sizeof(saddr) );
-	addrlen = sizeof(saddr);
+	NativeEndpoint nativeEndpoint;
+	SocketError result = recvFrom( nativeEndpoint, buffer, totalReceived );
+	if (result == SocketError::Success)
+		endpoint = nativeEndpoint.toEndpoint();
+	return result;
+}
+
+SocketError UdpSocket::recvFrom( NativeEndpoint & endpoint, byte_span buffer, size_t & totalReceived )
+{
+	socklen_t addrlen = NativeEndpoint::CAPACITY;
+
+	int received = ::recvfrom( _socket, (char *)buffer.data(), (int)buffer.size(), 0, endpoint.saddrBuffer(), &addrlen );
+	if (received < 0)
+	{
+		_lastSystemError = getLastError();
+		if (!_isBlocking && _isWouldBlock( _lastSystemError ))
+		{
+			return SocketError::WouldBlock;
+		}
+		else if (_isTimeout( _lastSystemError ))
+		{
+			return SocketError::Timeout;
+		}
+		else
+		{
+			return SocketError::Other;
+		}
+	}
+
+	if (!endpoint.setSaddrLen( int( addrlen ) ))
+	{
+		critical_error( "Socket operation returned unexpected address family." );
+	}
+
+	totalReceived = size_t( received );
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+
+//-- batch receive -----------------------------------------------------------------------------------------------------
+
+SocketError UdpSocket::recvBatch( span< UdpDatagram > datagrams, size_t & totalReceived )
+{
+	totalReceived = 0;
+	if (datagrams.empty())
+	{
+		return SocketError::Success;
+	}
+
+ #ifdef __linux__
+	static constexpr size_t MAX_BATCH = 64;
+	const size_t count = (std::min)( datagrams.size(), MAX_BATCH );
+
+	struct mmsghdr msgs [MAX_BATCH];
+	struct iovec iovs [MAX_BATCH];
+	alignas( struct cmsghdr ) char controls [MAX_BATCH][CMSG_SPACE( sizeof(uint32_t) )];
+
+	memset( msgs, 0, count * sizeof(msgs[0]) );
+	for (size_t i = 0; i < count; ++i)
+	{
+		iovs[i].iov_base = datagrams[i].buffer.data();
+		iovs[i].iov_len = datagrams[i].buffer.size();
+		msgs[i].msg_hdr.msg_name = datagrams[i].sender.saddrBuffer();
+		msgs[i].msg_hdr.msg_namelen = NativeEndpoint::CAPACITY;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = controls[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+	}
+
+	int received = ::recvmmsg( _socket, msgs, unsigned( count ), MSG_WAITFORONE, nullptr );
+	if (received < 0)
+	{
+		_lastSystemError = getLastError();
+		if (!_isBlocking && _isWouldBlock( _lastSystemError ))
+		{
+			return SocketError::WouldBlock;
+		}
+		else if (_isTimeout( _lastSystemError ))
+		{
+			return SocketError::Timeout;
+		}
+		else
+		{
+			return SocketError::Other;
+		}
+	}
+
+	for (size_t i = 0; i < size_t( received ); ++i)
+	{
+		datagrams[i].size = msgs[i].msg_len;
+		if (!datagrams[i].sender.setSaddrLen( int( msgs[i].msg_hdr.msg_namelen ) ))
+		{
+			critical_error( "Socket operation returned unexpected address family." );
+		}
+		for (struct cmsghdr * cmsg = CMSG_FIRSTHDR( &msgs[i].msg_hdr ); cmsg != nullptr; cmsg = CMSG_NXTHDR( &msgs[i].msg_hdr, cmsg ))
+		{
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+				memcpy( &_droppedCount, CMSG_DATA( cmsg ), sizeof(_droppedCount) );
+		}
+	}
+
+	totalReceived = size_t( received );
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #else
+	SocketError error = recvFrom( datagrams[0].sender, datagrams[0].buffer, datagrams[0].size );
+	if (error == SocketError::Success)
+		totalReceived = 1;
+	return error;
+ #endif // __linux__
+}
+
+SocketError UdpSocket::setDropCounting( bool enable ) noexcept
+{
+ #ifdef __linux__
+	int value = enable ? 1 : 0;
+	if (::setsockopt( _socket, SOL_SOCKET, SO_RXQ_OVFL, &value, sizeof(value) ) != 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #else
+	return enable ? SocketError::NotSupported : SocketError::Success;
+ #endif // __linux__
+}
+
+//-- segmentation offload ----------------------------------------------------------------------------------------------
+
+#ifdef __linux__
+static constexpr size_t MAX_GSO_SEGMENTS = 64;      // the limit of the oldest kernels supporting UDP_SEGMENT
+static constexpr size_t MAX_GSO_BYTES = 65535 - 8 - 20;  // the whole buffer must fit into one IPv4 packet
+#endif
+
+SocketError UdpSocket::sendSegmented( const NativeEndpoint & endpoint, const_byte_span buffer, size_t segmentSize )
+{
+	if (!endpoint.isValid())
+	{
+		critical_error( "Attempted socket operation with empty NativeEndpoint." );
+	}
+	if (segmentSize == 0)
+	{
+		critical_error( "Segment size for UdpSocket::sendSegmented() must not be 0." );
+	}
+
+	const uint8_t * sendBegin = buffer.data();
+	const uint8_t * const sendEnd = buffer.data() + buffer.size();
+
+ #ifdef __linux__
+	if (segmentSize <= MAX_GSO_BYTES)
+	{
+		const size_t maxChunkSize = (std::min)( MAX_GSO_SEGMENTS, MAX_GSO_BYTES / segmentSize ) * segmentSize;
+		alignas( struct cmsghdr ) char control [CMSG_SPACE( sizeof(uint16_t) )];
+
+		while (size_t( sendEnd - sendBegin ) > segmentSize)
+		{
+			size_t chunkSize = (std::min)( size_t( sendEnd - sendBegin ), maxChunkSize );
+
+			struct iovec iov;
+			iov.iov_base = const_cast< uint8_t * >( sendBegin );
+			iov.iov_len = chunkSize;
+
+			struct msghdr msg;
+			memset( &msg, 0, sizeof(msg) );
+			msg.msg_name = const_cast< struct sockaddr * >( endpoint.saddr() );
+			msg.msg_namelen = socklen_t( endpoint.saddrLen() );
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+
+			struct cmsghdr * cmsg = CMSG_FIRSTHDR( &msg );
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN( sizeof(uint16_t) );
+			uint16_t gsoSize = uint16_t( segmentSize );
+			memcpy( CMSG_DATA( cmsg ), &gsoSize, sizeof(gsoSize) );
+
+			if (::sendmsg( _socket, &msg, 0 ) < 0)
+			{
+				_lastSystemError = getLastError();
+				// the kernel or the network device doesn't support the segmentation, send the rest one by one
+				if (_lastSystemError == EINVAL || _lastSystemError == EIO || _lastSystemError == ENOPROTOOPT || _lastSystemError == EOPNOTSUPP)
+					break;
+				return SocketError::SendFailed;
+			}
+			sendBegin += chunkSize;
+		}
+	}
+ #endif // __linux__
+
+	for (; sendBegin < sendEnd; sendBegin += segmentSize)
+	{
+		size_t datagramSize = (std::min)( size_t( sendEnd - sendBegin ), segmentSize );
+		SocketError error = sendTo( endpoint, make_span( sendBegin, datagramSize ) );
+		if (error != SocketError::Success)
+			return error;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UdpSocket::setReceiveCoalescing( bool enable ) noexcept
+{
+ #ifdef __linux__
+	int value = enable ? 1 : 0;
+	if (::setsockopt( _socket, SOL_UDP, UDP_GRO, &value, sizeof(value) ) != 0)
+	{
+		_lastSystemError = getLastError();
+		return _lastSystemError == ENOPROTOOPT ? SocketError::NotSupported : SocketError::Other;
+	}
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #else
+	return enable ? SocketError::NotSupported : SocketError::Success;
+ #endif // __linux__
+}
+
+SocketError UdpSocket::recvCoalesced( NativeEndpoint & endpoint, byte_span buffer, size_t & totalReceived, size_t & segmentSize )
+{
+ #ifdef __linux__
+	struct iovec iov;
+	iov.iov_base = buffer.data();
+	iov.iov_len = buffer.size();
+
+	alignas( struct cmsghdr ) char control [CMSG_SPACE( sizeof(int) )];
+
+	struct msghdr msg;
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_name = endpoint.saddrBuffer();
+	msg.msg_namelen = NativeEndpoint::CAPACITY;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t received = ::recvmsg( _socket, &msg, 0 );
+	if (received < 0)
+	{
+		_lastSystemError = getLastError();
+		if (!_isBlocking && _isWouldBlock( _lastSystemError ))
+		{
+			return SocketError::WouldBlock;
+		}
+		else if (_isTimeout( _lastSystemError ))
+		{
+			return SocketError::Timeout;
+		}
+		else
+		{
+			return SocketError::Other;
+		}
+	}
+
+	if (!endpoint.setSaddrLen( int( msg.msg_namelen ) ))
+	{
+		critical_error( "Socket operation returned unexpected address family." );
+	}
+
+	totalReceived = size_t( received );
+	segmentSize = totalReceived;  // a single datagram unless the system says otherwise
+	for (struct cmsghdr * cmsg = CMSG_FIRSTHDR( &msg ); cmsg != nullptr; cmsg = CMSG_NXTHDR( &msg, cmsg ))
+	{
+		if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+		{
+			int gsoSize;
+			memcpy( &gsoSize, CMSG_DATA( cmsg ), sizeof(gsoSize) );
+			segmentSize = size_t( gsoSize );
+		}
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #else
+	SocketError error = recvFrom( endpoint, buffer, totalReceived );
+	segmentSize = totalReceived;
+	return error;
+ #endif // __linux__
+}
+
+//-- transmit time -----------------------------------------------------------------------------------------------------
+
+#ifdef __linux__
+/// the same as struct sock_txtime from linux/net_tstamp.h, which older system headers don't have
+struct TxTimeConfig
+{
+	clockid_t clockid;
+	uint32_t flags;
+};
+#endif // __linux__
+
+SocketError UdpSocket::enableTransmitTime() noexcept
+{
+ #ifdef __linux__
+	// steady_clock is CLOCK_MONOTONIC on Linux, so the departure times can be passed to the system as they are
+	TxTimeConfig config = { CLOCK_MONOTONIC, 0 };
+	if (::setsockopt( _socket, SOL_SOCKET, SO_TXTIME, &config, sizeof(config) ) != 0)
+	{
+		_lastSystemError = getLastError();
+		return _lastSystemError == ENOPROTOOPT || _lastSystemError == EINVAL ? SocketError::NotSupported : SocketError::Other;
+	}
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #else
+	return SocketError::NotSupported;
+ #endif // __linux__
+}
+
+SocketError UdpSocket::sendAt( const NativeEndpoint & endpoint, const_byte_span buffer, std::chrono::steady_clock::time_point departure )
+{
+	if (!endpoint.isValid())
+	{
+		critical_error( "Attempted socket operation with empty NativeEndpoint." );
+	}
+
+ #ifdef __linux__
+	struct iovec iov;
+	iov.iov_base = const_cast< uint8_t * >( buffer.data() );
+	iov.iov_len = buffer.size();
+
+	alignas( struct cmsghdr ) char control [CMSG_SPACE( sizeof(uint64_t) )];
+
+	struct msghdr msg;
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_name = const_cast< struct sockaddr * >( endpoint.saddr() );
+	msg.msg_namelen = socklen_t( endpoint.saddrLen() );
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	struct cmsghdr * cmsg = CMSG_FIRSTHDR( &msg );
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_TXTIME;
+	cmsg->cmsg_len = CMSG_LEN( sizeof(uint64_t) );
+	uint64_t txTime = uint64_t( std::chrono::duration_cast< std::chrono::nanoseconds >( departure.time_since_epoch() ).count() );
+	memcpy( CMSG_DATA( cmsg ), &txTime, sizeof(txTime) );
+
+	if (::sendmsg( _socket, &msg, 0 ) < 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::SendFailed;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #else
+	(void)buffer; (void)departure;
+	return SocketError::NotSupported;
+ #endif // __linux__
+}
+
+//-- multicast ---------------------------------------------------------------------------------------------------------
+
+SocketError UdpSocket::joinGroup( const IPAddr & group, uint32_t interfaceIndex )
+{
+	return _changeMembership( true, group, nullptr, interfaceIndex );
+}
+
+SocketError UdpSocket::leaveGroup( const IPAddr & group, uint32_t interfaceIndex )
+{
+	return _changeMembership( false, group, nullptr, interfaceIndex );
+}
+
+SocketError UdpSocket::joinSourceGroup( const IPAddr & group, const IPAddr & source, uint32_t interfaceIndex )
+{
+	return _changeMembership( true, group, &source, interfaceIndex );
+}
+
+SocketError UdpSocket::leaveSourceGroup( const IPAddr & group, const IPAddr & source, uint32_t interfaceIndex )
+{
+	return _changeMembership( false, group, &source, interfaceIndex );
+}
+
+SocketError UdpSocket::_changeMembership( bool join, const IPAddr & group, const IPAddr * source, uint32_t interfaceIndex )
+{
+	if (source && source->version() != group.version())
+	{
+		critical_error( "Multicast group and its source must be of the same IP version." );
+	}
+
+	// the protocol-independent options (RFC 3678) take the same structures for IPv4 and IPv6
+	const int level = group.version() == IPVer::_4 ? IPPROTO_IP : IPPROTO_IPV6;
+
+ #ifdef __linux__
+	// by default Linux delivers to a socket bound to the wildcard address also the groups joined by the other sockets,
+	// turn it off, so that each socket receives only its own groups like on the other systems (IPv6 since Linux 4.20)
+	if (join)
+	{
+		int all = 0;
+		::setsockopt( _socket, level, level == IPPROTO_IP ? IP_MULTICAST_ALL : IPV6_MULTICAST_ALL, &all, sizeof(all) );
+	}
+ #endif // __linux__
+	NativeEndpoint groupAddr( group, 0 );
+	int result;
+	if (source)
+	{
+		NativeEndpoint sourceAddr( *source, 0 );
+		struct group_source_req request;
+		memset( &request, 0, sizeof(request) );
+		request.gsr_interface = interfaceIndex;
+		memcpy( &request.gsr_group, groupAddr.saddr(), size_t( groupAddr.saddrLen() ) );
+		memcpy( &request.gsr_source, sourceAddr.saddr(), size_t( sourceAddr.saddrLen() ) );
+		int option = join ? MCAST_JOIN_SOURCE_GROUP : MCAST_LEAVE_SOURCE_GROUP;
+		result = ::setsockopt( _socket, level, option, (const char *)&request, sizeof(request) );
+	}
+	else
+	{
+		struct group_req request;
+		memset( &request, 0, sizeof(request) );
+		request.gr_interface = interfaceIndex;
+		memcpy( &request.gr_group, groupAddr.saddr(), size_t( groupAddr.saddrLen() ) );
+		int option = join ? MCAST_JOIN_GROUP : MCAST_LEAVE_GROUP;
+		result = ::setsockopt( _socket, level, option, (const char *)&request, sizeof(request) );
+	}
+
+	if (result != 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::MembershipFailed;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UdpSocket::setMulticastLoopback( bool enable ) noexcept
+{
+	int value = enable ? 1 : 0;
+	int result = _getSocketFamily( _socket ) == AF_INET6
+		? ::setsockopt( _socket, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, (const char *)&value, sizeof(value) )
+		: ::setsockopt( _socket, IPPROTO_IP, IP_MULTICAST_LOOP, (const char *)&value, sizeof(value) );
+	if (result != 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UdpSocket::setMulticastTtl( uint8_t ttl ) noexcept
+{
+	int value = ttl;
+	int result = _getSocketFamily( _socket ) == AF_INET6
+		? ::setsockopt( _socket, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, (const char *)&value, sizeof(value) )
+		: ::setsockopt( _socket, IPPROTO_IP, IP_MULTICAST_TTL, (const char *)&value, sizeof(value) );
+	if (result != 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UdpSocket::setMulticastInterface( uint32_t interfaceIndex ) noexcept
+{
+	int result;
+	if (_getSocketFamily( _socket ) == AF_INET6)
+	{
+		unsigned int value = interfaceIndex;
+		result = ::setsockopt( _socket, IPPROTO_IPV6, IPV6_MULTICAST_IF, (const char *)&value, sizeof(value) );
+	}
+	else
+	{
+		// each system has its own way to select an IPv4 interface by the index instead of by its address
+ #if defined(_WIN32)
+		DWORD value = htonl( interfaceIndex );  // an address in the block 0.0.0.0/8 is taken as an index
+		result = ::setsockopt( _socket, IPPROTO_IP, IP_MULTICAST_IF, (const char *)&value, sizeof(value) );
+ #elif defined(IP_MULTICAST_IFINDEX)
+		unsigned int value = interfaceIndex;
+		result = ::setsockopt( _socket, IPPROTO_IP, IP_MULTICAST_IFINDEX, &value, sizeof(value) );
+ #else
+		struct ip_mreqn request;
+		memset( &request, 0, sizeof(request) );
+		request.imr_ifindex = int( interfaceIndex );
+		result = ::setsockopt( _socket, IPPROTO_IP, IP_MULTICAST_IF, &request, sizeof(request) );
+ #endif
+	}
+	if (result != 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+
+//======================================================================================================================
+//  UdpPeer
+
+UdpPeer::UdpPeer() noexcept : ASocket() {}
+
+UdpPeer::~UdpPeer() noexcept
+{
+	disconnect();
+}
+
+UdpPeer::UdpPeer( UdpPeer && other ) noexcept
+{
+	*this = move( other );
+}
+
+UdpPeer & UdpPeer::operator=( UdpPeer && other ) noexcept
+{
+	ASocket::operator=( move( other ) );
+	_remote = other._remote;
+	other._remote = NativeEndpoint();
+	return *this;
+}
+
+SocketError UdpPeer::connect( const NativeEndpoint & remote, uint16_t localPort )
+{
+	if (!remote.isValid())
+	{
+		critical_error( "Attempted socket operation with empty NativeEndpoint." );
+	}
+
+	if (localPort == 0)
+	{
+		return _connect( remote, nullptr, false );
+	}
+
+	// any local address of the same version as the remote one
+	NativeEndpoint local( remote.version() == IPVer::_4 ? IPAddr( IPv4Addr() ) : IPAddr( IPv6Addr() ), localPort );
+	return _connect( remote, &local, false );
+}
+
+SocketError UdpPeer::connect( const Endpoint & remote, uint16_t localPort )
+{
+	return connect( NativeEndpoint( remote ), localPort );
+}
+
+SocketError UdpPeer::_connect( const NativeEndpoint & remote, const NativeEndpoint * local, bool shareAddr ) noexcept
+{
+	if (isConnected())
+	{
+		return SocketError::AlreadyConnected;
+	}
+
+	bool initialized = g_netSystem.initializeIfNotAlready();
+	if (!initialized)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::NetworkingInitFailed;
+	}
+
+	_socket = ::socket( remote.saddr()->sa_family, SOCK_DGRAM, 0 );
+	if (_socket == INVALID_SOCK)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+
+	if (shareAddr && !_setReuseAddr( _socket ))
+	{
+		_lastSystemError = getLastError();
+		_closeSocket( _socket );
+		_socket = INVALID_SOCK;
+		return SocketError::Other;
+	}
+
+	if (local && ::bind( _socket, local->saddr(), local->saddrLen() ) != 0)
+	{
+		_lastSystemError = getLastError();
+		_closeSocket( _socket );
+		_socket = INVALID_SOCK;
+		return SocketError::BindFailed;
+	}
+
+	// for UDP this only sets the default destination and the filter of incoming datagrams, nothing is sent
+	if (::connect( _socket, remote.saddr(), remote.saddrLen() ) != SUCCESS)
+	{
+		_lastSystemError = getLastError();
+		_closeSocket( _socket );
+		_socket = INVALID_SOCK;
+		return SocketError::ConnectFailed;
+	}
+
+	_remote = remote;
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UdpPeer::disconnect() noexcept
+{
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	// UDP has no connection to shut down, shutdown() would only discard the queued datagrams
+
+	if (!_closeSocket( _socket ))
+	{
+		critical_error( "close(socket) should not fail, please investigate, error code = %d", getLastError() );
+	}
+
+	_lastSystemError = getLastError();
+	_socket = INVALID_SOCK;
+	_remote = NativeEndpoint();
+	return SocketError::Success;
+}
+
+bool UdpPeer::isConnected() const noexcept
+{
+	return _socket != INVALID_SOCK;
+}
+
+bool UdpPeer::setTimeout( std::chrono::milliseconds timeout ) noexcept
+{
+	bool success = _setTimeout( _socket, timeout );
+	_lastSystemError = getLastError();
+	return success;
+}
+
+SocketError UdpPeer::send( const_byte_span buffer ) noexcept
+{
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	int sent = ::send( _socket, (const char *)buffer.data(), (int)buffer.size(), 0 );
+	if (sent < 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::SendFailed;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UdpPeer::receive( byte_span buffer, size_t & totalReceived ) noexcept
+{
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	int received = ::recv( _socket, (char *)buffer.data(), (int)buffer.size(), 0 );
+	if (received < 0)
+	{
+		_lastSystemError = getLastError();
+		totalReceived = 0;
+		if (_isConnectionRefused( _lastSystemError ))
+		{
+			return SocketError::ConnectionClosed;
+		}
+		else if (!_isBlocking && _isWouldBlock( _lastSystemError ))
+		{
+			return SocketError::WouldBlock;
+		}
+		else if (_isTimeout( _lastSystemError ))
+		{
+			return SocketError::Timeout;
+		}
+		else
+		{
+			return SocketError::Other;
+		}
+	}
+
+	totalReceived = size_t( received );
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+
+//======================================================================================================================
+//  UdpPeerServer
+
+SocketError UdpPeerServer::open( uint16_t port ) noexcept
+{
+	return _open( port, PortSharing::WithPeers );
+}
+
+SocketError UdpPeerServer::open( const NativeEndpoint & local ) noexcept
+{
+	if (!local.isValid())
+	{
+		critical_error( "Attempted socket operation with empty NativeEndpoint." );
+	}
+	return _open( &local, PortSharing::WithPeers );
+}
+
+UdpPeer UdpPeerServer::acceptPeer( const NativeEndpoint & remote )
+{
+	if (!isOpen())
+	{
+		return UdpPeer();
+	}
+
+	NativeEndpoint local;
+	socklen_t localLen = NativeEndpoint::CAPACITY;
+	if (::getsockname( _socket, local.saddrBuffer(), &localLen ) != 0 || !local.setSaddrLen( int( localLen ) ))
+	{
+		_lastSystemError = getLastError();
+		return UdpPeer();
+	}
+
+	UdpPeer peer;
+	if (peer._connect( remote, &local, true ) != SocketError::Success)
+	{
+		_lastSystemError = peer.getLastSystemError();
+		return UdpPeer();
+	}
+
+	_lastSystemError = getLastError();
+	return peer;
+}
+
+
+//======================================================================================================================
+//  Unix domain sockets
+
+static constexpr char ABSTRACT_PREFIX = '@';
+
+static bool _isAbstractPath( const std::string & path ) noexcept
+{
+ #ifdef __linux__
+	return !path.empty() && path[0] == ABSTRACT_PREFIX;
+ #else
+	(void)path;
+	return false;
+ #endif // __linux__
+}
+
+/// Fills the system structure of the address, returns false if the path is too long.
+static bool _makeUnixAddress( const std::string & path, struct sockaddr_un & saddr, socklen_t & addrlen ) noexcept
+{
+	memset( &saddr, 0, sizeof(saddr) );
+	saddr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(saddr.sun_path))  // a file path must be terminated by the null character
+	{
+		return false;
+	}
+
+	memcpy( saddr.sun_path, path.data(), path.size() );
+	if (_isAbstractPath( path ))
+	{
+		// an abstract name starts with the null character and it's not terminated, the address length ends it
+		saddr.sun_path[0] = '\0';
+		addrlen = socklen_t( offsetof( struct sockaddr_un, sun_path ) + path.size() );
+	}
+	else
+	{
+		addrlen = socklen_t( offsetof( struct sockaddr_un, sun_path ) + path.size() + 1 );
+	}
+	return true;
+}
+
+static std::string _unixAddressToPath( const struct sockaddr_un & saddr, socklen_t addrlen )
+{
+	size_t pathOffset = offsetof( struct sockaddr_un, sun_path );
+	size_t pathSize = size_t( addrlen ) > pathOffset ? (std::min)( size_t( addrlen ) - pathOffset, sizeof(saddr.sun_path) ) : 0;
+	if (pathSize == 0)
+	{
+		return std::string();  // unbound
+	}
+	else if (saddr.sun_path[0] == '\0')
+	{
+		return ABSTRACT_PREFIX + std::string( saddr.sun_path + 1, pathSize - 1 );
+	}
+	else
+	{
+		return std::string( saddr.sun_path, strnlen( saddr.sun_path, pathSize ) );
+	}
+}
+
+static int _unixSocketType( UnixSocketType type ) noexcept
+{
+	return type == UnixSocketType::SeqPacket ? SOCK_SEQPACKET : SOCK_STREAM;
+}
+
+//-- UnixStreamSocket --------------------------------------------------------------------------------------------------
+
+UnixStreamSocket::UnixStreamSocket() noexcept : ASocket() {}
+
+UnixStreamSocket::~UnixStreamSocket() noexcept
+{
+	disconnect();
+}
+
+UnixStreamSocket::UnixStreamSocket( UnixStreamSocket && other ) noexcept
+{
+	*this = move( other );
+}
+
+UnixStreamSocket & UnixStreamSocket::operator=( UnixStreamSocket && other ) noexcept
+{
+	ASocket::operator=( move( other ) );
+	return *this;
+}
+
+SocketError UnixStreamSocket::connect( const std::string & path, UnixSocketType type ) noexcept
+{
+	if (isConnected())
+	{
+		return SocketError::AlreadyConnected;
+	}
+
+	bool initialized = g_netSystem.initializeIfNotAlready();
+	if (!initialized)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::NetworkingInitFailed;
+	}
+
+	struct sockaddr_un saddr;
+	socklen_t addrlen;
+	if (!_makeUnixAddress( path, saddr, addrlen ))
+	{
+		_lastSystemError = NAME_TOO_LONG;
+		return SocketError::ConnectFailed;
+	}
+
+	_socket = ::socket( AF_UNIX, _unixSocketType( type ), 0 );
+	if (_socket == INVALID_SOCK)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+
+	if (::connect( _socket, (struct sockaddr *)&saddr, addrlen ) != SUCCESS)
+	{
+		_lastSystemError = getLastError();
+		_closeSocket( _socket );
+		_socket = INVALID_SOCK;
+		return SocketError::ConnectFailed;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UnixStreamSocket::disconnect() noexcept
+{
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	// unlike TCP, a Unix socket has nothing to announce to the other side and the shutdown may fail,
+	// when the other side has already closed, so just close it
+
+	if (!_closeSocket( _socket ))
+	{
+		critical_error( "close(socket) should not fail, please investigate, error code = %d", getLastError() );
+	}
+
+	_lastSystemError = getLastError();
+	_socket = INVALID_SOCK;
+	return SocketError::Success;
+}
+
+bool UnixStreamSocket::isConnected() const noexcept
+{
+	return _socket != INVALID_SOCK;
+}
+
+bool UnixStreamSocket::isAccepted() const noexcept
+{
+	return _socket != INVALID_SOCK;
+}
+
+bool UnixStreamSocket::setTimeout( std::chrono::milliseconds timeout ) noexcept
+{
+	bool success = _setTimeout( _socket, timeout );
+	_lastSystemError = getLastError();
+	return success;
+}
+
+SocketError UnixStreamSocket::send( const_byte_span buffer ) noexcept
+{
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	const uint8_t * sendBegin = buffer.data();
+	size_t sendSize = buffer.size();
+	while (sendSize > 0)
+	{
+		int sent = ::send( _socket, (const char *)sendBegin, (int)sendSize, 0 );
+		if (sent < 0)
+		{
+			_lastSystemError = getLastError();
+			return SocketError::SendFailed;
+		}
+		sendBegin += sent;
+		sendSize -= size_t( sent );
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UnixStreamSocket::receive( byte_span buffer, size_t & totalReceived ) noexcept
+{
+	if (!isConnected())
+	{
+		totalReceived = 0;
+		return SocketError::NotConnected;
+	}
+
+	uint8_t * recvBegin = buffer.data();
+	size_t recvSize = buffer.size();
+	while (recvSize > 0)
+	{
+		size_t received;
+		SocketError error = receiveOnce( make_span( recvBegin, recvSize ), received );
+		if (error != SocketError::Success)
+		{
+			totalReceived = buffer.size() - recvSize;  // this is how much we failed to receive
+			return error;
+		}
+		recvBegin += received;
+		recvSize -= received;
+	}
+
+	totalReceived = buffer.size();
+	return SocketError::Success;
+}
+
+SocketError UnixStreamSocket::receiveOnce( byte_span buffer, size_t & received ) noexcept
+{
+	received = 0;
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+
+	int result = ::recv( _socket, (char *)buffer.data(), (int)buffer.size(), 0 );
+	if (result <= 0)
+	{
+		_lastSystemError = getLastError();
+		if (result == 0 && buffer.empty())
+		{
+			return SocketError::Success;  // nothing was asked for
+		}
+		else if (result == 0)
+		{
+			_closeSocket( _socket );  // the other side closed, so let's close on our side too
+			_socket = INVALID_SOCK;
+			return SocketError::ConnectionClosed;
+		}
+		else if (!_isBlocking && _isWouldBlock( _lastSystemError ))
+		{
+			return SocketError::WouldBlock;
+		}
+		else if (_isTimeout( _lastSystemError ))
+		{
+			return SocketError::Timeout;
+		}
+		else
+		{
+			return SocketError::Other;
+		}
+	}
+
+	received = size_t( result );
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UnixStreamSocket::receiveOnce( std::vector< uint8_t > & buffer ) noexcept
+{
+	// the largest message that SeqPacket is expected to carry, unlike TCP there are no packets limiting it
+	static constexpr size_t MAX_MESSAGE_SIZE = 64 * 1024;
+
+	buffer.resize( MAX_MESSAGE_SIZE );
+	size_t received;
+	SocketError result = receiveOnce( make_span( buffer ), received );
+	buffer.resize( received );
+	return result;
+}
+
+SocketError UnixStreamSocket::sendSocket( TcpSocket & connection, const_byte_span message ) noexcept
+{
+	if (!isConnected() || !connection.isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+	if (message.empty())
+	{
+		critical_error( "The message sent with a socket must not be empty." );
+	}
+
+ #ifdef _WIN32
+	return SocketError::NotSupported;  // Windows duplicates sockets for other processes by WSADuplicateSocket() instead
+ #else
+	struct iovec iov;
+	iov.iov_base = const_cast< uint8_t * >( message.data() );
+	iov.iov_len = message.size();
+
+	alignas( struct cmsghdr ) char control [CMSG_SPACE( sizeof(int) )];
+
+	struct msghdr msg;
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	struct cmsghdr * cmsg = CMSG_FIRSTHDR( &msg );
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN( sizeof(int) );
+	int handle = connection._socket;
+	memcpy( CMSG_DATA( cmsg ), &handle, sizeof(handle) );
+
+	ssize_t sent = ::sendmsg( _socket, &msg, 0 );
+	if (sent < 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::SendFailed;
+	}
+
+	// the other process has its own handle now, shutdown() would end the connection for it too, so only close ours
+	_closeSocket( connection._socket );
+	connection._socket = INVALID_SOCK;
+
+	// the handle is already on its way with the first part, a stream may need more calls for the rest
+	if (size_t( sent ) < message.size())
+	{
+		return send( message.subspan( size_t( sent ) ) );
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #endif // _WIN32
+}
+
+SocketError UnixStreamSocket::receiveSocket( TcpSocket & connection, byte_span message, size_t & received ) noexcept
+{
+	received = 0;
+	if (!isConnected())
+	{
+		return SocketError::NotConnected;
+	}
+	if (connection.isConnected())
+	{
+		return SocketError::AlreadyConnected;
+	}
+
+ #ifdef _WIN32
+	(void)message;
+	return SocketError::NotSupported;
+ #else
+	struct iovec iov;
+	iov.iov_base = message.data();
+	iov.iov_len = message.size();
+
+	// room for more handles than expected, so that the extra ones can be closed instead of being lost open
+	static constexpr size_t MAX_HANDLES = 8;
+	alignas( struct cmsghdr ) char control [CMSG_SPACE( MAX_HANDLES * sizeof(int) )];
+
+	struct msghdr msg;
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+  #ifdef __linux__
+	const int flags = MSG_CMSG_CLOEXEC;  // don't leak the connection into the processes this one executes
+  #else
+	const int flags = 0;
+  #endif // __linux__
+	ssize_t result = ::recvmsg( _socket, &msg, flags );
+	if (result <= 0)
+	{
+		_lastSystemError = getLastError();
+		if (result == 0 && message.empty())
+		{
+			return SocketError::Success;
+		}
+		else if (result == 0)
+		{
+			_closeSocket( _socket );  // the other side closed, so let's close on our side too
+			_socket = INVALID_SOCK;
+			return SocketError::ConnectionClosed;
+		}
+		else if (!_isBlocking && _isWouldBlock( _lastSystemError ))
+		{
+			return SocketError::WouldBlock;
+		}
+		else if (_isTimeout( _lastSystemError ))
+		{
+			return SocketError::Timeout;
+		}
+		else
+		{
+			return SocketError::Other;
+		}
+	}
+
+	for (struct cmsghdr * cmsg = CMSG_FIRSTHDR( &msg ); cmsg != nullptr; cmsg = CMSG_NXTHDR( &msg, cmsg ))
+	{
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		size_t handleCount = (cmsg->cmsg_len - CMSG_LEN( 0 )) / sizeof(int);
+		for (size_t i = 0; i < handleCount; ++i)
+		{
+			int handle;
+			memcpy( &handle, CMSG_DATA( cmsg ) + i * sizeof(int), sizeof(handle) );
+  #ifndef __linux__
+			_setInheritable( handle, false );  // without MSG_CMSG_CLOEXEC it arrives inheritable
+  #endif // __linux__
+			system_error_t checkError;
+			if (!connection.isConnected() && _checkAdoptable( handle, SOCK_STREAM, false, checkError ) == SocketError::Success)
+			{
+				connection = TcpSocket( handle );
+				connection._isBlocking = _getBlockingMode( handle );  // the mode is shared with the sender
+			}
+			else
+			{
+				_closeSocket( handle );
+			}
+		}
+	}
+
+	received = size_t( result );
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+ #endif // _WIN32
+}
+
+//-- UnixServerSocket --------------------------------------------------------------------------------------------------
+
+UnixServerSocket::UnixServerSocket() noexcept : ASocket() {}
+
+UnixServerSocket::~UnixServerSocket() noexcept
+{
+	close();
+}
+
+UnixServerSocket::UnixServerSocket( UnixServerSocket && other ) noexcept
+{
+	*this = move( other );
+}
+
+UnixServerSocket & UnixServerSocket::operator=( UnixServerSocket && other ) noexcept
+{
+	ASocket::operator=( move( other ) );
+	_path = move( other._path );
+	other._path.clear();
+	return *this;
+}
+
+SocketError UnixServerSocket::open( const std::string & path, UnixSocketType type ) noexcept
+{
+	if (_socket != INVALID_SOCK)
+	{
+		return SocketError::AlreadyOpen;
+	}
+
+	bool initialized = g_netSystem.initializeIfNotAlready();
+	if (!initialized)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::NetworkingInitFailed;
+	}
+
+	struct sockaddr_un saddr;
+	socklen_t addrlen;
+	if (!_makeUnixAddress( path, saddr, addrlen ))
+	{
+		_lastSystemError = NAME_TOO_LONG;
+		return SocketError::BindFailed;
+	}
+
+	_socket = ::socket( AF_UNIX, _unixSocketType( type ), 0 );
+	if (_socket == INVALID_SOCK)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+
+	// bind the socket to the path, this creates the socket file
+	if (::bind( _socket, (struct sockaddr *)&saddr, addrlen ) != 0)
+	{
+		_lastSystemError = getLastError();
+		_closeSocket( _socket );
+		_socket = INVALID_SOCK;
+		return SocketError::BindFailed;
+	}
+	if (!_isAbstractPath( path ))
+	{
+		_path = path;
+	}
+
+	static constexpr int BACKLOG = 16;  // system queue for incoming connection requests
+	if (::listen( _socket, BACKLOG ) != 0)
+	{
+		_lastSystemError = getLastError();
+		close();
+		return SocketError::ListenFailed;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UnixServerSocket::close() noexcept
+{
+	if (!isOpen())
+	{
+		return SocketError::NotOpen;
+	}
+
+	if (!_closeSocket( _socket ))
+	{
+		critical_error( "close(socket) should not fail, please investigate, error code = %d", getLastError() );
+	}
+	_lastSystemError = getLastError();
+	_socket = INVALID_SOCK;
+
+	// the file stays after the socket is closed and it would prevent opening the server again
+	if (!_path.empty())
+	{
+		std::remove( _path.c_str() );
+		_path.clear();
+	}
+
+	return SocketError::Success;
+}
+
+bool UnixServerSocket::isOpen() const noexcept
+{
+	return _socket != INVALID_SOCK;
+}
+
+UnixStreamSocket UnixServerSocket::accept()
+{
+	if (!isOpen())
+	{
+		return UnixStreamSocket();
+	}
+
+	socket_t clientSocket = ::accept( _socket, nullptr, nullptr );  // the clients are usually not bound to any path
+	if (clientSocket == INVALID_SOCK)
+	{
+		_lastSystemError = getLastError();
+		return UnixStreamSocket();
+	}
+
+	_lastSystemError = getLastError();
+	return UnixStreamSocket( clientSocket );
+}
+
+//-- UnixDatagramSocket ------------------------------------------------------------------------------------------------
+
+UnixDatagramSocket::UnixDatagramSocket() noexcept : ASocket() {}
+
+UnixDatagramSocket::~UnixDatagramSocket() noexcept
+{
+	close();
+}
+
+UnixDatagramSocket::UnixDatagramSocket( UnixDatagramSocket && other ) noexcept
+{
+	*this = move( other );
+}
+
+UnixDatagramSocket & UnixDatagramSocket::operator=( UnixDatagramSocket && other ) noexcept
+{
+	ASocket::operator=( move( other ) );
+	_path = move( other._path );
+	other._path.clear();
+	return *this;
+}
+
+SocketError UnixDatagramSocket::open( const std::string & path ) noexcept
+{
+	if (_socket != INVALID_SOCK)
+	{
+		return SocketError::AlreadyOpen;
+	}
+
+	bool initialized = g_netSystem.initializeIfNotAlready();
+	if (!initialized)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::NetworkingInitFailed;
+	}
+
+	struct sockaddr_un saddr;
+	socklen_t addrlen;
+	if (!_makeUnixAddress( path, saddr, addrlen ))
+	{
+		_lastSystemError = NAME_TOO_LONG;
+		return SocketError::BindFailed;
+	}
+
+	_socket = ::socket( AF_UNIX, SOCK_DGRAM, 0 );
+	if (_socket == INVALID_SOCK)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::Other;
+	}
+
+	bool bindNeeded = !path.empty();
+ #ifdef __linux__
+	if (path.empty())
+	{
+		// binding only the address family makes Linux choose a random abstract name (autobind)
+		addrlen = socklen_t( offsetof( struct sockaddr_un, sun_path ) );
+		bindNeeded = true;
+	}
+ #endif // __linux__
+
+	if (bindNeeded && ::bind( _socket, (struct sockaddr *)&saddr, addrlen ) != 0)
+	{
+		_lastSystemError = getLastError();
+		_closeSocket( _socket );
+		_socket = INVALID_SOCK;
+		return SocketError::BindFailed;
+	}
+	if (!path.empty() && !_isAbstractPath( path ))
+	{
+		_path = path;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UnixDatagramSocket::close() noexcept
+{
+	if (!isOpen())
+	{
+		return SocketError::NotOpen;
+	}
+
+	if (!_closeSocket( _socket ))
+	{
+		critical_error( "close(socket) should not fail, please investigate, error code = %d", getLastError() );
+	}
+	_lastSystemError = getLastError();
+	_socket = INVALID_SOCK;
+
+	if (!_path.empty())
+	{
+		std::remove( _path.c_str() );
+		_path.clear();
+	}
+
+	return SocketError::Success;
+}
+
+bool UnixDatagramSocket::isOpen() const noexcept
+{
+	return _socket != INVALID_SOCK;
+}
+
+bool UnixDatagramSocket::setTimeout( std::chrono::milliseconds timeout ) noexcept
+{
+	bool success = _setTimeout( _socket, timeout );
+	_lastSystemError = getLastError();
+	return success;
+}
+
+SocketError UnixDatagramSocket::sendTo( const std::string & path, const_byte_span buffer ) noexcept
+{
+	struct sockaddr_un saddr;
+	socklen_t addrlen;
+	if (!_makeUnixAddress( path, saddr, addrlen ))
+	{
+		_lastSystemError = NAME_TOO_LONG;
+		return SocketError::SendFailed;
+	}
+
+	int sent = ::sendto( _socket, (const char *)buffer.data(), (int)buffer.size(), 0, (struct sockaddr *)&saddr, addrlen );
+	if (sent < 0)
+	{
+		_lastSystemError = getLastError();
+		return SocketError::SendFailed;
+	}
+
+	_lastSystemError = getLastError();
+	return SocketError::Success;
+}
+
+SocketError UnixDatagramSocket::recvFrom( std::string & path, byte_span buffer, size_t & totalReceived )
+{
+	struct sockaddr_un saddr;
+	socklen_t addrlen = sizeof(saddr);
 
 	int received = ::recvfrom( _socket, (char *)buffer.data(), (int)buffer.size(), 0, (struct sockaddr *)&saddr, &addrlen );
 	if (received < 0)
@@ -755,11 +2582,7 @@ SocketError UdpSocket::recvFrom( Endpoint & endpoint, byte_span buffer, size_t &
 		}
 	}
 
-	if (!sockaddrToEndpoint( (struct sockaddr *)&saddr, endpoint ))
-	{
-		critical_error( "Socket operation returned unexpected address family." );
-	}
-
+	path = _unixAddressToPath( saddr, addrlen );
 	totalReceived = size_t( received );
 	_lastSystemError = getLastError();
 	return SocketError::Success;
@@ -779,6 +2602,26 @@ SocketError UdpSocket::sendTo( const Endpoint & endpoint, const char * message )
 	return sendTo( endpoint, make_span( message, strlen(message) ).as_bytes() );
 }
 
+SocketError UdpSocket::sendTo( const NativeEndpoint & endpoint, const char * message )
+{
+	return sendTo( endpoint, make_span( message, strlen(message) ).as_bytes() );
+}
+
+SocketError UdpPeer::send( const char * message ) noexcept
+{
+	return send( make_span( message, strlen(message) ).as_bytes() );
+}
+
+SocketError UnixStreamSocket::send( const char * message ) noexcept
+{
+	return send( make_span( message, strlen(message) ).as_bytes() );
+}
+
+SocketError UnixDatagramSocket::sendTo( const std::string & path, const char * message ) noexcept
+{
+	return sendTo( path, make_span( message, strlen(message) ).as_bytes() );
+}
+
 SocketError TcpSocket::receive( std::vector< uint8_t > & buffer, size_t size ) noexcept
 {
 	buffer.resize( size );  // allocate the needed storage
@@ -788,6 +2631,133 @@ SocketError TcpSocket::receive( std::vector< uint8_t > & buffer, size_t size ) n
 	return result;
 }
 
+SocketError UnixStreamSocket::receive( std::vector< uint8_t > & buffer, size_t size ) noexcept
+{
+	buffer.resize( size );
+	size_t received;
+	SocketError result = receive( make_span( buffer ), received );
+	buffer.resize( received );
+	return result;
+}
+
+
+//======================================================================================================================
+//  SocketManifest
+
+static bool _isValidManifestName( const std::string & name ) noexcept
+{
+	return !name.empty() && name.find_first_of( "=," ) == std::string::npos;
+}
+
+bool SocketManifest::add( const std::string & name, ASocket & socket )
+{
+	if (!_isValidManifestName( name ))
+	{
+		critical_error( "Socket name \"%s\" must not be empty and must not contain '=' or ','.", name.c_str() );
+	}
+
+	if (!socket.setInheritable( true ))
+	{
+		return false;
+	}
+
+	_entries.push_back({ name, socket.getSystemHandle() });
+	return true;
+}
+
+bool SocketManifest::find( const std::string & name, socket_t & handle ) const
+{
+	for (const Entry & entry : _entries)
+	{
+		if (entry.name == name)
+		{
+			handle = entry.handle;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string SocketManifest::toString() const
+{
+	std::string str;
+	for (const Entry & entry : _entries)
+	{
+		if (!str.empty())
+			str += ',';
+		str += entry.name;
+		str += '=';
+		str += std::to_string( (unsigned long long)entry.handle );
+	}
+	return str;
+}
+
+bool SocketManifest::parse( const std::string & str )
+{
+	std::vector< Entry > entries;
+
+	size_t pos = 0;
+	while (pos < str.size())
+	{
+		size_t end = str.find( ',', pos );
+		if (end == std::string::npos)
+			end = str.size();
+
+		size_t separator = str.find( '=', pos );
+		if (separator == std::string::npos || separator >= end || separator == pos || separator + 1 == end)
+		{
+			return false;
+		}
+
+		std::string handleStr = str.substr( separator + 1, end - separator - 1 );
+		char * handleEnd;
+		unsigned long long handle = std::strtoull( handleStr.c_str(), &handleEnd, 10 );
+		if (*handleEnd != '\0' || handle != (unsigned long long)socket_t( handle ))
+		{
+			return false;
+		}
+
+		entries.push_back({ str.substr( pos, separator - pos ), socket_t( handle ) });
+		pos = end + 1;
+	}
+
+	_entries = move( entries );
+	return true;
+}
+
+bool SocketManifest::exportToEnvironment() const
+{
+ #ifdef _WIN32
+	return ::_putenv_s( ENV_VARIABLE, toString().c_str() ) == 0;  // an empty value removes the variable
+ #else
+	if (_entries.empty())
+		return ::unsetenv( ENV_VARIABLE ) == 0;
+	return ::setenv( ENV_VARIABLE, toString().c_str(), 1 ) == 0;
+ #endif // _WIN32
+}
+
+SocketManifest SocketManifest::fromEnvironment()
+{
+	SocketManifest manifest;
+
+	const char * value = std::getenv( ENV_VARIABLE );
+	if (!value)
+	{
+		return manifest;
+	}
+
+	// the variable is gone after this, so don't keep the pointer into it
+	std::string str = value;
+ #ifdef _WIN32
+	::_putenv_s( ENV_VARIABLE, "" );
+ #else
+	::unsetenv( ENV_VARIABLE );
+ #endif // _WIN32
+
+	manifest.parse( str );  // a malformed one is as good as none
+	return manifest;
+}
+
 
 //======================================================================================================================
 //  multi-socket operations
@@ -811,7 +2781,8 @@ bool waitForAny( const std::unordered_set< ASocket * > & activeSockets, std::vec
 	timeout.tv_sec  = long( timeout_ms.count() / 1000 );
 	timeout.tv_usec = long( timeout_ms.count() % 1000 ) * 1000;
 
-	if (::select( int( maxSocketFd ), &fdset, nullptr, nullptr, &timeout ) < 0)
+	// the first argument is the highest descriptor plus one (ignored on Windows)
+	if (::select( int( maxSocketFd ) + 1, &fdset, nullptr, nullptr, &timeout ) < 0)
 	{
 		return false;
 	}
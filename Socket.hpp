@@ -15,6 +15,7 @@
 #include <CppUtils-Essential/Span.hpp>
 
 #include <chrono>  // timeout
+#include <string>  // host names, Unix socket paths
 #include <vector>  // recv
 #include <unordered_set>  // waitForAny
 
@@ -24,6 +25,9 @@ struct sockaddr;
 namespace own {
 
 
+class MirroredRingBuffer;
+
+
 //======================================================================================================================
 //  types shared between multiple socket classes
 
@@ -44,11 +48,17 @@ enum class SocketError
 	ConnectionClosed = 30,      ///< Server has closed the connection.
 	Timeout = 31,               ///< Operation timed-out.
 	WouldBlock = 32,            ///< Socket is set to non-blocking mode and there is no data in the system input buffer.
+	MalformedMessage = 33,      ///< The received data can't be split into messages, e.g. a length prefix is over the limit.
 	// errors related to opening a server
 	AlreadyOpen = 40,           ///< Opening server failed because the socket is already listening. Call close() first.
 	NotOpen = 41,               ///< Operation failed because the socket has not been opened. Call open() first.
 	BindFailed = 42,            ///< Failed to bind the socket to a specified network address and port. Call getLastSystemError() for more info.
 	ListenFailed = 43,          ///< Failed to switch the socket to a listening state. Call getLastSystemError() for more info.
+	WrongSocketType = 44,       ///< The handle to adopt is not a socket of the type or in the state required by the class.
+	// errors related to optional system features
+	NotSupported = 50,          ///< The operation is not supported by this operating system or its version.
+	// errors related to multicast
+	MembershipFailed = 60,      ///< Failed to join or leave the multicast group. Call getLastSystemError() for more info.
 
 	Other = 255                 ///< Other system error. Call getLastSystemError() for more info.
 };
@@ -78,6 +88,11 @@ class ASocket
 	bool setBlockingMode( bool enable ) noexcept;
 	bool isBlocking() const noexcept  { return _isBlocking; }
 
+	/// Whether the system handle is passed on to the programs started by this process, see SocketManifest.
+	/** On POSIX systems the handle stays open across exec() unless it is marked close-on-exec, which disabling this does.
+	  * On Windows it is inherited by the processes created with inheritance of handles enabled. */
+	bool setInheritable( bool enable ) noexcept;
+
 	/// Returns the system error code that was recorded the last time an operation on this socket failed.
 	system_error_t getLastSystemError() const noexcept  { return _lastSystemError; }
 
@@ -125,6 +140,13 @@ class TcpSocket : public ASocket
 	/// Connects to a specified endpoint determined by IP address and port.
 	SocketError connect( const IPAddr & addr, uint16_t port );
 
+	/// Connects to an endpoint that is already in the system form.
+	SocketError connect( const NativeEndpoint & endpoint );
+
+	/// Takes over an established connection whose handle this process got from elsewhere, see SocketManifest.
+	/** Fails with WrongSocketType if the handle is not a connected TCP socket, the handle then stays with the caller. */
+	SocketError adopt( socket_t handle ) noexcept;
+
 	/// Disconnects from the currently connected server.
 	SocketError disconnect() noexcept;
 
@@ -139,11 +161,22 @@ class TcpSocket : public ASocket
 	/// Sets the timeout for further receive operations.
 	bool setTimeout( std::chrono::milliseconds timeout ) noexcept;
 
+	/// Disables the Nagle's algorithm (TCP_NODELAY), so that small sends are not held back until the previous data
+	/// are acknowledged. Then each send becomes a packet of its own, unless the data are collected before sending.
+	bool setNoDelay( bool enable ) noexcept;
+
+	/// While corked (TCP_CORK), the system sends only full packets, uncorking sends out what's left, only on Linux.
+	SocketError setCork( bool enable ) noexcept;
+
 	/// Sends given number of bytes to the socket.
 	/** If the system does not accept that amount of data all at once,
 	  * it repeats the system calls until all requested data are sent. */
 	SocketError send( const_byte_span buffer ) noexcept;
 
+	/// Same as send( const_byte_span ), but tells the system that more data will follow right away (MSG_MORE),
+	/// so it may hold back the last partially filled packet until the next send. Elsewhere than on Linux it's send().
+	SocketError sendMore( const_byte_span buffer ) noexcept;
+
 	/// Convenience wrapper of send( const_byte_span ) for sending textual data.
 	/** \param[in] message null-terminated array of chars */
 	SocketError send( const char * message ) noexcept;
@@ -167,13 +200,26 @@ class TcpSocket : public ASocket
 	  * If some data has already arrived prior to this call, it returns all we got so far. */
 	SocketError receiveOnce( std::vector< uint8_t > & buffer ) noexcept;
 
+	/// Same as receiveOnce( std::vector< uint8_t > & ), but receives directly into the buffer,
+	/// up to its size, without any intermediate copy.
+	SocketError receiveOnce( byte_span buffer, size_t & received ) noexcept;
+
+	/// Performs exactly one receive system call into all the free space of the ring and appends what it got.
+	/** The ring must not be full, a parser on top of it must limit the size of the messages below its capacity.
+	  * Fails with SocketError::NotOpen when the ring has not been allocated.
+	  * \param[out] received how many bytes were appended */
+	SocketError receiveInto( MirroredRingBuffer & ring, size_t & received ) noexcept;
+
  protected:
 
 	 // allow creating socket object from already initialized socket handle, but only for TcpServerSocket
+	 // and for UnixStreamSocket, which receives it from another process
 	 friend class TcpServerSocket;
+	 friend class UnixStreamSocket;
 	 TcpSocket( socket_t sock ) noexcept : ASocket( sock ) {}
 
-	 SocketError _connect( int family, int addrlen, struct sockaddr * addr ) noexcept;
+	 SocketError _connect( int family, int addrlen, const struct sockaddr * addr ) noexcept;
+	 SocketError _send( const_byte_span buffer, int flags ) noexcept;
 
 };
 
@@ -198,6 +244,12 @@ class TcpServerSocket : public ASocket
 	/// Opens a TCP server on selected port.
 	SocketError open( uint16_t port ) noexcept;
 
+	/// Takes over a listening socket whose handle this process got from elsewhere, instead of opening a new one.
+	/** This is how a new process of a server continues on the socket of the old one, see SocketManifest.
+	  * The connections waiting in the queue of the socket are not lost and the port is never closed.
+	  * Fails with WrongSocketType if the handle is not a listening TCP socket, the handle then stays with the caller. */
+	SocketError adopt( socket_t handle ) noexcept;
+
 	SocketError close() noexcept;
 
 	bool isOpen() const noexcept;
@@ -206,6 +258,20 @@ class TcpServerSocket : public ASocket
 	/** If the server is closed by another thread or an error occurs, the returned socket is invalid and isAccepted() returns false. */
 	TcpSocket accept( Endpoint & endpoint );
 
+	/// Same as accept( Endpoint & ), but stores the client address in the system form without any conversion.
+	TcpSocket accept( NativeEndpoint & endpoint );
+
+};
+
+
+//======================================================================================================================
+/// One datagram of a batch receive, see UdpSocket::recvBatch().
+
+struct UdpDatagram
+{
+	byte_span buffer;        ///< [in] where to store the data, the rest of a longer datagram is discarded
+	size_t size = 0;         ///< [out] how many bytes were received
+	NativeEndpoint sender;   ///< [out] where the datagram came from
 };
 
 
@@ -228,10 +294,34 @@ class UdpSocket : public ASocket
 	/// Opens an UDP socket on selected port.
 	SocketError open( uint16_t port = 0 ) noexcept;
 
+	/// Opens an UDP socket bound to the local address and port, the IP version of the socket is the one of the address.
+	/** Bind to the wildcard address (0.0.0.0 or ::) to receive from all the interfaces, or to the address of one of them.
+	  * With shareAddress other sockets can bind the same address and port, which is how more subscribers of the same
+	  * multicast group on one machine get each their own copy of every datagram (see joinGroup()). */
+	SocketError open( const NativeEndpoint & local, bool shareAddress = false ) noexcept;
+	SocketError open( const Endpoint & local, bool shareAddress = false );
+
+	/// Opens the socket as one of a group of sockets sharing the port (SO_REUSEPORT), only on Linux.
+	/** The system delivers each incoming datagram to one socket of the group, chosen by the hash of the sender address,
+	  * so each socket can be served by its own thread and all the datagrams of one sender go to the same socket. */
+	SocketError openLoadBalanced( uint16_t port ) noexcept;
+
+	/// Same as openLoadBalanced( uint16_t ), but bound to the local address, e.g. the wildcard one to receive
+	/// from all the interfaces. All the sockets of the group must be bound to the same address and port.
+	SocketError openLoadBalanced( const NativeEndpoint & local ) noexcept;
+
+	/// Takes over a UDP socket whose handle this process got from elsewhere, instead of opening a new one.
+	/** The datagrams waiting in the receive queue of the socket are not lost, see SocketManifest.
+	  * Fails with WrongSocketType if the handle is not a UDP socket, the handle then stays with the caller. */
+	SocketError adopt( socket_t handle ) noexcept;
+
 	SocketError close() noexcept;
 
 	bool isOpen() const noexcept;
 
+	/// Sets the timeout for further receive operations.
+	bool setTimeout( std::chrono::milliseconds timeout ) noexcept;
+
 	/// Sends a datagram to a specified address and port.
 	SocketError sendTo( const Endpoint & endpoint, const_byte_span buffer );
 
@@ -239,9 +329,404 @@ class UdpSocket : public ASocket
 	/** \param[in] message null-terminated array of chars */
 	SocketError sendTo( const Endpoint & endpoint, const char * message );
 
+	/// Sends a datagram to an endpoint that is already in the system form, without any conversion.
+	/** Prefer this for peers that are sent to repeatedly, the Endpoint version has to convert the address on every call. */
+	SocketError sendTo( const NativeEndpoint & endpoint, const_byte_span buffer );
+
+	/// Convenience wrapper of sendTo( const NativeEndpoint &, const_byte_span ) for sending textual data.
+	/** \param[in] message null-terminated array of chars */
+	SocketError sendTo( const NativeEndpoint & endpoint, const char * message );
+
 	/// Waits for an incomming datagram and returns the packet data and the address and port it came from.
 	SocketError recvFrom( Endpoint & endpoint, byte_span buffer, size_t & received );
 
+	/// Same as recvFrom( Endpoint &, ... ), but the system stores the sender address directly into the endpoint.
+	/** The endpoint can be passed to sendTo() to reply without any conversion. */
+	SocketError recvFrom( NativeEndpoint & endpoint, byte_span buffer, size_t & received );
+
+	/// Receives up to datagrams.size() datagrams with a single system call.
+	/** Waits for the first datagram and then takes all the others that are already waiting, without further waiting.
+	  * On systems without the batch call (recvmmsg) only one datagram is received per call. */
+	SocketError recvBatch( span< UdpDatagram > datagrams, size_t & received );
+
+	/// Enables counting of the datagrams the system dropped, because the receive queue of this socket was full.
+	/** Only on Linux (SO_RXQ_OVFL), the counter is updated by recvBatch(). */
+	SocketError setDropCounting( bool enable ) noexcept;
+
+	/// The number of datagrams dropped since setDropCounting() was enabled, as last reported by the system.
+	uint32_t droppedCount() const noexcept  { return _droppedCount; }
+
+	/// Sends the buffer as a sequence of datagrams of segmentSize bytes each, the last one may be shorter.
+	/** On Linux the system splits the buffer itself (UDP_SEGMENT), so up to 64 datagrams pass through the network stack
+	  * as one, which is several times cheaper than sending them one by one. Where this is not available, the datagrams
+	  * are sent one by one, with the same result for the receiver. */
+	SocketError sendSegmented( const NativeEndpoint & endpoint, const_byte_span buffer, size_t segmentSize );
+
+	/// Lets the system merge consecutive datagrams from the same sender into one buffer (UDP_GRO), only on Linux.
+	/** Once enabled, receive only with recvCoalesced(), otherwise the boundaries between the datagrams get lost. */
+	SocketError setReceiveCoalescing( bool enable ) noexcept;
+
+	/// Receives one or more datagrams of the same sender merged into the buffer.
+	/** All the datagrams have segmentSize bytes, except the last one, which may be shorter. Without coalescing enabled,
+	  * this receives a single datagram and segmentSize equals received. The buffer should have at least 64 kB,
+	  * otherwise the system has to truncate the merged datagrams. */
+	SocketError recvCoalesced( NativeEndpoint & endpoint, byte_span buffer, size_t & received, size_t & segmentSize );
+
+	/// Lets the datagrams sent by sendAt() carry the time they should leave at (SO_TXTIME), only on Linux.
+	/** The time is honoured only by the fq and etf queueing disciplines of the outgoing network interface,
+	  * with any other one the datagrams leave immediately. */
+	SocketError enableTransmitTime() noexcept;
+
+	/// Hands the datagram to the system, which sends it at the departure time, see enableTransmitTime().
+	SocketError sendAt( const NativeEndpoint & endpoint, const_byte_span buffer, std::chrono::steady_clock::time_point departure );
+
+	//-- multicast ----------------------------------------------------------------------------------------------------
+
+	/// Starts receiving the datagrams sent to the multicast group, which can be IPv4 or IPv6, like the socket.
+	/** The socket must be bound to the port the group is sent to and to the wildcard address,
+	  * see open( const NativeEndpoint &, bool ). Joining the same group again on another interface is allowed.
+	  * \param[in] interfaceIndex network interface to receive on (if_nametoindex()), 0 lets the system choose one */
+	SocketError joinGroup( const IPAddr & group, uint32_t interfaceIndex = 0 );
+
+	SocketError leaveGroup( const IPAddr & group, uint32_t interfaceIndex = 0 );
+
+	/// Source-specific multicast (SSM), starts receiving the datagrams sent to the group only from the source.
+	/** Can be called repeatedly to add more sources of the same group. */
+	SocketError joinSourceGroup( const IPAddr & group, const IPAddr & source, uint32_t interfaceIndex = 0 );
+
+	SocketError leaveSourceGroup( const IPAddr & group, const IPAddr & source, uint32_t interfaceIndex = 0 );
+
+	/// Whether the multicast datagrams sent by this socket are delivered also to the group members on this machine.
+	/** Enabled by default. Datagrams sent through the loopback interface come back regardless of this. */
+	SocketError setMulticastLoopback( bool enable ) noexcept;
+
+	/// How many routers the multicast datagrams sent by this socket can pass (TTL or hop limit).
+	/** The default is 1, which keeps them in the local network. */
+	SocketError setMulticastTtl( uint8_t ttl ) noexcept;
+
+	/// Sends the multicast datagrams through the interface, instead of the one chosen by the routing table.
+	/** \param[in] interfaceIndex see if_nametoindex(), 0 restores the choice by the routing table */
+	SocketError setMulticastInterface( uint32_t interfaceIndex ) noexcept;
+
+ protected:
+
+	enum class PortSharing
+	{
+		None,
+		WithPeers,     ///< SO_REUSEADDR, the system delivers datagrams to the connected sockets of the peers
+		LoadBalanced,  ///< SO_REUSEPORT, the system distributes the datagrams between the sockets
+		Multicast,     ///< SO_REUSEADDR, each of the sockets gets its own copy of every multicast datagram
+	};
+	SocketError _open( uint16_t port, PortSharing sharing ) noexcept;
+	/// \param[in] local where to bind the socket, nullptr leaves the binding to the first send
+	SocketError _open( const NativeEndpoint * local, PortSharing sharing ) noexcept;
+
+	SocketError _changeMembership( bool join, const IPAddr & group, const IPAddr * source, uint32_t interfaceIndex );
+
+	uint32_t _droppedCount;
+
+};
+
+
+//======================================================================================================================
+/// UDP socket connected to a single remote peer.
+/** The system resolves the route and the address of the peer only once in connect(), instead of in every sendTo(),
+  * and it discards datagrams from any other sender before they reach the application.
+  * If the peer's port is closed, the system may report it on a later send or receive. */
+
+class UdpPeer : public ASocket
+{
+
+ public:
+
+	UdpPeer() noexcept;
+	~UdpPeer() noexcept;
+
+	UdpPeer( const UdpPeer & other ) = delete;
+	UdpPeer( UdpPeer && other ) noexcept;
+	UdpPeer & operator=( const UdpPeer & other ) = delete;
+	UdpPeer & operator=( UdpPeer && other ) noexcept;
+
+	/// Opens a new socket and connects it to the remote endpoint.
+	/** \param[in] localPort local port to send from, 0 lets the system choose one */
+	SocketError connect( const NativeEndpoint & remote, uint16_t localPort = 0 );
+	SocketError connect( const Endpoint & remote, uint16_t localPort = 0 );
+
+	SocketError disconnect() noexcept;
+
+	bool isConnected() const noexcept;
+
+	/// This needs to be checked after UdpPeerServer::acceptPeer().
+	bool isAccepted() const noexcept  { return isConnected(); }
+
+	operator bool() const noexcept { return isConnected(); }
+
+	/// the endpoint this socket is connected to
+	const NativeEndpoint & remote() const noexcept  { return _remote; }
+
+	/// Sets the timeout for further receive operations.
+	bool setTimeout( std::chrono::milliseconds timeout ) noexcept;
+
+	/// Sends one datagram to the connected peer.
+	SocketError send( const_byte_span buffer ) noexcept;
+
+	/// Convenience wrapper of send( const_byte_span ) for sending textual data.
+	/** \param[in] message null-terminated array of chars */
+	SocketError send( const char * message ) noexcept;
+
+	/// Waits for one datagram from the connected peer.
+	/** Returns ConnectionClosed when the system learned that the peer's port is closed, the socket stays usable. */
+	SocketError receive( byte_span buffer, size_t & received ) noexcept;
+
+ protected:
+
+	friend class UdpPeerServer;
+
+	SocketError _connect( const NativeEndpoint & remote, const NativeEndpoint * local, bool shareAddr ) noexcept;
+
+	NativeEndpoint _remote;
+
+};
+
+
+//======================================================================================================================
+/// UDP server that hands each peer over to its own connected socket.
+/** The server receives the first datagram of a new peer through the inherited recvFrom(), and then acceptPeer() creates
+  * a socket bound to the same local address and port and connected to the peer. The system then delivers the further
+  * datagrams of that peer only to the connected socket, so each peer can be served by a different thread, and with
+  * multiple receive queues the system can steer each flow to a different CPU.
+  * Datagrams that the peer sent before acceptPeer() completed may still arrive to the server socket. */
+
+class UdpPeerServer : public UdpSocket
+{
+
+ public:
+
+	/// Opens the server on selected port, allowing the peer sockets to share it.
+	SocketError open( uint16_t port ) noexcept;
+
+	/// Opens the server on the local address and port, e.g. the wildcard one to accept peers from all the interfaces.
+	/** The peer sockets are bound to the same address and port. */
+	SocketError open( const NativeEndpoint & local ) noexcept;
+
+	/// Creates a socket connected to the peer that shares the local address and port of this server.
+	/** If it fails, the returned socket is invalid, isAccepted() returns false and getLastSystemError() tells why. */
+	UdpPeer acceptPeer( const NativeEndpoint & remote );
+
+};
+
+
+//======================================================================================================================
+//  Unix domain sockets
+//
+//  Sockets for communication between processes on the same machine, which bypass the whole TCP/IP stack.
+//  They are addressed by a path in the file system, or by a name in the abstract namespace, written as a path
+//  starting with '@', which creates no file and disappears with the last socket using it (only on Linux).
+
+enum class UnixSocketType
+{
+	Stream,     ///< stream of bytes like TCP (SOCK_STREAM)
+	SeqPacket,  ///< reliable and ordered like Stream, but it keeps the boundaries of the messages (SOCK_SEQPACKET)
+};
+
+/// Unix domain socket connected to another process, the counterpart of TcpSocket.
+/** With UnixSocketType::SeqPacket each send() is delivered as one message and each receiveOnce() returns exactly one
+  * message, while receive() still fills the whole buffer. */
+
+class UnixStreamSocket : public ASocket
+{
+
+ public:
+
+	UnixStreamSocket() noexcept;
+	~UnixStreamSocket() noexcept;
+
+	UnixStreamSocket( const UnixStreamSocket & other ) = delete;
+	UnixStreamSocket( UnixStreamSocket && other ) noexcept;
+	UnixStreamSocket & operator=( const UnixStreamSocket & other ) = delete;
+	UnixStreamSocket & operator=( UnixStreamSocket && other ) noexcept;
+
+	/// Connects to the UnixServerSocket listening on the path, which must be of the same type.
+	SocketError connect( const std::string & path, UnixSocketType type = UnixSocketType::Stream ) noexcept;
+
+	SocketError disconnect() noexcept;
+
+	bool isConnected() const noexcept;
+
+	/// This needs to be checked after UnixServerSocket::accept().
+	bool isAccepted() const noexcept;
+
+	operator bool() const noexcept { return isAccepted(); }
+
+	/// Sets the timeout for further receive operations.
+	bool setTimeout( std::chrono::milliseconds timeout ) noexcept;
+
+	/// Sends the whole buffer, see TcpSocket::send().
+	SocketError send( const_byte_span buffer ) noexcept;
+
+	/// Convenience wrapper of send( const_byte_span ) for sending textual data.
+	/** \param[in] message null-terminated array of chars */
+	SocketError send( const char * message ) noexcept;
+
+	/// Receives until the whole buffer is filled, see TcpSocket::receive().
+	SocketError receive( byte_span buffer, size_t & received ) noexcept;
+
+	/// Receives the given number of bytes, see TcpSocket::receive().
+	SocketError receive( std::vector< uint8_t > & buffer, size_t size ) noexcept;
+
+	/// Performs exactly one receive system call, with SeqPacket it receives one message.
+	/** A message longer than the buffer is truncated. */
+	SocketError receiveOnce( byte_span buffer, size_t & received ) noexcept;
+
+	/// Performs exactly one receive system call, with SeqPacket it receives one message of up to 64 kB.
+	SocketError receiveOnce( std::vector< uint8_t > & buffer ) noexcept;
+
+	/// Hands the connection over to the process on the other side together with the message (SCM_RIGHTS), not on Windows.
+	/** On success the socket in this process is closed without shutting the connection down and becomes invalid.
+	  * The message must not be empty, because the handle travels with its first byte. Use SeqPacket, so that each
+	  * connection arrives exactly with its own message. */
+	SocketError sendSocket( TcpSocket & connection, const_byte_span message ) noexcept;
+
+	/// Receives a connection passed by sendSocket() and the message that came with it, like receiveOnce().
+	/** The connection socket must not be connected yet. If the message came without a connection, or with a handle
+	  * that is not a TCP connection, which is then closed, it stays invalid and isAccepted() returns false. */
+	SocketError receiveSocket( TcpSocket & connection, byte_span message, size_t & received ) noexcept;
+
+ protected:
+
+	friend class UnixServerSocket;
+	UnixStreamSocket( socket_t sock ) noexcept : ASocket( sock ) {}
+
+};
+
+/// Listens for connections of UnixStreamSocket, the counterpart of TcpServerSocket.
+
+class UnixServerSocket : public ASocket
+{
+
+ public:
+
+	UnixServerSocket() noexcept;
+	~UnixServerSocket() noexcept;
+
+	UnixServerSocket( const UnixServerSocket & other ) = delete;
+	UnixServerSocket( UnixServerSocket && other ) noexcept;
+	UnixServerSocket & operator=( const UnixServerSocket & other ) = delete;
+	UnixServerSocket & operator=( UnixServerSocket && other ) noexcept;
+
+	/// Creates the socket file on the path and starts listening on it.
+	/** Fails with BindFailed when the file already exists, for example left by a process that crashed. */
+	SocketError open( const std::string & path, UnixSocketType type = UnixSocketType::Stream ) noexcept;
+
+	/// Stops listening and removes the socket file.
+	SocketError close() noexcept;
+
+	bool isOpen() const noexcept;
+
+	/// Waits for an incomming connection, see TcpServerSocket::accept().
+	UnixStreamSocket accept();
+
+ private:
+
+	std::string _path;  ///< the file to be removed on close, empty in the abstract namespace
+
+};
+
+/// Unix domain datagram socket, the counterpart of UdpSocket.
+/** Unlike UDP, the datagrams are never lost or reordered, when the receiver is not fast enough, the sender blocks. */
+
+class UnixDatagramSocket : public ASocket
+{
+
+ public:
+
+	UnixDatagramSocket() noexcept;
+	~UnixDatagramSocket() noexcept;
+
+	UnixDatagramSocket( const UnixDatagramSocket & other ) = delete;
+	UnixDatagramSocket( UnixDatagramSocket && other ) noexcept;
+	UnixDatagramSocket & operator=( const UnixDatagramSocket & other ) = delete;
+	UnixDatagramSocket & operator=( UnixDatagramSocket && other ) noexcept;
+
+	/// Opens the socket and binds it to the path, so that others can send to it.
+	/** Without a path the socket can only send, except on Linux, where it gets a random name in the abstract namespace,
+	  * so that the receivers can reply. The file is removed again on close. */
+	SocketError open( const std::string & path = std::string() ) noexcept;
+
+	SocketError close() noexcept;
+
+	bool isOpen() const noexcept;
+
+	/// Sets the timeout for further receive operations.
+	bool setTimeout( std::chrono::milliseconds timeout ) noexcept;
+
+	/// Sends a datagram to the socket bound to the path.
+	SocketError sendTo( const std::string & path, const_byte_span buffer ) noexcept;
+
+	/// Convenience wrapper of sendTo( const std::string &, const_byte_span ) for sending textual data.
+	/** \param[in] message null-terminated array of chars */
+	SocketError sendTo( const std::string & path, const char * message ) noexcept;
+
+	/// Waits for an incomming datagram and returns the path of the sender, which is empty if the sender is not bound.
+	SocketError recvFrom( std::string & path, byte_span buffer, size_t & received );
+
+ private:
+
+	std::string _path;  ///< the file to be removed on close, empty in the abstract namespace
+
+};
+
+
+//======================================================================================================================
+/// List of sockets handed over to a new process of the same program, which is how a server restarts with a new binary
+/// without closing its ports.
+/** The old process adds the sockets under names and exports the list into its environment, from where the new process
+  * it starts inherits it together with the handles. The new process then finds the handles by the names
+  * and adopts them, e.g. by TcpServerSocket::adopt(), which makes them not inheritable again, so that they don't leak
+  * into the other programs the new process starts. Both processes can accept connections from the same socket
+  * at the same time, so the old one closes its sockets only after the new one is ready.
+  * Handles that the new process does not adopt stay open until it exits. */
+
+class SocketManifest
+{
+
+ public:
+
+	/// Name of the environment variable holding the list.
+	static constexpr const char * ENV_VARIABLE = "CPPUTILS_INHERITED_SOCKETS";
+
+	/// Adds the socket to the list and makes its handle inheritable.
+	/** The name must not be empty and must not contain '=' or ','. */
+	bool add( const std::string & name, ASocket & socket );
+
+	/// Finds the handle added under the name, returns false if there is none.
+	bool find( const std::string & name, socket_t & handle ) const;
+
+	bool empty() const noexcept  { return _entries.empty(); }
+
+	/// The list in the form "name=handle,name=handle".
+	std::string toString() const;
+
+	/// Reads the list from the form produced by toString(), returns false if it is malformed.
+	bool parse( const std::string & str );
+
+	/// Puts the list into the environment of this process, from where the processes started afterwards inherit it.
+	bool exportToEnvironment() const;
+
+	/// Takes the list left by the previous process and removes it from the environment,
+	/// so that it is not inherited further by the processes started by this one.
+	/** The list is empty if this process was not started by a previous process of the program. */
+	static SocketManifest fromEnvironment();
+
+ private:
+
+	struct Entry
+	{
+		std::string name;
+		socket_t handle;
+	};
+	std::vector< Entry > _entries;
+
 };
 
 
@@ -0,0 +1,126 @@
+//======================================================================================================================
+// Project: CppUtils
+//----------------------------------------------------------------------------------------------------------------------
+// Author:      Jan Broz (Youda008)
+// Description: command-line tool converting a textual prefix list into a memory-mappable prefix database
+//======================================================================================================================
+
+#include "../PrefixDatabase.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+
+using namespace own;
+
+
+static void printUsage( const char * exeName )
+{
+	fprintf( stderr,
+		"Usage: %s <input.txt> <output.db>\n"
+		"  Each line of the input contains a prefix and optionally a number that will be its value, for example\n"
+		"    10.0.0.0/8 64512\n"
+		"    2001:db8::/32 64513\n"
+		"  Prefixes without a value get the value 1. Empty lines and lines starting with '#' are ignored.\n"
+		"  If a prefix is listed multiple times, the last value is used. Values are stored as 32-bit unsigned integers,\n"
+		"  load the database with PrefixDatabase< uint32_t >.\n",
+		exeName
+	);
+}
+
+static std::string_view trim( std::string_view str ) noexcept
+{
+	size_t begin = str.find_first_not_of( " \t\r" );
+	if (begin == std::string_view::npos)
+		return {};
+	size_t end = str.find_last_not_of( " \t\r" );
+	return str.substr( begin, end - begin + 1 );
+}
+
+static bool parseValue( std::string_view str, uint32_t & value ) noexcept
+{
+	if (str.empty() || str.size() > 10)
+		return false;
+	uint64_t result = 0;
+	for (char c : str)
+	{
+		if (c < '0' || c > '9')
+			return false;
+		result = result * 10 + uint64_t( c - '0' );
+	}
+	if (result > UINT32_MAX)
+		return false;
+	value = uint32_t( result );
+	return true;
+}
+
+int main( int argc, char * argv [] )
+{
+	if (argc != 3)
+	{
+		printUsage( argv[0] );
+		return 1;
+	}
+	const char * inputPath = argv[1];
+	const char * outputPath = argv[2];
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::ifstream input( inputPath );
+	if (!input)
+	{
+		fprintf( stderr, "cannot open %s\n", inputPath );
+		return 1;
+	}
+
+	std::vector< std::pair< IPPrefix, uint32_t > > entries;
+	std::string line;
+	size_t lineNum = 0;
+	while (std::getline( input, line ))
+	{
+		++lineNum;
+		std::string_view content = trim( line );
+		if (content.empty() || content[0] == '#')
+			continue;
+
+		size_t separatorPos = content.find_first_of( " \t" );
+		std::string_view prefixStr = content.substr( 0, separatorPos );
+		std::string_view valueStr = separatorPos != std::string_view::npos ? trim( content.substr( separatorPos ) ) : std::string_view();
+
+		std::optional< IPPrefix > prefix = IPPrefix::parse( prefixStr );
+		uint32_t value = 1;
+		if (!prefix || (!valueStr.empty() && !parseValue( valueStr, value )))
+		{
+			fprintf( stderr, "%s:%zu: invalid line: %s\n", inputPath, lineNum, line.c_str() );
+			return 1;
+		}
+		entries.emplace_back( *prefix, value );
+	}
+	if (input.bad())
+	{
+		fprintf( stderr, "error while reading %s\n", inputPath );
+		return 1;
+	}
+
+	PrefixTable< uint32_t > table( move( entries ) );
+
+	PrefixDatabase< uint32_t > db;
+	PrefixDbError error = db.create( outputPath, table );
+	if (error == PrefixDbError::Success)
+		error = db.verify();
+	if (error != PrefixDbError::Success)
+	{
+		fprintf( stderr, "cannot create %s: %s (%s)\n", outputPath, enumString( error ), getErrorString( db.getLastSystemError() ).c_str() );
+		return 1;
+	}
+
+	double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+	fprintf( stderr, "%s: %zu prefixes, %.1f MB of lookup structures, built in %.2f s\n",
+		outputPath, table.size(), double( table.memoryUsage() ) / 1e6, seconds );
+	return 0;
+}